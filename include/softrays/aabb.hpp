@@ -0,0 +1,96 @@
+#pragma once
+
+#include "math.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace softrays {
+
+// Axis-aligned bounding box, one Interval per axis
+struct Aabb {
+  Interval X = Interval::Empty;
+  Interval Y = Interval::Empty;
+  Interval Z = Interval::Empty;
+
+  [[nodiscard]] static Aabb FromPoints(const Point3& a, const Point3& b) noexcept
+  {
+    return {
+        .X = {.Min = std::fmin(a.x, b.x), .Max = std::fmax(a.x, b.x)},
+        .Y = {.Min = std::fmin(a.y, b.y), .Max = std::fmax(a.y, b.y)},
+        .Z = {.Min = std::fmin(a.z, b.z), .Max = std::fmax(a.z, b.z)},
+    };
+  }
+
+  [[nodiscard]] static Aabb Merge(const Aabb& a, const Aabb& b) noexcept
+  {
+    auto merge = [](const Interval& i, const Interval& j) { return Interval{.Min = std::fmin(i.Min, j.Min), .Max = std::fmax(i.Max, j.Max)}; };
+    return {.X = merge(a.X, b.X), .Y = merge(a.Y, b.Y), .Z = merge(a.Z, b.Z)};
+  }
+
+  [[nodiscard]] const Interval& Axis(int axis) const noexcept
+  {
+    return axis == 0 ? X : (axis == 1 ? Y : Z);
+  }
+
+  [[nodiscard]] bool IsEmpty() const noexcept { return X.Min > X.Max || Y.Min > Y.Max || Z.Min > Z.Max; }
+  [[nodiscard]] bool IsFinite() const noexcept
+  {
+    return std::isfinite(X.Size()) && std::isfinite(Y.Size()) && std::isfinite(Z.Size());
+  }
+
+  [[nodiscard]] Point3 Centroid() const noexcept
+  {
+    return {.x = (X.Min + X.Max) * 0.5, .y = (Y.Min + Y.Max) * 0.5, .z = (Z.Min + Z.Max) * 0.5};
+  }
+
+  [[nodiscard]] int LongestAxis() const noexcept
+  {
+    if (X.Size() > Y.Size()) {
+      return X.Size() > Z.Size() ? 0 : 2;
+    }
+    return Y.Size() > Z.Size() ? 1 : 2;
+  }
+
+  [[nodiscard]] double SurfaceArea() const noexcept
+  {
+    if (IsEmpty()) {
+      return 0.0;
+    }
+    return 2 * ((X.Size() * Y.Size()) + (Y.Size() * Z.Size()) + (Z.Size() * X.Size()));
+  }
+
+  // Slab test; `inverse_direction` is 1 / ray direction, computed once per ray.
+  // Narrows `ray_time` to the part of the ray inside the box
+  [[nodiscard]] bool Hit(const Point3& origin, const Vec3& inverse_direction, Interval& ray_time) const noexcept
+  {
+    return HitSlab(X, origin.x, inverse_direction.x, ray_time) && HitSlab(Y, origin.y, inverse_direction.y, ray_time)
+        && HitSlab(Z, origin.z, inverse_direction.z, ray_time);
+  }
+
+  [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time) const noexcept
+  {
+    return Hit(ray.Origin, InverseDirection(ray.Direction), ray_time);
+  }
+
+  [[nodiscard]] static Vec3 InverseDirection(const Vec3& direction) noexcept
+  {
+    return {.x = 1.0 / direction.x, .y = 1.0 / direction.y, .z = 1.0 / direction.z};
+  }
+
+  private:
+  static bool HitSlab(const Interval& slab, double origin, double inverse_direction, Interval& ray_time) noexcept
+  {
+    auto t0 = (slab.Min - origin) * inverse_direction;
+    auto t1 = (slab.Max - origin) * inverse_direction;
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+    // Written so a NaN (a ray in the plane of the slab) leaves the interval alone
+    ray_time.Min = t0 > ray_time.Min ? t0 : ray_time.Min;
+    ray_time.Max = t1 < ray_time.Max ? t1 : ray_time.Max;
+    return ray_time.Min <= ray_time.Max;
+  }
+};
+}
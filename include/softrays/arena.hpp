@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace softrays {
+
+// Bump allocator for a scene's objects and materials. Everything made by one arena sits in a few
+// large blocks, in creation order, and goes away in one Reset.
+//
+// Make returns a std::shared_ptr so arena objects plug into HittableList, Sphere and HitData
+// unchanged, but the pointer shares no control block: it owns nothing, copying it costs no atomic
+// reference counting, and it dangles once the arena is Reset or destroyed. Keep the arena alive for
+// as long as anything traces the scene.
+class SceneArena {
+  public:
+  explicit SceneArena(std::size_t block_size = 64 * 1024);  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  SceneArena(const SceneArena&) = delete;
+  SceneArena& operator=(const SceneArena&) = delete;
+  SceneArena(SceneArena&&) = delete;
+  SceneArena& operator=(SceneArena&&) = delete;
+  ~SceneArena() { Reset(); }
+
+  template <typename T, typename... Args>
+  [[nodiscard]] std::shared_ptr<T> Make(Args&&... args)
+  {
+    void* memory = Allocate(sizeof(T), alignof(T));
+    T* object = ::new (memory) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      Destructors.push_back({.Object = object, .Destroy = [](void* pointer) { static_cast<T*>(pointer)->~T(); }});
+    }
+    // Aliasing an empty shared_ptr: a non-null pointer with no owner
+    return std::shared_ptr<T>(std::shared_ptr<void>{}, object);
+  }
+
+  // Destroys every object, newest first, and keeps the biggest block for the next scene
+  void Reset() noexcept;
+
+  [[nodiscard]] std::size_t BytesUsed() const noexcept;
+  [[nodiscard]] std::size_t BlockCount() const noexcept { return Blocks.size(); }
+  [[nodiscard]] bool Owns(const void* object) const noexcept;
+
+  private:
+  struct Block {
+    std::unique_ptr<std::byte[]> Memory;  // NOLINT(cppcoreguidelines-avoid-c-arrays, modernize-avoid-c-arrays)
+    std::size_t Size{};
+    std::size_t Used{};
+  };
+  struct Destructor {
+    void* Object{};
+    void (*Destroy)(void*){};
+  };
+
+  std::size_t NextBlockSize;
+  std::vector<Block> Blocks;
+  std::vector<Destructor> Destructors;
+
+  [[nodiscard]] void* Allocate(std::size_t size, std::size_t alignment);
+};
+}
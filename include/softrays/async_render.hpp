@@ -0,0 +1,85 @@
+#pragma once
+
+#include "raytracer.hpp"
+#include "thread_pool.hpp"
+#include "utility.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace softrays {
+
+// Renders a RayTracer's frame tile by tile on a thread pool without blocking the caller, which
+// collects finished tiles as they arrive (or is called back per tile) and can cancel or replace the
+// job at any time.
+class AsyncRenderer {
+  public:
+  // Runs on the worker that finished the tile, after its pixels are in the raytracer's PixelData and
+  // before Wait counts the tile as done
+  using TileCallback = std::function<void(const TileRect&)>;
+
+  // Zero threads means one per hardware thread
+  explicit AsyncRenderer(unsigned threads = 0);
+  AsyncRenderer(const AsyncRenderer&) = delete;
+  AsyncRenderer& operator=(const AsyncRenderer&) = delete;
+  AsyncRenderer(AsyncRenderer&&) = delete;
+  AsyncRenderer& operator=(AsyncRenderer&&) = delete;
+  ~AsyncRenderer();
+
+  // Cancels the job in flight, if any, then sets up `raytracer`'s frame and queues its tiles,
+  // nearest the centre of the frame first. The tiles are traced on a copy of `raytracer` taken here
+  // and copied back into it as they finish, so its camera and settings may change for the next job
+  // straight away. Its frame is only safe to read once the job is done or cancelled (see
+  // TakeCompletedTiles for the frame so far), and it must outlive the job
+  void Start(RayTracer& raytracer, int tile_size = 32, TileCallback on_tile = {});
+  // Same, but each tile is first previewed coarse to fine (see RayTracer::RenderPreviewTile, every
+  // step of PreviewSteps) and only then path traced. Previews run ahead of any full tile, so the
+  // whole frame shows at 1/16 resolution within milliseconds. Each pass is delivered as a tile
+  void StartWithPreview(RayTracer& raytracer, int tile_size = 32, TileCallback on_tile = {});
+  // Stops the current job without waiting for it: workers drop their queued tiles, and the tiles
+  // they are tracing finish on the job's copy of the raytracer and are thrown away. Afterwards the
+  // raytracer's frame is no longer written
+  void Cancel();
+  // Same, then waits for the tiles still being traced, for when what the job's copy shares with the
+  // raytracer (the objects of its world, its Guide or Irradiance cache) is about to change or go away
+  void CancelAndWait();
+  // Blocks until every tile of the current job has been traced
+  void Wait();
+
+  // Tiles finished since the last call, in the order they finished
+  [[nodiscard]] std::vector<TileRect> TakeCompletedTiles();
+  // Same, also copying those tiles into `rgba`, the frame as RayTracer::GetRGBAData lays it out
+  // (resized to match). The workers convert each tile as it finishes, so unlike reading the
+  // raytracer while the job runs, this never sees a tile part way through its next pass
+  [[nodiscard]] std::vector<TileRect> TakeCompletedTiles(std::vector<std::uint8_t>& rgba);
+  [[nodiscard]] std::size_t TilesRemaining() const;
+  [[nodiscard]] bool Done() const { return TilesRemaining() == 0; }
+  // Increases with every Start, so callers can tell jobs apart
+  [[nodiscard]] std::uint64_t Generation() const noexcept { return CurrentGeneration.load(); }
+
+  static constexpr std::array<int, 4> PreviewSteps{16, 8, 4, 2};
+
+  private:
+  mutable std::mutex Mutex;
+  std::condition_variable TileFinished;
+  std::vector<TileRect> Completed;
+  std::size_t Remaining{};
+  std::vector<std::uint8_t> Rgba;  // The job's frame as of the tiles finished so far
+  int Width{};  // Of the job's frame
+  std::atomic<std::uint64_t> CurrentGeneration{};
+  ThreadPool Pool;  // Declared last so its workers stop before the state they use goes away
+
+  void Queue(RayTracer& raytracer, int tile_size, TileCallback on_tile, bool preview);
+  // Runs `pass` of `tile` (an index into PreviewSteps, or its size for the full render) and queues
+  // the tile's next pass, so one tile's passes never overlap
+  void RunPass(RayTracer& raytracer, std::shared_ptr<RayTracer> frame, const TileRect& tile, std::size_t pass, std::uint64_t generation,
+               const TileCallback& on_tile);
+};
+}
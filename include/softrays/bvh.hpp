@@ -0,0 +1,116 @@
+#pragma once
+
+#include "aabb.hpp"
+#include "math.hpp"
+#include "utility.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace softrays {
+
+// Bounding volume hierarchy, flattened depth-first: an interior node's first child is the node
+// right after it, so one subtree is contiguous in memory (and on disk, see MappedWorld).
+struct BvhNode {
+  Aabb Bounds;
+  std::uint32_t Offset{};  // Leaf: first primitive. Interior: index of the second child
+  std::uint16_t Count{};  // Primitives in a leaf, 0 for interior nodes
+  std::uint16_t Axis{};  // Split axis of an interior node; its first child holds the lower centroids
+
+  [[nodiscard]] bool IsLeaf() const noexcept { return Count != 0; }
+};
+static_assert(std::is_trivially_copyable_v<BvhNode>);
+
+struct BvhLayout {
+  std::vector<BvhNode> Nodes;
+  std::vector<std::uint32_t> Order;  // Leaf slot i holds primitive Order[i]
+};
+
+// A hierarchy's objects split by whether they can be boxed. Unbounded ones (planes) would make every
+// box above them infinite, so hierarchies keep them aside and test them against each ray before
+// walking the tree; a nearby floor hit then also culls whatever lies behind it
+struct PartitionedObjects {
+  std::vector<std::shared_ptr<Hittable>> Bounded;
+  std::vector<Aabb> Bounds;  // One per Bounded object, all finite
+  std::vector<std::shared_ptr<Hittable>> Unbounded;
+};
+[[nodiscard]] PartitionedObjects PartitionByBounds(const std::vector<std::shared_ptr<Hittable>>& objects);
+
+// Closest hit among `objects`, lowering ray_time.Max to it
+[[nodiscard]] bool HitClosest(std::span<const std::shared_ptr<Hittable>> objects, const Ray& ray, Interval& ray_time, HitData& hit);
+[[nodiscard]] bool AnyOccludes(std::span<const std::shared_ptr<Hittable>> objects, const Ray& ray, Interval ray_time);
+
+// Binned SAH build over primitive bounds; `bounds` must all be finite
+[[nodiscard]] BvhLayout BuildBvh(std::span<const Aabb> bounds, std::size_t max_leaf_size = 4);  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+// Walks the leaves the ray passes through, nearer child first. `hit_leaf(first, count, ray_time)`
+// tests the leaf's primitives and lowers ray_time.Max to the closest hit; returns true on a hit.
+// With AnyHit the walk ends at the first leaf that reports a hit, for occlusion queries.
+template <bool AnyHit = false, typename LeafFunction>
+[[nodiscard]] bool TraverseBvh(std::span<const BvhNode> nodes, const Ray& ray, Interval ray_time, LeafFunction&& hit_leaf)
+{
+  if (nodes.empty()) {
+    return false;
+  }
+
+  const auto inverse_direction = Aabb::InverseDirection(ray.Direction);
+  const std::array<bool, 3> negative{ray.Direction.x < 0, ray.Direction.y < 0, ray.Direction.z < 0};
+
+  // BuildBvh keeps the depth well below this
+  constexpr std::size_t max_depth = 128;
+  std::array<std::uint32_t, max_depth> stack{};
+  std::size_t top = 0;
+  stack[top++] = 0;
+
+  bool hit_anything = false;
+  while (top > 0) {
+    const auto index = stack[--top];
+    const auto& node = nodes[index];
+    auto box_time = ray_time;
+    if (!node.Bounds.Hit(ray.Origin, inverse_direction, box_time)) {
+      continue;
+    }
+    if (node.IsLeaf()) {
+      hit_anything = hit_leaf(node.Offset, node.Count, ray_time) || hit_anything;
+      if constexpr (AnyHit) {
+        if (hit_anything) {
+          return true;
+        }
+      }
+      continue;
+    }
+    // The child popped next is the one on the ray's side of the split
+    if (negative[node.Axis]) {
+      stack[top++] = index + 1;
+      stack[top++] = node.Offset;
+    } else {
+      stack[top++] = node.Offset;
+      stack[top++] = index + 1;
+    }
+  }
+  return hit_anything;
+}
+
+// In-memory hierarchy over any Hittables, with the unbounded ones kept beside it
+class Bvh : public Hittable {
+  public:
+  explicit Bvh(const std::vector<std::shared_ptr<Hittable>>& objects);
+
+  [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override;
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override;
+  [[nodiscard]] Aabb BoundingBox() const override;
+
+  [[nodiscard]] std::span<const BvhNode> GetNodes() const noexcept { return Nodes; }
+  [[nodiscard]] std::size_t Size() const noexcept { return Objects.size() + Unbounded.size(); }
+
+  private:
+  std::vector<std::shared_ptr<Hittable>> Objects;  // In leaf order
+  std::vector<std::shared_ptr<Hittable>> Unbounded;
+  std::vector<BvhNode> Nodes;
+};
+}
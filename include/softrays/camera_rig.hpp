@@ -0,0 +1,35 @@
+#pragma once
+
+#include "math.hpp"
+#include "raytracer.hpp"
+
+namespace softrays {
+
+// Orbit/fly camera for interactive viewers. The eye sits on a sphere around Target, so dragging
+// orbits, zooming changes the radius and flying moves eye and target together.
+struct CameraRig {
+  Point3 Target{0, 0, 0};
+  double Distance = 1;
+  double Yaw = 0;  // Radians around +Y, measured from +X towards +Z
+  double Pitch = 0;  // Radians above the horizon
+
+  [[nodiscard]] static CameraRig FromLookAt(const Point3& look_from, const Point3& look_at);
+
+  [[nodiscard]] Point3 Eye() const noexcept;
+  // Unit vectors of the view: towards the target, and to the right of it on the horizon
+  [[nodiscard]] Vec3 Forward() const noexcept;
+  [[nodiscard]] Vec3 Right() const noexcept;
+
+  // Pitch stops just short of the poles, where the view's up vector would flip
+  void Orbit(double yaw, double pitch) noexcept;
+  // Scales the distance to the target, which never gets closer than MinDistance
+  void Zoom(double factor) noexcept;
+  // Moves along Forward, Right and world up
+  void Fly(double forward, double right, double up) noexcept;
+
+  // Sets LookFrom, LookAt and CameraUp, and focuses on the target
+  void ApplyTo(RayTracer& raytracer) const;
+
+  static constexpr double MinDistance = 1e-3;
+};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "image.hpp"
+#include "raytracer.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
+namespace softrays {
+
+// Long renders that survive being killed. The frame is traced in passes of a few samples per pixel
+// over every tile, and the running per-pixel sums, with how many passes each tile has had, are
+// written to a checkpoint file now and then. A new process rendering the same frame picks up from
+// the file. Each pass of each tile seeds the random numbers it uses from the render's seed, and a
+// tile's passes always add up in the same order, so a resumed render finishes on exactly the image
+// an uninterrupted one would have.
+
+struct CheckpointOptions {
+  // Resumed from when it holds a checkpoint of the same render, and replaced as the render goes
+  std::string Path;
+  double IntervalSeconds{60};  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  int TileSize{32};  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  // At least 2 unless the frame takes a single sample, which is one unjittered ray per pixel
+  int SamplesPerPass{8};  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  // Zero means one per hardware thread
+  unsigned Threads{0};
+  std::uint64_t Seed{0};
+  // Identifies the scene, e.g. SceneDescription::Hash. A checkpoint of another scene, camera, seed
+  // or pass layout is ignored, and the render starts over
+  std::uint64_t SceneKey{0};
+  // Polled by the workers before each tile pass. Once it returns true the passes being traced
+  // finish, a checkpoint is written and the render returns
+  std::function<bool()> ShouldStop;
+};
+
+// Renders `raytracer`'s frame with its SamplesPerPixel rounded up to whole passes. The tracer needs
+// no framebuffer (see RayTracer::ResizeViewport). Checkpoints are written by a thread of their own
+// from a copy taken a tile at a time, so tracing never waits on the disk. One that can't be written
+// is skipped, leaving the previous one in place; the last is written when the render finishes or
+// stops. Returns std::nullopt if it was stopped before the end
+[[nodiscard]] std::optional<FloatImage> RenderWithCheckpoints(RayTracer& raytracer, const CheckpointOptions& options);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "math.hpp"
+#include "utility.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace softrays {
+
+// Quantised hierarchy node: both children's boxes, 8 bits per bound relative to this node's own
+// (decoded) box, in 32 bytes, against 2 x 56 for a pair of BvhNodes. Decoding rounds outwards, so a
+// decoded box always contains everything under it and no hit is lost, only a few extra box tests.
+struct alignas(32) CompactBvhNode {
+  static constexpr std::uint32_t NoChild = std::numeric_limits<std::uint32_t>::max();
+
+  std::array<std::array<std::uint8_t, 3>, 2> Lower{};  // Per child, per axis
+  std::array<std::array<std::uint8_t, 3>, 2> Upper{};
+  std::array<std::uint32_t, 2> Child{NoChild, NoChild};  // Node index, or first primitive of a leaf
+  std::array<std::uint16_t, 2> Count{};  // Primitives in a leaf child, 0 for a node
+  std::uint8_t Axis{};  // Split axis; child 0 holds the lower centroids
+
+  // The box of `child` inside `frame`, this node's own decoded box
+  [[nodiscard]] Aabb Decode(std::size_t child, const Aabb& frame) const noexcept;
+};
+static_assert(sizeof(CompactBvhNode) == 32);
+
+class CompactBvh : public Hittable {
+  public:
+  explicit CompactBvh(const std::vector<std::shared_ptr<Hittable>>& objects);
+
+  [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override;
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override;
+  [[nodiscard]] Aabb BoundingBox() const override { return Unbounded.empty() ? RootBounds : Hittable::BoundingBox(); }
+
+  [[nodiscard]] std::span<const CompactBvhNode> GetNodes() const noexcept { return Nodes; }
+  [[nodiscard]] std::span<const std::shared_ptr<Hittable>> GetObjects() const noexcept { return Objects; }
+  [[nodiscard]] std::size_t NodeBytes() const noexcept { return Nodes.size() * sizeof(CompactBvhNode); }
+
+  private:
+  Aabb RootBounds;  // Kept at full precision, as the frame of the root node
+  std::vector<std::shared_ptr<Hittable>> Objects;  // In leaf order
+  std::vector<std::shared_ptr<Hittable>> Unbounded;  // Tested before the tree, see PartitionByBounds
+  std::vector<CompactBvhNode> Nodes;  // Node 0 is the root; 32-byte aligned, so none straddles a cache line
+
+  std::uint32_t Compress(const BvhLayout& layout, std::uint32_t node, const Aabb& frame);
+};
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "image.hpp"
+#include "net.hpp"
+#include "scene.hpp"
+#include "utility.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace softrays {
+
+// Multi-process rendering: a Coordinator splits the frame into tiles and hands them to worker
+// processes (RunWorker) connected over a unix or tcp socket. Workers receive the scene once,
+// then render one tile at a time with RayTracer::RenderTile and stream the linear float pixels
+// back.
+//
+// Tiles held by a worker that disconnects, or that stays silent for WorkerTimeout, go back in the
+// queue. Once the queue is empty, idle workers are given duplicates of straggling tiles, and
+// whichever copy finishes first wins.
+
+enum class DistributedMessage : std::uint32_t {
+  Scene = 1,  // coordinator -> worker: SceneDescription + CameraSettings
+  Tile,  // coordinator -> worker: tile index + TileRect
+  Result,  // worker -> coordinator: tile index + RGB floats
+  Done,  // coordinator -> worker: no more work
+};
+
+struct DistributedOptions {
+  int TileSize = 32;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  // Duplicate a tile once it has been out this many times longer than the average tile took
+  double StragglerFactor = 3.0;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  // A worker that hasn't returned its tile after this long is presumed dead
+  std::chrono::milliseconds WorkerTimeout = std::chrono::minutes(5);
+  // Give up if no worker is connected for this long while tiles remain
+  std::chrono::milliseconds IdleTimeout = std::chrono::seconds(30);
+};
+
+struct DistributedStats {
+  std::size_t WorkersSeen{};
+  std::size_t TilesReassigned{};  // Requeued after their worker died or timed out
+  std::size_t TilesDuplicated{};  // Speculatively handed to a second worker
+  std::size_t DuplicateResults{};  // Late results for tiles that were already done
+};
+
+class Coordinator {
+  public:
+  Coordinator(SceneDescription scene, CameraSettings camera, DistributedOptions options = {});
+
+  [[nodiscard]] bool Listen(const std::string& endpoint);
+  // Serves workers until every tile is back; std::nullopt if no worker showed up for IdleTimeout
+  [[nodiscard]] std::optional<FloatImage> Run();
+
+  [[nodiscard]] const DistributedStats& GetStats() const noexcept { return Stats; }
+
+  private:
+  using Clock = std::chrono::steady_clock;
+
+  struct TileState {
+    TileRect Rect;
+    bool Done{};
+    int Holders{};
+    Clock::time_point Started;
+  };
+
+  struct WorkerSlot {
+    Socket Connection;
+    std::optional<std::size_t> Tile;
+    Clock::time_point Assigned;
+    bool Dead{};
+  };
+
+  SceneDescription Scene;
+  CameraSettings Camera;
+  DistributedOptions Options;
+  DistributedStats Stats;
+  Socket Listener;
+
+  std::vector<TileState> Tiles;
+  std::deque<std::size_t> Pending;
+  std::vector<WorkerSlot> Workers;
+  std::size_t Completed{};
+  Clock::duration CompletedTime{};
+  FloatImage Image;
+
+  void AcceptWorker();
+  void HandleMessage(WorkerSlot& worker);
+  void ReleaseTile(WorkerSlot& worker);
+  void AssignWork();
+  [[nodiscard]] bool SendTile(WorkerSlot& worker, std::size_t tile);
+  [[nodiscard]] std::optional<std::size_t> FindStraggler(Clock::time_point now) const;
+};
+
+// Connects to a coordinator and renders tiles until told to stop; false if the connection or
+// scene setup failed, or the coordinator went away early
+[[nodiscard]] bool RunWorker(const std::string& endpoint, std::chrono::milliseconds connect_timeout = std::chrono::seconds(10));
+}
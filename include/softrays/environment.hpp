@@ -0,0 +1,50 @@
+#pragma once
+
+#include "image.hpp"
+#include "math.hpp"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace softrays {
+
+// Equirectangular (latitude-longitude) HDR environment, used as the miss shader and as a light.
+// +y is up, the top row of the image is straight up, and u wraps around the horizon.
+// Sampling follows PBRT's piecewise-constant 2D distribution: a marginal CDF over rows and a
+// conditional CDF per row, weighted by luminance * sin(theta) so bright regions such as the sun
+// are found directly instead of by chance.
+class EnvironmentMap {
+  public:
+  explicit EnvironmentMap(FloatImage image, double intensity = 1.0);
+
+  [[nodiscard]] static std::optional<EnvironmentMap> Load(const std::string& path, double intensity = 1.0);
+
+  // Radiance arriving from `direction`
+  [[nodiscard]] Colour Lookup(const Vec3& direction) const noexcept;
+
+  // Importance-sampled unit direction from two uniform numbers in [0,1)
+  [[nodiscard]] Vec3 Sample(double u1, double u2) const noexcept;
+  [[nodiscard]] Vec3 RandomDirection() const { return Sample(RandomDouble(), RandomDouble()); }
+
+  // Solid-angle density of Sample() producing `direction`
+  [[nodiscard]] double Pdf(const Vec3& direction) const noexcept;
+
+  [[nodiscard]] int GetWidth() const noexcept { return Image.Width; }
+  [[nodiscard]] int GetHeight() const noexcept { return Image.Height; }
+
+  private:
+  FloatImage Image;
+  double Intensity;
+
+  // Conditional CDFs, (Width + 1) entries per row, each row normalised to end at 1
+  std::vector<float> ConditionalCdf;
+  // Marginal CDF over rows, Height + 1 entries
+  std::vector<double> MarginalCdf;
+
+  void BuildDistribution();
+  [[nodiscard]] double Weight(int x, int y) const noexcept;
+  [[nodiscard]] std::pair<int, int> PixelFor(const Vec3& unit_direction) const noexcept;
+};
+}
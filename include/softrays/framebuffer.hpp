@@ -0,0 +1,215 @@
+#pragma once
+
+#include "math.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace softrays {
+
+// How a Framebuffer stores its pixels. Smaller formats cost precision but cut the memory and
+// bandwidth of every pass over the frame
+enum class PixelFormat : std::uint8_t {
+  RGB64,  // Three doubles (24 bytes): exact, for offline renders
+  RGBA32,  // Four floats (16 bytes), aligned so a pixel is a single vector load
+  RGBA16,  // Four half floats (8 bytes), plenty for an 8-bit preview
+  RGB9E5,  // Three 9-bit mantissas sharing a 5-bit exponent (4 bytes), non-negative only
+};
+
+struct alignas(16) PixelRGBA32 {
+  std::array<float, 4> Channels{};
+};
+
+struct PixelRGBA16 {
+  std::array<std::uint16_t, 4> Channels{};
+};
+
+struct PixelRGB9E5 {
+  std::uint32_t Bits{};
+};
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+// IEEE 754 binary16, rounding to nearest even; out of range values become infinities
+[[nodiscard]] inline std::uint16_t FloatToHalf(float value) noexcept
+{
+  const auto bits = std::bit_cast<std::uint32_t>(value);
+  const auto sign = (bits >> 16U) & 0x8000U;
+  const auto exponent = static_cast<int>((bits >> 23U) & 0xFFU);
+  auto mantissa = bits & 0x7FFFFFU;
+  if (exponent == 0xFF) {
+    return static_cast<std::uint16_t>(sign | 0x7C00U | (mantissa != 0 ? 0x200U : 0U));
+  }
+  const auto half_exponent = exponent - 127 + 15;
+  if (half_exponent >= 31) {
+    return static_cast<std::uint16_t>(sign | 0x7C00U);
+  }
+  if (half_exponent <= 0) {
+    if (half_exponent < -10) {
+      return static_cast<std::uint16_t>(sign);
+    }
+    // Subnormal: shift the mantissa, implicit bit included, down to the 2^-24 grid
+    mantissa |= 0x800000U;
+    const auto shift = static_cast<std::uint32_t>(14 - half_exponent);
+    auto half = mantissa >> shift;
+    const auto remainder = mantissa & ((1U << shift) - 1U);
+    const auto halfway = 1U << (shift - 1U);
+    if (remainder > halfway || (remainder == halfway && (half & 1U) != 0)) {
+      ++half;
+    }
+    return static_cast<std::uint16_t>(sign | half);
+  }
+  // A carry out of the mantissa rounds up into the exponent, and from the largest finite into infinity
+  auto half = (static_cast<std::uint32_t>(half_exponent) << 10U) | (mantissa >> 13U);
+  const auto remainder = mantissa & 0x1FFFU;
+  if (remainder > 0x1000U || (remainder == 0x1000U && (half & 1U) != 0)) {
+    ++half;
+  }
+  return static_cast<std::uint16_t>(sign | half);
+}
+
+[[nodiscard]] inline float HalfToFloat(std::uint16_t half) noexcept
+{
+  const std::uint32_t sign = (half & 0x8000U) << 16U;
+  const auto exponent = (half >> 10U) & 0x1FU;
+  const std::uint32_t mantissa = half & 0x3FFU;
+  if (exponent == 0) {
+    const auto value = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign != 0 ? -value : value;
+  }
+  if (exponent == 0x1F) {
+    return std::bit_cast<float>(sign | 0x7F800000U | (mantissa << 13U));
+  }
+  return std::bit_cast<float>(sign | ((exponent + 112U) << 23U) | (mantissa << 13U));
+}
+
+// The shared-exponent encoding of EXT_texture_shared_exponent. Negative channels become zero and
+// channels above 65408 saturate
+[[nodiscard]] inline std::uint32_t EncodeRGB9E5(const Colour& colour) noexcept
+{
+  constexpr int mantissaBits = 9;
+  constexpr int bias = 15;
+  static constexpr double maxValue = 65408.0;  // (2^9 - 1) / 2^9 * 2^(31 - 15)
+  auto clamp = [](double channel) { return std::isnan(channel) ? 0.0 : std::clamp(channel, 0.0, maxValue); };
+  const auto r = clamp(colour.x);
+  const auto g = clamp(colour.y);
+  const auto b = clamp(colour.z);
+  const auto max_channel = std::max({r, g, b});
+
+  int exponent = -bias;
+  if (max_channel > 0) {
+    // frexp's exponent is floor(log2(max_channel)) + 1
+    std::frexp(max_channel, &exponent);
+  }
+  auto shared = std::max(-bias, exponent) + bias;
+  auto scale = std::ldexp(1.0, shared - bias - mantissaBits);
+  if (std::floor((max_channel / scale) + 0.5) >= (1 << mantissaBits)) {
+    ++shared;
+    scale *= 2;
+  }
+  auto mantissa = [scale](double channel) { return static_cast<std::uint32_t>(std::floor((channel / scale) + 0.5)); };
+  return mantissa(r) | (mantissa(g) << 9U) | (mantissa(b) << 18U) | (static_cast<std::uint32_t>(shared) << 27U);
+}
+
+[[nodiscard]] inline Colour DecodeRGB9E5(std::uint32_t bits) noexcept
+{
+  const auto scale = std::ldexp(1.0, static_cast<int>(bits >> 27U) - 15 - 9);
+  return {
+      .x = static_cast<double>(bits & 0x1FFU) * scale,
+      .y = static_cast<double>((bits >> 9U) & 0x1FFU) * scale,
+      .z = static_cast<double>((bits >> 18U) & 0x1FFU) * scale,
+  };
+}
+
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+// Conversion between Colour and each storage type, so per-pixel loops can be written once as
+// templates and compiled for every format
+template <typename Pixel>
+struct PixelCodec;
+
+template <>
+struct PixelCodec<Colour> {
+  [[nodiscard]] static Colour Encode(const Colour& colour) noexcept { return colour; }
+  [[nodiscard]] static Colour Decode(const Colour& pixel) noexcept { return pixel; }
+};
+
+template <>
+struct PixelCodec<PixelRGBA32> {
+  [[nodiscard]] static PixelRGBA32 Encode(const Colour& colour) noexcept
+  {
+    return {.Channels = {static_cast<float>(colour.x), static_cast<float>(colour.y), static_cast<float>(colour.z), 1.0F}};
+  }
+  [[nodiscard]] static Colour Decode(const PixelRGBA32& pixel) noexcept
+  {
+    return {.x = pixel.Channels[0], .y = pixel.Channels[1], .z = pixel.Channels[2]};
+  }
+};
+
+template <>
+struct PixelCodec<PixelRGBA16> {
+  static constexpr std::uint16_t One = 0x3C00;
+
+  [[nodiscard]] static PixelRGBA16 Encode(const Colour& colour) noexcept
+  {
+    return {.Channels = {FloatToHalf(static_cast<float>(colour.x)), FloatToHalf(static_cast<float>(colour.y)), FloatToHalf(static_cast<float>(colour.z)), One}};
+  }
+  [[nodiscard]] static Colour Decode(const PixelRGBA16& pixel) noexcept
+  {
+    return {.x = HalfToFloat(pixel.Channels[0]), .y = HalfToFloat(pixel.Channels[1]), .z = HalfToFloat(pixel.Channels[2])};
+  }
+};
+
+template <>
+struct PixelCodec<PixelRGB9E5> {
+  [[nodiscard]] static PixelRGB9E5 Encode(const Colour& colour) noexcept { return {.Bits = EncodeRGB9E5(colour)}; }
+  [[nodiscard]] static Colour Decode(const PixelRGB9E5& pixel) noexcept { return DecodeRGB9E5(pixel.Bits); }
+};
+
+// A frame's pixels in one of the PixelFormats. Indexing decodes a single pixel, like the
+// std::vector<Colour> it replaces; loops over the whole frame should use Visit, which hands them
+// the typed storage so each format gets its own specialised loop
+class Framebuffer {
+  public:
+  // Alternatives in PixelFormat order
+  using Storage = std::variant<std::vector<Colour>, std::vector<PixelRGBA32>, std::vector<PixelRGBA16>, std::vector<PixelRGB9E5>>;
+
+  Framebuffer() = default;
+  explicit Framebuffer(PixelFormat format, std::size_t pixels = 0);
+
+  [[nodiscard]] PixelFormat Format() const noexcept { return static_cast<PixelFormat>(Pixels.index()); }
+  // Switches the storage format; the pixel count is kept but their contents are lost
+  void SetFormat(PixelFormat format);
+  [[nodiscard]] std::size_t BytesPerPixel() const noexcept;
+
+  // Resizes to `pixels` black pixels
+  void Resize(std::size_t pixels);
+  void ShrinkToFit();
+  [[nodiscard]] std::size_t size() const noexcept;  // NOLINT(readability-identifier-naming) container-like
+  [[nodiscard]] bool empty() const noexcept { return size() == 0; }  // NOLINT(readability-identifier-naming) container-like
+
+  [[nodiscard]] Colour operator[](std::size_t pixel) const;
+  void Set(std::size_t pixel, const Colour& colour);
+
+  template <typename Visitor>
+  decltype(auto) Visit(Visitor&& visitor)
+  {
+    return std::visit(std::forward<Visitor>(visitor), Pixels);
+  }
+  template <typename Visitor>
+  decltype(auto) Visit(Visitor&& visitor) const
+  {
+    return std::visit(std::forward<Visitor>(visitor), Pixels);
+  }
+
+  private:
+  Storage Pixels;
+};
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "math.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace softrays {
+
+// Linear, floating point RGB image (row 0 is the top of the image)
+struct FloatImage {
+  int Width{};
+  int Height{};
+  std::vector<float> Pixels;  // Width * Height * 3 floats, tightly packed RGB
+
+  FloatImage() = default;
+  FloatImage(int width, int height)
+      : Width(width), Height(height), Pixels(static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 3, 0.0F)
+  {
+  }
+
+  [[nodiscard]] std::size_t Index(int x, int y) const noexcept
+  {
+    return ((static_cast<std::size_t>(y) * static_cast<std::size_t>(Width)) + static_cast<std::size_t>(x)) * 3;
+  }
+
+  [[nodiscard]] Colour At(int x, int y) const noexcept
+  {
+    const auto index = Index(x, y);
+    return {.x = Pixels[index], .y = Pixels[index + 1], .z = Pixels[index + 2]};
+  }
+
+  void Set(int x, int y, const Colour& colour) noexcept
+  {
+    const auto index = Index(x, y);
+    Pixels[index] = static_cast<float>(colour.x);
+    Pixels[index + 1] = static_cast<float>(colour.y);
+    Pixels[index + 2] = static_cast<float>(colour.z);
+  }
+};
+
+// Portable Float Map (.pfm) colour images, the simplest common HDR format.
+// Loading returns std::nullopt for unreadable or malformed files
+[[nodiscard]] std::optional<FloatImage> LoadPFM(const std::string& path);
+[[nodiscard]] bool SavePFM(const std::string& path, const FloatImage& image);
+
+// Gamma-corrected 8-bit RGBA, the same layout as RayTracer::GetRGBAData
+[[nodiscard]] std::vector<std::uint8_t> ToRGBA8(const FloatImage& image);
+
+// Writes .pfm files as floats and anything else as an 8-bit PPM
+[[nodiscard]] bool SaveImage(const std::string& path, const FloatImage& image);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "math.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace softrays {
+
+// Irradiance caching (Ward et al.): indirect light on diffuse surfaces changes slowly, so rather
+// than estimating it afresh at every pixel it is gathered at sparse points, each with a hemisphere
+// of stratified rays, and interpolated between them.
+//
+// A record keeps the irradiance it gathered with its gradients over position and over the surface's
+// rotation (Ward and Heckbert), and a validity radius from how far away the surfaces it saw were:
+// close to other geometry light changes quickly and records are dense, in the open they are sparse.
+// Lookups blend every record valid at the point, each extrapolated along its gradients.
+//
+// Records live in a fixed pool and are linked into the cells of a hashed uniform grid that their
+// radius overlaps, so a lookup reads one cell. Inserting only ever pushes onto a cell's list, with
+// atomics, so threads fill the cache lazily while others read it and no one takes a lock.
+class IrradianceCache {
+  public:
+  static constexpr std::size_t DefaultCapacity = std::size_t{1} << 16U;  // About 20 MB with its grid
+
+  struct Record {
+    Point3 Position;
+    Vec3 Normal;
+    Colour Irradiance;
+    double Radius{};  // Beyond it the record isn't used
+    std::array<Vec3, 3> TranslationGradient{};  // Per channel, of irradiance over position
+    std::array<Vec3, 3> RotationGradient{};  // Per channel, of irradiance over the normal's rotation
+  };
+
+  // Incoming radiance along `ray`, which was sampled with density `pdf` from a cosine-weighted
+  // hemisphere; sets `distance` to how far the ray went before hitting something, or Infinity
+  using IncomingRadiance = std::function<Colour(const Ray& ray, double pdf, double& distance)>;
+
+  // Records' radii are kept within [max_spacing / 32, max_spacing]. Grid cells are twice as wide
+  explicit IrradianceCache(double max_spacing, std::size_t capacity = DefaultCapacity);
+
+  // Interpolated irradiance at `position` on a surface facing `normal`; nullopt when no record is
+  // valid there and one should be gathered. Safe alongside Insert
+  [[nodiscard]] std::optional<Colour> Lookup(const Point3& position, const Vec3& normal) const noexcept;
+
+  // Samples the hemisphere over `normal` in ThetaStrata x (pi ThetaStrata) strata and turns what
+  // they saw into a record, with a radius of at least `min_radius` (up to the maximum spacing)
+  [[nodiscard]] Record Gather(const Point3& position, const Vec3& normal, const IncomingRadiance& incoming, double min_radius = 0) const;
+
+  // Adds a record for later lookups, from any thread. false once the pool is full
+  bool Insert(const Record& record);
+
+  // Forgets every record, e.g. when the scene or its lighting changes. Not while rendering
+  void Clear();
+
+  [[nodiscard]] std::size_t Size() const noexcept;
+  [[nodiscard]] std::size_t Capacity() const noexcept { return Records.size(); }
+  [[nodiscard]] double GetMaxSpacing() const noexcept { return MaxSpacing; }
+
+  // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  double Accuracy = 0.3;  // Radius as a share of the mean distance a record saw; smaller is denser and slower
+  int ThetaStrata = 10;  // Rays per record are about pi times its square; fewer leave records blotchy
+  // NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+  private:
+  static constexpr std::uint64_t EmptyKey = ~std::uint64_t{0};
+  static constexpr std::uint32_t NoNode = ~std::uint32_t{0};
+  static constexpr std::size_t MaxProbes = 16;
+  static constexpr std::size_t CellsPerRecord = 8;  // A radius at most half a cell overlaps 2 x 2 x 2
+
+  // One link of a cell's list
+  struct Node {
+    std::uint32_t Record{};
+    std::atomic<std::uint32_t> Next{NoNode};
+  };
+
+  double MaxSpacing;
+  double MinSpacing;
+  double InverseCellSize;
+  std::vector<Record> Records;
+  std::atomic<std::size_t> RecordCount{0};
+  std::vector<Node> Nodes;
+  std::atomic<std::size_t> NodeCount{0};
+  // Open addressing of the grid's cells, as in PathGuide, each the head of its list of nodes
+  std::vector<std::atomic<std::uint64_t>> Keys;
+  std::vector<std::atomic<std::uint32_t>> Heads;
+
+  [[nodiscard]] std::uint64_t KeyOf(const Point3& position) const noexcept;
+  // The slot of the cell at `key`, if it has one
+  [[nodiscard]] std::optional<std::size_t> FindSlot(std::uint64_t key) const noexcept;
+  // Same, claiming a slot if it hasn't; nullopt when there is no room near it
+  [[nodiscard]] std::optional<std::size_t> ClaimSlot(std::uint64_t key) noexcept;
+};
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "scene.hpp"
+#include "utility.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace softrays {
+
+// Out-of-core world: the spheres of a SceneDescription and a hierarchy over them are written once
+// to a file (WriteMappedScene), then memory-mapped for tracing (MappedWorld). Spheres are stored in
+// leaf order and subtrees are contiguous, so neighbouring rays touch neighbouring pages, and the OS
+// only pages in what rays actually reach. A sphere costs 40 bytes on disk and nothing in memory
+// until it is touched. Files are written in the host's byte order.
+
+struct MappedSphere {
+  Point3 Center{};
+  double Radius{};
+  std::uint32_t Material{};
+  std::uint32_t Reserved{};
+};
+static_assert(std::is_trivially_copyable_v<MappedSphere> && sizeof(MappedSphere) == 40);
+
+// Planes are few and unbounded, so they are built as Planes in memory on open and tested before
+// the hierarchy rather than traced from the file
+struct MappedPlane {
+  Point3 Point{};
+  Vec3 Normal{};
+  double TextureSize{};
+  std::uint32_t Material{};
+  std::uint32_t Reserved{};
+};
+static_assert(std::is_trivially_copyable_v<MappedPlane> && sizeof(MappedPlane) == 64);
+
+// Read-only view of a whole file, mapped where the platform allows, read into memory elsewhere
+class MappedFile {
+  public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  ~MappedFile();
+
+  [[nodiscard]] static std::optional<MappedFile> Open(const std::string& path);
+
+  [[nodiscard]] std::span<const std::byte> Data() const noexcept { return {Bytes, Size}; }
+  // Bytes of the file currently in memory
+  [[nodiscard]] std::size_t ResidentBytes() const;
+  // Hands the file's pages back to the OS; they are read again when next touched
+  void ReleaseResident() const;
+
+  private:
+  void Close() noexcept;
+
+  const std::byte* Bytes{};
+  std::size_t Size{};
+  int Handle = -1;
+  std::vector<std::byte> Fallback;  // Used where files can't be mapped
+};
+
+// Lays the scene out for MappedWorld; false if a material index is out of range, the scene has
+// quads (which the format doesn't hold), or the file can't be written. The scene's background and
+// environment are not part of the file
+[[nodiscard]] bool WriteMappedScene(const std::string& path, const SceneDescription& scene);
+
+class MappedWorld : public Hittable {
+  public:
+  // nullptr if the file is missing or isn't a mapped scene. Only the header is checked; the rest is
+  // trusted, so that opening doesn't touch every page
+  [[nodiscard]] static std::unique_ptr<MappedWorld> Open(const std::string& path);
+
+  [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override;
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override;
+  [[nodiscard]] Aabb BoundingBox() const override;
+
+  // The emissive spheres as ordinary Spheres, for light sampling (see RayTracer::ShareWorld)
+  [[nodiscard]] const std::shared_ptr<const HittableList>& GetLights() const noexcept { return Lights; }
+
+  [[nodiscard]] std::size_t SphereCount() const noexcept { return Spheres.size(); }
+  [[nodiscard]] std::size_t FileSize() const noexcept { return File.Data().size(); }
+  [[nodiscard]] std::size_t ResidentBytes() const { return File.ResidentBytes(); }
+  void ReleaseResident() const { File.ReleaseResident(); }
+
+  private:
+  MappedWorld() = default;
+
+  MappedFile File;
+  std::span<const BvhNode> Nodes;
+  std::span<const MappedSphere> Spheres;
+  std::vector<std::shared_ptr<Hittable>> Planes;
+  std::vector<std::shared_ptr<MaterialBase>> Materials;
+  std::shared_ptr<const HittableList> Lights;
+};
+
+// The mapped scene at `path`, written from `scene` first if it is missing, with the scene's
+// background and environment: the scene's objects are never built in memory. std::nullopt if the
+// file can't be written or opened, or the environment map can't be loaded
+[[nodiscard]] std::optional<PreparedScene> PrepareMapped(const std::string& path, const SceneDescription& scene);
+}
@@ -3,7 +3,17 @@
 #include "math.hpp"
 #include "utility.hpp"
 
+#include <memory>
+#include <utility>
+
 namespace softrays {
+class TiledTexture;
+
+// The texture's colour where the ray hit it, filtered over the ray cone's width there (stretched
+// when the surface is seen at a grazing angle), or its mean where the hit has no texture coordinates
+[[nodiscard]] Colour SampleTexture(const TiledTexture& texture, const Ray& ray, const HitData& hit);
+[[nodiscard]] Colour TextureAverage(const TiledTexture& texture);
+
 struct MaterialBase {
   MaterialBase() = default;
   MaterialBase(const MaterialBase&) = default;
@@ -16,12 +26,49 @@ struct MaterialBase {
   {
     return false;
   }
+
+  // Radiance leaving the hit point back along `ray`
+  [[nodiscard]] virtual Colour Emitted([[maybe_unused]] const Ray& ray, [[maybe_unused]] const HitData& hit) const
+  {
+    return {};
+  }
+
+  [[nodiscard]] virtual bool IsEmissive() const noexcept
+  {
+    return false;
+  }
+
+  // Whether shading reads HitData's texture coordinates, which shapes skip computing otherwise
+  [[nodiscard]] virtual bool IsTextured() const noexcept
+  {
+    return false;
+  }
+
+  // BSDF times the cosine term for light arriving from `direction`.
+  // Only meaningful for materials with a non-zero ScatterPdf
+  [[nodiscard]] virtual Colour Evaluate([[maybe_unused]] const Ray& ray, [[maybe_unused]] const HitData& hit, [[maybe_unused]] const Vec3& direction) const
+  {
+    return {};
+  }
+
+  // Solid-angle density of Scatter() producing `direction`.
+  // Specular (delta) materials return 0, which also opts them out of light sampling
+  [[nodiscard]] virtual double ScatterPdf([[maybe_unused]] const Ray& ray, [[maybe_unused]] const HitData& hit, [[maybe_unused]] const Vec3& direction) const
+  {
+    return 0.0;
+  }
+
+  // Surface colour for the quick first-hit shading of progressive previews
+  [[nodiscard]] virtual Colour PreviewAlbedo() const
+  {
+    return {.x = 0.5, .y = 0.5, .z = 0.5};  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  }
 };
 
 class Lambertian : public MaterialBase {
   public:
-  Lambertian(const Colour& albedo) : Albedo(albedo) { }
-  [[nodiscard]] bool Scatter([[maybe_unused]] const Ray& r_in, const HitData& hit,
+  Lambertian(const Colour& albedo, std::shared_ptr<const TiledTexture> texture = nullptr) : Albedo(albedo), Texture(std::move(texture)) { }
+  [[nodiscard]] bool Scatter(const Ray& r_in, const HitData& hit,
       Colour& attenuation, Ray& scattered) const override
   {
     auto scatter_direction = hit.Normal + Vec3::RandomUnitVector();
@@ -30,28 +77,63 @@ class Lambertian : public MaterialBase {
     if (scatter_direction.NearZero())
       scatter_direction = hit.Normal;
     scattered = {.Origin = hit.Location, .Direction = scatter_direction};
-    attenuation = Albedo;
+    attenuation = SurfaceAlbedo(r_in, hit);
     return true;
   }
 
-  Colour Albedo{};
+  [[nodiscard]] Colour Evaluate(const Ray& ray, const HitData& hit, const Vec3& direction) const override
+  {
+    return SurfaceAlbedo(ray, hit) * ScatterPdf(ray, hit, direction);
+  }
+
+  // Normal + RandomUnitVector() is cosine-distributed around the normal
+  [[nodiscard]] double ScatterPdf([[maybe_unused]] const Ray& ray, const HitData& hit, const Vec3& direction) const override
+  {
+    const auto cosine = hit.Normal.Dot(direction.UnitVector());
+    return cosine > 0 ? cosine / Pi : 0.0;
+  }
+
+  [[nodiscard]] Colour PreviewAlbedo() const override { return Texture ? Albedo * TextureAverage(*Texture) : Albedo; }
+  [[nodiscard]] bool IsTextured() const noexcept override { return Texture != nullptr; }
+
+  Colour Albedo{};  // Multiplies the texture when there is one
+  std::shared_ptr<const TiledTexture> Texture;
+
+  private:
+  [[nodiscard]] Colour SurfaceAlbedo(const Ray& ray, const HitData& hit) const
+  {
+    return Texture ? Albedo * SampleTexture(*Texture, ray, hit) : Albedo;
+  }
 };
 
 class Metal : public MaterialBase {
   public:
-  Metal(const Colour& albedo, double fuzz) : Albedo(albedo), Fuzz(fuzz < 1 ? fuzz : 1) { }
+  Metal(const Colour& albedo, double fuzz, std::shared_ptr<const TiledTexture> texture = nullptr)
+      : Albedo(albedo), Fuzz(fuzz < 1 ? fuzz : 1), Texture(std::move(texture))
+  {
+  }
   [[nodiscard]] bool Scatter(const Ray& r_in, const HitData& hit,
       Colour& attenuation, Ray& scattered) const override
   {
     Vec3 reflected = r_in.Direction.Reflect(hit.Normal);
     reflected = reflected.UnitVector() + (Vec3::RandomUnitVector() * Fuzz);
     scattered = {.Origin = hit.Location, .Direction = reflected};
-    attenuation = Albedo;
+    attenuation = SurfaceAlbedo(r_in, hit);
     return scattered.Direction.Dot(hit.Normal) > 0;
   }
 
-  Colour Albedo{};
+  [[nodiscard]] Colour PreviewAlbedo() const override { return Texture ? Albedo * TextureAverage(*Texture) : Albedo; }
+  [[nodiscard]] bool IsTextured() const noexcept override { return Texture != nullptr; }
+
+  Colour Albedo{};  // Multiplies the texture when there is one
   double Fuzz{};
+  std::shared_ptr<const TiledTexture> Texture;
+
+  private:
+  [[nodiscard]] Colour SurfaceAlbedo(const Ray& ray, const HitData& hit) const
+  {
+    return Texture ? Albedo * SampleTexture(*Texture, ray, hit) : Albedo;
+  }
 };
 
 class Dielectric : public MaterialBase {
@@ -75,6 +157,8 @@ class Dielectric : public MaterialBase {
     return true;
   }
 
+  [[nodiscard]] Colour PreviewAlbedo() const override { return {.x = 1.0, .y = 1.0, .z = 1.0}; }
+
   // Refractive index in vacuum or air, or the ratio of the material's refractive index over
   // the refractive index of the enclosing media
   double RefractionIndex;
@@ -88,4 +172,25 @@ class Dielectric : public MaterialBase {
     return r0 + ((1 - r0) * std::pow((1 - cosine), 5));
   }
 };
+
+class DiffuseLight : public MaterialBase {
+  public:
+  DiffuseLight(const Colour& emit) noexcept : Emit(emit) { }
+
+  [[nodiscard]] Colour Emitted([[maybe_unused]] const Ray& ray, const HitData& hit) const override
+  {
+    // Only the outside of a light emits
+    return hit.FrontFace ? Emit : Colour{};
+  }
+
+  [[nodiscard]] bool IsEmissive() const noexcept override
+  {
+    return true;
+  }
+
+  // Previews show lights by their emission alone
+  [[nodiscard]] Colour PreviewAlbedo() const override { return {}; }
+
+  Colour Emit{};
+};
 }
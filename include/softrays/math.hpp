@@ -2,6 +2,7 @@
 
 #include "random.hpp"
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <limits>
 #include <numbers>
@@ -9,6 +10,43 @@
 
 namespace softrays {
 
+struct SinCos {
+  double Sin;
+  double Cos;
+};
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+// Taylor series of sin(x) / x and cos(x) in powers of x^2, lowest first
+inline constexpr std::array<double, 8> SinTerms{1, -1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800, 1.0 / 6227020800, -1.0 / 1307674368000};
+inline constexpr std::array<double, 9> CosTerms{1, -1.0 / 2, 1.0 / 24, -1.0 / 720, 1.0 / 40320, -1.0 / 3628800, 1.0 / 479001600, -1.0 / 87178291200, 1.0 / 20922789888000};
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+// sin and cos of `turns` whole turns (2 pi radians each) for turns > -1/2, without branches: the
+// angle is reduced to within an eighth of a turn of a quadrant, where the series are accurate to a
+// few ulp, and the quadrant is applied by swapping and negating. SampleBatch runs the same steps on
+// SIMD lanes
+[[nodiscard]] inline SinCos SinCosTurns(double turns) noexcept
+{
+  constexpr auto roundingOffset = 2.5;  // Truncating a positive value floors it
+  const auto quarters = turns * 4;
+  const auto quadrant = static_cast<int>(quarters + roundingOffset) - 2;
+  const auto x = (quarters - quadrant) * (std::numbers::pi / 2);
+  const auto x2 = x * x;
+  auto sin = SinTerms.back();
+  for (auto term = SinTerms.size() - 1; term-- > 0;) {
+    sin = (sin * x2) + SinTerms[term];
+  }
+  sin *= x;
+  auto cos = CosTerms.back();
+  for (auto term = CosTerms.size() - 1; term-- > 0;) {
+    cos = (cos * x2) + CosTerms[term];
+  }
+  const auto swap = (static_cast<unsigned>(quadrant) & 1U) != 0;
+  const auto sin_sign = (static_cast<unsigned>(quadrant) & 2U) != 0 ? -1.0 : 1.0;
+  const auto cos_sign = (static_cast<unsigned>(quadrant + 1) & 2U) != 0 ? -1.0 : 1.0;
+  return {.Sin = (swap ? cos : sin) * sin_sign, .Cos = (swap ? sin : cos) * cos_sign};
+}
+
 struct Vec3 {
   double x = 0.0;
   double y = 0.0;
@@ -92,19 +130,20 @@ struct Vec3 {
     return *this / Length();
   }
 
+  // Uniform on the unit sphere: z uniform in [-1, 1] (Archimedes' hat-box theorem) and the azimuth
+  // uniform, mapped from `u` and `v` in [0, 1)
+  [[nodiscard]] static Vec3 OnUnitSphere(double u, double v) noexcept
+  {
+    const auto z = 1 - (2 * u);
+    const auto radius = std::sqrt(std::fmax(0.0, 1 - (z * z)));
+    const auto [sin, cos] = SinCosTurns(v);
+    return {.x = radius * cos, .y = radius * sin, .z = z};
+  }
+
   [[nodiscard]] static Vec3 RandomUnitVector() noexcept
   {
-    constexpr auto min_len = 1e-160;
-    // NOTE: this was in the book, but surely we are better off getting a random vector and just normalising it???
-    while (true) {
-      const auto rand = Vec3::Random(-1.0, 1.0);
-      const auto lensq = rand.LengthSquared();
-      if (min_len < lensq && lensq <= 1) {
-        return rand / std::sqrt(lensq);
-      }
-    }
-    // NOTE: I tried this, but it did look different for some reason
-    // return Vec3::Random().unit_vector();
+    const auto u = RandomDouble();
+    return OnUnitSphere(u, RandomDouble());
   }
 
   [[nodiscard]] static Vec3 Random()
@@ -138,14 +177,27 @@ struct Vec3 {
     return r_out_perp + r_out_parallel;
   }
 
+  // Shirley and Chiu's concentric map of [0, 1)^2 onto the unit disk (z = 0), uniform and keeping
+  // nearby samples nearby. The square's rings become circles; which of its two diagonals' sides a
+  // point is on is a select, not a branch
+  [[nodiscard]] static Vec3 InUnitDisk(double u, double v) noexcept
+  {
+    const auto a = (2 * u) - 1;
+    const auto b = (2 * v) - 1;
+    const auto horizontal = std::fabs(a) > std::fabs(b);
+    const auto radius = horizontal ? a : b;
+    // The centre has radius 0 whichever angle it gets, so only the division by zero needs avoiding
+    const auto divisor = std::fabs(radius) > 0 ? radius : 1.0;
+    constexpr auto eighth = 0.125;
+    const auto turns = horizontal ? eighth * (b / divisor) : (2 * eighth) - (eighth * (a / divisor));
+    const auto [sin, cos] = SinCosTurns(turns);
+    return {.x = radius * cos, .y = radius * sin, .z = 0};
+  }
+
   [[nodiscard]] static Vec3 RandomInUnitDisk() noexcept
   {
-    // TODO: again, surely there's a better way than looping
-    while (true) {
-      const auto rand = Vec3{.x = RandomDouble(-1, 1), .y = RandomDouble(-1, 1), .z = 0};
-      if (rand.LengthSquared() < 1)
-        return rand;
-    }
+    const auto u = RandomDouble();
+    return InUnitDisk(u, RandomDouble());
   }
 };
 
@@ -154,6 +206,13 @@ using Point3 = Vec3;
 
 using Colour = Vec3;
 
+// Perceived brightness of a linear Rec. 709 colour
+[[nodiscard]] constexpr double Luminance(const Colour& colour) noexcept
+{
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  return (0.2126 * colour.x) + (0.7152 * colour.y) + (0.0722 * colour.z);
+}
+
 // Constants
 constexpr auto Infinity = std::numeric_limits<double>::infinity();
 constexpr double Pi = std::numbers::pi;
@@ -179,6 +238,34 @@ constexpr auto DegreesToRadiansFactor = Pi / 180.0;
   return Vec3(RandomDouble() - offset, RandomDouble() - offset, 0);
 }
 
+// Veach's power heuristic (beta = 2) for weighting a sample drawn from the `pdf_a` strategy
+// against one drawn from the `pdf_b` strategy
+[[nodiscard]] constexpr double PowerHeuristic(double pdf_a, double pdf_b) noexcept
+{
+  const auto a2 = pdf_a * pdf_a;
+  const auto b2 = pdf_b * pdf_b;
+  return (a2 + b2) > 0 ? a2 / (a2 + b2) : 0.0;
+}
+
+// Right-handed frame around a given axis, used to map locally sampled directions into world space
+struct OrthonormalBasis {
+  Vec3 U, V, W;
+
+  [[nodiscard]] static OrthonormalBasis FromW(const Vec3& axis) noexcept
+  {
+    constexpr auto parallel_limit = 0.9;
+    const auto w = axis.UnitVector();
+    const auto helper = (std::fabs(w.x) > parallel_limit) ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    const auto v = w.Cross(helper).UnitVector();
+    return {.U = w.Cross(v), .V = v, .W = w};
+  }
+
+  [[nodiscard]] constexpr Vec3 Transform(const Vec3& local) const noexcept
+  {
+    return (U * local.x) + (V * local.y) + (W * local.z);
+  }
+};
+
 struct Interval {
   double Min = Infinity;
   double Max = -Infinity;
@@ -209,9 +296,22 @@ struct Interval {
 inline const Interval Interval::Empty = Interval{.Min = +Infinity, .Max = -Infinity};
 inline const Interval Interval::Universe = Interval{.Min = -Infinity, .Max = Infinity};
 
+// How wide the bundle of rays a ray stands for is, to filter texture lookups over (the ray cones of
+// Akenine-Möller et al., "Texture Level of Detail Strategies for Real-Time Ray Tracing")
+struct RayCone {
+  double Width{};  // At the ray's origin
+  double Spread{};  // Growth in width per unit of distance travelled
+
+  [[nodiscard]] constexpr double WidthAt(double distance) const noexcept
+  {
+    return Width + (Spread * distance);
+  }
+};
+
 struct Ray {
   Point3 Origin;
   Vec3 Direction;
+  RayCone Cone{};  // Zero unless the camera set it
 
   [[nodiscard]] Point3 At(double val) const noexcept
   {
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace softrays {
+
+// Length-prefixed messages over stream sockets (POSIX only; elsewhere every call fails).
+// Endpoints are written as "unix:/path/to/socket" or "tcp:host:port"; a bare path means unix.
+
+// Largest payload Receive accepts, so a peer can't make it allocate whatever it likes: room for a
+// big scene, or a 1080p frame of floats coming back from a render server
+inline constexpr std::size_t MaxMessageBytes = std::size_t{64} << 20U;
+
+struct Message {
+  std::uint32_t Type{};
+  std::vector<std::byte> Payload;
+};
+
+class Socket {
+  int Handle = -1;
+
+  public:
+  Socket() = default;
+  explicit Socket(int handle) noexcept : Handle(handle) { }
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+  Socket(Socket&& other) noexcept;
+  Socket& operator=(Socket&& other) noexcept;
+  ~Socket();
+
+  [[nodiscard]] bool Valid() const noexcept { return Handle >= 0; }
+  [[nodiscard]] int Get() const noexcept { return Handle; }
+  void Close() noexcept;
+
+  [[nodiscard]] bool Send(std::uint32_t type, std::span<const std::byte> payload = {}) const;
+  // Blocks until a whole message arrives; std::nullopt once the peer has gone away
+  [[nodiscard]] std::optional<Message> Receive() const;
+  // Gives up on a half-sent message after `timeout`, so a stalled peer can't wedge the reader
+  void SetReceiveTimeout(std::chrono::milliseconds timeout) const;
+};
+
+[[nodiscard]] Socket ListenOn(const std::string& endpoint);
+[[nodiscard]] Socket Accept(const Socket& listener);
+// Retries until the endpoint accepts or `timeout` passes, so workers can start before the coordinator
+[[nodiscard]] Socket ConnectTo(const std::string& endpoint, std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+// Waits until one of `sockets` is readable; returns their indices, empty on timeout
+[[nodiscard]] std::vector<std::size_t> WaitReadable(std::span<const int> sockets, std::chrono::milliseconds timeout);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "math.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace softrays {
+
+// Online path guiding: learns, for each small region of the scene, which directions the light
+// arriving there comes from, and steers diffuse bounces towards them. Without it a bounce samples
+// its BSDF alone, so light that reaches a room only through a narrow opening is found by chance.
+//
+// Space is cut into cubic cells, kept in a fixed-size hash table and split by the way the surface
+// faces so the two sides of a wall learn apart. Each region holds a histogram of incident radiance
+// over the sphere of directions, in equal-area bins. Paths add to the histograms as they finish,
+// from any thread, with atomics. Refresh (RayTracer::BeginFrame calls it) turns everything recorded
+// so far into the distributions the next frame samples from, which don't change while it renders.
+// Sampling mixes the guide with the BSDF and weights paths by the mixture's density, so the
+// result is unbiased however good or bad the guide is.
+class PathGuide {
+  public:
+  static constexpr std::size_t BinsCosTheta = 8;
+  static constexpr std::size_t BinsPhi = 16;
+  static constexpr std::size_t Bins = BinsCosTheta * BinsPhi;
+  static constexpr std::size_t DefaultCapacity = std::size_t{1} << 14U;  // About 17 MB of regions
+
+  class Region {
+    public:
+    // Whether the last Refresh gave it a distribution to sample
+    [[nodiscard]] bool IsTrained() const noexcept { return Trained; }
+
+    // Direction drawn from the learned distribution, from two uniform numbers in [0,1); trained regions only
+    [[nodiscard]] Vec3 Sample(double u1, double u2) const noexcept;
+    [[nodiscard]] Vec3 RandomDirection() const { return Sample(RandomDouble(), RandomDouble()); }
+    // Solid-angle density of Sample() producing `direction`
+    [[nodiscard]] double Pdf(const Vec3& direction) const noexcept;
+
+    // Adds what a path found by bouncing towards `direction`: the luminance of the radiance it
+    // reflected back along the path (so incident radiance times BSDF and cosine), divided by the
+    // density the direction was sampled with. Safe from any thread
+    void Record(const Vec3& direction, double value) noexcept;
+    [[nodiscard]] std::uint32_t RecordCount() const noexcept { return Records.load(std::memory_order_relaxed); }
+
+    private:
+    friend class PathGuide;
+
+    std::atomic<std::uint32_t> Records{0};
+    bool Trained{};
+    std::array<float, Bins + 1> Cdf{};  // Of the distribution sampled this frame
+    std::array<std::atomic<float>, Bins> Learned{};
+
+    [[nodiscard]] static std::size_t BinOf(const Vec3& direction) noexcept;
+  };
+
+  // Cells are `cell_size` on a side; a region of a few times the scene's smallest features learns
+  // quickly without blurring light and shadow together
+  explicit PathGuide(double cell_size, std::size_t capacity = DefaultCapacity);
+
+  // The region holding `position` on a surface facing `normal`, claimed on first use. nullptr
+  // when the table has no room left near it, and the bounce there is left unguided
+  [[nodiscard]] Region* Locate(const Point3& position, const Vec3& normal) noexcept;
+
+  // Rebuilds every region's distribution from all it has recorded. Not while rendering
+  void Refresh();
+  // Forgets everything learned, e.g. when the scene changes. Not while rendering
+  void Clear();
+
+  [[nodiscard]] double GetCellSize() const noexcept { return 1 / InverseCellSize; }
+  [[nodiscard]] std::size_t RegionCount() const noexcept { return Claimed.load(std::memory_order_relaxed); }
+  [[nodiscard]] std::size_t TrainedCount() const noexcept { return Trained; }
+
+  // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  double Fraction = 0.3;  // Share of bounces in trained regions that sample the guide rather than the BSDF
+  std::uint32_t MinRecords = 64;  // Paths a region needs to have seen before it is sampled
+  // NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+  private:
+  static constexpr std::size_t MaxProbes = 16;
+  static constexpr std::uint64_t EmptyKey = ~std::uint64_t{0};
+
+  double InverseCellSize;
+  // Open addressing, so lookups never take a lock. The keys are kept apart from the much larger
+  // regions so that probing stays in cache
+  std::vector<std::atomic<std::uint64_t>> Keys;
+  std::vector<Region> Regions;
+  std::atomic<std::size_t> Claimed{0};
+  std::size_t Trained{};
+
+  [[nodiscard]] std::uint64_t KeyOf(const Point3& position, const Vec3& normal) const noexcept;
+};
+
+// The diffuse bounces of one path, kept so that once it ends the radiance that arrived at each can
+// be recorded to its region
+class GuidedPath {
+  public:
+  static constexpr std::size_t MaxVertices = 8;
+
+  // `throughput` and `radiance` are the path's before the bounce towards `direction`
+  void Add(PathGuide::Region* region, const Vec3& direction, const Colour& throughput, const Colour& radiance) noexcept
+  {
+    if (Count < MaxVertices) {
+      Vertices[Count++] = {.Region = region, .Direction = direction, .Throughput = throughput, .Radiance = radiance};
+    }
+  }
+  // Records what each vertex received out of the path's final `radiance`
+  void Finish(const Colour& radiance) const noexcept;
+
+  private:
+  struct Vertex {
+    PathGuide::Region* Region;
+    Vec3 Direction;
+    Colour Throughput;
+    Colour Radiance;
+  };
+  std::array<Vertex, MaxVertices> Vertices;  // NOLINT(cppcoreguidelines-pro-type-member-init) only the first Count are set
+  std::size_t Count{};
+};
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "image.hpp"
+#include "scene.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace softrays {
+
+// Equal-time quality measurement: render a canonical scene for growing wall-clock budgets and
+// compare each result against a high-sample reference, so a rendering change is judged by the
+// error it reaches in a given time rather than by raw throughput.
+
+enum class BenchmarkScene : std::uint8_t {
+  SphereField,  // The book's final scene, as in the demo
+  GlassHeavy,  // Mostly dielectrics: long specular paths
+  SmallLight,  // Lit only by a small, bright sphere: where light sampling matters
+  WindowRoom,  // Lit through a small window by light bounced outside: where path guiding matters
+  DiffuseRoom,  // A closed diffuse box, mostly lit indirectly: where irradiance caching matters
+};
+
+inline constexpr std::array AllBenchmarkScenes{BenchmarkScene::SphereField, BenchmarkScene::GlassHeavy, BenchmarkScene::SmallLight, BenchmarkScene::WindowRoom, BenchmarkScene::DiffuseRoom};
+
+struct BenchmarkCase {
+  std::string Name;  // Stable, file-name friendly
+  SceneDescription Scene;
+  CameraSettings Camera;  // SamplesPerPixel is ignored, the budget decides
+};
+
+[[nodiscard]] BenchmarkCase MakeBenchmarkCase(BenchmarkScene scene);
+[[nodiscard]] std::optional<BenchmarkScene> FindBenchmarkScene(const std::string& name);
+
+// Root mean squared error over every channel of every pixel, in linear radiance
+[[nodiscard]] double RootMeanSquaredError(const FloatImage& image, const FloatImage& reference);
+// Squared error relative to the reference's squared value, so dark and bright regions count
+// alike; `epsilon` keeps black reference pixels from dominating
+[[nodiscard]] double RelativeMeanSquaredError(const FloatImage& image, const FloatImage& reference, double epsilon = 1e-2);
+// Average luminance of the image: a bias in overall brightness shows in it long before per-pixel
+// noise is low enough for the errors above to
+[[nodiscard]] double MeanLuminance(const FloatImage& image);
+
+// Adjusts a tracer once the case has set it up, e.g. to give it a path guide or a cache
+using TracerSetup = std::function<void(RayTracer& raytracer)>;
+
+// Renders with every hardware thread, at `samples_per_pixel`
+[[nodiscard]] std::optional<FloatImage> RenderReference(const BenchmarkCase& bench, int samples_per_pixel, const TracerSetup& setup = {});
+// Loads the reference from `path` if it is there at the case's resolution, otherwise renders and
+// stores it
+[[nodiscard]] std::optional<FloatImage> LoadOrRenderReference(const BenchmarkCase& bench, const std::string& path, int samples_per_pixel);
+
+struct QualityPoint {
+  double Seconds{};  // Tracing time spent, at least the budget
+  int SamplesPerPixel{};
+  double Rmse{};
+  double RelMse{};
+};
+
+struct QualityCurve {
+  std::string Scene;
+  std::vector<QualityPoint> Points;
+};
+
+// Renders passes of `samples_per_pass` on one thread, averaging them, and records the error
+// each time the tracing time crosses one of `budgets` (seconds, ascending)
+[[nodiscard]] std::optional<QualityCurve> MeasureQuality(const BenchmarkCase& bench, const FloatImage& reference, std::span<const double> budgets, int samples_per_pass = 1, const TracerSetup& setup = {});
+
+void WriteQualityCsv(std::ostream& out, std::span<const QualityCurve> curves);
+void WriteQualityJson(std::ostream& out, std::span<const QualityCurve> curves);
+}
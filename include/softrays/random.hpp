@@ -1,13 +1,24 @@
 #pragma once
 
+#include <cstdint>
 #include <random>
 
+// One generator per thread, so tiles can be traced concurrently
+[[nodiscard]] inline std::mt19937& RandomGenerator()
+{
+  thread_local std::mt19937 generator{std::random_device{}()};
+  return generator;
+}
+
+[[nodiscard]] inline std::uniform_real_distribution<double>& RandomDistribution()
+{
+  thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  return distribution;
+}
+
 [[nodiscard]] inline double RandomDouble()
 {
-  static std::random_device rd;
-  static std::mt19937 generator{rd()};
-  static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-  return distribution(generator);
+  return RandomDistribution()(RandomGenerator());
 }
 
 // Returns a random real in [min,max).
@@ -15,3 +26,12 @@
 {
   return min + ((max - min) * RandomDouble());
 }
+
+// Restarts the calling thread's sequence, so work traced after it is reproducible
+inline void SeedRandom(std::uint64_t seed)
+{
+  constexpr auto lowBits = 32U;
+  std::seed_seq sequence{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> lowBits)};
+  RandomGenerator().seed(sequence);
+  RandomDistribution().reset();
+}
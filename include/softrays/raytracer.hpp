@@ -1,8 +1,17 @@
 #pragma once
 
+#include "environment.hpp"
+#include "framebuffer.hpp"
+#include "irradiance_cache.hpp"
 #include "math.hpp"
+#include "path_guide.hpp"
 #include "utility.hpp"
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
 
 namespace softrays {
 class RayTracer {
@@ -20,6 +29,22 @@ class RayTracer {
   double DefocusAngle = 0;  // Variation angle of rays through each pixel
   double FocusDistance = 10;  // Distance from camera lookfrom point to plane of perfect focus
 
+  bool SkyBackground = true;  // Use the white-to-blue sky gradient for rays that escape the scene
+  Colour BackgroundColour{0, 0, 0};  // Radiance of escaping rays when SkyBackground is off
+  bool SampleLights = true;  // Next-event estimation towards emissive objects and the environment at diffuse bounces
+  std::shared_ptr<const EnvironmentMap> Environment;  // HDR miss shader, replaces the background when set
+  bool TemporalReuse = false;  // Blend each frame with the previous one, reprojected through the camera's motion
+  int MaxHistorySamples = 512;  // Most samples the history counts for, so stale radiance fades out
+  // Learns where light comes from as paths finish and steers diffuse bounces towards it from the
+  // next frame on, so it pays off over several frames or passes. May be shared between tracers
+  std::shared_ptr<PathGuide> Guide;
+  // Indirect light at the first diffuse surface of each camera path is interpolated from this
+  // cache, and gathered into it where it has nothing yet, instead of followed by a bounce. Smooth
+  // and nearly free once the cache fills, but it blurs indirect detail smaller than its records.
+  // Records are no smaller than a pixel, and surfaces so far away that even the largest record
+  // would cover about a pixel bounce as usual
+  std::shared_ptr<IrradianceCache> Irradiance;
+
   private:
   Dimension2d ViewportDimensions{.Width = 600, .Height = 400};  // Rendered Image Dimensions
   int SamplesPerPixel = 100;  // Count of random samples for each pixel
@@ -27,15 +52,89 @@ class RayTracer {
   Vec3 Camera_u, Camera_v, Camera_w;  // Camera frame basis vectors
   Vec3 DefocusDisk_u;  // Defocus disk horizontal radius
   Vec3 DefocusDisk_v;  // Defocus disk vertical radius
+  Point3 Pixel00Location;  // Center of the upper left pixel
+  Vec3 PixelDelta_u, PixelDelta_v;  // Offsets from pixel to pixel
+  double PixelSpread{};  // Ray cone spread of camera rays, one pixel's width per unit of distance
 
   // NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
 
   HittableList World;
+  HittableList Lights;  // Emissive objects from World, rebuilt at the start of each frame
+  // Prebuilt world traced instead of World when set, e.g. shared between tracers by a scene cache
+  std::shared_ptr<const Hittable> SharedWorld;
+  std::shared_ptr<const HittableList> SharedLights;
   std::vector<std::uint8_t> rlPixels;
-  std::vector<Colour> PixelData;
+  Framebuffer PixelData;
+
+  // Temporal reuse: the first surface seen through each pixel's centre decides whether the previous
+  // frame's colour at the reprojected location still belongs to it
+  struct PixelSurface {
+    Point3 Position;  // First hit, or the ray's unit direction when it escaped
+    Vec3 Normal;  // Zero when the ray escaped
+    bool Hit{};
+  };
+  struct FrameCamera {
+    Point3 Position;
+    Vec3 Forward;
+    Point3 Pixel00Location;
+    Vec3 PixelDelta_u, PixelDelta_v;
+  };
+  struct HistorySample {
+    Colour Value;
+    double Samples{};
+  };
+  std::vector<PixelSurface> Surfaces;
+  std::vector<double> SampleCounts;  // Samples behind each pixel of PixelData, history included
+  Framebuffer HistoryColour;
+  std::vector<PixelSurface> HistorySurfaces;
+  std::vector<double> HistorySampleCounts;
+  FrameCamera HistoryCamera;
+  bool CollectingHistory{};  // This frame fills Surfaces and SampleCounts
+  bool HasHistory{};
+
+  // The frame's render kernels, instantiated for its features (see SelectKernels) so their
+  // per-pixel loops don't test them. Set by BeginFrame
+  using TileKernelFn = void (RayTracer::*)(const TileRect&);
+  using SpanKernelFn = void (RayTracer::*)(const TileRect&, std::span<Colour>) const;
+  TileKernelFn FrameTileKernel{};
+  SpanKernelFn FrameSpanKernel{};
 
   [[nodiscard]] Point3 DefocusDiskSample() const noexcept;
-  [[nodiscard]] Colour RayColour(const Ray& ray, int depth, const class Hittable& World) const;
+  template <bool Defocus>
+  [[nodiscard]] Ray JitteredRay(int x, int y, const Vec3& pixel00_loc, const Vec3& pixel_delta_u, const Vec3& pixel_delta_v) const;
+  template <bool MultiSample, bool Defocus>
+  [[nodiscard]] Colour TracePixel(int x, int y, const Hittable& world) const;
+  // `ray_pdf` is the density a path's bounce sampled `ray` with, 0 for camera rays; `distance`, if
+  // given, receives how far the ray went before it hit anything
+  [[nodiscard]] Colour RayColour(const Ray& ray, int depth, const class Hittable& World, double ray_pdf = 0, double* distance = nullptr) const;
+  // Irradiance at a diffuse hit from the cache, gathering a new record with paths `depth` long,
+  // at least `min_radius` across, if no record covers it
+  [[nodiscard]] Colour CachedIrradiance(const HitData& hit, double min_radius, int depth, const Hittable& world) const;
+  [[nodiscard]] Colour Background(const Ray& ray) const;
+  [[nodiscard]] Colour SampleDirectLight(const Ray& ray, const HitData& hit, const Hittable& world, const PathGuide::Region* region) const;
+  // Density of a diffuse bounce producing `direction`: the BSDF's, mixed with the guide's in a trained `region`
+  [[nodiscard]] double BounceDensity(const Ray& ray, const HitData& hit, const Vec3& direction, const PathGuide::Region* region) const;
+  // Light sampling strategy: a mixture of the emissive objects and the environment map
+  [[nodiscard]] double EnvironmentSelectProbability() const noexcept;
+  [[nodiscard]] Vec3 SampleLightDirection(const Point3& origin) const;
+  [[nodiscard]] double LightPdf(const Point3& origin, const Vec3& direction) const;
+  [[nodiscard]] const Hittable& ActiveWorld() const noexcept;
+  [[nodiscard]] const HittableList& ActiveLights() const noexcept;
+  void RollHistory();
+  // Blends `colour`, just traced for the pixel, with the reprojected history
+  [[nodiscard]] Colour AccumulateHistory(int x, int y, std::size_t pixel, const Colour& colour);
+  void SelectKernels();
+  template <bool MultiSample, bool Defocus>
+  void SelectKernels();
+  template <bool MultiSample, bool Defocus, bool History>
+  void TileKernel(const TileRect& tile);
+  template <bool MultiSample, bool Defocus, bool History, typename Pixel>
+  void RenderTileInto(const TileRect& tile, std::vector<Pixel>& pixels);
+  template <bool MultiSample, bool Defocus>
+  void SpanKernel(const TileRect& tile, std::span<Colour> pixels) const;
+  [[nodiscard]] PixelSurface TraceSurface(int x, int y) const;
+  [[nodiscard]] Colour PreviewColour(int x, int y, const Hittable& world) const;
+  [[nodiscard]] std::optional<HistorySample> ReprojectHistory(const PixelSurface& surface) const;
 
   public:
   [[nodiscard]] int GetSamplesPerPixel() const noexcept
@@ -50,13 +149,42 @@ class RayTracer {
   }
 
   [[nodiscard]] HittableList& GetWorld() { return World; }
-  void ResizeViewport(const Dimension2d& dim);
+  [[nodiscard]] const HittableList& GetLights() const noexcept { return ActiveLights(); }
+  void UpdateLights();
+  // Traces `world`, lit by `lights`, instead of GetWorld(); pass nullptr to go back
+  void ShareWorld(std::shared_ptr<const Hittable> world, std::shared_ptr<const HittableList> lights);
+  // Without a framebuffer only RenderTile into a caller's buffer works, which is how frames too big
+  // for memory are streamed to disk
+  void ResizeViewport(const Dimension2d& dim, bool framebuffer = true);
+  [[nodiscard]] const Dimension2d& GetViewport() const noexcept { return ViewportDimensions; }
+  // Storage for the frame's pixels, RGB64 by default. Changing it clears the frame and its history
+  void SetPixelFormat(PixelFormat format);
+  [[nodiscard]] PixelFormat GetPixelFormat() const noexcept { return PixelData.Format(); }
 
   [[nodiscard]] Ray GetRayForPixel(int x, int y, const Vec3& pixel00_loc, const Vec3& pixel_delta_u, const Vec3& pixel_delta_v) const;
   [[nodiscard]] const std::vector<std::uint8_t>& GetRGBAData();
+  // Converts only `tile` of the frame, leaving the rest of the returned buffer as it was
+  [[nodiscard]] const std::vector<std::uint8_t>& GetRGBAData(const TileRect& tile);
   void SetupCamera();
+  // Camera, pixel grid and light list for a frame; call once before rendering its tiles
+  void BeginFrame();
+  // Renders one tile of the frame set up by BeginFrame. Disjoint tiles may be rendered concurrently
+  void RenderTile(const TileRect& tile);
+  // Same, into `pixels` (row-major, the tile's width) instead of the frame's PixelData
+  void RenderTile(const TileRect& tile, std::span<Colour> pixels) const;
+  // Progressive preview of one tile of the frame: a single pinhole ray per `step` x `step` block of
+  // pixels, shaded at its first hit by albedo x N.L with the light at the camera, fills the block.
+  // With `refine` the pixels a pass at twice the step already traced are kept, so passes at 16, 8,
+  // 4, ... each add to the last. RenderTile replaces the preview; until it does, the previewed
+  // pixels count no samples towards temporal reuse
+  void RenderPreviewTile(const TileRect& tile, int step, bool refine);
+  // Copies `tile` of the frame, with what temporal reuse keeps of it, from `other`: a copy of this
+  // tracer, taken after BeginFrame, that rendered the tile (see AsyncRenderer)
+  void CopyTile(const RayTracer& other, const TileRect& tile);
   void Render(int fromX, int fromY, int toX, int toY);
   void Render();
-  [[nodiscard]] const std::vector<Colour>& GetPixelData() const { return PixelData; }
+  [[nodiscard]] const Framebuffer& GetPixelData() const { return PixelData; }
+  // Samples behind each pixel; only kept up to date while TemporalReuse is on
+  [[nodiscard]] const std::vector<double>& GetSampleCounts() const { return SampleCounts; }
 };
 }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "image.hpp"
+#include "net.hpp"
+#include "scene.hpp"
+#include "scene_cache.hpp"
+#include "serialize.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace softrays {
+
+// Long-running render service: clients connect over a socket (see net.hpp) and send RenderJobs.
+// Built scenes are kept in a SceneCache between jobs, so a new camera on a cached scene only pays
+// for tracing. Jobs are split into tiles on a shared ThreadPool at the job's priority, and each
+// job is answered with a RenderReply once its last tile is done, in completion order.
+
+enum class ServerMessage : std::uint32_t {
+  Job = 1,  // client -> server: RenderJob
+  Reply,  // server -> client: RenderReply
+};
+
+struct RenderJob {
+  int Priority = 0;  // Higher runs first
+  SceneDescription Scene;
+  CameraSettings Camera;
+  std::string Output;  // Where the server saves the image; empty sends it back in the reply
+
+  void Serialize(ByteWriter& writer) const;
+  [[nodiscard]] static std::optional<RenderJob> Deserialize(ByteReader& reader);
+};
+
+struct RenderReply {
+  bool Ok{};
+  bool CacheHit{};
+  double SetupSeconds{};  // Scene lookup (and build, on a miss) plus camera setup
+  double TraceSeconds{};
+  FloatImage Image;  // Only for jobs without an Output
+
+  void Serialize(ByteWriter& writer) const;
+  [[nodiscard]] static std::optional<RenderReply> Deserialize(ByteReader& reader);
+};
+
+struct RenderServerOptions {
+  unsigned Threads = 0;  // Zero means one per hardware thread
+  std::size_t CacheCapacity = 8;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  int TileSize = 32;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+};
+
+class RenderServer {
+  public:
+  explicit RenderServer(RenderServerOptions options = {});
+
+  [[nodiscard]] bool Listen(const std::string& endpoint);
+  // Accepts clients and queues their jobs until Stop is called
+  void Serve();
+  // May be called from any thread; Serve returns shortly after
+  void Stop() noexcept { Stopping = true; }
+
+  [[nodiscard]] const SceneCache& GetCache() const noexcept { return Cache; }
+
+  private:
+  struct Client {
+    Socket Connection;
+    std::mutex SendMutex;  // Replies are sent from pool threads
+    bool Dead{};
+  };
+  struct ActiveJob;
+
+  RenderServerOptions Options;
+  SceneCache Cache;
+  Socket Listener;
+  std::atomic<bool> Stopping{};
+  std::vector<std::shared_ptr<Client>> Clients;
+  ThreadPool Pool;  // Last, so running jobs finish before the rest of the server goes away
+
+  void AcceptClient();
+  void HandleMessage(const std::shared_ptr<Client>& client);
+  void StartJob(const std::shared_ptr<ActiveJob>& job);
+  void FinishJob(const std::shared_ptr<ActiveJob>& job);
+  static void SendReply(Client& client, const RenderReply& reply);
+};
+
+// Sends one job to a server and waits for its reply; std::nullopt if the server couldn't be reached
+[[nodiscard]] std::optional<RenderReply> SubmitRenderJob(const std::string& endpoint, const RenderJob& job,
+    std::chrono::milliseconds connect_timeout = std::chrono::seconds(10));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "math.hpp"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace softrays {
+
+// Samples in structure-of-arrays form, one array per component, so they are generated a SIMD
+// register at a time
+struct SampleBatch {
+#if defined(__SSE2__) || defined(_M_X64)
+  static constexpr bool UsesSimd = true;
+#else
+  static constexpr bool UsesSimd = false;
+#endif
+
+  std::vector<double> X, Y, Z;
+
+  [[nodiscard]] std::size_t Size() const noexcept { return X.size(); }
+  [[nodiscard]] Vec3 operator[](std::size_t index) const noexcept { return {.x = X[index], .y = Y[index], .z = Z[index]}; }
+  void Resize(std::size_t count);
+};
+
+// The calling thread's next values.size() RandomDouble()s, without looking the generator up for each
+void RandomDoubles(std::span<double> values);
+
+// Vec3::OnUnitSphere and Vec3::InUnitDisk of each (u[i], v[i]) pair, into a batch of u.size()
+void MapToUnitSphere(std::span<const double> u, std::span<const double> v, SampleBatch& samples);
+void MapToUnitDisk(std::span<const double> u, std::span<const double> v, SampleBatch& samples);
+
+// `count` samples drawn from the calling thread's generator, the same ones as `count` calls to
+// Vec3::RandomUnitVector or Vec3::RandomInUnitDisk would return
+void SampleUnitSphere(std::size_t count, SampleBatch& samples);
+void SampleUnitDisk(std::size_t count, SampleBatch& samples);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "math.hpp"
+#include "serialize.hpp"
+#include "utility.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace softrays {
+class EnvironmentMap;
+class RayTracer;
+struct MaterialBase;
+struct PreparedScene;
+class SceneArena;
+
+// Plain-data description of a scene, so it can be hashed, cached and sent to other processes.
+// RayTracer's world is built from it with Populate.
+
+enum class MaterialType : std::uint8_t {
+  Lambertian,
+  Metal,
+  Dielectric,
+  DiffuseLight,
+};
+
+struct MaterialDescription {
+  MaterialType Type = MaterialType::Lambertian;
+  Colour Albedo{};  // Emitted radiance for DiffuseLight
+  double Parameter{};  // Fuzz for Metal, refraction index for Dielectric
+  std::string TexturePath{};  // Optional image multiplying Albedo, for Lambertian and Metal (see TiledTexture::OpenImage)
+
+  // Null if the texture can't be opened
+  [[nodiscard]] std::shared_ptr<MaterialBase> Build() const;
+  [[nodiscard]] std::shared_ptr<MaterialBase> Build(SceneArena& arena) const;
+};
+
+struct SphereDescription {
+  Point3 Center{};
+  double Radius{};
+  std::uint32_t Material{};  // Index into SceneDescription::Materials
+};
+
+// The plane through Point facing Normal (see Plane), e.g. a floor
+struct PlaneDescription {
+  Point3 Point{};
+  Vec3 Normal{0, 1, 0};
+  std::uint32_t Material{};
+  double TextureSize = 1.0;  // Distance a texture repeats over
+};
+
+// Axis-aligned rectangle between two opposite corners (see Quad), e.g. a wall or an area light
+struct QuadDescription {
+  Point3 Corner{};
+  Point3 Opposite{};
+  std::uint32_t Material{};
+};
+
+struct SceneDescription {
+  std::vector<MaterialDescription> Materials;
+  std::vector<SphereDescription> Spheres;
+  std::vector<PlaneDescription> Planes;
+  std::vector<QuadDescription> Quads;
+
+  bool SkyBackground = true;
+  Colour BackgroundColour{};
+  std::string EnvironmentPath;  // Optional .pfm environment map, resolved by the process that populates
+  double EnvironmentIntensity = 1.0;
+
+  std::uint32_t AddMaterial(const MaterialDescription& material)
+  {
+    Materials.push_back(material);
+    return static_cast<std::uint32_t>(Materials.size() - 1);
+  }
+
+  void Serialize(ByteWriter& writer) const;
+  [[nodiscard]] static std::optional<SceneDescription> Deserialize(ByteReader& reader);
+
+  // Content hash of everything that affects the built world (not the camera)
+  [[nodiscard]] std::uint64_t Hash() const;
+
+  // Adds the scene's objects to the tracer's world and sets its background.
+  // Returns false if a material index is out of range or a texture or the environment map can't be loaded
+  [[nodiscard]] bool Populate(RayTracer& raytracer) const;
+  // Same, with the objects and materials allocated in `arena`, which must outlive their use
+  [[nodiscard]] bool Populate(RayTracer& raytracer, SceneArena& arena) const;
+
+  // Builds the world once, for any number of tracers to share; std::nullopt on the same errors as Populate
+  [[nodiscard]] std::optional<PreparedScene> Prepare() const;
+  // Only the background and environment map, with no world or lights, for tracers that get their
+  // world elsewhere (see PrepareMapped); std::nullopt if the environment map can't be loaded
+  [[nodiscard]] std::optional<PreparedScene> PrepareBackground() const;
+};
+
+// A built scene that is only ever read, so tracers on many threads can trace it at once
+struct PreparedScene {
+  std::shared_ptr<const Hittable> World;  // A WideBvh over the scene's objects
+  std::shared_ptr<const HittableList> Lights;  // The emissive objects of World
+  std::shared_ptr<const EnvironmentMap> Environment;
+  bool SkyBackground = true;
+  Colour BackgroundColour{};
+
+  // Points the tracer at this scene instead of its own world
+  void AttachTo(RayTracer& raytracer) const;
+};
+
+// Everything a render needs besides the scene itself
+struct CameraSettings {
+  Dimension2d Dimensions{.Width = 600, .Height = 400};  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  int SamplesPerPixel = 100;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  int MaxDepth = 50;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  double FieldOfView = 90;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  Point3 LookFrom{0, 0, 0};
+  Point3 LookAt{0, 0, -1};
+  Vec3 CameraUp{0, 1, 0};
+  double DefocusAngle = 0;
+  double FocusDistance = 10;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+  void Serialize(ByteWriter& writer) const;
+  [[nodiscard]] static std::optional<CameraSettings> Deserialize(ByteReader& reader);
+
+  // Sets the tracer's camera and quality settings, resizing its viewport (see ResizeViewport for
+  // `framebuffer`)
+  void Apply(RayTracer& raytracer, bool framebuffer = true) const;
+};
+
+// The "final scene" from Ray Tracing in One Weekend, generated from a fixed seed so every
+// process that builds it gets the same spheres
+[[nodiscard]] SceneDescription RandomSphereScene(std::uint32_t seed = 0);
+[[nodiscard]] CameraSettings RandomSphereCamera();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "scene.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace softrays {
+
+// Least-recently-used cache of built scenes, keyed by SceneDescription::Hash, so a stream of
+// camera variants of one scene only builds it once. Safe to use from many threads: a scene that
+// is already being built by one thread is waited for, not built again, by the others.
+class SceneCache {
+  public:
+  explicit SceneCache(std::size_t capacity = 8);  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+  struct Result {
+    std::shared_ptr<const PreparedScene> Scene;  // nullptr if the scene could not be built
+    bool Hit{};  // Built (or being built) before this call
+  };
+
+  // Evicted scenes stay alive for as long as a caller still holds them. If building the scene
+  // throws, so does every call waiting for it, and the next request builds it again
+  [[nodiscard]] Result Acquire(const SceneDescription& scene);
+
+  [[nodiscard]] std::size_t Size() const;
+  [[nodiscard]] std::size_t Hits() const;
+  [[nodiscard]] std::size_t Misses() const;
+
+  private:
+  using Future = std::shared_future<std::shared_ptr<const PreparedScene>>;
+
+  struct Entry {
+    std::uint64_t Hash{};
+    Future Scene;
+  };
+
+  std::size_t Capacity;
+  mutable std::mutex Mutex;
+  std::list<Entry> Entries;  // Most recently used first
+  std::unordered_map<std::uint64_t, std::list<Entry>::iterator> Index;
+  std::size_t HitCount{};
+  std::size_t MissCount{};
+
+  // Drops the entry for `hash`, if there is one; with Mutex held
+  void Forget(std::uint64_t hash);
+};
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "image.hpp"
+#include "scene.hpp"
+
+#include <functional>
+#include <istream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace softrays {
+
+// Animation rendering. Each frame goes through three stages, run as a pipeline so the cores that
+// trace never wait for the others: while frame N is traced on a thread pool, frame N+1's scene and
+// camera are being produced and frame N-1 is being written.
+
+// What one frame of a sequence renders
+struct SequenceFrame {
+  PreparedScene Scene;
+  CameraSettings Camera;
+};
+
+// Produces frame `frame`, or std::nullopt to abort. Runs on its own thread, one frame ahead of tracing
+using FrameUpdate = std::function<std::optional<SequenceFrame>(int frame)>;
+// Stores a finished frame, returning false to abort. Runs on its own thread, one frame behind tracing
+using FrameWriter = std::function<bool(int frame, const FloatImage& image)>;
+
+struct SequenceOptions {
+  int TileSize{32};
+  // Zero means one per hardware thread
+  unsigned Threads{0};
+};
+
+// Renders frames [0, frame_count). Returns false when an update or write fails, after the frames
+// before it are written
+[[nodiscard]] bool RenderSequence(int frame_count, const FrameUpdate& update, const FrameWriter& write, const SequenceOptions& options = {});
+
+// A camera at one frame of an animation
+struct CameraKeyframe {
+  int Frame{};
+  CameraSettings Camera;
+};
+
+// The camera at `frame`, interpolated linearly between the keyframes either side of it (which must
+// be sorted by Frame and not empty) and held before the first and after the last. Resolution and
+// quality come from the earlier keyframe
+[[nodiscard]] CameraSettings InterpolateCamera(std::span<const CameraKeyframe> keyframes, int frame);
+
+// Reads keyframes, one per line: `frame fromX fromY fromZ atX atY atZ [fieldOfView]`, on top of
+// `base` for everything else. Blank lines and lines starting with '#' are skipped. Returns
+// std::nullopt on a malformed line or when there are no keyframes; the result is sorted by frame
+[[nodiscard]] std::optional<std::vector<CameraKeyframe>> ReadCameraKeyframes(std::istream& input, const CameraSettings& base);
+
+// A fixed scene seen through keyframed cameras: the scene is built once and shared by every frame
+[[nodiscard]] FrameUpdate KeyframedCamera(PreparedScene scene, std::vector<CameraKeyframe> keyframes);
+
+// Writes each frame to `pattern` with its last run of '#' replaced by the zero-padded frame
+// number (see FramePath), as a .pfm or 8-bit PPM like SaveImage
+[[nodiscard]] FrameWriter WriteNumberedFrames(std::string pattern);
+// "frame_###.ppm" and 7 give "frame_007.ppm"; a pattern without '#' gets "_<frame>" before its extension
+[[nodiscard]] std::string FramePath(std::string_view pattern, int frame);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace softrays {
+
+// Minimal binary (de)serialisation of trivially copyable values, in native byte order.
+// Used for scenes and messages exchanged between processes on the same kind of machine.
+class ByteWriter {
+  std::vector<std::byte> Buffer;
+
+  public:
+  // Room for `bytes` more, for callers that know what they are about to write
+  void Reserve(std::size_t bytes) { Buffer.reserve(Buffer.size() + bytes); }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  void Write(const T& value)
+  {
+    const auto offset = Buffer.size();
+    Buffer.resize(offset + sizeof(T));
+    std::memcpy(&Buffer[offset], &value, sizeof(T));
+  }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  void WriteSpan(std::span<const T> values)
+  {
+    Write<std::uint64_t>(values.size());
+    const auto offset = Buffer.size();
+    Buffer.resize(offset + values.size_bytes());
+    if (!values.empty()) {
+      std::memcpy(&Buffer[offset], values.data(), values.size_bytes());
+    }
+  }
+
+  void WriteString(const std::string& value)
+  {
+    WriteSpan(std::span<const char>(value.data(), value.size()));
+  }
+
+  [[nodiscard]] const std::vector<std::byte>& Data() const noexcept { return Buffer; }
+  [[nodiscard]] std::vector<std::byte> Take() noexcept { return std::move(Buffer); }
+};
+
+// Reads values back in the order they were written; any overrun marks the reader as failed
+// and yields value-initialised results, so callers only need to check Ok() once at the end.
+class ByteReader {
+  std::span<const std::byte> Buffer;
+  std::size_t Offset{};
+  bool Failed{};
+
+  public:
+  explicit ByteReader(std::span<const std::byte> buffer) noexcept : Buffer(buffer) { }
+
+  // Any bytes make a valid T; bools and enums, which don't, have their own readers below
+  template <typename T>
+    requires(std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool> && !std::is_enum_v<T>)
+  [[nodiscard]] T Read() noexcept
+  {
+    T value{};
+    if (Failed || Buffer.size() - Offset < sizeof(T)) {
+      Failed = true;
+      return value;
+    }
+    std::memcpy(&value, &Buffer[Offset], sizeof(T));
+    Offset += sizeof(T);
+    return value;
+  }
+
+  // A byte other than 0 or 1 fails the reader
+  [[nodiscard]] bool ReadBool() noexcept
+  {
+    const auto value = Read<std::uint8_t>();
+    if (value > 1) {
+      Failed = true;
+    }
+    return value == 1;
+  }
+
+  // A value past `last`, the enum's last enumerator, fails the reader
+  template <typename E>
+    requires std::is_enum_v<E>
+  [[nodiscard]] E ReadEnum(E last) noexcept
+  {
+    using Underlying = std::underlying_type_t<E>;
+    const auto value = Read<Underlying>();
+    if (value > static_cast<Underlying>(last)) {
+      Failed = true;
+      return E{};
+    }
+    return static_cast<E>(value);
+  }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  [[nodiscard]] std::vector<T> ReadVector()
+  {
+    const auto count = Read<std::uint64_t>();
+    if (Failed || (Buffer.size() - Offset) / sizeof(T) < count) {
+      Failed = true;
+      return {};
+    }
+    std::vector<T> values(static_cast<std::size_t>(count));
+    if (count > 0) {
+      std::memcpy(values.data(), &Buffer[Offset], values.size() * sizeof(T));
+    }
+    Offset += values.size() * sizeof(T);
+    return values;
+  }
+
+  [[nodiscard]] std::string ReadString()
+  {
+    const auto chars = ReadVector<char>();
+    return {chars.begin(), chars.end()};
+  }
+
+  [[nodiscard]] bool Ok() const noexcept { return !Failed; }
+  [[nodiscard]] bool AtEnd() const noexcept { return Offset == Buffer.size(); }
+};
+
+// 64-bit FNV-1a, good enough to key caches on serialised content
+[[nodiscard]] constexpr std::uint64_t HashBytes(std::span<const std::byte> bytes, std::uint64_t hash = 14695981039346656037ULL) noexcept
+{
+  constexpr std::uint64_t prime = 1099511628211ULL;
+  for (const auto byte : bytes) {
+    hash ^= static_cast<std::uint64_t>(byte);
+    hash *= prime;
+  }
+  return hash;
+}
+}
@@ -3,50 +3,305 @@
 #include "material.hpp"
 #include "utility.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <memory>
+#include <numbers>
 #include <utility>
 
 namespace softrays {
+// Nearest ray time inside `ray_time` at which the ray meets the sphere, into `root`
+[[nodiscard]] inline bool SphereRoot(const Point3& center, double radius, const Ray& ray, Interval ray_time, double& root) noexcept
+{
+  const Vec3 o_c = center - ray.Origin;
+  const auto a = ray.Direction.LengthSquared();
+  const auto hyp = ray.Direction.Dot(o_c);
+  const auto c_comp = o_c.LengthSquared() - (radius * radius);
+  const auto discriminant = (hyp * hyp) - (a * c_comp);
+
+  if (discriminant < 0) {
+    return false;
+  }
+
+  const auto sqrtd = std::sqrt(discriminant);
+
+  // Find the nearest root that lies in the acceptable range.
+  root = (hyp - sqrtd) / a;
+  if (!ray_time.Surrounds(root)) {
+    root = (hyp + sqrtd) / a;
+    if (!ray_time.Surrounds(root))
+      return false;
+  }
+  return true;
+}
+
+// Closest intersection with the sphere inside `ray_time`; fills in everything but the material
+[[nodiscard]] inline bool IntersectSphere(const Point3& center, double radius, const Ray& ray, Interval ray_time, HitData& hit) noexcept
+{
+  double root = 0;
+  if (!SphereRoot(center, radius, ray, ray_time, root)) {
+    return false;
+  }
+
+  hit.Time = root;
+  hit.Location = ray.At(hit.Time);
+  const Vec3 outward_normal = (hit.Location - center) / radius;
+  hit.SetFaceNormal(ray, outward_normal);
+  return true;
+}
+
+// Texture coordinates of a hit on the sphere, kept apart from IntersectSphere so untextured spheres
+// don't pay for the trigonometry on every candidate hit
+inline void SetSphereTextureCoordinates(const Point3& center, double radius, HitData& hit) noexcept
+{
+  const Vec3 outward_normal = (hit.Location - center) / radius;
+  // Latitude and longitude: U runs around from -x through +z, V from the bottom pole to the top
+  hit.U = (std::atan2(-outward_normal.z, outward_normal.x) + Pi) / (2 * Pi);
+  hit.V = std::acos(std::clamp(-outward_normal.y, -1.0, 1.0)) / Pi;
+  // The geometric mean of the circumference U spans and the half circumference V spans
+  hit.TextureScale = Pi * std::numbers::sqrt2 * radius;
+}
+
 class Sphere : public Hittable {
   private:
   Point3 Center;
   double Radius;
   std::shared_ptr<MaterialBase> Material;
+  bool Textured;
 
   public:
   Sphere(const Point3& center, double radius, std::shared_ptr<MaterialBase>&& mat) noexcept
-      : Center(center), Radius(std::fmax(0, radius)), Material(std::move(mat))
+      : Center(center), Radius(std::fmax(0, radius)), Material(std::move(mat)), Textured(Material && Material->IsTextured())
   {
   }
 
   [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override
   {
-    const Vec3 o_c = Center - ray.Origin;
-    const auto a = ray.Direction.LengthSquared();
-    const auto hyp = ray.Direction.Dot(o_c);
-    const auto c_comp = o_c.LengthSquared() - (Radius * Radius);
-    const auto discriminant = (hyp * hyp) - (a * c_comp);
+    if (!IntersectSphere(Center, Radius, ray, ray_time, hit)) {
+      return false;
+    }
+    if (Textured) {
+      SetSphereTextureCoordinates(Center, Radius, hit);
+    }
+    hit.Material = Material;
+    return true;
+  }
+
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override
+  {
+    double root = 0;
+    return SphereRoot(Center, Radius, ray, ray_time, root);
+  }
+
+  [[nodiscard]] Aabb BoundingBox() const override
+  {
+    const Vec3 extent{.x = Radius, .y = Radius, .z = Radius};
+    return Aabb::FromPoints(Center - extent, Center + extent);
+  }
+
+  [[nodiscard]] bool IsEmissive() const noexcept override
+  {
+    return Material && Material->IsEmissive();
+  }
+
+  // Lights are sampled uniformly over the cone of directions they subtend from `origin`
+  [[nodiscard]] double PdfValue(const Point3& origin, const Vec3& direction) const override
+  {
+    constexpr auto minDist = 0.001;
+    if (!Occluded({.Origin = origin, .Direction = direction}, {.Min = minDist, .Max = Infinity})) {
+      return 0.0;
+    }
+    return 1.0 / SolidAngle(origin);
+  }
+
+  [[nodiscard]] Vec3 RandomDirection(const Point3& origin) const override
+  {
+    const auto to_center = Center - origin;
+    const auto cos_theta_max = CosThetaMax(to_center.LengthSquared());
+    const auto z = 1 + (RandomDouble() * (cos_theta_max - 1));
+    const auto phi = 2 * Pi * RandomDouble();
+    const auto sin_theta = std::sqrt(std::fmax(0.0, 1 - (z * z)));
+    const Vec3 local{.x = std::cos(phi) * sin_theta, .y = std::sin(phi) * sin_theta, .z = z};
+    return OrthonormalBasis::FromW(to_center).Transform(local);
+  }
+
+  [[nodiscard]] const Point3& GetCenter() const noexcept { return Center; }
+  [[nodiscard]] double GetRadius() const noexcept { return Radius; }
+  [[nodiscard]] const std::shared_ptr<MaterialBase>& GetMaterial() const noexcept { return Material; }
+
+  private:
+  // Cosine of the half-angle of the cone subtended by the sphere, -1 (whole sphere of directions) from inside it
+  [[nodiscard]] double CosThetaMax(double distance_squared) const noexcept
+  {
+    const auto radius_squared = Radius * Radius;
+    return distance_squared > radius_squared ? std::sqrt(1 - (radius_squared / distance_squared)) : -1.0;
+  }
+
+  [[nodiscard]] double SolidAngle(const Point3& origin) const noexcept
+  {
+    return 2 * Pi * (1 - CosThetaMax((Center - origin).LengthSquared()));
+  }
+};
+
+// The plane through `point` facing `normal`, unbounded: hierarchies test it against every ray
+// rather than trying to box it (see PartitionByBounds). One division per ray instead of the
+// quadratic a huge sphere standing in for a floor costs
+class Plane : public Hittable {
+  public:
+  // Textures repeat every `texture_size` along the plane
+  Plane(const Point3& point, const Vec3& normal, std::shared_ptr<MaterialBase>&& mat, double texture_size = 1.0) noexcept
+      : Point(point), Basis(OrthonormalBasis::FromW(normal)), Offset(Basis.W.Dot(point)), TextureSize(texture_size),
+        Material(std::move(mat)), Textured(Material && Material->IsTextured())
+  {
+  }
 
-    if (discriminant < 0) {
+  [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override
+  {
+    double time = 0;
+    if (!Intersect(ray, ray_time, time)) {
       return false;
     }
+    hit.Time = time;
+    hit.Location = ray.At(time);
+    hit.SetFaceNormal(ray, Basis.W);
+    if (Textured) {
+      const auto local = hit.Location - Point;
+      hit.U = local.Dot(Basis.U) / TextureSize;
+      hit.V = local.Dot(Basis.V) / TextureSize;
+      hit.TextureScale = TextureSize;
+    }
+    hit.Material = Material;
+    return true;
+  }
 
-    const auto sqrtd = std::sqrt(discriminant);
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override
+  {
+    double time = 0;
+    return Intersect(ray, ray_time, time);
+  }
+
+  [[nodiscard]] const Point3& GetPoint() const noexcept { return Point; }
+  [[nodiscard]] const Vec3& GetNormal() const noexcept { return Basis.W; }
+
+  private:
+  Point3 Point;
+  OrthonormalBasis Basis;  // W is the unit normal; U and V lay textures out
+  double Offset;  // Normal . point for every point on the plane
+  double TextureSize;
+  std::shared_ptr<MaterialBase> Material;
+  bool Textured;
 
-    // Find the nearest root that lies in the acceptable range.
-    auto root = (hyp - sqrtd) / a;
-    if (!ray_time.Surrounds(root)) {
-      root = (hyp + sqrtd) / a;
-      if (!ray_time.Surrounds(root))
-        return false;
+  [[nodiscard]] bool Intersect(const Ray& ray, Interval ray_time, double& time) const noexcept
+  {
+    const auto denominator = Basis.W.Dot(ray.Direction);
+    // A ray along the plane never meets it; the division below would give infinity or NaN
+    constexpr auto parallelLimit = 1e-12;
+    if (std::fabs(denominator) < parallelLimit) {
+      return false;
     }
+    time = (Offset - Basis.W.Dot(ray.Origin)) / denominator;
+    return ray_time.Surrounds(time);
+  }
+};
+
+// Rectangle lying in a plane of constant x, y or z, between two opposite corners. Which axis is
+// flat is the one the corners differ least along. Can be an area light
+class Quad : public Hittable {
+  public:
+  Quad(const Point3& corner, const Point3& opposite, std::shared_ptr<MaterialBase>&& mat) noexcept
+      : Material(std::move(mat)), Textured(Material && Material->IsTextured())
+  {
+    const auto extent = opposite - corner;
+    const std::array<double, 3> sizes{std::fabs(extent.x), std::fabs(extent.y), std::fabs(extent.z)};
+    const auto flat = static_cast<int>(std::ranges::min_element(sizes) - sizes.begin());
+    const std::array<Vec3, 3> axes{Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1)};
+    Normal = axes[static_cast<std::size_t>(flat)];
+    AxisU = axes[static_cast<std::size_t>((flat + 1) % 3)];
+    AxisV = axes[static_cast<std::size_t>((flat + 2) % 3)];
+    Position = Normal.Dot(corner);
+    RangeU = {.Min = std::fmin(AxisU.Dot(corner), AxisU.Dot(opposite)), .Max = std::fmax(AxisU.Dot(corner), AxisU.Dot(opposite))};
+    RangeV = {.Min = std::fmin(AxisV.Dot(corner), AxisV.Dot(opposite)), .Max = std::fmax(AxisV.Dot(corner), AxisV.Dot(opposite))};
+  }
 
-    hit.Time = root;
-    hit.Location = ray.At(hit.Time);
-    const Vec3 outward_normal = (hit.Location - Center) / Radius;
-    hit.SetFaceNormal(ray, outward_normal);
+  [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override
+  {
+    double time = 0;
+    Point3 location;
+    if (!Intersect(ray, ray_time, time, location)) {
+      return false;
+    }
+    hit.Time = time;
+    hit.Location = location;
+    hit.SetFaceNormal(ray, Normal);
+    if (Textured) {
+      hit.U = (AxisU.Dot(location) - RangeU.Min) / RangeU.Size();
+      hit.V = (AxisV.Dot(location) - RangeV.Min) / RangeV.Size();
+      hit.TextureScale = std::sqrt(RangeU.Size() * RangeV.Size());
+    }
     hit.Material = Material;
     return true;
   }
+
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override
+  {
+    double time = 0;
+    Point3 location;
+    return Intersect(ray, ray_time, time, location);
+  }
+
+  // Padded along the flat axis, since hierarchies build poorly on boxes of zero thickness
+  [[nodiscard]] Aabb BoundingBox() const override
+  {
+    constexpr auto padding = 1e-4;
+    const auto low = (Normal * (Position - padding)) + (AxisU * RangeU.Min) + (AxisV * RangeV.Min);
+    const auto high = (Normal * (Position + padding)) + (AxisU * RangeU.Max) + (AxisV * RangeV.Max);
+    return Aabb::FromPoints(low, high);
+  }
+
+  [[nodiscard]] bool IsEmissive() const noexcept override
+  {
+    return Material && Material->IsEmissive();
+  }
+
+  // Lights are sampled uniformly over their area, converted to solid angle at `origin`
+  [[nodiscard]] double PdfValue(const Point3& origin, const Vec3& direction) const override
+  {
+    constexpr auto minDist = 0.001;
+    double time = 0;
+    Point3 location;
+    if (!Intersect({.Origin = origin, .Direction = direction}, {.Min = minDist, .Max = Infinity}, time, location)) {
+      return 0.0;
+    }
+    const auto distance_squared = (location - origin).LengthSquared();
+    const auto cosine = std::fabs(direction.Dot(Normal)) / direction.Length();
+    return distance_squared / (cosine * RangeU.Size() * RangeV.Size());
+  }
+
+  [[nodiscard]] Vec3 RandomDirection(const Point3& origin) const override
+  {
+    const auto point = (Normal * Position) + (AxisU * RandomDouble(RangeU.Min, RangeU.Max)) + (AxisV * RandomDouble(RangeV.Min, RangeV.Max));
+    return (point - origin).UnitVector();
+  }
+
+  private:
+  Vec3 Normal;  // A coordinate axis
+  Vec3 AxisU, AxisV;  // The other two, in cyclic order
+  double Position{};  // Along Normal
+  Interval RangeU, RangeV;
+  std::shared_ptr<MaterialBase> Material;
+  bool Textured;
+
+  [[nodiscard]] bool Intersect(const Ray& ray, Interval ray_time, double& time, Point3& location) const noexcept
+  {
+    // Dividing by zero for rays along the quad gives an infinite or NaN time, which fails the test
+    time = (Position - Normal.Dot(ray.Origin)) / Normal.Dot(ray.Direction);
+    if (!ray_time.Surrounds(time)) {
+      return false;
+    }
+    location = ray.At(time);
+    return RangeU.Contains(AxisU.Dot(location)) && RangeV.Contains(AxisV.Dot(location));
+  }
 };
 }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "raytracer.hpp"
+
+#include <string>
+
+namespace softrays {
+
+struct StreamRenderOptions {
+  int TileSize{64};
+  // Zero means one per hardware thread
+  unsigned Threads{0};
+};
+
+// Renders `raytracer`'s frame tile by tile straight into the image file at `path`, for frames too
+// big to hold in memory. Each worker traces into one small reusable tile buffer and writes the
+// finished rows to their place in the file, so peak memory is threads x tile size squared however
+// large the image is. The tracer needs no framebuffer (see RayTracer::ResizeViewport).
+// .pfm files are written as floats and anything else as a binary 8-bit PPM (P6).
+// Returns false if the file could not be created or written
+[[nodiscard]] bool RenderToFile(RayTracer& raytracer, const std::string& path, const StreamRenderOptions& options = {});
+}
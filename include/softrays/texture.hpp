@@ -0,0 +1,158 @@
+#pragma once
+
+#include "image.hpp"
+#include "math.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace softrays {
+
+// Image textures too big, or too many, to keep in memory. A texture is converted once into a file
+// of its mip pyramid cut into square tiles, and tiles are read from it as lookups need them into a
+// TextureCache shared by all textures, which holds at most its capacity in bytes and drops the
+// least recently used tiles to make room.
+
+struct TextureCacheStats {
+  std::uint64_t Hits{};
+  std::uint64_t Misses{};  // Tiles read from disk
+  std::uint64_t Evictions{};
+  std::size_t ResidentBytes{};
+  std::size_t PeakBytes{};  // Most ever resident at once
+  std::size_t CapacityBytes{};
+
+  [[nodiscard]] double HitRate() const noexcept
+  {
+    const auto lookups = Hits + Misses;
+    return lookups > 0 ? static_cast<double>(Hits) / static_cast<double>(lookups) : 0.0;
+  }
+};
+
+// One tile of one mip level, with a texel of its right and bottom neighbours stored along the far
+// edges so bilinear filtering never needs a second tile
+struct TextureTile {
+  int Width{};  // Including the extra column
+  int Height{};  // Including the extra row
+  std::vector<float> Texels;  // Width * Height RGB
+
+  [[nodiscard]] std::size_t Bytes() const noexcept { return Texels.size() * sizeof(float); }
+};
+
+// Thread-safe LRU cache of texture tiles, split into shards by key so lookups on many threads
+// rarely wait on the same lock. Each shard keeps to its share of the capacity. Tiles handed out
+// stay valid while held even if evicted meanwhile, so memory is the capacity plus the few tiles
+// threads are filtering at that moment
+class TextureCache {
+  public:
+  static constexpr std::size_t DefaultShards = 16;
+
+  explicit TextureCache(std::size_t capacity_bytes, std::size_t shards = DefaultShards);
+
+  // Shared by textures opened without a cache of their own, e.g. by SceneDescription::Populate
+  [[nodiscard]] static const std::shared_ptr<TextureCache>& Default();
+
+  using TileLoader = std::function<std::shared_ptr<const TextureTile>()>;
+  // The tile under `key`, calling `load` to read it on a miss; null if that fails
+  [[nodiscard]] std::shared_ptr<const TextureTile> Find(std::uint64_t key, const TileLoader& load);
+
+  // Evicts down to the new capacity at once
+  void SetCapacity(std::size_t capacity_bytes);
+  [[nodiscard]] std::uint32_t NewTextureId() noexcept { return NextTextureId++; }
+
+  [[nodiscard]] TextureCacheStats Stats() const;
+  void ResetStats() noexcept;
+
+  private:
+  struct Entry {
+    std::uint64_t Key;
+    std::shared_ptr<const TextureTile> Tile;
+  };
+  struct Shard {
+    std::mutex Mutex;
+    std::list<Entry> Recent;  // Most recently used first
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> Index;
+    std::size_t Bytes{};
+  };
+
+  std::vector<Shard> Shards;
+  std::atomic<std::size_t> ShardCapacity;
+  std::atomic<std::uint32_t> NextTextureId{0};
+  std::atomic<std::uint64_t> Hits{0};
+  std::atomic<std::uint64_t> Misses{0};
+  std::atomic<std::uint64_t> Evictions{0};
+  std::atomic<std::size_t> ResidentBytes{0};
+  std::atomic<std::size_t> PeakBytes{0};
+
+  void EvictDownTo(Shard& shard, std::size_t capacity);
+};
+
+// A tiled mip-mapped texture file, read through a TextureCache. Coordinates repeat outside [0, 1),
+// and v = 0 is the bottom row of the image
+class TiledTexture {
+  public:
+  static constexpr int DefaultTileSize = 64;
+
+  // Null if the file is missing or not a tiled texture
+  [[nodiscard]] static std::shared_ptr<TiledTexture> Open(const std::string& path, std::shared_ptr<TextureCache> cache = TextureCache::Default());
+  // Opens `path` as a tiled texture, first converting it from the .pfm image it names if it is one
+  // (to path + ".tiles", reused from then on)
+  [[nodiscard]] static std::shared_ptr<TiledTexture> OpenImage(const std::string& path, std::shared_ptr<TextureCache> cache = TextureCache::Default());
+
+  // Trilinearly filtered colour at (u, v) for a lookup covering `footprint` of the texture's width
+  // (1 is the whole texture), which picks the mip level whose texels are about that size
+  [[nodiscard]] Colour Sample(double u, double v, double footprint) const;
+  // Unfiltered colour of texel (x, y) of mip `level`, wrapping around
+  [[nodiscard]] Colour Texel(int level, int x, int y) const;
+
+  [[nodiscard]] int GetWidth() const noexcept { return Levels.front().Width; }
+  [[nodiscard]] int GetHeight() const noexcept { return Levels.front().Height; }
+  [[nodiscard]] int LevelCount() const noexcept { return static_cast<int>(Levels.size()); }
+  // Mean colour, the one texel of the coarsest level
+  [[nodiscard]] const Colour& Average() const noexcept { return Mean; }
+
+  private:
+  struct Level {
+    int Width{};
+    int Height{};
+    int TilesX{};
+    int TilesY{};
+    std::size_t FirstTile{};  // Index of its first tile in Offsets
+  };
+  struct TileSize2d {
+    int Width;
+    int Height;
+  };
+
+  std::shared_ptr<TextureCache> Cache;
+  std::uint32_t Id{};
+  int TileSize{};
+  std::vector<Level> Levels;
+  std::vector<std::uint64_t> Offsets;  // Where each tile starts in the file
+  Colour Mean;
+  mutable std::mutex FileMutex;
+  mutable std::ifstream File;
+
+  TiledTexture() = default;
+  [[nodiscard]] TileSize2d TileExtent(std::size_t level, int tile_x, int tile_y) const noexcept;
+  [[nodiscard]] std::size_t TileIndex(std::size_t level, int tile_x, int tile_y) const noexcept;
+  [[nodiscard]] std::shared_ptr<const TextureTile> LoadTile(std::size_t level, int tile_x, int tile_y) const;
+  // The cached tile holding texel (x, y) of `level`
+  [[nodiscard]] std::shared_ptr<const TextureTile> FindTile(std::size_t level, int x, int y) const;
+  [[nodiscard]] Colour Bilinear(std::size_t level, double u, double v) const;
+};
+
+// Writes `image` as a tiled texture file with its whole mip pyramid, down to 1x1. The pyramid is
+// built in memory, so this is done once per texture ahead of rendering. Returns false if the file
+// can't be written
+[[nodiscard]] bool WriteTiledTexture(const std::string& path, const FloatImage& image, int tile_size = TiledTexture::DefaultTileSize);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace softrays {
+
+// Fixed set of worker threads running submitted tasks, highest priority first and in submission
+// order within a priority. A render split into tiles can then be overtaken, tile by tile, by a
+// more urgent one.
+class ThreadPool {
+  public:
+  // Zero threads means one per hardware thread
+  explicit ThreadPool(unsigned threads = 0);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+  // Finishes the tasks already running; anything still queued is dropped
+  ~ThreadPool();
+
+  void Submit(std::function<void()> task, int priority = 0);
+  // Blocks until the queue is empty and no task is running
+  void WaitIdle();
+
+  [[nodiscard]] std::size_t ThreadCount() const noexcept { return Threads.size(); }
+
+  private:
+  struct Task {
+    int Priority{};
+    std::uint64_t Sequence{};
+    std::function<void()> Work;
+  };
+
+  struct RunsBefore {
+    bool operator()(const Task& a, const Task& b) const noexcept
+    {
+      // priority_queue pops its "largest" element, so the task that should run first must compare greatest
+      return a.Priority != b.Priority ? a.Priority < b.Priority : a.Sequence > b.Sequence;
+    }
+  };
+
+  std::mutex Mutex;
+  std::condition_variable WorkAvailable;
+  std::condition_variable Idle;
+  std::priority_queue<Task, std::vector<Task>, RunsBefore> Tasks;
+  std::uint64_t NextSequence{};
+  std::size_t Running{};
+  bool Stopping{};
+  std::vector<std::thread> Threads;
+
+  void WorkerLoop();
+};
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "utility.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace softrays {
+
+// Timeline tracing: scoped events recorded per thread and written out in the Chrome trace event
+// format, which chrome://tracing and ui.perfetto.dev show as one track per thread, so load
+// imbalance and straggler tiles are visible at a glance.
+// Nothing is recorded until StartTracing, and the SOFTRAYS_TRACE_SCOPE points in the library
+// compile to nothing unless it is built with softrays_ENABLE_TRACING.
+
+// Discards the events of any earlier trace and starts recording
+void StartTracing();
+void StopTracing();
+[[nodiscard]] bool TracingEnabled() noexcept;
+
+// The events recorded since StartTracing as Chrome trace JSON. Each thread keeps only its latest
+// events, and those must not be added to while this runs: stop tracing, or let the traced work finish
+[[nodiscard]] std::string ChromeTraceJson();
+[[nodiscard]] bool WriteChromeTrace(const std::string& path);
+
+// Records the time from construction to destruction as one event on the calling thread's track,
+// if tracing was on when it began. `name` must outlive the trace, e.g. a string literal
+class TraceScope {
+  public:
+  explicit TraceScope(const char* name) noexcept;
+  // Also records which tile the event worked on
+  TraceScope(const char* name, const TileRect& tile) noexcept;
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+  TraceScope(TraceScope&&) = delete;
+  TraceScope& operator=(TraceScope&&) = delete;
+  ~TraceScope();
+
+  private:
+  const char* Name;
+  TileRect Tile{};
+  bool HasTile{};
+  std::int64_t Begin{-1};  // Nanoseconds on the steady clock, -1 when not recording
+};
+}
+
+#if defined(SOFTRAYS_TRACING)
+// NOLINTBEGIN(cppcoreguidelines-macro-usage)
+#define SOFTRAYS_TRACE_CONCAT_IMPL(a, b) a##b
+#define SOFTRAYS_TRACE_CONCAT(a, b) SOFTRAYS_TRACE_CONCAT_IMPL(a, b)
+// Traces the rest of the enclosing block: SOFTRAYS_TRACE_SCOPE("name") or SOFTRAYS_TRACE_SCOPE("name", tile)
+#define SOFTRAYS_TRACE_SCOPE(...) const ::softrays::TraceScope SOFTRAYS_TRACE_CONCAT(softrays_trace_scope_, __LINE__)(__VA_ARGS__)
+// NOLINTEND(cppcoreguidelines-macro-usage)
+#else
+#define SOFTRAYS_TRACE_SCOPE(...) static_cast<void>(0)  // NOLINT(cppcoreguidelines-macro-usage)
+#endif
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "aabb.hpp"
 #include "math.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <ostream>
@@ -15,6 +18,9 @@ struct HitData {
   Vec3 Normal{};
   double Time{};
   bool FrontFace{};
+  // Surface texture coordinates, only filled in when the material is textured
+  double U{}, V{};
+  double TextureScale{};  // World-space length that one unit of U or V spans there, 0 without texture coordinates
   std::shared_ptr<struct MaterialBase> Material;
 
   // TODO: do we really want this here?
@@ -38,6 +44,36 @@ class Hittable {
   Hittable& operator=(Hittable&&) = default;
   virtual ~Hittable() = default;
   [[nodiscard]] virtual bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const = 0;
+
+  // Whether anything lies on the ray inside `ray_time`, for shadow and visibility rays. Stops at the
+  // first intersection found rather than the closest, and computes no HitData where overridden
+  [[nodiscard]] virtual bool Occluded(const Ray& ray, Interval ray_time) const
+  {
+    HitData hit;
+    return Hit(ray, ray_time, hit);
+  }
+
+  // Unbounded unless overridden, which keeps an object out of any hierarchy's pruning
+  [[nodiscard]] virtual Aabb BoundingBox() const
+  {
+    return {.X = Interval::Universe, .Y = Interval::Universe, .Z = Interval::Universe};
+  }
+
+  // Light sampling support, only implemented by shapes that can act as area lights:
+
+  [[nodiscard]] virtual bool IsEmissive() const noexcept { return false; }
+
+  // Solid-angle density of RandomDirection(origin) producing `direction`
+  [[nodiscard]] virtual double PdfValue([[maybe_unused]] const Point3& origin, [[maybe_unused]] const Vec3& direction) const
+  {
+    return 0.0;
+  }
+
+  // A unit direction from `origin` towards this object
+  [[nodiscard]] virtual Vec3 RandomDirection([[maybe_unused]] const Point3& origin) const
+  {
+    return {.x = 1, .y = 0, .z = 0};
+  }
 };
 
 // TODO: I REALLY HATE THIS, replace this ASAP
@@ -48,11 +84,16 @@ class HittableList : public Hittable {
 
   public:
   void Clear() { Objects.clear(); }
+  void Reserve(std::size_t count) { Objects.reserve(count); }
   void Add(std::shared_ptr<Hittable>&& object)
   {
     Objects.push_back(std::move(object));
   }
 
+  [[nodiscard]] bool Empty() const noexcept { return Objects.empty(); }
+  [[nodiscard]] std::size_t Size() const noexcept { return Objects.size(); }
+  [[nodiscard]] const std::vector<std::shared_ptr<Hittable>>& GetObjects() const noexcept { return Objects; }
+
   [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override
   {
     HitData temp_hit{};
@@ -68,6 +109,48 @@ class HittableList : public Hittable {
     }
     return hit_anything;
   }
+
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override
+  {
+    return std::ranges::any_of(Objects, [&](const auto& object) { return object->Occluded(ray, ray_time); });
+  }
+
+  [[nodiscard]] Aabb BoundingBox() const override
+  {
+    Aabb bounds;
+    for (const auto& object : Objects) {
+      bounds = Aabb::Merge(bounds, object->BoundingBox());
+    }
+    return bounds;
+  }
+
+  // Treating the list as a set of lights, picked uniformly:
+
+  [[nodiscard]] bool IsEmissive() const noexcept override
+  {
+    return std::ranges::any_of(Objects, [](const auto& object) { return object->IsEmissive(); });
+  }
+
+  [[nodiscard]] double PdfValue(const Point3& origin, const Vec3& direction) const override
+  {
+    if (Objects.empty()) {
+      return 0.0;
+    }
+    double sum = 0.0;
+    for (const auto& object : Objects) {
+      sum += object->PdfValue(origin, direction);
+    }
+    return sum / static_cast<double>(Objects.size());
+  }
+
+  [[nodiscard]] Vec3 RandomDirection(const Point3& origin) const override
+  {
+    if (Objects.empty()) {
+      return Hittable::RandomDirection(origin);
+    }
+    const auto index = std::min(static_cast<std::size_t>(RandomDouble() * static_cast<double>(Objects.size())), Objects.size() - 1);
+    return Objects[index]->RandomDirection(origin);
+  }
 };
 
 constexpr double LinearToGamma(double linear_component)
@@ -86,7 +169,8 @@ inline void StreamPPM(std::ostream& stream, int width, int height, const std::ve
     for (int x = 0; x < width; ++x) {
       const auto rl_pixel_start = static_cast<std::size_t>((y * width) + x) * 4;
       // Write out the pixel color components.
-      stream << ' ' << data[rl_pixel_start] << ' ' << data[rl_pixel_start + 1] << ' ' << data[rl_pixel_start + 2] << '\n';
+      // (promoted to int, so the bytes are written as numbers rather than characters)
+      stream << ' ' << +data[rl_pixel_start] << ' ' << +data[rl_pixel_start + 1] << ' ' << +data[rl_pixel_start + 2] << '\n';
     }
   }
 }
@@ -101,6 +185,30 @@ struct Dimension2d {
   int Height{};
 };
 
+// Half-open pixel rectangle [FromX, ToX) x [FromY, ToY), as taken by RayTracer::Render
+struct TileRect {
+  int FromX{};
+  int FromY{};
+  int ToX{};
+  int ToY{};
+
+  [[nodiscard]] int Width() const noexcept { return ToX - FromX; }
+  [[nodiscard]] int Height() const noexcept { return ToY - FromY; }
+  [[nodiscard]] std::size_t PixelCount() const noexcept { return static_cast<std::size_t>(Width()) * static_cast<std::size_t>(Height()); }
+};
+
+// Covers the image with tiles of at most `tile_size` pixels square, in scanline order
+inline std::vector<TileRect> SplitIntoTiles(const Dimension2d& dim, int tile_size)
+{
+  std::vector<TileRect> tiles;
+  for (int y = 0; y < dim.Height; y += tile_size) {
+    for (int x = 0; x < dim.Width; x += tile_size) {
+      tiles.push_back({.FromX = x, .FromY = y, .ToX = std::min(x + tile_size, dim.Width), .ToY = std::min(y + tile_size, dim.Height)});
+    }
+  }
+  return tiles;
+}
+
 // Vector Utility Functions
 inline std::ostream& operator<<(std::ostream& out, const Vec3& vec)
 {
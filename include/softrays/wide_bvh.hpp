@@ -0,0 +1,58 @@
+#pragma once
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "math.hpp"
+#include "utility.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace softrays {
+
+// Four children per node, with their boxes stored structure-of-arrays so the slab test runs on
+// several children per instruction (SSE2 where available, a scalar loop elsewhere). Built by
+// collapsing a binary BuildBvh layout, so a wide tree is about half as deep as the binary one.
+struct alignas(64) WideBvhNode {
+  static constexpr std::size_t Width = 4;
+
+  std::array<double, Width> MinX{};
+  std::array<double, Width> MinY{};
+  std::array<double, Width> MinZ{};
+  std::array<double, Width> MaxX{};
+  std::array<double, Width> MaxY{};
+  std::array<double, Width> MaxZ{};
+  std::array<std::uint32_t, Width> Child{};  // Node index, or first primitive of a leaf
+  std::array<std::uint16_t, Width> Count{};  // Primitives in a leaf child, 0 for a node
+  std::uint8_t ChildCount{};  // Slots past this are unused
+};
+
+class WideBvh : public Hittable {
+  public:
+#if defined(__SSE2__) || defined(_M_X64)
+  static constexpr bool UsesSimd = true;
+#else
+  static constexpr bool UsesSimd = false;
+#endif
+
+  explicit WideBvh(const std::vector<std::shared_ptr<Hittable>>& objects);
+
+  [[nodiscard]] bool Hit(const Ray& ray, Interval ray_time, HitData& hit) const override;
+  [[nodiscard]] bool Occluded(const Ray& ray, Interval ray_time) const override;
+  [[nodiscard]] Aabb BoundingBox() const override { return RootBounds; }
+
+  [[nodiscard]] std::span<const WideBvhNode> GetNodes() const noexcept { return Nodes; }
+
+  private:
+  Aabb RootBounds;  // Infinite with unbounded objects
+  std::vector<std::shared_ptr<Hittable>> Objects;  // In leaf order
+  std::vector<std::shared_ptr<Hittable>> Unbounded;  // Tested before the tree, see PartitionByBounds
+  std::vector<WideBvhNode> Nodes;  // Node 0 is the root
+
+  std::uint32_t Collapse(const BvhLayout& layout, std::uint32_t node);
+};
+}
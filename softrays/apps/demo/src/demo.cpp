@@ -1,22 +1,35 @@
+#include "arena.hpp"
+#include "async_render.hpp"
+#include "camera_rig.hpp"
+#include "framebuffer.hpp"
 #include "material.hpp"
 #include "math.hpp"
 #include "raytracer.hpp"
 #include "shapes.hpp"
 #include "utility.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <utility>
 #include <raylib-cpp.hpp>
 #include <raylib.h>
+#include <vector>
 
+using softrays::AsyncRenderer;
+using softrays::CameraRig;
 using softrays::Colour;
 using softrays::Dielectric;
 using softrays::Dimension2d;
 using softrays::Lambertian;
 using softrays::Metal;
+using softrays::PixelFormat;
+using softrays::Plane;
 using softrays::Point3;
 using softrays::RayTracer;
+using softrays::SceneArena;
 using softrays::Sphere;
 using softrays::Vec3;
 
@@ -32,9 +45,21 @@ void RenderLoopCallback(void* arg);
 constexpr Dimension2d screen{.Width = 800, .Height = 600};
 constexpr Dimension2d renderDim{.Width = 400, .Height = 300};
 constexpr auto maxFps = 60;
+constexpr auto tileSize = 32;
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+constexpr auto orbitSpeed = 0.005;  // Radians per pixel of mouse drag
+constexpr auto zoomStep = 0.9;  // Distance factor per wheel notch
+constexpr auto fieldOfViewSpeed = 30.0;  // Degrees per second
+constexpr auto defocusSpeed = 1.0;  // Degrees per second
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
 
 class Renderer {
+  SceneArena arena;  // Owns every object and material in the world, so it must outlive the raytracer's use of them
   RayTracer raytracer;
+#if !defined(PLATFORM_WEB)
+  AsyncRenderer tracer;  // Traces raytracer's frames off the UI thread; declared after it so it stops first
+  std::vector<std::uint8_t> FrameRgba;  // What the tracer has delivered of the frame, for upload
+#endif
 
   public:
   raylib::Image baseImage;
@@ -46,10 +71,20 @@ class Renderer {
   bool IncrementalRender = true;
   std::size_t LastRenderedPixel{};
   double LastCompleteDrawTime{};
+  bool FirstFrame = true;  // Previewed, like every frame restarted by the camera
+
+  CameraRig Camera;
+  double FieldOfView{};
+  double DefocusAngle{};
+  double InputTime = -1;  // When the camera last moved, until the first pixels of the restarted frame are shown
+  double InputLatency{};  // Seconds from the last camera move to its first updated pixels
 
   void SetupViewport(const Dimension2d& dim)
   {
     RenderDim = dim;
+#if !defined(PLATFORM_WEB)
+    tracer.Cancel();
+#endif
     raytracer.ResizeViewport(RenderDim);
     baseImage.Unload();
     RenderTarget.Unload();
@@ -63,6 +98,8 @@ class Renderer {
   {
     InitWindow(ScreenDim.Width, ScreenDim.Height, "Softrays");
     SetTargetFPS(maxFps);
+    // Every frame reads and writes the whole buffer, and only 8 bits per channel reach the screen
+    raytracer.SetPixelFormat(PixelFormat::RGBA16);
     SetupViewport(renderDim);
   }
 
@@ -92,10 +129,16 @@ class Renderer {
       }
     }
 
+    if (HandleCameraInput()) {
+      RestartRender();
+    }
+
     BeginDrawing();
     ClearBackground(raylib::Color::DarkGray());
 
     if (IncrementalRender) {
+#if defined(PLATFORM_WEB)
+      // No worker threads on the web: trace a slice of a row per frame on the UI thread
       if (LastRenderedPixel >= (static_cast<std::size_t>(RenderDim.Width) * static_cast<std::size_t>(RenderDim.Height))) {
         LastRenderedPixel = 0;
         std::cout << "Frame Render took:" << GetTime() - LastCompleteDrawTime << "s\n";
@@ -105,12 +148,16 @@ class Renderer {
       int nextX = static_cast<int>(LastRenderedPixel % static_cast<std::size_t>(RenderDim.Width));
       LastRenderedPixel += static_cast<std::size_t>(RenderDim.Width) / 4;
       raytracer.Render(nextX, nextY, nextX + (renderDim.Width / 4), nextY + 1);
+      RenderTarget.Update(raytracer.GetRGBAData().data());
+      MeasureInputLatency();
+#else
+      UploadCompletedTiles();
+#endif
     } else {
       raytracer.Render();
+      RenderTarget.Update(raytracer.GetRGBAData().data());
     }
 
-    RenderTarget.Update(raytracer.GetRGBAData().data());
-
     RenderTarget.Draw(Rectangle{0, 0, static_cast<float>(RenderDim.Width), static_cast<float>(RenderDim.Height)}, Rectangle{0, 0, static_cast<float>(ScreenDim.Width), static_cast<float>(ScreenDim.Height)});
     // NOTE: Render texture must be y-flipped due to default OpenGL coordinates (left-bottom) (our raytracer takes care of that already)
     // target->Draw(Rectangle{0, 0, static_cast<float>(target->width), static_cast<float>(target->height)}, {0, 0}, WHITE);
@@ -120,10 +167,115 @@ class Renderer {
     } else if (!std::isinf(fps) && !IncrementalRender) {
       raylib::DrawText(TextFormat("%3.3f fps @ %3.4f seconds %1d spp", fps, time, raytracer.GetSamplesPerPixel()), 10, 10, 30, raylib::Color::Green());  // NOLINT
     }
+    if (IncrementalRender) {
+      raylib::DrawText(TextFormat("input to first pixels: %.1f ms", InputLatency * 1000), 10, 10, 20, raylib::Color::Green());  // NOLINT
+      raylib::DrawText("drag: orbit | wheel: zoom | WASD/QE: fly | up/down: fov | left/right: defocus", 10, 35, 10, raylib::Color::Green());  // NOLINT
+    }
 
     EndDrawing();
   }
 
+#if !defined(PLATFORM_WEB)
+  // Converts and uploads whatever tiles finished since the last frame, and starts the next frame
+  // once the current one is complete
+  void UploadCompletedTiles()
+  {
+    // Checked before taking the tiles, so the last tile of a finished frame is not lost to Start
+    const auto frame_done = tracer.Done();
+    if (!tracer.TakeCompletedTiles(FrameRgba).empty()) {
+      RenderTarget.Update(FrameRgba.data());
+      MeasureInputLatency();
+    }
+
+    if (frame_done) {
+      if (LastCompleteDrawTime > 0) {
+        std::cout << "Frame Render took:" << GetTime() - LastCompleteDrawTime << "s\n";
+      }
+      LastCompleteDrawTime = GetTime();
+      // Frames that follow a finished one only add samples, which a preview would hide
+      if (std::exchange(FirstFrame, false)) {
+        tracer.StartWithPreview(raytracer, tileSize);
+      } else {
+        tracer.Start(raytracer, tileSize);
+      }
+    }
+  }
+#endif
+
+  // Applies this frame's mouse and keyboard input to the camera; true when anything moved
+  bool HandleCameraInput()
+  {
+    const auto frame_time = static_cast<double>(GetFrameTime());
+    auto key_axis = [](int positive, int negative) { return (IsKeyDown(positive) ? 1.0 : 0.0) - (IsKeyDown(negative) ? 1.0 : 0.0); };
+    bool moved = false;
+
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
+      const auto delta = GetMouseDelta();
+      if (std::abs(delta.x) + std::abs(delta.y) > 0.0F) {
+        Camera.Orbit(static_cast<double>(delta.x) * orbitSpeed, static_cast<double>(delta.y) * orbitSpeed);
+        moved = true;
+      }
+    }
+    if (const auto wheel = static_cast<double>(GetMouseWheelMove()); std::abs(wheel) > 0.0) {
+      Camera.Zoom(std::pow(zoomStep, wheel));
+      moved = true;
+    }
+
+    // Flying speed scales with the distance to the target, so it feels the same close up and far out
+    const auto fly_step = Camera.Distance * frame_time;
+    const auto forward = key_axis(KEY_W, KEY_S);
+    const auto right = key_axis(KEY_D, KEY_A);
+    const auto up = key_axis(KEY_E, KEY_Q);
+    if (std::abs(forward) + std::abs(right) + std::abs(up) > 0.0) {
+      Camera.Fly(forward * fly_step, right * fly_step, up * fly_step);
+      moved = true;
+    }
+
+    // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+    if (const auto zoom = key_axis(KEY_DOWN, KEY_UP); std::abs(zoom) > 0.0) {
+      FieldOfView = std::clamp(FieldOfView + (zoom * fieldOfViewSpeed * frame_time), 5.0, 120.0);
+      moved = true;
+    }
+    if (const auto defocus = key_axis(KEY_RIGHT, KEY_LEFT); std::abs(defocus) > 0.0) {
+      DefocusAngle = std::clamp(DefocusAngle + (defocus * defocusSpeed * frame_time), 0.0, 10.0);
+      moved = true;
+    }
+    // NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+    return moved;
+  }
+
+  void ApplyCamera()
+  {
+    Camera.ApplyTo(raytracer);
+    raytracer.FieldOfView = FieldOfView;
+    raytracer.DefocusAngle = DefocusAngle;
+  }
+
+  // Drops the frame in flight and starts accumulating the new view straight away
+  void RestartRender()
+  {
+    // The tracer's job traces its own copy of the camera, so it needn't stop first
+    ApplyCamera();
+    InputTime = GetTime();
+    LastCompleteDrawTime = InputTime;
+#if defined(PLATFORM_WEB)
+    LastRenderedPixel = 0;
+#else
+    // Coarse previews fill the screen within milliseconds, then the path-traced tiles replace them
+    FirstFrame = false;
+    tracer.StartWithPreview(raytracer, tileSize);
+#endif
+  }
+
+  // Called whenever new pixels reach the screen
+  void MeasureInputLatency()
+  {
+    if (InputTime >= 0) {
+      InputLatency = GetTime() - InputTime;
+      InputTime = -1;
+    }
+  }
+
   void Start()
   {
     auto& world = raytracer.GetWorld();
@@ -131,8 +283,8 @@ class Renderer {
     // Create the Scene:
 
     // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
-    auto ground_material = std::make_shared<Lambertian>(Colour{0.5, 0.5, 0.5});  // NOLINT
-    world.Add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
+    auto ground_material = arena.Make<Lambertian>(Colour{0.5, 0.5, 0.5});  // NOLINT
+    world.Add(arena.Make<Plane>(Point3(0, 0, 0), Vec3(0, 1, 0), ground_material));
 
     for (int a = -11; a < 11; a++) {
       for (int b = -11; b < 11; b++) {
@@ -142,28 +294,28 @@ class Renderer {
           if (choose_mat < 0.8) {
             // diffuse
             auto albedo = Colour::Random() * Colour::Random();
-            world.Add(std::make_shared<Sphere>(center, 0.2, std::make_shared<Lambertian>(albedo)));
+            world.Add(arena.Make<Sphere>(center, 0.2, arena.Make<Lambertian>(albedo)));
           } else if (choose_mat < 0.95) {
             // metal
             auto albedo = Colour::Random(0.5, 1);
             auto fuzz = RandomDouble(0, 0.5);
-            world.Add(std::make_shared<Sphere>(center, 0.2, std::make_shared<Metal>(albedo, fuzz)));
+            world.Add(arena.Make<Sphere>(center, 0.2, arena.Make<Metal>(albedo, fuzz)));
           } else {
             // glass
-            world.Add(std::make_shared<Sphere>(center, 0.2, std::make_shared<Dielectric>(1.5)));
+            world.Add(arena.Make<Sphere>(center, 0.2, arena.Make<Dielectric>(1.5)));
           }
         }
       }
     }
 
-    auto material1 = std::make_shared<Dielectric>(1.5);
-    world.Add(std::make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
+    auto material1 = arena.Make<Dielectric>(1.5);
+    world.Add(arena.Make<Sphere>(Point3(0, 1, 0), 1.0, material1));
 
-    auto material2 = std::make_shared<Lambertian>(Colour(0.4, 0.2, 0.1));
-    world.Add(std::make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
+    auto material2 = arena.Make<Lambertian>(Colour(0.4, 0.2, 0.1));
+    world.Add(arena.Make<Sphere>(Point3(-4, 1, 0), 1.0, material2));
 
-    auto material3 = std::make_shared<Metal>(Colour(0.7, 0.6, 0.5), 0.0);
-    world.Add(std::make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
+    auto material3 = arena.Make<Metal>(Colour(0.7, 0.6, 0.5), 0.0);
+    world.Add(arena.Make<Sphere>(Point3(4, 1, 0), 1.0, material3));
 
     // Have use lower quality settings for web builds
 #if defined(PLATFORM_WEB)
@@ -172,14 +324,14 @@ class Renderer {
 #else
     raytracer.SetSamplesPerPixel(50);
     raytracer.MaxDepth = 20;
+    // Frames keep accumulating while the camera is still, and survive small moves
+    raytracer.TemporalReuse = true;
 #endif
-    raytracer.FieldOfView = 40;
-    raytracer.LookFrom = Point3(13, 2, 3);
-    raytracer.LookAt = Point3(0, 0, 0);
-    raytracer.CameraUp = Vec3(0, 1, 0);
-
-    raytracer.DefocusAngle = 0.6;
-    raytracer.FocusDistance = 10.0;
+    // The rig keeps the focus on what it orbits
+    Camera = CameraRig::FromLookAt(Point3(13, 2, 3), Point3(0, 0, 0));
+    FieldOfView = 40;
+    DefocusAngle = 0.6;
+    ApplyCamera();
     // NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
 
 #if defined(PLATFORM_WEB)
@@ -1 +1,185 @@
 #pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace offline {
+
+enum class Mode {
+  Render,  // Render in this process
+  Stream,  // Render in this process, writing tiles straight to the output file
+  Sequence,  // Render an animation, one numbered file per frame
+  Coordinator,  // Split the frame across worker processes
+  Worker,  // Render tiles for a coordinator
+  Server,  // Keep running, rendering jobs sent by `submit`
+  Submit,  // Send one job to a server
+};
+
+struct Options {
+  Mode RunMode = Mode::Render;
+  std::string Output = "render.ppm";
+  std::string Endpoint = "unix:/tmp/softrays.sock";
+  int LocalWorkers = 0;  // Coordinator only: forks this many workers on this machine
+  int TileSize = 32;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  int Width = 0;  // 0 keeps the scene's default
+  int Height = 0;
+  int SamplesPerPixel = 0;
+  unsigned Seed = 0;
+  int Priority = 0;  // Submit only: higher runs first
+  std::size_t CacheSize = 8;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  unsigned Threads = 0;  // Server, stream, sequence and checkpointed renders only: 0 means one per hardware thread
+  std::string MappedPath;  // Render only: trace the scene from this memory-mapped file
+  std::string TracePath;  // Chrome trace of the run, written when it finishes
+  int Frames = 0;  // Sequence only: 0 runs through the last keyframe
+  std::string KeyframesPath;  // Sequence only: camera keyframes, an orbit of the scene without them
+  std::string CheckpointPath;  // Render only: resume from and periodically save progress to this file
+  double CheckpointInterval = 60;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  std::string GroundTexture;  // Image for the ground plane's material
+  std::size_t TextureCacheMb = 0;  // 0 keeps the library's default
+  int GuidePasses = 0;  // Render only: one-sample passes that train a path guide before the render
+  double IrradianceSpacing = 0;  // Render and stream only: largest gap between irradiance cache records, 0 for none
+};
+
+inline constexpr std::string_view Usage = R"(usage:
+  offline [render] [--mapped <file>]
+                  [--checkpoint <file> [--checkpoint-interval S] | [--guide N] [--irradiance-cache D]] [options]
+  offline stream [--mapped <file>] [--tile-size N] [--threads N] [--irradiance-cache D] [options]
+  offline sequence [--frames N] [--keyframes <file>] [--tile-size N] [--threads N] [options]
+  offline coordinator --listen <endpoint> [--local-workers N] [--tile-size N] [options]
+  offline worker --connect <endpoint>
+  offline server --listen <endpoint> [--threads N] [--cache N] [--tile-size N]
+  offline submit --connect <endpoint> [--priority N] [options]
+
+endpoints are unix:/path/to/socket or tcp:host:port
+
+options:
+  --output <file>   .pfm for linear floats, anything else for an 8-bit PPM
+  --width N --height N --spp N --seed N
+  --trace <file>    write a timeline of the run's tiles, builds and writes in Chrome trace format
+  --ground-texture <file>  .pfm image (or tiled texture) to cover the ground with
+  --texture-cache-mb N     memory for texture tiles, 256 by default
+
+stream never holds the whole frame in memory, for images too large to fit: each thread traces
+one --tile-size tile at a time and writes it to its place in --output (8-bit PPMs are binary).
+sequence writes frame N to --output with its last run of '#' replaced by N (frame_####.ppm).
+each --keyframes line is `frame fromX fromY fromZ atX atY atZ [fov]`; frames in between are
+interpolated. without keyframes the camera orbits the scene once over --frames (default 60).
+--mapped traces the scene out of core from a memory-mapped file, which is written first if missing.
+--checkpoint saves the render's progress every --checkpoint-interval seconds (default 60) and when
+interrupted (SIGINT/SIGTERM); running the same command again resumes it. the file is removed once
+--output is written.
+--guide first renders N one-sample passes that teach a path guide where light comes from, then
+steers the render's diffuse bounces with it; worth it when light arrives indirectly.
+--irradiance-cache interpolates indirect light on diffuse surfaces between records gathered at
+most D apart as the render goes: smooth at few samples in diffuse interiors, but small indirect
+detail is blurred, and many small curved objects need so many records that it is slower.
+a .pfm --ground-texture is converted once to a tiled mip-mapped <file>.tiles beside it, and only the
+tiles rendering touches are kept in memory, up to --texture-cache-mb.
+a server keeps the last --cache scenes built, so submitting new cameras for the same --seed
+only pays for tracing; submit's --output is written by the server
+)";
+
+namespace detail {
+  template <typename T>
+  bool ParseNumber(std::string_view text, T& value)
+  {
+    const auto* end = text.data() + text.size();
+    const auto [ptr, error] = std::from_chars(text.data(), end, value);
+    return error == std::errc{} && ptr == end;
+  }
+}
+
+// std::nullopt on unknown or malformed arguments
+[[nodiscard]] inline std::optional<Options> ParseArguments(std::span<const std::string_view> args)
+{
+  Options options;
+  std::size_t i = 0;
+  if (i < args.size() && !args[i].starts_with("--")) {
+    if (args[i] == "render") {
+      options.RunMode = Mode::Render;
+    } else if (args[i] == "stream") {
+      options.RunMode = Mode::Stream;
+    } else if (args[i] == "sequence") {
+      options.RunMode = Mode::Sequence;
+    } else if (args[i] == "coordinator") {
+      options.RunMode = Mode::Coordinator;
+    } else if (args[i] == "worker") {
+      options.RunMode = Mode::Worker;
+    } else if (args[i] == "server") {
+      options.RunMode = Mode::Server;
+    } else if (args[i] == "submit") {
+      options.RunMode = Mode::Submit;
+    } else {
+      return std::nullopt;
+    }
+    ++i;
+  }
+
+  for (; i < args.size(); ++i) {
+    const auto flag = args[i];
+    if (i + 1 >= args.size()) {
+      return std::nullopt;
+    }
+    const auto value = args[++i];
+    bool parsed = true;
+    if (flag == "--output") {
+      options.Output = value;
+    } else if (flag == "--listen" || flag == "--connect") {
+      options.Endpoint = value;
+    } else if (flag == "--local-workers") {
+      parsed = detail::ParseNumber(value, options.LocalWorkers);
+    } else if (flag == "--tile-size") {
+      parsed = detail::ParseNumber(value, options.TileSize) && options.TileSize > 0;
+    } else if (flag == "--width") {
+      parsed = detail::ParseNumber(value, options.Width);
+    } else if (flag == "--height") {
+      parsed = detail::ParseNumber(value, options.Height);
+    } else if (flag == "--spp") {
+      parsed = detail::ParseNumber(value, options.SamplesPerPixel);
+    } else if (flag == "--seed") {
+      parsed = detail::ParseNumber(value, options.Seed);
+    } else if (flag == "--priority") {
+      parsed = detail::ParseNumber(value, options.Priority);
+    } else if (flag == "--cache") {
+      parsed = detail::ParseNumber(value, options.CacheSize) && options.CacheSize > 0;
+    } else if (flag == "--threads") {
+      parsed = detail::ParseNumber(value, options.Threads);
+    } else if (flag == "--mapped") {
+      options.MappedPath = value;
+    } else if (flag == "--trace") {
+      options.TracePath = value;
+    } else if (flag == "--frames") {
+      parsed = detail::ParseNumber(value, options.Frames) && options.Frames > 0;
+    } else if (flag == "--keyframes") {
+      options.KeyframesPath = value;
+    } else if (flag == "--checkpoint") {
+      options.CheckpointPath = value;
+    } else if (flag == "--checkpoint-interval") {
+      parsed = detail::ParseNumber(value, options.CheckpointInterval) && options.CheckpointInterval > 0;
+    } else if (flag == "--ground-texture") {
+      options.GroundTexture = value;
+    } else if (flag == "--texture-cache-mb") {
+      parsed = detail::ParseNumber(value, options.TextureCacheMb) && options.TextureCacheMb > 0;
+    } else if (flag == "--guide") {
+      parsed = detail::ParseNumber(value, options.GuidePasses) && options.GuidePasses > 0;
+    } else if (flag == "--irradiance-cache") {
+      parsed = detail::ParseNumber(value, options.IrradianceSpacing) && options.IrradianceSpacing > 0;
+    } else {
+      parsed = false;
+    }
+    if (!parsed) {
+      return std::nullopt;
+    }
+  }
+  // A checkpointed render resumes from its saved passes alone, with no guide or irradiance cache to
+  // train or restore
+  if (!options.CheckpointPath.empty() && (options.GuidePasses > 0 || options.IrradianceSpacing > 0)) {
+    return std::nullopt;
+  }
+  return options;
+}
+}
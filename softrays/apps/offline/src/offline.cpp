@@ -1,8 +1,322 @@
 #include "offline.hpp"
-#include "libsoftrays.hpp"
-#include "softrays.hpp"
+#include "checkpoint.hpp"
+#include "distributed.hpp"
+#include "image.hpp"
+#include "irradiance_cache.hpp"
+#include "mapped_world.hpp"
+#include "path_guide.hpp"
+#include "raytracer.hpp"
+#include "render_server.hpp"
+#include "scene.hpp"
+#include "sequence.hpp"
+#include "stream_render.hpp"
+#include "texture.hpp"
+#include "trace.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/wait.h>)
+#include <sys/wait.h>
+#include <unistd.h>
+#define OFFLINE_HAS_FORK 1
+#endif
+
+using softrays::CameraSettings;
+using softrays::SceneDescription;
 
-int main()
+namespace {
+// Set by SIGINT/SIGTERM while a checkpointed render runs, so it can save its progress and exit
+std::atomic<bool> StopRequested{false};
+static_assert(std::atomic<bool>::is_always_lock_free);
+
+extern "C" void RequestStop(int /*signal*/)
 {
+  StopRequested = true;
+}
+
+CameraSettings MakeCamera(const offline::Options& options)
+{
+  auto camera = softrays::RandomSphereCamera();
+  if (options.Width > 0) {
+    camera.Dimensions.Width = options.Width;
+  }
+  if (options.Height > 0) {
+    camera.Dimensions.Height = options.Height;
+  }
+  if (options.SamplesPerPixel > 0) {
+    camera.SamplesPerPixel = options.SamplesPerPixel;
+  }
+  return camera;
+}
+
+int RenderLocally(const offline::Options& options, const SceneDescription& scene, const CameraSettings& camera)
+{
+  const bool streaming = options.RunMode == offline::Mode::Stream;
+  const bool checkpointed = !streaming && !options.CheckpointPath.empty();
+  softrays::RayTracer raytracer;
+  camera.Apply(raytracer, !streaming && !checkpointed);
+  // Out of core: trace the scene from a memory-mapped file, written on first use, without ever
+  // building its objects in memory
+  const auto prepared = options.MappedPath.empty() ? scene.Prepare() : softrays::PrepareMapped(options.MappedPath, scene);
+  if (!prepared) {
+    if (options.MappedPath.empty()) {
+      std::cerr << "failed to build the scene\n";
+    } else {
+      std::cerr << "could not write or open " << options.MappedPath << '\n';
+    }
+    return EXIT_FAILURE;
+  }
+  prepared->AttachTo(raytracer);
+  if (options.IrradianceSpacing > 0) {
+    raytracer.Irradiance = std::make_shared<softrays::IrradianceCache>(options.IrradianceSpacing);
+  }
+
+  if (streaming) {
+    const softrays::StreamRenderOptions stream_options{.TileSize = options.TileSize, .Threads = options.Threads};
+    if (!softrays::RenderToFile(raytracer, options.Output, stream_options)) {
+      std::cerr << "could not write " << options.Output << '\n';
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+  if (checkpointed) {
+    std::signal(SIGINT, RequestStop);
+    std::signal(SIGTERM, RequestStop);
+    const softrays::CheckpointOptions checkpoint_options{
+        .Path = options.CheckpointPath,
+        .IntervalSeconds = options.CheckpointInterval,
+        .TileSize = options.TileSize,
+        .Threads = options.Threads,
+        .Seed = options.Seed,
+        .SceneKey = scene.Hash(),
+        .ShouldStop = [] { return StopRequested.load(); },
+    };
+    const auto image = softrays::RenderWithCheckpoints(raytracer, checkpoint_options);
+    if (!image) {
+      std::cerr << "stopped; progress saved to " << options.CheckpointPath << ", run again to resume\n";
+      return EXIT_FAILURE;
+    }
+    if (!softrays::SaveImage(options.Output, *image)) {
+      return EXIT_FAILURE;
+    }
+    std::error_code error;
+    std::filesystem::remove(options.CheckpointPath, error);
+    return EXIT_SUCCESS;
+  }
+  if (options.GuidePasses > 0) {
+    // Cells of a unit or so suit the scene's spheres; the training passes' images are thrown away
+    raytracer.Guide = std::make_shared<softrays::PathGuide>(1.0);
+    const auto samples = raytracer.GetSamplesPerPixel();
+    raytracer.SetSamplesPerPixel(1);
+    for (int pass = 0; pass < options.GuidePasses; ++pass) {
+      raytracer.Render();
+    }
+    raytracer.SetSamplesPerPixel(samples);
+  }
+  raytracer.Render();
+
+  softrays::FloatImage image(camera.Dimensions.Width, camera.Dimensions.Height);
+  const auto& pixels = raytracer.GetPixelData();
+  for (int y = 0; y < image.Height; ++y) {
+    for (int x = 0; x < image.Width; ++x) {
+      image.Set(x, y, pixels[(static_cast<std::size_t>(y) * static_cast<std::size_t>(image.Width)) + static_cast<std::size_t>(x)]);
+    }
+  }
+  return softrays::SaveImage(options.Output, image) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int Coordinate(const offline::Options& options, const SceneDescription& scene, const CameraSettings& camera)
+{
+  softrays::Coordinator coordinator(scene, camera, {.TileSize = options.TileSize});
+  if (!coordinator.Listen(options.Endpoint)) {
+    std::cerr << "could not listen on " << options.Endpoint << '\n';
+    return EXIT_FAILURE;
+  }
+
+#if defined(OFFLINE_HAS_FORK)
+  // Local workers are plain forks of this process, before it has started any threads
+  std::vector<pid_t> children;
+  for (int i = 0; i < options.LocalWorkers; ++i) {
+    const auto pid = fork();
+    if (pid == 0) {
+      _exit(softrays::RunWorker(options.Endpoint) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (pid > 0) {
+      children.push_back(pid);
+    }
+  }
+#else
+  if (options.LocalWorkers > 0) {
+    std::cerr << "--local-workers is not supported on this platform, start workers separately\n";
+  }
+#endif
+
+  std::cout << "waiting for workers on " << options.Endpoint << '\n';
+  const auto image = coordinator.Run();
+
+#if defined(OFFLINE_HAS_FORK)
+  for (const auto child : children) {
+    waitpid(child, nullptr, 0);
+  }
+#endif
+
+  const auto& stats = coordinator.GetStats();
+  std::cout << "workers: " << stats.WorkersSeen << ", tiles reassigned: " << stats.TilesReassigned
+            << ", duplicated: " << stats.TilesDuplicated << '\n';
+  if (!image) {
+    std::cerr << "no workers connected\n";
+    return EXIT_FAILURE;
+  }
+  return softrays::SaveImage(options.Output, *image) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int Serve(const offline::Options& options)
+{
+  softrays::RenderServer server({.Threads = options.Threads, .CacheCapacity = options.CacheSize, .TileSize = options.TileSize});
+  if (!server.Listen(options.Endpoint)) {
+    std::cerr << "could not listen on " << options.Endpoint << '\n';
+    return EXIT_FAILURE;
+  }
+  std::cout << "serving on " << options.Endpoint << '\n';
+  server.Serve();
+  return EXIT_SUCCESS;
+}
+
+// One turn around the camera's target, for sequences without a keyframe file
+std::vector<softrays::CameraKeyframe> OrbitKeyframes(const CameraSettings& camera, int frames)
+{
+  std::vector<softrays::CameraKeyframe> keyframes;
+  const auto offset = camera.LookFrom - camera.LookAt;
+  for (int frame = 0; frame < frames; ++frame) {
+    const auto angle = 2 * softrays::Pi * frame / frames;
+    auto keyframe = softrays::CameraKeyframe{.Frame = frame, .Camera = camera};
+    keyframe.Camera.LookFrom = camera.LookAt + softrays::Vec3{(offset.x * std::cos(angle)) - (offset.z * std::sin(angle)), offset.y, (offset.x * std::sin(angle)) + (offset.z * std::cos(angle))};
+    keyframes.push_back(keyframe);
+  }
+  return keyframes;
+}
+
+int RenderFrames(const offline::Options& options, const SceneDescription& scene, const CameraSettings& camera)
+{
+  constexpr int defaultOrbitFrames = 60;
+  std::vector<softrays::CameraKeyframe> keyframes;
+  auto frames = options.Frames;
+  if (options.KeyframesPath.empty()) {
+    frames = frames > 0 ? frames : defaultOrbitFrames;
+    keyframes = OrbitKeyframes(camera, frames);
+  } else {
+    std::ifstream file(options.KeyframesPath);
+    auto loaded = softrays::ReadCameraKeyframes(file, camera);
+    if (!loaded) {
+      std::cerr << "could not read keyframes from " << options.KeyframesPath << '\n';
+      return EXIT_FAILURE;
+    }
+    keyframes = std::move(*loaded);
+    frames = frames > 0 ? frames : keyframes.back().Frame + 1;
+  }
+
+  auto prepared = scene.Prepare();
+  if (!prepared) {
+    std::cerr << "failed to build the scene\n";
+    return EXIT_FAILURE;
+  }
+  const softrays::SequenceOptions sequence_options{.TileSize = options.TileSize, .Threads = options.Threads};
+  if (!softrays::RenderSequence(frames, softrays::KeyframedCamera(std::move(*prepared), std::move(keyframes)), softrays::WriteNumberedFrames(options.Output), sequence_options)) {
+    std::cerr << "could not write " << options.Output << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int Submit(const offline::Options& options, SceneDescription scene, const CameraSettings& camera)
+{
+  // The server may run elsewhere, so relative paths are resolved here
+  const softrays::RenderJob job{
+      .Priority = options.Priority,
+      .Scene = std::move(scene),
+      .Camera = camera,
+      .Output = std::filesystem::absolute(options.Output).string(),
+  };
+  const auto reply = softrays::SubmitRenderJob(options.Endpoint, job);
+  if (!reply) {
+    std::cerr << "no reply from " << options.Endpoint << '\n';
+    return EXIT_FAILURE;
+  }
+  std::cout << (reply->CacheHit ? "cached scene" : "new scene") << ", setup " << reply->SetupSeconds << " s, trace "
+            << reply->TraceSeconds << " s\n";
+  return reply->Ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int Run(const offline::Options& options)
+{
+  if (options.RunMode == offline::Mode::Worker) {
+    return softrays::RunWorker(options.Endpoint) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (options.RunMode == offline::Mode::Server) {
+    return Serve(options);
+  }
+
+  constexpr std::size_t bytesPerMb = std::size_t{1} << 20U;
+  if (options.TextureCacheMb > 0) {
+    softrays::TextureCache::Default()->SetCapacity(options.TextureCacheMb * bytesPerMb);
+  }
+  auto scene = softrays::RandomSphereScene(options.Seed);
+  if (!options.GroundTexture.empty()) {
+    // The ground is the scene's first material; absolute, so servers and workers elsewhere find it
+    scene.Materials.front().TexturePath = std::filesystem::absolute(options.GroundTexture).string();
+  }
+  const auto camera = MakeCamera(options);
+  if (options.RunMode == offline::Mode::Coordinator) {
+    return Coordinate(options, scene, camera);
+  }
+  if (options.RunMode == offline::Mode::Submit) {
+    return Submit(options, scene, camera);
+  }
+  if (options.RunMode == offline::Mode::Sequence) {
+    return RenderFrames(options, scene, camera);
+  }
+  const auto result = RenderLocally(options, scene, camera);
+  const auto textures = softrays::TextureCache::Default()->Stats();
+  if (textures.Hits + textures.Misses > 0) {
+    std::cout << "texture tiles: " << textures.Misses << " loaded, " << textures.Evictions << " evicted, hit rate "
+              << textures.HitRate() << ", peak " << (static_cast<double>(textures.PeakBytes) / bytesPerMb) << " of "
+              << (static_cast<double>(textures.CapacityBytes) / bytesPerMb) << " MB\n";
+  }
+  return result;
+}
+}
+
+int main(int argc, char** argv)
+{
+  const std::vector<std::string_view> args(argv + 1, argv + argc);
+  const auto options = offline::ParseArguments(args);
+  if (!options) {
+    std::cerr << offline::Usage;
+    return EXIT_FAILURE;
+  }
+
+  if (options->TracePath.empty()) {
+    return Run(*options);
+  }
+  softrays::StartTracing();
+  const auto result = Run(*options);
+  softrays::StopTracing();
+  if (!softrays::WriteChromeTrace(options->TracePath)) {
+    std::cerr << "could not write " << options->TracePath << '\n';
+    return EXIT_FAILURE;
+  }
+  return result;
 }
@@ -10,3 +10,102 @@ TEST_CASE("Factorial of 0 is 1 (fail)", "[single-file]")
 {
   REQUIRE(Factorial(0) == 1);
 }
+
+#include "offline.hpp"
+
+#include <array>
+#include <string_view>
+
+TEST_CASE("Offline arguments select the run mode")
+{
+  constexpr std::array<std::string_view, 6> coordinator_args{"coordinator", "--listen", "tcp:localhost:9000", "--local-workers", "4", "--output=x"};
+  REQUIRE_FALSE(offline::ParseArguments(coordinator_args).has_value());
+
+  constexpr std::array<std::string_view, 5> valid_args{"coordinator", "--listen", "tcp:localhost:9000", "--local-workers", "4"};
+  const auto options = offline::ParseArguments(valid_args);
+  REQUIRE(options.has_value());
+  REQUIRE(options->RunMode == offline::Mode::Coordinator);
+  REQUIRE(options->Endpoint == "tcp:localhost:9000");
+  REQUIRE(options->LocalWorkers == 4);
+
+  constexpr std::array<std::string_view, 0> no_args{};
+  REQUIRE(offline::ParseArguments(no_args)->RunMode == offline::Mode::Render);
+
+  constexpr std::array<std::string_view, 3> bad_number{"worker", "--spp", "many"};
+  REQUIRE_FALSE(offline::ParseArguments(bad_number).has_value());
+
+  constexpr std::array<std::string_view, 7> stream_args{"stream", "--width", "40000", "--tile-size", "128", "--output", "huge.pfm"};
+  const auto stream = offline::ParseArguments(stream_args);
+  REQUIRE(stream.has_value());
+  REQUIRE(stream->RunMode == offline::Mode::Stream);
+  REQUIRE(stream->Width == 40000);
+  REQUIRE(stream->TileSize == 128);
+
+  constexpr std::array<std::string_view, 3> trace_args{"render", "--trace", "render.json"};
+  REQUIRE(offline::ParseArguments(trace_args)->TracePath == "render.json");
+
+  constexpr std::array<std::string_view, 5> sequence_args{"sequence", "--frames", "24", "--keyframes", "path.txt"};
+  const auto sequence = offline::ParseArguments(sequence_args);
+  REQUIRE(sequence.has_value());
+  REQUIRE(sequence->RunMode == offline::Mode::Sequence);
+  REQUIRE(sequence->Frames == 24);
+  REQUIRE(sequence->KeyframesPath == "path.txt");
+  constexpr std::array<std::string_view, 3> no_frames{"sequence", "--frames", "0"};
+  REQUIRE_FALSE(offline::ParseArguments(no_frames).has_value());
+
+  constexpr std::array<std::string_view, 5> checkpoint_args{"render", "--checkpoint", "frame.ckpt", "--checkpoint-interval", "2.5"};
+  const auto checkpoint = offline::ParseArguments(checkpoint_args);
+  REQUIRE(checkpoint.has_value());
+  REQUIRE(checkpoint->CheckpointPath == "frame.ckpt");
+  REQUIRE(checkpoint->CheckpointInterval == 2.5);
+  constexpr std::array<std::string_view, 3> no_interval{"render", "--checkpoint-interval", "0"};
+  REQUIRE_FALSE(offline::ParseArguments(no_interval).has_value());
+
+  constexpr std::array<std::string_view, 4> texture_args{"--ground-texture", "grass.pfm", "--texture-cache-mb", "64"};
+  const auto texture = offline::ParseArguments(texture_args);
+  REQUIRE(texture.has_value());
+  REQUIRE(texture->GroundTexture == "grass.pfm");
+  REQUIRE(texture->TextureCacheMb == 64);
+  constexpr std::array<std::string_view, 2> no_cache_memory{"--texture-cache-mb", "0"};
+  REQUIRE_FALSE(offline::ParseArguments(no_cache_memory).has_value());
+
+  constexpr std::array<std::string_view, 3> guide_args{"render", "--guide", "8"};
+  const auto guided = offline::ParseArguments(guide_args);
+  REQUIRE(guided.has_value());
+  REQUIRE(guided->GuidePasses == 8);
+  constexpr std::array<std::string_view, 2> no_passes{"--guide", "0"};
+  REQUIRE_FALSE(offline::ParseArguments(no_passes).has_value());
+  constexpr std::array<std::string_view, 5> guided_checkpoint{"render", "--checkpoint", "frame.ckpt", "--guide", "8"};
+  REQUIRE_FALSE(offline::ParseArguments(guided_checkpoint).has_value());
+
+  constexpr std::array<std::string_view, 3> cache_args{"stream", "--irradiance-cache", "0.5"};
+  const auto cached = offline::ParseArguments(cache_args);
+  REQUIRE(cached.has_value());
+  REQUIRE(cached->IrradianceSpacing == 0.5);
+  constexpr std::array<std::string_view, 2> no_spacing{"--irradiance-cache", "-1"};
+  REQUIRE_FALSE(offline::ParseArguments(no_spacing).has_value());
+  constexpr std::array<std::string_view, 5> cached_checkpoint{"render", "--checkpoint", "frame.ckpt", "--irradiance-cache", "0.5"};
+  REQUIRE_FALSE(offline::ParseArguments(cached_checkpoint).has_value());
+}
+
+TEST_CASE("Offline arguments for the render server")
+{
+  constexpr std::array<std::string_view, 7> server_args{"server", "--listen", "unix:/tmp/s.sock", "--threads", "3", "--cache", "2"};
+  const auto server = offline::ParseArguments(server_args);
+  REQUIRE(server.has_value());
+  REQUIRE(server->RunMode == offline::Mode::Server);
+  REQUIRE(server->Threads == 3);
+  REQUIRE(server->CacheSize == 2);
+
+  constexpr std::array<std::string_view, 5> submit_args{"submit", "--connect", "unix:/tmp/s.sock", "--priority", "-2"};
+  const auto submit = offline::ParseArguments(submit_args);
+  REQUIRE(submit.has_value());
+  REQUIRE(submit->RunMode == offline::Mode::Submit);
+  REQUIRE(submit->Priority == -2);
+
+  constexpr std::array<std::string_view, 3> mapped_args{"render", "--mapped", "scene.world"};
+  REQUIRE(offline::ParseArguments(mapped_args)->MappedPath == "scene.world");
+
+  constexpr std::array<std::string_view, 3> no_cache{"server", "--cache", "0"};
+  REQUIRE_FALSE(offline::ParseArguments(no_cache).has_value());
+}
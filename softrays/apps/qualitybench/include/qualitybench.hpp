@@ -0,0 +1,95 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qualitybench {
+
+struct Options {
+  std::vector<std::string> Scenes;  // Empty means every canonical scene
+  std::vector<double> Budgets{0.5, 1, 2, 4, 8};  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  std::string Output = "quality.csv";
+  std::string References = "quality-references";
+  int ReferenceSamples = 4096;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  int PassSamples = 1;
+};
+
+inline constexpr std::string_view Usage = R"(usage:
+  qualitybench [--scenes a,b] [--budgets s1,s2,...] [--output file] [--references dir]
+               [--reference-spp N] [--pass-spp N]
+
+renders each canonical scene (sphere-field, glass-heavy, small-light, window-room, diffuse-room) on
+one thread, in passes of --pass-spp samples, and scores the running average against a reference at
+every budget (seconds of tracing, ascending). references are rendered on all threads at
+--reference-spp the first time and kept in --references as .pfm. the error-versus-time curve goes
+to --output, as JSON if it ends in .json and CSV otherwise
+)";
+
+namespace detail {
+  template <typename T>
+  bool ParseNumber(std::string_view text, T& value)
+  {
+    const auto* end = text.data() + text.size();
+    const auto [ptr, error] = std::from_chars(text.data(), end, value);
+    return error == std::errc{} && ptr == end;
+  }
+
+  inline std::vector<std::string_view> SplitList(std::string_view text)
+  {
+    std::vector<std::string_view> items;
+    while (!text.empty()) {
+      const auto comma = text.find(',');
+      items.push_back(text.substr(0, comma));
+      text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+    }
+    return items;
+  }
+}
+
+// std::nullopt on unknown or malformed arguments
+[[nodiscard]] inline std::optional<Options> ParseArguments(std::span<const std::string_view> args)
+{
+  Options options;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    const auto flag = args[i];
+    if (i + 1 >= args.size()) {
+      return std::nullopt;
+    }
+    const auto value = args[++i];
+    bool parsed = true;
+    if (flag == "--scenes") {
+      options.Scenes.clear();
+      for (const auto scene : detail::SplitList(value)) {
+        options.Scenes.emplace_back(scene);
+      }
+    } else if (flag == "--budgets") {
+      options.Budgets.clear();
+      for (const auto budget : detail::SplitList(value)) {
+        double seconds = 0;
+        parsed = parsed && detail::ParseNumber(budget, seconds) && seconds > 0 && (options.Budgets.empty() || seconds > options.Budgets.back());
+        options.Budgets.push_back(seconds);
+      }
+      parsed = parsed && !options.Budgets.empty();
+    } else if (flag == "--output") {
+      options.Output = value;
+    } else if (flag == "--references") {
+      options.References = value;
+    } else if (flag == "--reference-spp") {
+      parsed = detail::ParseNumber(value, options.ReferenceSamples) && options.ReferenceSamples > 0;
+    } else if (flag == "--pass-spp") {
+      parsed = detail::ParseNumber(value, options.PassSamples) && options.PassSamples > 0;
+    } else {
+      parsed = false;
+    }
+    if (!parsed) {
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+}
@@ -0,0 +1,70 @@
+#include "qualitybench.hpp"
+#include "quality.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using softrays::BenchmarkScene;
+
+int main(int argc, char** argv)
+{
+  const std::vector<std::string_view> args(argv + 1, argv + argc);
+  const auto options = qualitybench::ParseArguments(args);
+  if (!options) {
+    std::cerr << qualitybench::Usage;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<BenchmarkScene> scenes(softrays::AllBenchmarkScenes.begin(), softrays::AllBenchmarkScenes.end());
+  if (!options->Scenes.empty()) {
+    scenes.clear();
+    for (const auto& name : options->Scenes) {
+      const auto scene = softrays::FindBenchmarkScene(name);
+      if (!scene) {
+        std::cerr << "unknown scene " << name << '\n';
+        return EXIT_FAILURE;
+      }
+      scenes.push_back(*scene);
+    }
+  }
+
+  std::vector<softrays::QualityCurve> curves;
+  for (const auto scene : scenes) {
+    const auto bench = softrays::MakeBenchmarkCase(scene);
+    const auto path = (std::filesystem::path(options->References) / (bench.Name + "-" + std::to_string(options->ReferenceSamples) + "spp.pfm")).string();
+    std::cout << bench.Name << ": reference " << path << '\n';
+    const auto reference = softrays::LoadOrRenderReference(bench, path, options->ReferenceSamples);
+    if (!reference) {
+      std::cerr << "could not render or store the reference for " << bench.Name << '\n';
+      return EXIT_FAILURE;
+    }
+
+    auto curve = softrays::MeasureQuality(bench, *reference, options->Budgets, options->PassSamples);
+    if (!curve) {
+      std::cerr << "could not build " << bench.Name << '\n';
+      return EXIT_FAILURE;
+    }
+    for (const auto& point : curve->Points) {
+      std::cout << "  " << point.Seconds << " s, " << point.SamplesPerPixel << " spp: rmse " << point.Rmse << ", relmse " << point.RelMse << '\n';
+    }
+    curves.push_back(std::move(*curve));
+  }
+
+  std::ofstream out(options->Output);
+  if (options->Output.ends_with(".json")) {
+    softrays::WriteQualityJson(out, curves);
+  } else {
+    softrays::WriteQualityCsv(out, curves);
+  }
+  if (!out) {
+    std::cerr << "could not write " << options->Output << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+#include "qualitybench.hpp"
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Quality benchmark arguments")
+{
+  constexpr std::array<std::string_view, 0> no_args{};
+  const auto defaults = qualitybench::ParseArguments(no_args);
+  REQUIRE(defaults.has_value());
+  REQUIRE(defaults->Scenes.empty());
+  REQUIRE(defaults->Output == "quality.csv");
+
+  constexpr std::array<std::string_view, 6> args{"--scenes", "glass-heavy,small-light", "--budgets", "0.25,1,3", "--output", "curve.json"};
+  const auto options = qualitybench::ParseArguments(args);
+  REQUIRE(options.has_value());
+  REQUIRE(options->Scenes == std::vector<std::string>{"glass-heavy", "small-light"});
+  REQUIRE(options->Budgets == std::vector<double>{0.25, 1, 3});
+  REQUIRE(options->Output == "curve.json");
+
+  constexpr std::array<std::string_view, 2> descending{"--budgets", "2,1"};
+  REQUIRE_FALSE(qualitybench::ParseArguments(descending).has_value());
+  constexpr std::array<std::string_view, 2> not_a_number{"--budgets", "1,soon"};
+  REQUIRE_FALSE(qualitybench::ParseArguments(not_a_number).has_value());
+  constexpr std::array<std::string_view, 2> no_samples{"--reference-spp", "0"};
+  REQUIRE_FALSE(qualitybench::ParseArguments(no_samples).has_value());
+  constexpr std::array<std::string_view, 1> missing_value{"--output"};
+  REQUIRE_FALSE(qualitybench::ParseArguments(missing_value).has_value());
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,79 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ranges>
+#include <utility>
+
+using namespace softrays;
+
+namespace {
+// Blocks double in size up to this, so big scenes need few of them
+constexpr std::size_t MaxBlockSize = std::size_t{16} * 1024 * 1024;
+}
+
+SceneArena::SceneArena(std::size_t block_size) : NextBlockSize(std::max<std::size_t>(block_size, 64))  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+{
+}
+
+void SceneArena::Reset() noexcept
+{
+  for (const auto& destructor : std::views::reverse(Destructors)) {
+    destructor.Destroy(destructor.Object);
+  }
+  Destructors.clear();
+
+  if (Blocks.empty()) {
+    return;
+  }
+  auto biggest = std::ranges::max_element(Blocks, {}, &Block::Size);
+  Block kept = std::move(*biggest);
+  kept.Used = 0;
+  Blocks.clear();
+  Blocks.push_back(std::move(kept));
+}
+
+std::size_t SceneArena::BytesUsed() const noexcept
+{
+  std::size_t used = 0;
+  for (const auto& block : Blocks) {
+    used += block.Used;
+  }
+  return used;
+}
+
+bool SceneArena::Owns(const void* object) const noexcept
+{
+  const auto* byte = static_cast<const std::byte*>(object);
+  return std::ranges::any_of(Blocks, [&](const Block& block) {
+    // std::less gives a total order even for pointers into different blocks
+    return !std::less<>{}(byte, block.Memory.get()) && std::less<>{}(byte, block.Memory.get() + block.Used);
+  });
+}
+
+void* SceneArena::Allocate(std::size_t size, std::size_t alignment)
+{
+  auto try_block = [&](Block& block) -> void* {
+    void* position = block.Memory.get() + block.Used;
+    auto space = block.Size - block.Used;
+    if (std::align(alignment, size, position, space) == nullptr) {
+      return nullptr;
+    }
+    block.Used = block.Size - space + size;
+    return position;
+  };
+
+  if (!Blocks.empty()) {
+    if (auto* memory = try_block(Blocks.back())) {
+      return memory;
+    }
+  }
+
+  const auto block_size = std::max(NextBlockSize, size + alignment);
+  NextBlockSize = std::min(NextBlockSize * 2, MaxBlockSize);
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays, modernize-avoid-c-arrays)
+  Blocks.push_back({.Memory = std::make_unique_for_overwrite<std::byte[]>(block_size), .Size = block_size, .Used = 0});
+  return try_block(Blocks.back());
+}
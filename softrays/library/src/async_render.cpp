@@ -0,0 +1,171 @@
+#include "async_render.hpp"
+#include "raytracer.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+// Copies `tile` between RGBA buffers laid out like a frame `width` pixels wide
+void CopyTileRgba(const std::vector<std::uint8_t>& from, std::vector<std::uint8_t>& to, int width, const TileRect& tile)
+{
+  const auto row_bytes = static_cast<std::ptrdiff_t>(tile.ToX - tile.FromX) * 4;
+  for (int y = tile.FromY; y < tile.ToY; ++y) {
+    const auto start = ((static_cast<std::ptrdiff_t>(y) * width) + tile.FromX) * 4;
+    std::copy_n(from.begin() + start, row_bytes, to.begin() + start);
+  }
+}
+}
+
+AsyncRenderer::AsyncRenderer(unsigned threads) : Pool(threads)
+{
+}
+
+AsyncRenderer::~AsyncRenderer()
+{
+  CancelAndWait();
+}
+
+void AsyncRenderer::Start(RayTracer& raytracer, int tile_size, TileCallback on_tile)
+{
+  Queue(raytracer, tile_size, std::move(on_tile), false);
+}
+
+void AsyncRenderer::StartWithPreview(RayTracer& raytracer, int tile_size, TileCallback on_tile)
+{
+  Queue(raytracer, tile_size, std::move(on_tile), true);
+}
+
+void AsyncRenderer::Queue(RayTracer& raytracer, int tile_size, TileCallback on_tile, bool preview)
+{
+  Cancel();
+  // The guide's distributions are rebuilt for the new frame, which can't happen while the cancelled
+  // job's tiles still sample them
+  if (raytracer.Guide) {
+    Pool.WaitIdle();
+  }
+  raytracer.BeginFrame();
+  // The job's own camera and settings, so the caller's can move on while its tiles are traced
+  auto frame = std::make_shared<RayTracer>(raytracer);
+
+  // Centre first: that is where a viewer looks, and where a restarted frame should show up first
+  auto tiles = SplitIntoTiles(raytracer.GetViewport(), tile_size);
+  const auto& viewport = raytracer.GetViewport();
+  auto distance_to_centre = [&viewport](const TileRect& tile) {
+    const auto dx = (tile.FromX + tile.ToX) - viewport.Width;
+    const auto dy = (tile.FromY + tile.ToY) - viewport.Height;
+    return (dx * dx) + (dy * dy);
+  };
+  std::ranges::stable_sort(tiles, {}, distance_to_centre);
+  const auto first_pass = preview ? 0 : PreviewSteps.size();
+  std::uint64_t generation{};
+  {
+    const std::scoped_lock lock(Mutex);
+    Remaining = tiles.size() * (PreviewSteps.size() + 1 - first_pass);
+    Width = viewport.Width;
+    Rgba.resize(static_cast<std::size_t>(viewport.Width) * static_cast<std::size_t>(viewport.Height) * 4);
+    generation = ++CurrentGeneration;
+  }
+  for (const auto& tile : tiles) {
+    RunPass(raytracer, frame, tile, first_pass, generation, on_tile);
+  }
+}
+
+void AsyncRenderer::RunPass(RayTracer& raytracer, std::shared_ptr<RayTracer> frame, const TileRect& tile, std::size_t pass, std::uint64_t generation,
+                            const TileCallback& on_tile)
+{
+  const auto full = pass == PreviewSteps.size();
+  // Previews of every tile come before any tile's full render
+  const auto priority = full ? 0 : 1;
+  Pool.Submit([this, &raytracer, frame, tile, pass, full, generation, on_tile] {
+    // Checked per tile, so a cancelled job's queue drains without tracing anything
+    if (CurrentGeneration.load() != generation) {
+      return;
+    }
+    if (full) {
+      frame->RenderTile(tile);
+    } else {
+      frame->RenderPreviewTile(tile, PreviewSteps[pass], pass > 0);
+    }
+    // Converted while this worker still owns the tile: once its next pass is queued, the job's
+    // pixels there may be rewritten at any time
+    const auto& rgba = frame->GetRGBAData(tile);
+    {
+      // Cancel takes the lock too, so once it returns nothing more reaches the raytracer
+      const std::scoped_lock lock(Mutex);
+      if (CurrentGeneration.load() != generation) {
+        return;
+      }
+      raytracer.CopyTile(*frame, tile);
+      CopyTileRgba(rgba, Rgba, Width, tile);
+    }
+    // Called back before the tile counts as done, so Wait also waits for the callbacks
+    if (on_tile && CurrentGeneration.load() == generation) {
+      on_tile(tile);
+    }
+    {
+      const std::scoped_lock lock(Mutex);
+      if (CurrentGeneration.load() != generation) {
+        return;
+      }
+      Completed.push_back(tile);
+      --Remaining;
+    }
+    TileFinished.notify_all();
+    if (!full) {
+      RunPass(raytracer, frame, tile, pass + 1, generation, on_tile);
+    }
+  }, priority);
+}
+
+void AsyncRenderer::Cancel()
+{
+  {
+    const std::scoped_lock lock(Mutex);
+    ++CurrentGeneration;
+    Completed.clear();
+    Remaining = 0;
+  }
+  TileFinished.notify_all();
+}
+
+void AsyncRenderer::CancelAndWait()
+{
+  Cancel();
+  Pool.WaitIdle();
+}
+
+void AsyncRenderer::Wait()
+{
+  std::unique_lock lock(Mutex);
+  TileFinished.wait(lock, [this] { return Remaining == 0; });
+}
+
+std::vector<TileRect> AsyncRenderer::TakeCompletedTiles()
+{
+  const std::scoped_lock lock(Mutex);
+  return std::exchange(Completed, {});
+}
+
+std::vector<TileRect> AsyncRenderer::TakeCompletedTiles(std::vector<std::uint8_t>& rgba)
+{
+  const std::scoped_lock lock(Mutex);
+  rgba.resize(Rgba.size());
+  for (const auto& tile : Completed) {
+    CopyTileRgba(Rgba, rgba, Width, tile);
+  }
+  return std::exchange(Completed, {});
+}
+
+std::size_t AsyncRenderer::TilesRemaining() const
+{
+  const std::scoped_lock lock(Mutex);
+  return Remaining;
+}
@@ -0,0 +1,240 @@
+#include "bvh.hpp"
+#include "aabb.hpp"
+#include "math.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr int BinCount = 12;
+// Past this depth, splits are forced to the median so the tree can't get deep enough to overflow
+// TraverseBvh's stack
+constexpr int MaxSahDepth = 40;
+
+double CentroidOn(const Point3& centroid, int axis) noexcept
+{
+  return axis == 0 ? centroid.x : (axis == 1 ? centroid.y : centroid.z);
+}
+
+Aabb PointBox(const Point3& point) noexcept
+{
+  return Aabb::FromPoints(point, point);
+}
+
+class Builder {
+  public:
+  Builder(std::span<const Aabb> bounds, std::size_t max_leaf_size) : Bounds(bounds), MaxLeafSize(std::clamp<std::size_t>(max_leaf_size, 1, std::numeric_limits<std::uint16_t>::max()))
+  {
+    Centroids.reserve(bounds.size());
+    Layout.Order.reserve(bounds.size());
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+      Centroids.push_back(bounds[i].Centroid());
+      Layout.Order.push_back(static_cast<std::uint32_t>(i));
+    }
+    // A binary tree with at least one primitive per leaf
+    Layout.Nodes.reserve(bounds.size() * 2);
+  }
+
+  BvhLayout Build() &&
+  {
+    if (!Bounds.empty()) {
+      BuildNode(0, Bounds.size(), 0);
+    }
+    return std::move(Layout);
+  }
+
+  private:
+  std::span<const Aabb> Bounds;
+  std::size_t MaxLeafSize;
+  std::vector<Point3> Centroids;
+  BvhLayout Layout;
+
+  void BuildNode(std::size_t first, std::size_t last, int depth)
+  {
+    const auto node_index = Layout.Nodes.size();
+    Layout.Nodes.emplace_back();
+
+    Aabb bounds;
+    Aabb centroid_bounds;
+    for (auto i = first; i < last; ++i) {
+      bounds = Aabb::Merge(bounds, Bounds[Layout.Order[i]]);
+      centroid_bounds = Aabb::Merge(centroid_bounds, PointBox(Centroids[Layout.Order[i]]));
+    }
+    Layout.Nodes[node_index].Bounds = bounds;
+
+    const auto count = last - first;
+    if (count <= MaxLeafSize) {
+      Layout.Nodes[node_index].Offset = static_cast<std::uint32_t>(first);
+      Layout.Nodes[node_index].Count = static_cast<std::uint16_t>(count);
+      return;
+    }
+
+    const auto axis = centroid_bounds.LongestAxis();
+    const auto middle = Partition(first, last, axis, centroid_bounds.Axis(axis), depth);
+
+    Layout.Nodes[node_index].Axis = static_cast<std::uint16_t>(axis);
+    BuildNode(first, middle, depth + 1);
+    Layout.Nodes[node_index].Offset = static_cast<std::uint32_t>(Layout.Nodes.size());
+    BuildNode(middle, last, depth + 1);
+  }
+
+  // Splits [first, last) in two non-empty halves along `axis`, returning where the second starts
+  std::size_t Partition(std::size_t first, std::size_t last, int axis, const Interval& extent, int depth)
+  {
+    auto order = std::span(Layout.Order).subspan(first, last - first);
+    auto centroid = [&](std::uint32_t primitive) { return CentroidOn(Centroids[primitive], axis); };
+
+    if (extent.Size() > 0 && depth < MaxSahDepth) {
+      if (const auto split = BestSahSplit(order, axis, extent)) {
+        const auto scale = BinCount / extent.Size();
+        const auto middle = std::ranges::partition(order, [&](std::uint32_t primitive) {
+          return std::min(static_cast<int>((centroid(primitive) - extent.Min) * scale), BinCount - 1) < *split;
+        });
+        const auto offset = static_cast<std::size_t>(middle.begin() - order.begin());
+        if (offset > 0 && offset < order.size()) {
+          return first + offset;
+        }
+      }
+    }
+
+    // Identical centroids, or too deep: halve by count
+    const auto half = order.size() / 2;
+    std::ranges::nth_element(order, order.begin() + static_cast<std::ptrdiff_t>(half), {}, centroid);
+    return first + half;
+  }
+
+  // Index of the first bin that goes to the second child, or nothing if all bins are empty but one
+  std::optional<int> BestSahSplit(std::span<const std::uint32_t> order, int axis, const Interval& extent) const
+  {
+    struct Bin {
+      Aabb Bounds;
+      std::size_t Count{};
+    };
+    std::array<Bin, BinCount> bins{};
+    const auto scale = BinCount / extent.Size();
+    for (const auto primitive : order) {
+      const auto bin = std::min(static_cast<int>((CentroidOn(Centroids[primitive], axis) - extent.Min) * scale), BinCount - 1);
+      bins[static_cast<std::size_t>(bin)].Bounds = Aabb::Merge(bins[static_cast<std::size_t>(bin)].Bounds, Bounds[primitive]);
+      ++bins[static_cast<std::size_t>(bin)].Count;
+    }
+
+    // Sweep from the right to get the cost of everything past each split, then from the left
+    std::array<double, BinCount> right_cost{};
+    Aabb right_bounds;
+    std::size_t right_count = 0;
+    for (auto i = BinCount - 1; i > 0; --i) {
+      right_bounds = Aabb::Merge(right_bounds, bins[static_cast<std::size_t>(i)].Bounds);
+      right_count += bins[static_cast<std::size_t>(i)].Count;
+      right_cost[static_cast<std::size_t>(i)] = right_bounds.SurfaceArea() * static_cast<double>(right_count);
+    }
+
+    std::optional<int> best;
+    auto best_cost = Infinity;
+    Aabb left_bounds;
+    std::size_t left_count = 0;
+    for (auto i = 1; i < BinCount; ++i) {
+      left_bounds = Aabb::Merge(left_bounds, bins[static_cast<std::size_t>(i - 1)].Bounds);
+      left_count += bins[static_cast<std::size_t>(i - 1)].Count;
+      if (left_count == 0 || left_count == order.size()) {
+        continue;
+      }
+      const auto cost = (left_bounds.SurfaceArea() * static_cast<double>(left_count)) + right_cost[static_cast<std::size_t>(i)];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best = i;
+      }
+    }
+    return best;
+  }
+};
+}
+
+BvhLayout softrays::BuildBvh(std::span<const Aabb> bounds, std::size_t max_leaf_size)
+{
+  SOFTRAYS_TRACE_SCOPE("BuildBvh");
+  return Builder(bounds, max_leaf_size).Build();
+}
+
+PartitionedObjects softrays::PartitionByBounds(const std::vector<std::shared_ptr<Hittable>>& objects)
+{
+  PartitionedObjects partition;
+  partition.Bounded.reserve(objects.size());
+  partition.Bounds.reserve(objects.size());
+  for (const auto& object : objects) {
+    const auto bounds = object->BoundingBox();
+    if (bounds.IsFinite()) {
+      partition.Bounded.push_back(object);
+      partition.Bounds.push_back(bounds);
+    } else {
+      partition.Unbounded.push_back(object);
+    }
+  }
+  return partition;
+}
+
+bool softrays::HitClosest(std::span<const std::shared_ptr<Hittable>> objects, const Ray& ray, Interval& ray_time, HitData& hit)
+{
+  HitData temp_hit{};
+  bool hit_anything = false;
+  for (const auto& object : objects) {
+    if (object->Hit(ray, ray_time, temp_hit)) {
+      ray_time.Max = temp_hit.Time;
+      hit_anything = true;
+      hit = temp_hit;
+    }
+  }
+  return hit_anything;
+}
+
+bool softrays::AnyOccludes(std::span<const std::shared_ptr<Hittable>> objects, const Ray& ray, Interval ray_time)
+{
+  return std::ranges::any_of(objects, [&](const auto& object) { return object->Occluded(ray, ray_time); });
+}
+
+Bvh::Bvh(const std::vector<std::shared_ptr<Hittable>>& objects)
+{
+  auto partition = PartitionByBounds(objects);
+  Unbounded = std::move(partition.Unbounded);
+  auto layout = BuildBvh(partition.Bounds);
+  Nodes = std::move(layout.Nodes);
+  Objects.reserve(partition.Bounded.size());
+  for (const auto index : layout.Order) {
+    Objects.push_back(partition.Bounded[index]);
+  }
+}
+
+bool Bvh::Hit(const Ray& ray, Interval ray_time, HitData& hit) const
+{
+  const auto hit_unbounded = HitClosest(Unbounded, ray, ray_time, hit);
+  return TraverseBvh(Nodes, ray, ray_time, [&](std::uint32_t first, std::uint32_t count, Interval& time) {
+    return HitClosest(std::span(Objects).subspan(first, count), ray, time, hit);
+  }) || hit_unbounded;
+}
+
+bool Bvh::Occluded(const Ray& ray, Interval ray_time) const
+{
+  return AnyOccludes(Unbounded, ray, ray_time)
+      || TraverseBvh<true>(Nodes, ray, ray_time, [&](std::uint32_t first, std::uint32_t count, const Interval& time) {
+           return AnyOccludes(std::span(Objects).subspan(first, count), ray, time);
+         });
+}
+
+Aabb Bvh::BoundingBox() const
+{
+  if (!Unbounded.empty()) {
+    return Hittable::BoundingBox();
+  }
+  return Nodes.empty() ? Aabb{} : Nodes.front().Bounds;
+}
@@ -0,0 +1,63 @@
+#include "camera_rig.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace softrays;
+
+namespace {
+constexpr auto MaxPitch = (Pi / 2) - 1e-3;
+}
+
+CameraRig CameraRig::FromLookAt(const Point3& look_from, const Point3& look_at)
+{
+  const auto offset = look_from - look_at;
+  const auto distance = std::max(offset.Length(), MinDistance);
+  return {
+      .Target = look_at,
+      .Distance = distance,
+      .Yaw = std::atan2(offset.z, offset.x),
+      .Pitch = std::clamp(std::asin(std::clamp(offset.y / distance, -1.0, 1.0)), -MaxPitch, MaxPitch),
+  };
+}
+
+Point3 CameraRig::Eye() const noexcept
+{
+  return Target - (Forward() * Distance);
+}
+
+Vec3 CameraRig::Forward() const noexcept
+{
+  return {-std::cos(Pitch) * std::cos(Yaw), -std::sin(Pitch), -std::cos(Pitch) * std::sin(Yaw)};
+}
+
+Vec3 CameraRig::Right() const noexcept
+{
+  return Forward().Cross(Vec3(0, 1, 0)).UnitVector();
+}
+
+void CameraRig::Orbit(double yaw, double pitch) noexcept
+{
+  Yaw = std::remainder(Yaw + yaw, 2 * Pi);
+  Pitch = std::clamp(Pitch + pitch, -MaxPitch, MaxPitch);
+}
+
+void CameraRig::Zoom(double factor) noexcept
+{
+  Distance = std::max(Distance * factor, MinDistance);
+}
+
+void CameraRig::Fly(double forward, double right, double up) noexcept
+{
+  Target += (Forward() * forward) + (Right() * right) + Vec3(0, up, 0);
+}
+
+void CameraRig::ApplyTo(RayTracer& raytracer) const
+{
+  raytracer.LookFrom = Eye();
+  raytracer.LookAt = Target;
+  raytracer.CameraUp = Vec3(0, 1, 0);
+  raytracer.FocusDistance = Distance;
+}
@@ -0,0 +1,266 @@
+#include "checkpoint.hpp"
+#include "image.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "serialize.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr std::uint32_t CheckpointMagic = 0x50435253;  // "SRCP"
+constexpr std::uint32_t CheckpointVersion = 1;
+
+// The splitmix64 finaliser, so neighbouring passes and tiles get unrelated random streams
+constexpr std::uint64_t Mix(std::uint64_t value) noexcept
+{
+  // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27U)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31U);
+  // NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+}
+
+constexpr std::uint64_t PassSeed(std::uint64_t seed, std::uint64_t pass, std::uint64_t tile) noexcept
+{
+  return Mix(Mix(Mix(seed) ^ pass) ^ tile);
+}
+
+template <typename Fields>
+constexpr std::size_t PackedSize = 0;
+template <typename... Field>
+constexpr std::size_t PackedSize<std::tuple<Field...>> = (sizeof(Field) + ...);
+
+// Everything a checkpoint must have been made with to be resumed
+std::uint64_t RenderKey(const RayTracer& raytracer, const CheckpointOptions& options, int tile_size, int samples_per_pass, int passes)
+{
+  const std::tuple fields{
+      options.SceneKey, options.Seed, raytracer.GetViewport(), tile_size, samples_per_pass, passes,
+      raytracer.LookFrom, raytracer.LookAt, raytracer.CameraUp, raytracer.FieldOfView, raytracer.DefocusAngle,
+      raytracer.FocusDistance, raytracer.MaxDepth, raytracer.SkyBackground, raytracer.BackgroundColour, raytracer.SampleLights,
+  };
+  // The fields' bytes one after another, in a buffer sized for exactly them
+  std::array<std::byte, PackedSize<std::remove_const_t<decltype(fields)>>> key{};
+  std::apply(
+      [&key](const auto&... field) {
+        std::size_t offset = 0;
+        ((std::memcpy(&key[offset], &field, sizeof(field)), offset += sizeof(field)), ...);
+      },
+      fields);
+  return HashBytes(key);
+}
+
+struct Accumulation {
+  std::vector<TileRect> Tiles;
+  std::vector<Colour> Sums;  // Per pixel, row-major: every sample traced so far, added up
+  std::vector<std::uint32_t> TilePasses;  // Passes each tile has finished
+  std::vector<std::mutex> TileLocks;  // Guard each tile's sums and pass count
+
+  Accumulation(const Dimension2d& dim, int tile_size)
+      : Tiles(SplitIntoTiles(dim, tile_size)),
+        Sums(static_cast<std::size_t>(dim.Width) * static_cast<std::size_t>(dim.Height)),
+        TilePasses(Tiles.size()),
+        TileLocks(Tiles.size())
+  {
+  }
+};
+
+// A copy of the accumulation taken a tile at a time, so no tile is held for longer than its memcpy
+struct Snapshot {
+  std::vector<Colour> Sums;
+  std::vector<std::uint32_t> TilePasses;
+
+  void Take(Accumulation& accumulation, int width)
+  {
+    Sums.resize(accumulation.Sums.size());
+    TilePasses.resize(accumulation.TilePasses.size());
+    for (std::size_t index = 0; index < accumulation.Tiles.size(); ++index) {
+      const auto& tile = accumulation.Tiles[index];
+      const std::scoped_lock lock(accumulation.TileLocks[index]);
+      TilePasses[index] = accumulation.TilePasses[index];
+      for (int y = tile.FromY; y < tile.ToY; ++y) {
+        const auto row = (static_cast<std::size_t>(y) * static_cast<std::size_t>(width)) + static_cast<std::size_t>(tile.FromX);
+        std::copy_n(&accumulation.Sums[row], tile.Width(), &Sums[row]);
+      }
+    }
+  }
+};
+
+// Written next to the checkpoint and renamed over it, so a process killed mid-write leaves the last
+// complete one behind
+bool WriteCheckpoint(const std::string& path, std::uint64_t key, const Snapshot& snapshot)
+{
+  SOFTRAYS_TRACE_SCOPE("WriteCheckpoint");
+  const auto partial = path + ".partial";
+  {
+    std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+    ByteWriter header;
+    header.Write(CheckpointMagic);
+    header.Write(CheckpointVersion);
+    header.Write(key);
+    header.WriteSpan(std::span<const std::uint32_t>(snapshot.TilePasses));
+    header.Write<std::uint64_t>(snapshot.Sums.size());
+    file.write(reinterpret_cast<const char*>(header.Data().data()), static_cast<std::streamsize>(header.Data().size()));
+    file.write(reinterpret_cast<const char*>(snapshot.Sums.data()), static_cast<std::streamsize>(snapshot.Sums.size() * sizeof(Colour)));
+    if (!file.flush()) {
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(partial, path, error);
+  return !error;
+}
+
+// Loads a checkpoint of the render `key` identifies into `accumulation`; false leaves it untouched
+bool ReadCheckpoint(const std::string& path, std::uint64_t key, Accumulation& accumulation)
+{
+  std::error_code error;
+  const auto size = std::filesystem::file_size(path, error);
+  if (error) {
+    return false;
+  }
+  std::vector<std::byte> bytes(static_cast<std::size_t>(size));
+  std::ifstream file(path, std::ios::binary);
+  if (!file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+    return false;
+  }
+
+  ByteReader reader(bytes);
+  if (reader.Read<std::uint32_t>() != CheckpointMagic || reader.Read<std::uint32_t>() != CheckpointVersion || reader.Read<std::uint64_t>() != key) {
+    return false;
+  }
+  auto tile_passes = reader.ReadVector<std::uint32_t>();
+  auto sums = reader.ReadVector<Colour>();
+  if (!reader.Ok() || !reader.AtEnd() || tile_passes.size() != accumulation.TilePasses.size() || sums.size() != accumulation.Sums.size()) {
+    return false;
+  }
+  accumulation.TilePasses = std::move(tile_passes);
+  accumulation.Sums = std::move(sums);
+  return true;
+}
+}
+
+std::optional<FloatImage> softrays::RenderWithCheckpoints(RayTracer& raytracer, const CheckpointOptions& options)
+{
+  const auto total_samples = std::max(raytracer.GetSamplesPerPixel(), 1);
+  const auto samples_per_pass = total_samples == 1 ? 1 : std::clamp(options.SamplesPerPass, 2, total_samples);
+  const auto passes = (total_samples + samples_per_pass - 1) / samples_per_pass;
+  const auto tile_size = std::max(options.TileSize, 1);
+  const auto dim = raytracer.GetViewport();
+  const auto key = RenderKey(raytracer, options, tile_size, samples_per_pass, passes);
+
+  // Every pass traces samples_per_pass samples per pixel; the caller's count is put back at the end
+  raytracer.SetSamplesPerPixel(samples_per_pass);
+  raytracer.BeginFrame();
+
+  Accumulation accumulation(dim, tile_size);
+  if (!options.Path.empty()) {
+    static_cast<void>(ReadCheckpoint(options.Path, key, accumulation));
+  }
+
+  // Each finished pass queues the tile's next one, so a tile's passes never overlap and its sums
+  // always add up in pass order
+  std::atomic<bool> stopped{false};
+  ThreadPool pool(options.Threads);
+  std::function<void(std::size_t)> trace_pass;
+  trace_pass = [&](std::size_t index) {
+    if (stopped || (options.ShouldStop && options.ShouldStop())) {
+      stopped = true;
+      return;
+    }
+    const auto& tile = accumulation.Tiles[index];
+    const auto pass = accumulation.TilePasses[index];
+    thread_local std::vector<Colour> pixels;
+    pixels.resize(tile.PixelCount());
+    SeedRandom(PassSeed(options.Seed, pass, index));
+    raytracer.RenderTile(tile, std::span(pixels));
+
+    {
+      const std::scoped_lock lock(accumulation.TileLocks[index]);
+      for (int y = tile.FromY; y < tile.ToY; ++y) {
+        for (int x = tile.FromX; x < tile.ToX; ++x) {
+          const auto pixel = (static_cast<std::size_t>(y) * static_cast<std::size_t>(dim.Width)) + static_cast<std::size_t>(x);
+          accumulation.Sums[pixel] += pixels[(static_cast<std::size_t>(y - tile.FromY) * static_cast<std::size_t>(tile.Width())) + static_cast<std::size_t>(x - tile.FromX)] * samples_per_pass;
+        }
+      }
+      ++accumulation.TilePasses[index];
+    }
+    if (std::cmp_less(pass + 1, passes)) {
+      pool.Submit([&trace_pass, index] { trace_pass(index); });
+    }
+  };
+
+  Snapshot snapshot;
+  std::mutex writer_mutex;
+  std::condition_variable writer_wake;
+  bool tracing = true;
+  std::jthread writer;
+  if (!options.Path.empty()) {
+    writer = std::jthread([&] {
+      const auto interval = std::chrono::duration<double>(std::max(options.IntervalSeconds, 0.0));
+      std::unique_lock lock(writer_mutex);
+      while (!writer_wake.wait_for(lock, interval, [&tracing] { return !tracing; })) {
+        lock.unlock();
+        snapshot.Take(accumulation, dim.Width);
+        static_cast<void>(WriteCheckpoint(options.Path, key, snapshot));
+        lock.lock();
+      }
+    });
+  }
+
+  for (std::size_t index = 0; index < accumulation.Tiles.size(); ++index) {
+    if (std::cmp_less(accumulation.TilePasses[index], passes)) {
+      pool.Submit([&trace_pass, index] { trace_pass(index); });
+    }
+  }
+  pool.WaitIdle();
+  raytracer.SetSamplesPerPixel(total_samples);
+
+  {
+    const std::scoped_lock lock(writer_mutex);
+    tracing = false;
+  }
+  writer_wake.notify_all();
+  if (writer.joinable()) {
+    writer.join();
+    snapshot.Take(accumulation, dim.Width);
+    static_cast<void>(WriteCheckpoint(options.Path, key, snapshot));
+  }
+  if (stopped) {
+    return std::nullopt;
+  }
+
+  FloatImage image(dim.Width, dim.Height);
+  const auto scale = 1.0 / (static_cast<double>(passes) * samples_per_pass);
+  for (int y = 0; y < dim.Height; ++y) {
+    for (int x = 0; x < dim.Width; ++x) {
+      image.Set(x, y, accumulation.Sums[(static_cast<std::size_t>(y) * static_cast<std::size_t>(dim.Width)) + static_cast<std::size_t>(x)] * scale);
+    }
+  }
+  return image;
+}
@@ -0,0 +1,251 @@
+#include "compact_bvh.hpp"
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "math.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr double Steps = 255.0;
+// Decoded bounds are widened by this fraction of their frame, on top of rounding outwards, so
+// floating-point error in decoding can't shave a box below what it must contain
+constexpr double SlackFraction = 1e-9;
+
+// A frame axis, ready for decoding any number of children against it
+struct AxisScale {
+  double Min;
+  double Step;
+  double Slack;
+
+  explicit AxisScale(const Interval& frame) noexcept
+      : Min(frame.Min), Step(frame.Size() / Steps), Slack(SlackFraction * (frame.Size() + std::fabs(frame.Min) + std::fabs(frame.Max)))
+  {
+  }
+
+  [[nodiscard]] Interval Decode(std::uint8_t lower, std::uint8_t upper) const noexcept
+  {
+    return {.Min = Min + (lower * Step) - Slack, .Max = Min + (upper * Step) + Slack};
+  }
+};
+
+Interval DecodeAxis(const Interval& frame, std::uint8_t lower, std::uint8_t upper) noexcept
+{
+  return AxisScale(frame).Decode(lower, upper);
+}
+
+// The tightest pair of steps whose decoded interval holds `bounds`
+std::array<std::uint8_t, 2> QuantiseAxis(const Interval& frame, const Interval& bounds) noexcept
+{
+  const auto step = frame.Size() / Steps;
+  auto to_step = [&](double value, bool round_up) {
+    if (step <= 0) {
+      return round_up ? Steps : 0.0;
+    }
+    const auto position = (value - frame.Min) / step;
+    return std::clamp(round_up ? std::ceil(position) : std::floor(position), 0.0, Steps);
+  };
+  auto lower = static_cast<std::uint8_t>(to_step(bounds.Min, false));
+  auto upper = static_cast<std::uint8_t>(to_step(bounds.Max, true));
+  // Division error can leave the rounded step a hair on the wrong side
+  while (lower > 0 && DecodeAxis(frame, lower, upper).Min > bounds.Min) {
+    --lower;
+  }
+  while (upper < Steps && DecodeAxis(frame, lower, upper).Max < bounds.Max) {
+    ++upper;
+  }
+  return {lower, upper};
+}
+}
+
+Aabb CompactBvhNode::Decode(std::size_t child, const Aabb& frame) const noexcept
+{
+  return {
+      .X = DecodeAxis(frame.X, Lower[child][0], Upper[child][0]),
+      .Y = DecodeAxis(frame.Y, Lower[child][1], Upper[child][1]),
+      .Z = DecodeAxis(frame.Z, Lower[child][2], Upper[child][2]),
+  };
+}
+
+CompactBvh::CompactBvh(const std::vector<std::shared_ptr<Hittable>>& objects)
+{
+  SOFTRAYS_TRACE_SCOPE("BuildCompactBvh");
+  auto partition = PartitionByBounds(objects);
+  Unbounded = std::move(partition.Unbounded);
+  const auto layout = BuildBvh(partition.Bounds);
+  Objects.reserve(partition.Bounded.size());
+  for (const auto index : layout.Order) {
+    Objects.push_back(partition.Bounded[index]);
+  }
+  if (layout.Nodes.empty()) {
+    return;
+  }
+
+  RootBounds = layout.Nodes.front().Bounds;
+  // Only interior nodes become compact nodes, and half the binary nodes are leaves
+  Nodes.reserve((layout.Nodes.size() / 2) + 1);
+  Compress(layout, 0, RootBounds);
+}
+
+// Emits the compact node for binary node `node`, whose box decodes to `frame`, and its subtree
+std::uint32_t CompactBvh::Compress(const BvhLayout& layout, std::uint32_t node, const Aabb& frame)
+{
+  const auto index = static_cast<std::uint32_t>(Nodes.size());
+  Nodes.emplace_back();
+
+  const auto& source = layout.Nodes[node];
+  // A leaf root gets a node of its own with a single child
+  std::array<std::uint32_t, 2> children{node, CompactBvhNode::NoChild};
+  if (!source.IsLeaf()) {
+    children = {node + 1, source.Offset};
+    Nodes[index].Axis = static_cast<std::uint8_t>(source.Axis);
+  }
+
+  for (std::size_t i = 0; i < 2; ++i) {
+    if (children[i] == CompactBvhNode::NoChild) {
+      continue;
+    }
+    const auto& child = layout.Nodes[children[i]];
+    for (int axis = 0; axis < 3; ++axis) {
+      const auto [lower, upper] = QuantiseAxis(frame.Axis(axis), child.Bounds.Axis(axis));
+      Nodes[index].Lower[i][static_cast<std::size_t>(axis)] = lower;
+      Nodes[index].Upper[i][static_cast<std::size_t>(axis)] = upper;
+    }
+
+    if (child.IsLeaf()) {
+      Nodes[index].Child[i] = child.Offset;
+      Nodes[index].Count[i] = child.Count;
+    } else {
+      // The child's frame is its decoded box, exactly as traversal will see it
+      const auto child_frame = Nodes[index].Decode(i, frame);
+      const auto compressed = Compress(layout, children[i], child_frame);
+      Nodes[index].Child[i] = compressed;
+    }
+  }
+  return index;
+}
+
+bool CompactBvh::Hit(const Ray& ray, Interval ray_time, HitData& hit) const
+{
+  const auto hit_unbounded = HitClosest(Unbounded, ray, ray_time, hit);
+  if (Nodes.empty()) {
+    return hit_unbounded;
+  }
+
+  const auto inverse_direction = Aabb::InverseDirection(ray.Direction);
+  const std::array<bool, 3> negative{ray.Direction.x < 0, ray.Direction.y < 0, ray.Direction.z < 0};
+
+  struct Entry {
+    std::uint32_t Node;
+    Aabb Frame;
+  };
+  constexpr std::size_t max_depth = 128;
+  std::array<Entry, max_depth> stack{};
+  std::size_t top = 0;
+  if (auto root_time = ray_time; RootBounds.Hit(ray.Origin, inverse_direction, root_time)) {
+    stack[top++] = {.Node = 0, .Frame = RootBounds};
+  }
+
+  HitData temp_hit{};
+  bool hit_anything = hit_unbounded;
+  while (top > 0) {
+    const auto entry = stack[--top];
+    const auto& node = Nodes[entry.Node];
+    const std::array<AxisScale, 3> scale{AxisScale(entry.Frame.X), AxisScale(entry.Frame.Y), AxisScale(entry.Frame.Z)};
+
+    // Nearer child first; leaves are tested straight away, so their hits can cull the far child
+    const std::size_t near = negative[node.Axis] ? 1 : 0;
+    std::array<std::uint32_t, 2> descend{};
+    std::array<Aabb, 2> frames{};
+    std::size_t descend_count = 0;
+    for (const auto i : {near, 1 - near}) {
+      if (node.Child[i] == CompactBvhNode::NoChild) {
+        continue;
+      }
+      const Aabb box{
+          .X = scale[0].Decode(node.Lower[i][0], node.Upper[i][0]),
+          .Y = scale[1].Decode(node.Lower[i][1], node.Upper[i][1]),
+          .Z = scale[2].Decode(node.Lower[i][2], node.Upper[i][2]),
+      };
+      if (auto box_time = ray_time; !box.Hit(ray.Origin, inverse_direction, box_time)) {
+        continue;
+      }
+      if (node.Count[i] == 0) {
+        descend[descend_count] = node.Child[i];
+        frames[descend_count] = box;
+        ++descend_count;
+        continue;
+      }
+      for (auto object = node.Child[i]; object < node.Child[i] + node.Count[i]; ++object) {
+        if (Objects[object]->Hit(ray, ray_time, temp_hit)) {
+          ray_time.Max = temp_hit.Time;
+          hit_anything = true;
+          hit = temp_hit;
+        }
+      }
+    }
+    // Pushed far first, so the near one is popped next
+    while (descend_count > 0) {
+      --descend_count;
+      stack[top++] = {.Node = descend[descend_count], .Frame = frames[descend_count]};
+    }
+  }
+  return hit_anything;
+}
+
+bool CompactBvh::Occluded(const Ray& ray, Interval ray_time) const
+{
+  if (AnyOccludes(Unbounded, ray, ray_time)) {
+    return true;
+  }
+  if (Nodes.empty()) {
+    return false;
+  }
+
+  const auto inverse_direction = Aabb::InverseDirection(ray.Direction);
+
+  struct Entry {
+    std::uint32_t Node;
+    Aabb Frame;
+  };
+  constexpr std::size_t max_depth = 128;
+  std::array<Entry, max_depth> stack{};
+  std::size_t top = 0;
+  if (auto root_time = ray_time; RootBounds.Hit(ray.Origin, inverse_direction, root_time)) {
+    stack[top++] = {.Node = 0, .Frame = RootBounds};
+  }
+
+  // Any hit will do, so leaves are tested as soon as their box is and child order doesn't matter
+  while (top > 0) {
+    const auto entry = stack[--top];
+    const auto& node = Nodes[entry.Node];
+    for (std::size_t i = 0; i < 2; ++i) {
+      if (node.Child[i] == CompactBvhNode::NoChild) {
+        continue;
+      }
+      const auto box = node.Decode(i, entry.Frame);
+      if (auto box_time = ray_time; !box.Hit(ray.Origin, inverse_direction, box_time)) {
+        continue;
+      }
+      if (node.Count[i] == 0) {
+        stack[top++] = {.Node = node.Child[i], .Frame = box};
+        continue;
+      }
+      for (auto object = node.Child[i]; object < node.Child[i] + node.Count[i]; ++object) {
+        if (Objects[object]->Occluded(ray, ray_time)) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,304 @@
+#include "distributed.hpp"
+#include "image.hpp"
+#include "net.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "serialize.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr auto PollInterval = std::chrono::milliseconds(50);
+
+std::uint32_t ToWire(DistributedMessage type) noexcept
+{
+  return static_cast<std::uint32_t>(type);
+}
+}
+
+Coordinator::Coordinator(SceneDescription scene, CameraSettings camera, DistributedOptions options)
+    : Scene(std::move(scene)), Camera(camera), Options(options)
+{
+}
+
+bool Coordinator::Listen(const std::string& endpoint)
+{
+  Listener = ListenOn(endpoint);
+  return Listener.Valid();
+}
+
+std::optional<FloatImage> Coordinator::Run()
+{
+  if (!Listener.Valid()) {
+    return std::nullopt;
+  }
+
+  Image = FloatImage(Camera.Dimensions.Width, Camera.Dimensions.Height);
+  Tiles.clear();
+  Pending.clear();
+  for (const auto& rect : SplitIntoTiles(Camera.Dimensions, Options.TileSize)) {
+    Pending.push_back(Tiles.size());
+    Tiles.push_back({.Rect = rect, .Done = false, .Holders = 0, .Started = {}});
+  }
+  Completed = 0;
+  CompletedTime = {};
+
+  auto last_worker_seen = Clock::now();
+  while (Completed < Tiles.size()) {
+    std::vector<int> handles{Listener.Get()};
+    for (const auto& worker : Workers) {
+      handles.push_back(worker.Connection.Get());
+    }
+
+    for (const auto index : WaitReadable(handles, PollInterval)) {
+      if (index == 0) {
+        AcceptWorker();
+      } else {
+        HandleMessage(Workers[index - 1]);
+      }
+    }
+
+    // A tile can take a long time, but never this long
+    const auto now = Clock::now();
+    for (auto& worker : Workers) {
+      if (worker.Tile && now - worker.Assigned > Options.WorkerTimeout) {
+        worker.Dead = true;
+      }
+    }
+
+    for (auto& worker : Workers) {
+      if (worker.Dead) {
+        ReleaseTile(worker);
+      }
+    }
+    std::erase_if(Workers, [](const WorkerSlot& worker) { return worker.Dead; });
+
+    AssignWork();
+
+    if (!Workers.empty()) {
+      last_worker_seen = now;
+    } else if (now - last_worker_seen > Options.IdleTimeout) {
+      return std::nullopt;
+    }
+  }
+
+  for (auto& worker : Workers) {
+    [[maybe_unused]] const auto sent = worker.Connection.Send(ToWire(DistributedMessage::Done));
+  }
+  Workers.clear();
+  return std::move(Image);
+}
+
+void Coordinator::AcceptWorker()
+{
+  WorkerSlot worker{.Connection = Accept(Listener), .Tile = std::nullopt, .Assigned = {}, .Dead = false};
+  if (!worker.Connection.Valid()) {
+    return;
+  }
+  // Don't let a worker that dies mid-message block the whole coordinator
+  constexpr auto stalled_message = std::chrono::seconds(10);
+  worker.Connection.SetReceiveTimeout(stalled_message);
+
+  ByteWriter writer;
+  Scene.Serialize(writer);
+  Camera.Serialize(writer);
+  if (worker.Connection.Send(ToWire(DistributedMessage::Scene), writer.Data())) {
+    ++Stats.WorkersSeen;
+    Workers.push_back(std::move(worker));
+  }
+}
+
+void Coordinator::HandleMessage(WorkerSlot& worker)
+{
+  const auto message = worker.Connection.Receive();
+  if (!message || message->Type != ToWire(DistributedMessage::Result)) {
+    worker.Dead = true;
+    return;
+  }
+
+  ByteReader reader(message->Payload);
+  const auto index = reader.Read<std::uint64_t>();
+  const auto pixels = reader.ReadVector<float>();
+  if (!reader.Ok() || !worker.Tile || index != *worker.Tile || pixels.size() != Tiles[*worker.Tile].Rect.PixelCount() * 3) {
+    worker.Dead = true;
+    return;
+  }
+
+  auto& tile = Tiles[*worker.Tile];
+  if (tile.Done) {
+    ++Stats.DuplicateResults;
+  } else {
+    const auto& rect = tile.Rect;
+    const auto row_floats = static_cast<std::size_t>(rect.Width()) * 3;
+    for (int y = rect.FromY; y < rect.ToY; ++y) {
+      const auto source = static_cast<std::size_t>(y - rect.FromY) * row_floats;
+      std::copy_n(pixels.begin() + static_cast<std::ptrdiff_t>(source), row_floats, Image.Pixels.begin() + static_cast<std::ptrdiff_t>(Image.Index(rect.FromX, y)));
+    }
+    tile.Done = true;
+    ++Completed;
+    CompletedTime += Clock::now() - worker.Assigned;
+  }
+  --tile.Holders;
+  worker.Tile.reset();
+}
+
+void Coordinator::ReleaseTile(WorkerSlot& worker)
+{
+  if (!worker.Tile) {
+    return;
+  }
+  auto& tile = Tiles[*worker.Tile];
+  --tile.Holders;
+  if (!tile.Done && tile.Holders == 0) {
+    Pending.push_front(*worker.Tile);
+    ++Stats.TilesReassigned;
+  }
+  worker.Tile.reset();
+}
+
+bool Coordinator::SendTile(WorkerSlot& worker, std::size_t tile)
+{
+  const auto& rect = Tiles[tile].Rect;
+  ByteWriter writer;
+  writer.Write<std::uint64_t>(tile);
+  writer.Write(rect);
+  if (!worker.Connection.Send(ToWire(DistributedMessage::Tile), writer.Data())) {
+    worker.Dead = true;
+    return false;
+  }
+  const auto now = Clock::now();
+  if (Tiles[tile].Holders == 0) {
+    Tiles[tile].Started = now;
+  }
+  ++Tiles[tile].Holders;
+  worker.Tile = tile;
+  worker.Assigned = now;
+  return true;
+}
+
+std::optional<std::size_t> Coordinator::FindStraggler(Clock::time_point now) const
+{
+  if (Completed == 0) {
+    return std::nullopt;
+  }
+  const auto average = CompletedTime / Completed;
+  const auto threshold = std::chrono::duration_cast<Clock::duration>(average * Options.StragglerFactor);
+
+  std::optional<std::size_t> oldest;
+  for (std::size_t i = 0; i < Tiles.size(); ++i) {
+    const auto& tile = Tiles[i];
+    if (tile.Done || tile.Holders != 1 || now - tile.Started < threshold) {
+      continue;
+    }
+    if (!oldest || tile.Started < Tiles[*oldest].Started) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+void Coordinator::AssignWork()
+{
+  for (auto& worker : Workers) {
+    if (worker.Dead || worker.Tile) {
+      continue;
+    }
+
+    while (!Pending.empty() && Tiles[Pending.front()].Done) {
+      Pending.pop_front();
+    }
+    if (!Pending.empty()) {
+      const auto tile = Pending.front();
+      if (SendTile(worker, tile)) {
+        Pending.pop_front();
+      }
+      continue;
+    }
+
+    if (const auto straggler = FindStraggler(Clock::now())) {
+      if (SendTile(worker, *straggler)) {
+        ++Stats.TilesDuplicated;
+      }
+    }
+  }
+}
+
+bool softrays::RunWorker(const std::string& endpoint, std::chrono::milliseconds connect_timeout)
+{
+  const auto connection = ConnectTo(endpoint, connect_timeout);
+  const auto setup = connection.Receive();
+  if (!setup || setup->Type != ToWire(DistributedMessage::Scene)) {
+    return false;
+  }
+
+  ByteReader setup_reader(setup->Payload);
+  const auto scene = SceneDescription::Deserialize(setup_reader);
+  const auto camera = CameraSettings::Deserialize(setup_reader);
+  if (!scene || !camera) {
+    return false;
+  }
+
+  const auto prepared = scene->Prepare();
+  if (!prepared) {
+    return false;
+  }
+  RayTracer raytracer;
+  camera->Apply(raytracer);
+  prepared->AttachTo(raytracer);
+
+  // Every tile belongs to the same frame, so the camera and lights are only set up once
+  raytracer.BeginFrame();
+  const auto width = static_cast<std::size_t>(camera->Dimensions.Width);
+  while (true) {
+    const auto message = connection.Receive();
+    if (!message) {
+      return false;
+    }
+    if (message->Type == ToWire(DistributedMessage::Done)) {
+      return true;
+    }
+
+    ByteReader reader(message->Payload);
+    const auto index = reader.Read<std::uint64_t>();
+    const auto rect = reader.Read<TileRect>();
+    if (!reader.Ok() || message->Type != ToWire(DistributedMessage::Tile)) {
+      return false;
+    }
+    if (rect.FromX < 0 || rect.FromY < 0 || rect.FromX >= rect.ToX || rect.FromY >= rect.ToY || rect.ToX > camera->Dimensions.Width ||
+        rect.ToY > camera->Dimensions.Height) {
+      return false;
+    }
+
+    raytracer.RenderTile(rect);
+
+    const auto& pixel_data = raytracer.GetPixelData();
+    std::vector<float> pixels;
+    pixels.reserve(rect.PixelCount() * 3);
+    for (int y = rect.FromY; y < rect.ToY; ++y) {
+      for (int x = rect.FromX; x < rect.ToX; ++x) {
+        const auto& colour = pixel_data[(static_cast<std::size_t>(y) * width) + static_cast<std::size_t>(x)];
+        pixels.push_back(static_cast<float>(colour.x));
+        pixels.push_back(static_cast<float>(colour.y));
+        pixels.push_back(static_cast<float>(colour.z));
+      }
+    }
+
+    ByteWriter writer;
+    writer.Write(index);
+    writer.WriteSpan(std::span<const float>(pixels));
+    if (!connection.Send(ToWire(DistributedMessage::Result), writer.Data())) {
+      return false;
+    }
+  }
+}
@@ -0,0 +1,137 @@
+#include "environment.hpp"
+#include "image.hpp"
+#include "math.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+// Index of the CDF segment [cdf[i], cdf[i + 1]) containing `value`, skipping empty segments
+template <typename Container>
+std::size_t FindSegment(const Container& cdf, std::size_t first, std::size_t count, double value) noexcept
+{
+  const auto begin = cdf.begin() + static_cast<std::ptrdiff_t>(first);
+  const auto end = begin + static_cast<std::ptrdiff_t>(count + 1);
+  const auto upper = std::upper_bound(begin, end, value);
+  const auto index = static_cast<std::size_t>(std::max<std::ptrdiff_t>(0, (upper - begin) - 1));
+  return std::min(index, count - 1);
+}
+}
+
+EnvironmentMap::EnvironmentMap(FloatImage image, double intensity)
+    : Image(std::move(image)), Intensity(intensity)
+{
+  BuildDistribution();
+}
+
+std::optional<EnvironmentMap> EnvironmentMap::Load(const std::string& path, double intensity)
+{
+  auto image = LoadPFM(path);
+  if (!image) {
+    return std::nullopt;
+  }
+  return EnvironmentMap(std::move(*image), intensity);
+}
+
+double EnvironmentMap::Weight(int x, int y) const noexcept
+{
+  // Rows near the poles cover less solid angle
+  const auto theta = Pi * (y + 0.5) / Image.Height;
+  return std::max(0.0, Luminance(Image.At(x, y))) * std::sin(theta);
+}
+
+void EnvironmentMap::BuildDistribution()
+{
+  const auto width = static_cast<std::size_t>(Image.Width);
+  const auto height = static_cast<std::size_t>(Image.Height);
+  ConditionalCdf.assign(height * (width + 1), 0.0F);
+  MarginalCdf.assign(height + 1, 0.0);
+
+  for (std::size_t y = 0; y < height; ++y) {
+    const auto row = y * (width + 1);
+    double sum = 0.0;
+    std::vector<double> running(width + 1, 0.0);
+    for (std::size_t x = 0; x < width; ++x) {
+      sum += Weight(static_cast<int>(x), static_cast<int>(y));
+      running[x + 1] = sum;
+    }
+    for (std::size_t x = 0; x <= width; ++x) {
+      // A black row is never picked by the marginal, but keep its CDF well-formed
+      ConditionalCdf[row + x] = static_cast<float>(sum > 0 ? running[x] / sum : static_cast<double>(x) / static_cast<double>(width));
+    }
+    ConditionalCdf[row + width] = 1.0F;
+    MarginalCdf[y + 1] = MarginalCdf[y] + sum;
+  }
+
+  const auto total = MarginalCdf[height];
+  for (std::size_t y = 0; y <= height; ++y) {
+    MarginalCdf[y] = total > 0 ? MarginalCdf[y] / total : static_cast<double>(y) / static_cast<double>(height);
+  }
+  MarginalCdf[height] = 1.0;
+}
+
+std::pair<int, int> EnvironmentMap::PixelFor(const Vec3& unit_direction) const noexcept
+{
+  const auto theta = std::acos(std::clamp(unit_direction.y, -1.0, 1.0));
+  const auto phi = std::atan2(unit_direction.z, unit_direction.x);
+  const auto u = (phi + Pi) / (2 * Pi);
+  const auto v = theta / Pi;
+  const auto x = std::clamp(static_cast<int>(u * Image.Width), 0, Image.Width - 1);
+  const auto y = std::clamp(static_cast<int>(v * Image.Height), 0, Image.Height - 1);
+  return {x, y};
+}
+
+Colour EnvironmentMap::Lookup(const Vec3& direction) const noexcept
+{
+  const auto [x, y] = PixelFor(direction.UnitVector());
+  return Image.At(x, y) * Intensity;
+}
+
+Vec3 EnvironmentMap::Sample(double u1, double u2) const noexcept
+{
+  const auto width = static_cast<std::size_t>(Image.Width);
+  const auto height = static_cast<std::size_t>(Image.Height);
+
+  const auto y = FindSegment(MarginalCdf, 0, height, u2);
+  const auto row_width = MarginalCdf[y + 1] - MarginalCdf[y];
+  const auto dv = row_width > 0 ? (u2 - MarginalCdf[y]) / row_width : 0.5;
+
+  const auto row = y * (width + 1);
+  const auto x = FindSegment(ConditionalCdf, row, width, u1);
+  const auto column_width = static_cast<double>(ConditionalCdf[row + x + 1] - ConditionalCdf[row + x]);
+  const auto du = column_width > 0 ? (u1 - static_cast<double>(ConditionalCdf[row + x])) / column_width : 0.5;
+
+  const auto u = (static_cast<double>(x) + std::clamp(du, 0.0, 1.0)) / static_cast<double>(width);
+  const auto v = (static_cast<double>(y) + std::clamp(dv, 0.0, 1.0)) / static_cast<double>(height);
+  const auto theta = v * Pi;
+  const auto phi = (u * 2 * Pi) - Pi;
+  const auto sin_theta = std::sin(theta);
+  return {.x = sin_theta * std::cos(phi), .y = std::cos(theta), .z = sin_theta * std::sin(phi)};
+}
+
+double EnvironmentMap::Pdf(const Vec3& direction) const noexcept
+{
+  const auto unit_direction = direction.UnitVector();
+  const auto sin_theta = std::sqrt(std::max(0.0, 1 - (unit_direction.y * unit_direction.y)));
+  if (sin_theta <= 0) {
+    return 0.0;
+  }
+
+  const auto [x, y] = PixelFor(unit_direction);
+  const auto width = static_cast<std::size_t>(Image.Width);
+  const auto row = static_cast<std::size_t>(y) * (width + 1);
+  const auto column = static_cast<std::size_t>(x);
+  const auto row_probability = MarginalCdf[static_cast<std::size_t>(y) + 1] - MarginalCdf[static_cast<std::size_t>(y)];
+  const auto column_probability = static_cast<double>(ConditionalCdf[row + column + 1] - ConditionalCdf[row + column]);
+
+  // Density over the unit (u, v) square, then the Jacobian of the lat-long mapping
+  const auto pdf_uv = row_probability * column_probability * Image.Width * Image.Height;
+  return pdf_uv / (2 * Pi * Pi * sin_theta);
+}
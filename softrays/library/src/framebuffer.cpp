@@ -0,0 +1,66 @@
+#include "framebuffer.hpp"
+#include "math.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+using namespace softrays;
+
+Framebuffer::Framebuffer(PixelFormat format, std::size_t pixels)
+{
+  SetFormat(format);
+  Resize(pixels);
+}
+
+void Framebuffer::SetFormat(PixelFormat format)
+{
+  const auto pixels = size();
+  switch (format) {
+  case PixelFormat::RGB64:
+    Pixels.emplace<std::vector<Colour>>(pixels);
+    break;
+  case PixelFormat::RGBA32:
+    Pixels.emplace<std::vector<PixelRGBA32>>(pixels);
+    break;
+  case PixelFormat::RGBA16:
+    Pixels.emplace<std::vector<PixelRGBA16>>(pixels);
+    break;
+  case PixelFormat::RGB9E5:
+    Pixels.emplace<std::vector<PixelRGB9E5>>(pixels);
+    break;
+  }
+}
+
+std::size_t Framebuffer::BytesPerPixel() const noexcept
+{
+  return Visit([](const auto& pixels) { return sizeof(typename std::decay_t<decltype(pixels)>::value_type); });
+}
+
+void Framebuffer::Resize(std::size_t pixels)
+{
+  Visit([pixels](auto& storage) {
+    storage.clear();
+    storage.resize(pixels);
+  });
+}
+
+void Framebuffer::ShrinkToFit()
+{
+  Visit([](auto& storage) { storage.shrink_to_fit(); });
+}
+
+std::size_t Framebuffer::size() const noexcept
+{
+  return Visit([](const auto& storage) { return storage.size(); });
+}
+
+Colour Framebuffer::operator[](std::size_t pixel) const
+{
+  return Visit([pixel](const auto& storage) { return PixelCodec<typename std::decay_t<decltype(storage)>::value_type>::Decode(storage[pixel]); });
+}
+
+void Framebuffer::Set(std::size_t pixel, const Colour& colour)
+{
+  Visit([pixel, &colour](auto& storage) { storage[pixel] = PixelCodec<typename std::decay_t<decltype(storage)>::value_type>::Encode(colour); });
+}
@@ -0,0 +1,108 @@
+#include "image.hpp"
+#include "math.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+float SwapBytes(float value) noexcept
+{
+  auto bits = std::bit_cast<std::uint32_t>(value);
+  bits = ((bits & 0x000000FFU) << 24U) | ((bits & 0x0000FF00U) << 8U) | ((bits & 0x00FF0000U) >> 8U) | ((bits & 0xFF000000U) >> 24U);
+  return std::bit_cast<float>(bits);
+}
+}
+
+std::optional<FloatImage> softrays::LoadPFM(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+
+  std::string magic;
+  int width = 0;
+  int height = 0;
+  double scale = 0;
+  file >> magic >> width >> height >> scale;
+  // Exactly one whitespace character separates the header from the raster
+  file.get();
+  if (!file || magic != "PF" || width <= 0 || height <= 0) {
+    return std::nullopt;
+  }
+
+  FloatImage image(width, height);
+  const auto row_floats = static_cast<std::size_t>(width) * 3;
+  // PFM stores rows bottom-to-top
+  for (int y = height - 1; y >= 0; --y) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    file.read(reinterpret_cast<char*>(&image.Pixels[image.Index(0, y)]), static_cast<std::streamsize>(row_floats * sizeof(float)));
+  }
+  if (!file) {
+    return std::nullopt;
+  }
+
+  // A negative scale means little-endian data
+  const bool file_little_endian = scale < 0;
+  if (file_little_endian != (std::endian::native == std::endian::little)) {
+    for (auto& value : image.Pixels) {
+      value = SwapBytes(value);
+    }
+  }
+  return image;
+}
+
+bool softrays::SavePFM(const std::string& path, const FloatImage& image)
+{
+  SOFTRAYS_TRACE_SCOPE("SavePFM");
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  const auto scale = (std::endian::native == std::endian::little) ? "-1.0" : "1.0";
+  file << "PF\n"
+       << image.Width << ' ' << image.Height << '\n'
+       << scale << '\n';
+  const auto row_floats = static_cast<std::size_t>(image.Width) * 3;
+  for (int y = image.Height - 1; y >= 0; --y) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    file.write(reinterpret_cast<const char*>(&image.Pixels[image.Index(0, y)]), static_cast<std::streamsize>(row_floats * sizeof(float)));
+  }
+  return static_cast<bool>(file);
+}
+
+std::vector<std::uint8_t> softrays::ToRGBA8(const FloatImage& image)
+{
+  static constexpr Interval intensity(0.000, 0.999);
+  static constexpr int byteMax{256};
+  const auto pixel_count = static_cast<std::size_t>(image.Width) * static_cast<std::size_t>(image.Height);
+  std::vector<std::uint8_t> rgba(pixel_count * 4);
+  for (std::size_t i = 0; i < pixel_count; ++i) {
+    for (std::size_t channel = 0; channel < 3; ++channel) {
+      const auto value = LinearToGamma(static_cast<double>(image.Pixels[(i * 3) + channel]));
+      rgba[(i * 4) + channel] = static_cast<std::uint8_t>(intensity.Clamp(value) * byteMax);
+    }
+    rgba[(i * 4) + 3] = byteMax - 1;
+  }
+  return rgba;
+}
+
+bool softrays::SaveImage(const std::string& path, const FloatImage& image)
+{
+  if (path.ends_with(".pfm")) {
+    return SavePFM(path, image);
+  }
+  SOFTRAYS_TRACE_SCOPE("SavePPM");
+  std::ofstream file(path);
+  StreamPPM(file, image.Width, image.Height, ToRGBA8(image));
+  return static_cast<bool>(file);
+}
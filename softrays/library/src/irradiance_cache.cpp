@@ -0,0 +1,282 @@
+#include "irradiance_cache.hpp"
+#include "math.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr double Channel(const Colour& colour, std::size_t channel) noexcept
+{
+  return channel == 0 ? colour.x : (channel == 1 ? colour.y : colour.z);
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+constexpr double MinSpacingShare = 1.0 / 32;
+// Records serve normals within about 20 degrees of their own: sqrt(1 - cos(20 degrees))
+constexpr double MaxNormalDeviation = 0.2456;
+// Records further in front of the point than this share of their radius would see what it can't
+constexpr double InFrontTolerance = 0.05;
+// Gathered samples are kept within this multiple of their mean
+constexpr double OutlierLimit = 10;
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+// Cell coordinates get this many bits each in a key
+constexpr unsigned CoordinateBits = 21;
+constexpr std::int64_t CoordinateLimit = std::int64_t{1} << (CoordinateBits - 1);
+}
+
+IrradianceCache::IrradianceCache(double max_spacing, std::size_t capacity)
+    : MaxSpacing(max_spacing), MinSpacing(max_spacing * MinSpacingShare), InverseCellSize(1 / (2 * max_spacing)),
+      Records(capacity), Nodes(capacity * CellsPerRecord), Keys(std::bit_ceil(std::max(capacity * 2, MaxProbes))), Heads(Keys.size())
+{
+  Clear();
+}
+
+std::uint64_t IrradianceCache::KeyOf(const Point3& position) const noexcept
+{
+  auto coordinate = [&](double value) {
+    const auto cell = std::clamp(static_cast<std::int64_t>(std::floor(value * InverseCellSize)), -CoordinateLimit, CoordinateLimit - 1);
+    return static_cast<std::uint64_t>(cell + CoordinateLimit);
+  };
+  return (coordinate(position.z) << (2 * CoordinateBits)) | (coordinate(position.y) << CoordinateBits) | coordinate(position.x);
+}
+
+std::optional<std::size_t> IrradianceCache::FindSlot(std::uint64_t key) const noexcept
+{
+  constexpr std::uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+  const auto mask = Keys.size() - 1;
+  const auto start = (key * multiplier) >> 32U;
+  for (std::size_t probe = 0; probe < MaxProbes; ++probe) {
+    const auto slot = (start + probe) & mask;
+    const auto current = Keys[slot].load(std::memory_order_acquire);
+    if (current == key) {
+      return slot;
+    }
+    if (current == EmptyKey) {
+      return std::nullopt;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<std::size_t> IrradianceCache::ClaimSlot(std::uint64_t key) noexcept
+{
+  constexpr std::uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+  const auto mask = Keys.size() - 1;
+  const auto start = (key * multiplier) >> 32U;
+  for (std::size_t probe = 0; probe < MaxProbes; ++probe) {
+    const auto slot = (start + probe) & mask;
+    auto current = Keys[slot].load(std::memory_order_acquire);
+    if (current == EmptyKey && Keys[slot].compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+      return slot;
+    }
+    // Ours already, perhaps claimed by another thread just now
+    if (current == key) {
+      return slot;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<Colour> IrradianceCache::Lookup(const Point3& position, const Vec3& normal) const noexcept
+{
+  const auto slot = FindSlot(KeyOf(position));
+  if (!slot) {
+    return std::nullopt;
+  }
+  Colour sum{0, 0, 0};
+  double weights = 0;
+  for (auto node = Heads[*slot].load(std::memory_order_acquire); node != NoNode; node = Nodes[node].Next.load(std::memory_order_acquire)) {
+    const auto& record = Records[Nodes[node].Record];
+    const auto offset = position - record.Position;
+    const auto distance = offset.Length() / record.Radius;
+    const auto deviation = std::sqrt(std::fmax(0.0, 1 - normal.Dot(record.Normal))) / MaxNormalDeviation;
+    const auto error = std::fmax(distance, deviation);
+    if (error >= 1 || offset.Dot(normal + record.Normal) < -InFrontTolerance * 2 * record.Radius) {
+      continue;
+    }
+    // Falls to nothing at the edge of validity, so records coming and going leave no seams
+    const auto weight = 1 - error;
+    const auto rotation = record.Normal.Cross(normal);
+    const Colour extrapolated{
+        record.Irradiance.x + rotation.Dot(record.RotationGradient[0]) + offset.Dot(record.TranslationGradient[0]),
+        record.Irradiance.y + rotation.Dot(record.RotationGradient[1]) + offset.Dot(record.TranslationGradient[1]),
+        record.Irradiance.z + rotation.Dot(record.RotationGradient[2]) + offset.Dot(record.TranslationGradient[2]),
+    };
+    sum += extrapolated * weight;
+    weights += weight;
+  }
+  if (weights <= 0) {
+    return std::nullopt;
+  }
+  const auto irradiance = sum / weights;
+  return Colour{std::fmax(irradiance.x, 0.0), std::fmax(irradiance.y, 0.0), std::fmax(irradiance.z, 0.0)};
+}
+
+IrradianceCache::Record IrradianceCache::Gather(const Point3& position, const Vec3& normal, const IncomingRadiance& incoming, double min_radius) const
+{
+  // Cosine-weighted strata: equal steps in sin^2 theta and in phi, so every one of them carries
+  // the same share of the irradiance
+  const auto rows = static_cast<std::size_t>(std::max(ThetaStrata, 1));
+  const auto columns = std::max<std::size_t>(static_cast<std::size_t>(std::lround(Pi * static_cast<double>(rows))), 1);
+  const auto basis = OrthonormalBasis::FromW(normal);
+  auto sin_theta_at = [&](double row) { return std::sqrt(row / static_cast<double>(rows)); };
+  auto plane_direction = [&](double phi) { return (basis.U * std::cos(phi)) + (basis.V * std::sin(phi)); };
+  const auto phi_step = 2 * Pi / static_cast<double>(columns);
+
+  std::vector<Colour> radiance(rows * columns);
+  std::vector<double> distances(rows * columns);
+  std::vector<Vec3> directions(rows * columns);
+  double inverse_distances = 0;
+  for (std::size_t row = 0; row < rows; ++row) {
+    for (std::size_t column = 0; column < columns; ++column) {
+      const auto sin_theta = sin_theta_at(static_cast<double>(row) + RandomDouble());
+      const auto cos_theta = std::sqrt(std::fmax(0.0, 1 - (sin_theta * sin_theta)));
+      const auto phi = (static_cast<double>(column) + RandomDouble()) * phi_step;
+      const auto index = (row * columns) + column;
+      directions[index] = (plane_direction(phi) * sin_theta) + (basis.W * cos_theta);
+      distances[index] = Infinity;
+      radiance[index] = incoming({.Origin = position, .Direction = directions[index]}, cos_theta / Pi, distances[index]);
+      inverse_distances += 1 / distances[index];
+    }
+  }
+
+  // A rare bright path would be baked into the record and shared by every pixel near it, a
+  // blotch where path tracing has a single speck, so samples far above the rest are cut down
+  double limit = Infinity;
+  for (int pass = 0; pass < 2; ++pass) {
+    double mean = 0;
+    for (auto& sample : radiance) {
+      const auto luminance = Luminance(sample);
+      if (luminance > limit) {
+        sample = sample * (limit / luminance);
+      }
+      mean += std::fmin(luminance, limit) / static_cast<double>(radiance.size());
+    }
+    limit = OutlierLimit * mean;
+  }
+
+  Record record{.Position = position, .Normal = basis.W, .Irradiance = {0, 0, 0}};
+  const auto share = Pi / static_cast<double>(rows * columns);
+  for (std::size_t index = 0; index < radiance.size(); ++index) {
+    record.Irradiance += radiance[index] * share;
+    // Turning the normal towards the light brightens it in proportion to tan theta
+    const auto cos_theta = directions[index].Dot(basis.W);
+    if (cos_theta > 0) {
+      const auto turn = basis.W.Cross(directions[index]) * (share / cos_theta);
+      for (std::size_t channel = 0; channel < 3; ++channel) {
+        record.RotationGradient[channel] += turn * Channel(radiance[index], channel);
+      }
+    }
+  }
+
+  // Moving the point slides what each stratum sees across its borders, faster the closer it is
+  for (std::size_t row = 0; row < rows; ++row) {
+    const auto sin_low = sin_theta_at(static_cast<double>(row));
+    const auto sin_high = sin_theta_at(static_cast<double>(row + 1));
+    const auto cos_low_squared = 1 - (sin_low * sin_low);
+    for (std::size_t column = 0; column < columns; ++column) {
+      const auto index = (row * columns) + column;
+      // The border with the row nearer the normal
+      if (row > 0) {
+        const auto nearest = std::fmin(distances[index], distances[index - columns]);
+        if (nearest < Infinity) {
+          const auto across = plane_direction((static_cast<double>(column) + 0.5) * phi_step) * (phi_step * sin_low * cos_low_squared / nearest);
+          const auto difference = radiance[index] - radiance[index - columns];
+          for (std::size_t channel = 0; channel < 3; ++channel) {
+            record.TranslationGradient[channel] += across * Channel(difference, channel);
+          }
+        }
+      }
+      // The border with the previous column, wrapping around
+      const auto previous = (row * columns) + ((column + columns - 1) % columns);
+      const auto nearest = std::fmin(distances[index], distances[previous]);
+      if (nearest < Infinity) {
+        const auto border = static_cast<double>(column) * phi_step;
+        const auto along = ((basis.V * std::cos(border)) - (basis.U * std::sin(border))) * ((sin_high - sin_low) / nearest);
+        const auto difference = radiance[index] - radiance[previous];
+        for (std::size_t channel = 0; channel < 3; ++channel) {
+          record.TranslationGradient[channel] += along * Channel(difference, channel);
+        }
+      }
+    }
+  }
+
+  // Valid for a share of the harmonic mean distance to what the record saw, and no further than
+  // its gradient would take the irradiance to nothing
+  const auto mean_distance = static_cast<double>(rows * columns) / inverse_distances;
+  const auto smallest = std::clamp(min_radius, MinSpacing, MaxSpacing);
+  auto radius = std::clamp(Accuracy * mean_distance, smallest, MaxSpacing);
+  const auto gradient = (record.TranslationGradient[0] * Luminance({1, 0, 0})) + (record.TranslationGradient[1] * Luminance({0, 1, 0})) + (record.TranslationGradient[2] * Luminance({0, 0, 1}));
+  const auto gradient_length = gradient.Length();
+  if (gradient_length > 0) {
+    radius = std::clamp(Luminance(record.Irradiance) / gradient_length, smallest, radius);
+  }
+  record.Radius = radius;
+  return record;
+}
+
+bool IrradianceCache::Insert(const Record& record)
+{
+  const auto index = RecordCount.fetch_add(1, std::memory_order_relaxed);
+  if (index >= Records.size()) {
+    return false;
+  }
+  Records[index] = record;
+
+  // Into every cell the radius overlaps, made visible by the release on the cell's head
+  const auto radius = std::fmin(record.Radius, MaxSpacing);
+  auto cells = [&](double value) {
+    return std::array{std::floor((value - radius) * InverseCellSize), std::floor((value + radius) * InverseCellSize)};
+  };
+  const auto xs = cells(record.Position.x);
+  const auto ys = cells(record.Position.y);
+  const auto zs = cells(record.Position.z);
+  const auto cell_size = 1 / InverseCellSize;
+  for (auto z = zs[0]; z <= zs[1]; ++z) {
+    for (auto y = ys[0]; y <= ys[1]; ++y) {
+      for (auto x = xs[0]; x <= xs[1]; ++x) {
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+        const auto slot = ClaimSlot(KeyOf(Point3(x + 0.5, y + 0.5, z + 0.5) * cell_size));
+        if (!slot) {
+          continue;
+        }
+        const auto node = NodeCount.fetch_add(1, std::memory_order_relaxed);
+        if (node >= Nodes.size()) {
+          return false;
+        }
+        Nodes[node].Record = static_cast<std::uint32_t>(index);
+        auto head = Heads[*slot].load(std::memory_order_relaxed);
+        do {
+          Nodes[node].Next.store(head, std::memory_order_relaxed);
+        } while (!Heads[*slot].compare_exchange_weak(head, static_cast<std::uint32_t>(node), std::memory_order_release, std::memory_order_relaxed));
+      }
+    }
+  }
+  return true;
+}
+
+void IrradianceCache::Clear()
+{
+  for (auto& key : Keys) {
+    key.store(EmptyKey, std::memory_order_relaxed);
+  }
+  for (auto& head : Heads) {
+    head.store(NoNode, std::memory_order_relaxed);
+  }
+  RecordCount = 0;
+  NodeCount = 0;
+}
+
+std::size_t IrradianceCache::Size() const noexcept
+{
+  return std::min(RecordCount.load(std::memory_order_relaxed), Records.size());
+}
@@ -0,0 +1,382 @@
+#include "mapped_world.hpp"
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "material.hpp"
+#include "scene.hpp"
+#include "shapes.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SOFTRAYS_HAS_MMAP 1
+#endif
+
+using namespace softrays;
+
+namespace {
+constexpr std::array<char, 8> MappedMagic{'S', 'R', 'W', 'O', 'R', 'L', 'D', '\0'};
+constexpr std::uint32_t MappedFormatVersion = 2;
+// Sections start on a cache line, so a node never straddles two
+constexpr std::uint64_t SectionAlignment = 64;
+
+struct MappedHeader {
+  std::array<char, 8> Magic{};
+  std::uint32_t Version{};
+  std::uint32_t MaterialCount{};
+  std::uint64_t NodeCount{};
+  std::uint64_t SphereCount{};
+  std::uint64_t LightCount{};
+  std::uint64_t PlaneCount{};
+  std::uint64_t MaterialsOffset{};
+  std::uint64_t NodesOffset{};
+  std::uint64_t SpheresOffset{};
+  std::uint64_t LightsOffset{};
+  std::uint64_t PlanesOffset{};
+};
+
+// Fixed-size, so texture paths aren't stored and mapped worlds render untextured
+struct MappedMaterial {
+  std::uint32_t Type{};
+  std::uint32_t Reserved{};
+  Colour Albedo{};
+  double Parameter{};
+};
+
+constexpr std::uint64_t AlignUp(std::uint64_t offset) noexcept
+{
+  return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+}
+
+template <typename T>
+void WriteSection(std::ofstream& file, std::uint64_t offset, std::span<const T> values)
+{
+  file.seekp(static_cast<std::streamoff>(offset));
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+}
+
+// The section if it lies inside the file and is suitably aligned
+template <typename T>
+std::optional<std::span<const T>> SectionOf(std::span<const std::byte> file, std::uint64_t offset, std::uint64_t count)
+{
+  if (count == 0) {
+    return std::span<const T>{};
+  }
+  if (offset % alignof(T) != 0 || offset > file.size() || count > (file.size() - offset) / sizeof(T)) {
+    return std::nullopt;
+  }
+  // The mapping is page aligned and the offset suitably aligned, so this is a valid array of T
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return std::span<const T>(reinterpret_cast<const T*>(file.data() + offset), count);
+}
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : Bytes(std::exchange(other.Bytes, nullptr)), Size(std::exchange(other.Size, 0)), Handle(std::exchange(other.Handle, -1)),
+      Fallback(std::move(other.Fallback))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other) {
+    Close();
+    Bytes = std::exchange(other.Bytes, nullptr);
+    Size = std::exchange(other.Size, 0);
+    Handle = std::exchange(other.Handle, -1);
+    Fallback = std::move(other.Fallback);
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+void MappedFile::Close() noexcept
+{
+#if defined(SOFTRAYS_HAS_MMAP)
+  if (Handle >= 0) {
+    if (Size > 0) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+      ::munmap(const_cast<std::byte*>(Bytes), Size);
+    }
+    ::close(Handle);
+  }
+#endif
+  Bytes = nullptr;
+  Size = 0;
+  Handle = -1;
+}
+
+std::optional<MappedFile> MappedFile::Open(const std::string& path)
+{
+  MappedFile mapped;
+#if defined(SOFTRAYS_HAS_MMAP)
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+  mapped.Handle = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (mapped.Handle < 0) {
+    return std::nullopt;
+  }
+  struct stat status {};
+  if (::fstat(mapped.Handle, &status) != 0 || status.st_size <= 0) {
+    return std::nullopt;
+  }
+  mapped.Size = static_cast<std::size_t>(status.st_size);
+  void* address = ::mmap(nullptr, mapped.Size, PROT_READ, MAP_SHARED, mapped.Handle, 0);
+  if (address == MAP_FAILED) {
+    mapped.Size = 0;
+    return std::nullopt;
+  }
+  // Rays jump around the tree, so reading ahead would mostly bring in pages nobody asked for
+  ::madvise(address, mapped.Size, MADV_RANDOM);
+  mapped.Bytes = static_cast<const std::byte*>(address);
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return std::nullopt;
+  }
+  mapped.Fallback.resize(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (!file.read(reinterpret_cast<char*>(mapped.Fallback.data()), static_cast<std::streamsize>(mapped.Fallback.size()))) {
+    return std::nullopt;
+  }
+  mapped.Bytes = mapped.Fallback.data();
+  mapped.Size = mapped.Fallback.size();
+#endif
+  return mapped;
+}
+
+std::size_t MappedFile::ResidentBytes() const
+{
+#if defined(SOFTRAYS_HAS_MMAP)
+  if (Handle < 0 || Size == 0) {
+    return 0;
+  }
+  const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  std::vector<unsigned char> pages((Size + page_size - 1) / page_size);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+  if (::mincore(const_cast<std::byte*>(Bytes), Size, pages.data()) != 0) {
+    return 0;
+  }
+  const auto resident = std::ranges::count_if(pages, [](unsigned char page) { return (page & 1U) != 0; });
+  return std::min(static_cast<std::size_t>(resident) * page_size, Size);
+#else
+  return Size;
+#endif
+}
+
+void MappedFile::ReleaseResident() const
+{
+#if defined(SOFTRAYS_HAS_MMAP)
+  if (Handle < 0 || Size == 0) {
+    return;
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+  ::madvise(const_cast<std::byte*>(Bytes), Size, MADV_DONTNEED);
+  // Dropping our mapping isn't enough while the pages stay in the page cache. A freshly written
+  // file's pages are dirty and can't be dropped until they are on disk
+  ::fdatasync(Handle);
+  ::posix_fadvise(Handle, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
+bool softrays::WriteMappedScene(const std::string& path, const SceneDescription& scene)
+{
+  SOFTRAYS_TRACE_SCOPE("WriteMappedScene");
+  if (!scene.Quads.empty()) {
+    return false;
+  }
+  std::vector<MappedMaterial> materials;
+  materials.reserve(scene.Materials.size());
+  for (const auto& material : scene.Materials) {
+    materials.push_back({.Type = static_cast<std::uint32_t>(material.Type), .Reserved = 0, .Albedo = material.Albedo, .Parameter = material.Parameter});
+  }
+
+  std::vector<Aabb> bounds;
+  bounds.reserve(scene.Spheres.size());
+  for (const auto& sphere : scene.Spheres) {
+    if (sphere.Material >= materials.size()) {
+      return false;
+    }
+    const Vec3 extent{.x = sphere.Radius, .y = sphere.Radius, .z = sphere.Radius};
+    bounds.push_back(Aabb::FromPoints(sphere.Center - extent, sphere.Center + extent));
+  }
+  auto layout = BuildBvh(bounds);
+  bounds = {};
+
+  std::vector<MappedSphere> spheres;
+  std::vector<std::uint32_t> lights;
+  spheres.reserve(scene.Spheres.size());
+  for (const auto index : layout.Order) {
+    const auto& sphere = scene.Spheres[index];
+    if (scene.Materials[sphere.Material].Type == MaterialType::DiffuseLight) {
+      lights.push_back(static_cast<std::uint32_t>(spheres.size()));
+    }
+    spheres.push_back({.Center = sphere.Center, .Radius = sphere.Radius, .Material = sphere.Material, .Reserved = 0});
+  }
+  std::vector<MappedPlane> planes;
+  planes.reserve(scene.Planes.size());
+  for (const auto& plane : scene.Planes) {
+    if (plane.Material >= materials.size()) {
+      return false;
+    }
+    planes.push_back({.Point = plane.Point, .Normal = plane.Normal, .TextureSize = plane.TextureSize, .Material = plane.Material, .Reserved = 0});
+  }
+
+  MappedHeader header{
+      .Magic = MappedMagic,
+      .Version = MappedFormatVersion,
+      .MaterialCount = static_cast<std::uint32_t>(materials.size()),
+      .NodeCount = layout.Nodes.size(),
+      .SphereCount = spheres.size(),
+      .LightCount = lights.size(),
+      .PlaneCount = planes.size(),
+  };
+  header.MaterialsOffset = AlignUp(sizeof(MappedHeader));
+  header.NodesOffset = AlignUp(header.MaterialsOffset + (materials.size() * sizeof(MappedMaterial)));
+  header.SpheresOffset = AlignUp(header.NodesOffset + (layout.Nodes.size() * sizeof(BvhNode)));
+  header.LightsOffset = AlignUp(header.SpheresOffset + (spheres.size() * sizeof(MappedSphere)));
+  header.PlanesOffset = AlignUp(header.LightsOffset + (lights.size() * sizeof(std::uint32_t)));
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  WriteSection(file, 0, std::span<const MappedHeader>(&header, 1));
+  WriteSection(file, header.MaterialsOffset, std::span<const MappedMaterial>(materials));
+  WriteSection(file, header.NodesOffset, std::span<const BvhNode>(layout.Nodes));
+  WriteSection(file, header.SpheresOffset, std::span<const MappedSphere>(spheres));
+  WriteSection(file, header.LightsOffset, std::span<const std::uint32_t>(lights));
+  WriteSection(file, header.PlanesOffset, std::span<const MappedPlane>(planes));
+  return static_cast<bool>(file.flush());
+}
+
+std::unique_ptr<MappedWorld> MappedWorld::Open(const std::string& path)
+{
+  auto file = MappedFile::Open(path);
+  if (!file || file->Data().size() < sizeof(MappedHeader)) {
+    return nullptr;
+  }
+
+  MappedHeader header;
+  std::memcpy(&header, file->Data().data(), sizeof(header));
+  if (header.Magic != MappedMagic || header.Version != MappedFormatVersion) {
+    return nullptr;
+  }
+
+  const auto materials = SectionOf<MappedMaterial>(file->Data(), header.MaterialsOffset, header.MaterialCount);
+  const auto nodes = SectionOf<BvhNode>(file->Data(), header.NodesOffset, header.NodeCount);
+  const auto spheres = SectionOf<MappedSphere>(file->Data(), header.SpheresOffset, header.SphereCount);
+  const auto lights = SectionOf<std::uint32_t>(file->Data(), header.LightsOffset, header.LightCount);
+  const auto planes = SectionOf<MappedPlane>(file->Data(), header.PlanesOffset, header.PlaneCount);
+  if (!materials || !nodes || !spheres || !lights || !planes) {
+    return nullptr;
+  }
+
+  std::unique_ptr<MappedWorld> world(new MappedWorld());
+  for (const auto& material : *materials) {
+    if (material.Type > static_cast<std::uint32_t>(MaterialType::DiffuseLight)) {
+      return nullptr;
+    }
+    const MaterialDescription description{.Type = static_cast<MaterialType>(material.Type), .Albedo = material.Albedo, .Parameter = material.Parameter};
+    world->Materials.push_back(description.Build());
+    if (!world->Materials.back()) {
+      return nullptr;
+    }
+  }
+
+  auto light_list = std::make_shared<HittableList>();
+  for (const auto index : *lights) {
+    if (index >= spheres->size() || (*spheres)[index].Material >= world->Materials.size()) {
+      return nullptr;
+    }
+    const auto& sphere = (*spheres)[index];
+    auto material = world->Materials[sphere.Material];
+    light_list->Add(std::make_shared<Sphere>(sphere.Center, sphere.Radius, std::move(material)));
+  }
+
+  for (const auto& plane : *planes) {
+    if (plane.Material >= world->Materials.size()) {
+      return nullptr;
+    }
+    auto material = world->Materials[plane.Material];
+    world->Planes.push_back(std::make_shared<Plane>(plane.Point, plane.Normal, std::move(material), plane.TextureSize));
+  }
+
+  world->Nodes = *nodes;
+  world->Spheres = *spheres;
+  world->Lights = std::move(light_list);
+  // The spans point into the mapping, which doesn't move with the MappedFile
+  world->File = std::move(*file);
+  return world;
+}
+
+bool MappedWorld::Hit(const Ray& ray, Interval ray_time, HitData& hit) const
+{
+  const auto hit_plane = HitClosest(Planes, ray, ray_time, hit);
+  return TraverseBvh(Nodes, ray, ray_time, [&](std::uint32_t first, std::uint32_t count, Interval& time) {
+    const MappedSphere* closest = nullptr;
+    for (const auto& sphere : Spheres.subspan(first, count)) {
+      if (sphere.Material < Materials.size() && IntersectSphere(sphere.Center, sphere.Radius, ray, time, hit)) {
+        time.Max = hit.Time;
+        closest = &sphere;
+      }
+    }
+    if (closest == nullptr) {
+      return false;
+    }
+    hit.Material = Materials[closest->Material];
+    return true;
+  }) || hit_plane;
+}
+
+bool MappedWorld::Occluded(const Ray& ray, Interval ray_time) const
+{
+  return AnyOccludes(Planes, ray, ray_time) || TraverseBvh<true>(Nodes, ray, ray_time, [&](std::uint32_t first, std::uint32_t count, const Interval& time) {
+    return std::ranges::any_of(Spheres.subspan(first, count), [&](const MappedSphere& sphere) {
+      double root = 0;
+      return sphere.Material < Materials.size() && SphereRoot(sphere.Center, sphere.Radius, ray, time, root);
+    });
+  });
+}
+
+Aabb MappedWorld::BoundingBox() const
+{
+  if (!Planes.empty()) {
+    return Hittable::BoundingBox();
+  }
+  return Nodes.empty() ? Aabb{} : Nodes.front().Bounds;
+}
+
+std::optional<PreparedScene> softrays::PrepareMapped(const std::string& path, const SceneDescription& scene)
+{
+  if (!std::filesystem::exists(path) && !WriteMappedScene(path, scene)) {
+    return std::nullopt;
+  }
+  std::shared_ptr<const MappedWorld> world = MappedWorld::Open(path);
+  auto prepared = scene.PrepareBackground();
+  if (!world || !prepared) {
+    return std::nullopt;
+  }
+  prepared->Lights = world->GetLights();
+  prepared->World = std::move(world);
+  return prepared;
+}
@@ -0,0 +1,289 @@
+#include "net.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __has_include(<sys/socket.h>) && __has_include(<poll.h>)
+#define SOFTRAYS_HAS_SOCKETS 1
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace softrays;
+
+Socket::Socket(Socket&& other) noexcept : Handle(other.Handle)
+{
+  other.Handle = -1;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+  if (this != &other) {
+    Close();
+    Handle = other.Handle;
+    other.Handle = -1;
+  }
+  return *this;
+}
+
+Socket::~Socket()
+{
+  Close();
+}
+
+#if defined(SOFTRAYS_HAS_SOCKETS)
+
+namespace {
+struct Endpoint {
+  bool IsUnix = true;
+  std::string Path;  // or host for tcp
+  std::string Port;
+};
+
+Endpoint ParseEndpoint(const std::string& endpoint)
+{
+  constexpr std::string_view unix_prefix = "unix:";
+  constexpr std::string_view tcp_prefix = "tcp:";
+  if (endpoint.starts_with(tcp_prefix)) {
+    const auto rest = endpoint.substr(tcp_prefix.size());
+    const auto colon = rest.rfind(':');
+    if (colon == std::string::npos) {
+      return {.IsUnix = false, .Path = "localhost", .Port = rest};
+    }
+    return {.IsUnix = false, .Path = rest.substr(0, colon), .Port = rest.substr(colon + 1)};
+  }
+  if (endpoint.starts_with(unix_prefix)) {
+    return {.IsUnix = true, .Path = endpoint.substr(unix_prefix.size()), .Port = {}};
+  }
+  return {.IsUnix = true, .Path = endpoint, .Port = {}};
+}
+
+bool FillUnixAddress(const std::string& path, sockaddr_un& address)
+{
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(&address.sun_path[0], path.c_str(), path.size() + 1);
+  return true;
+}
+
+// Opens a socket for the endpoint and runs `bind_or_connect` on it, trying each tcp address in turn
+template <typename Callback>
+Socket OpenSocket(const Endpoint& endpoint, bool passive, Callback&& bind_or_connect)
+{
+  if (endpoint.IsUnix) {
+    sockaddr_un address{};
+    if (!FillUnixAddress(endpoint.Path, address)) {
+      return {};
+    }
+    Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (!socket.Valid() || !bind_or_connect(socket.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address))) {
+      return {};
+    }
+    return socket;
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  addrinfo* results = nullptr;
+  if (getaddrinfo(endpoint.Path.empty() ? nullptr : endpoint.Path.c_str(), endpoint.Port.c_str(), &hints, &results) != 0) {
+    return {};
+  }
+  Socket found;
+  for (auto* info = results; info != nullptr; info = info->ai_next) {
+    Socket socket(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+    if (socket.Valid() && bind_or_connect(socket.Get(), info->ai_addr, info->ai_addrlen)) {
+      found = std::move(socket);
+      break;
+    }
+  }
+  freeaddrinfo(results);
+  return found;
+}
+
+bool WriteAll(int handle, const void* data, std::size_t size)
+{
+  const auto* bytes = static_cast<const std::byte*>(data);
+  while (size > 0) {
+    const auto written = ::send(handle, bytes, size, MSG_NOSIGNAL);
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+bool ReadAll(int handle, void* data, std::size_t size)
+{
+  auto* bytes = static_cast<std::byte*>(data);
+  while (size > 0) {
+    const auto received = ::recv(handle, bytes, size, 0);
+    if (received <= 0) {
+      return false;
+    }
+    bytes += received;
+    size -= static_cast<std::size_t>(received);
+  }
+  return true;
+}
+
+struct MessageHeader {
+  std::uint32_t Type;
+  std::uint32_t Reserved;
+  std::uint64_t Length;
+};
+}
+
+void Socket::Close() noexcept
+{
+  if (Handle >= 0) {
+    ::close(Handle);
+    Handle = -1;
+  }
+}
+
+bool Socket::Send(std::uint32_t type, std::span<const std::byte> payload) const
+{
+  const MessageHeader header{.Type = type, .Reserved = 0, .Length = payload.size()};
+  return Valid() && WriteAll(Handle, &header, sizeof(header)) && WriteAll(Handle, payload.data(), payload.size());
+}
+
+std::optional<Message> Socket::Receive() const
+{
+  MessageHeader header{};
+  if (!Valid() || !ReadAll(Handle, &header, sizeof(header)) || header.Length > MaxMessageBytes) {
+    return std::nullopt;
+  }
+  Message message{.Type = header.Type, .Payload = {}};
+  message.Payload.resize(header.Length);
+  if (!ReadAll(Handle, message.Payload.data(), message.Payload.size())) {
+    return std::nullopt;
+  }
+  return message;
+}
+
+void Socket::SetReceiveTimeout(std::chrono::milliseconds timeout) const
+{
+  const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(timeout - seconds);
+  timeval value{};
+  value.tv_sec = seconds.count();
+  value.tv_usec = micros.count();
+  setsockopt(Handle, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value));
+}
+
+Socket softrays::ListenOn(const std::string& endpoint)
+{
+  const auto parsed = ParseEndpoint(endpoint);
+  if (parsed.IsUnix) {
+    // A stale socket file from an earlier run would make bind fail
+    ::unlink(parsed.Path.c_str());
+  }
+  return OpenSocket(parsed, true, [&](int handle, const sockaddr* address, socklen_t length) {
+    const int enable = 1;
+    if (!parsed.IsUnix) {
+      setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    }
+    constexpr int backlog = 64;
+    return ::bind(handle, address, length) == 0 && ::listen(handle, backlog) == 0;
+  });
+}
+
+Socket softrays::Accept(const Socket& listener)
+{
+  return Socket(::accept(listener.Get(), nullptr, nullptr));
+}
+
+Socket softrays::ConnectTo(const std::string& endpoint, std::chrono::milliseconds timeout)
+{
+  const auto parsed = ParseEndpoint(endpoint);
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  constexpr auto retry_interval = std::chrono::milliseconds(50);
+  while (true) {
+    auto socket = OpenSocket(parsed, false, [](int handle, const sockaddr* address, socklen_t length) {
+      return ::connect(handle, address, length) == 0;
+    });
+    if (socket.Valid() || std::chrono::steady_clock::now() >= deadline) {
+      return socket;
+    }
+    std::this_thread::sleep_for(retry_interval);
+  }
+}
+
+std::vector<std::size_t> softrays::WaitReadable(std::span<const int> sockets, std::chrono::milliseconds timeout)
+{
+  std::vector<pollfd> fds;
+  fds.reserve(sockets.size());
+  for (const auto handle : sockets) {
+    fds.push_back({.fd = handle, .events = POLLIN, .revents = 0});
+  }
+  std::vector<std::size_t> ready;
+  if (::poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) > 0) {
+    for (std::size_t i = 0; i < fds.size(); ++i) {
+      // Hang-ups and errors count as readable; the following Receive reports them
+      if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+        ready.push_back(i);
+      }
+    }
+  }
+  return ready;
+}
+
+#else
+
+void Socket::Close() noexcept
+{
+  Handle = -1;
+}
+
+bool Socket::Send([[maybe_unused]] std::uint32_t type, [[maybe_unused]] std::span<const std::byte> payload) const
+{
+  return false;
+}
+
+std::optional<Message> Socket::Receive() const
+{
+  return std::nullopt;
+}
+
+void Socket::SetReceiveTimeout([[maybe_unused]] std::chrono::milliseconds timeout) const { }
+
+Socket softrays::ListenOn([[maybe_unused]] const std::string& endpoint)
+{
+  return {};
+}
+
+Socket softrays::Accept([[maybe_unused]] const Socket& listener)
+{
+  return {};
+}
+
+Socket softrays::ConnectTo([[maybe_unused]] const std::string& endpoint, [[maybe_unused]] std::chrono::milliseconds timeout)
+{
+  return {};
+}
+
+std::vector<std::size_t> softrays::WaitReadable([[maybe_unused]] std::span<const int> sockets, [[maybe_unused]] std::chrono::milliseconds timeout)
+{
+  return {};
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include "path_guide.hpp"
+#include "math.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+// Every bin covers the same solid angle, 4 pi / Bins
+constexpr double BinDensity = PathGuide::Bins / (4 * Pi);
+
+// Cell coordinates get this many bits each in a key, which leaves three for the facing
+constexpr unsigned CoordinateBits = 20;
+constexpr std::int64_t CoordinateLimit = std::int64_t{1} << (CoordinateBits - 1);
+}
+
+std::size_t PathGuide::Region::BinOf(const Vec3& direction) noexcept
+{
+  // The inverse of Vec3::OnUnitSphere, whose u and v are uniform over equal areas
+  const auto z = direction.z / direction.Length();
+  const auto u = (1 - z) / 2;
+  auto v = std::atan2(direction.y, direction.x) / (2 * Pi);
+  if (v < 0) {
+    v += 1;
+  }
+  const auto row = std::min(static_cast<std::size_t>(std::fmax(0.0, u) * BinsCosTheta), BinsCosTheta - 1);
+  const auto column = std::min(static_cast<std::size_t>(v * BinsPhi), BinsPhi - 1);
+  return (row * BinsPhi) + column;
+}
+
+Vec3 PathGuide::Region::Sample(double u1, double u2) const noexcept
+{
+  // The bin from u1, then u1's place within the bin's share of the CDF as the height inside it
+  const auto upper = std::upper_bound(Cdf.begin() + 1, Cdf.end(), u1);
+  const auto bin = std::min(static_cast<std::size_t>(upper - Cdf.begin()) - 1, Bins - 1);
+  const auto low = static_cast<double>(Cdf[bin]);
+  const auto width = static_cast<double>(Cdf[bin + 1]) - low;
+  const auto within = width > 0 ? std::clamp((u1 - low) / width, 0.0, 1.0) : 0.5;
+  const auto row = bin / BinsPhi;
+  const auto column = bin % BinsPhi;
+  return Vec3::OnUnitSphere((static_cast<double>(row) + within) / BinsCosTheta, (static_cast<double>(column) + u2) / BinsPhi);
+}
+
+double PathGuide::Region::Pdf(const Vec3& direction) const noexcept
+{
+  const auto bin = BinOf(direction);
+  return static_cast<double>(Cdf[bin + 1] - Cdf[bin]) * BinDensity;
+}
+
+void PathGuide::Region::Record(const Vec3& direction, double value) noexcept
+{
+  if (std::isfinite(value) && value > 0) {
+    Learned[BinOf(direction)].fetch_add(static_cast<float>(value), std::memory_order_relaxed);
+  }
+  Records.fetch_add(1, std::memory_order_relaxed);
+}
+
+PathGuide::PathGuide(double cell_size, std::size_t capacity)
+    : InverseCellSize(1 / cell_size), Keys(std::bit_ceil(std::max(capacity, MaxProbes))), Regions(Keys.size())
+{
+  for (auto& key : Keys) {
+    key.store(EmptyKey, std::memory_order_relaxed);
+  }
+}
+
+std::uint64_t PathGuide::KeyOf(const Point3& position, const Vec3& normal) const noexcept
+{
+  auto coordinate = [&](double value) {
+    const auto cell = std::clamp(static_cast<std::int64_t>(std::floor(value * InverseCellSize)), -CoordinateLimit, CoordinateLimit - 1);
+    return static_cast<std::uint64_t>(cell + CoordinateLimit);
+  };
+  // The axis the surface faces most along, and which way
+  const auto ax = std::fabs(normal.x);
+  const auto ay = std::fabs(normal.y);
+  const auto az = std::fabs(normal.z);
+  std::uint64_t facing = 0;
+  if (ax >= ay && ax >= az) {
+    facing = normal.x < 0 ? 1 : 0;
+  } else if (ay >= az) {
+    facing = normal.y < 0 ? 3 : 2;
+  } else {
+    facing = normal.z < 0 ? 5 : 4;
+  }
+  return (facing << (3 * CoordinateBits)) | (coordinate(position.z) << (2 * CoordinateBits)) | (coordinate(position.y) << CoordinateBits) | coordinate(position.x);
+}
+
+PathGuide::Region* PathGuide::Locate(const Point3& position, const Vec3& normal) noexcept
+{
+  const auto key = KeyOf(position, normal);
+  // Fibonacci hashing spreads neighbouring cells over the table
+  constexpr std::uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+  const auto mask = Keys.size() - 1;
+  const auto start = (key * multiplier) >> 32U;
+  for (std::size_t probe = 0; probe < MaxProbes; ++probe) {
+    const auto slot = (start + probe) & mask;
+    auto current = Keys[slot].load(std::memory_order_acquire);
+    if (current == key) {
+      return &Regions[slot];
+    }
+    if (current == EmptyKey) {
+      if (Keys[slot].compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+        Claimed.fetch_add(1, std::memory_order_relaxed);
+        return &Regions[slot];
+      }
+      // Another thread claimed it first, perhaps for this same cell
+      if (current == key) {
+        return &Regions[slot];
+      }
+    }
+  }
+  return nullptr;
+}
+
+void PathGuide::Refresh()
+{
+  Trained = 0;
+  for (std::size_t slot = 0; slot < Keys.size(); ++slot) {
+    if (Keys[slot].load(std::memory_order_relaxed) == EmptyKey) {
+      continue;
+    }
+    auto& region = Regions[slot];
+    region.Trained = false;
+    if (region.RecordCount() < MinRecords) {
+      continue;
+    }
+    double total = 0;
+    for (const auto& bin : region.Learned) {
+      total += static_cast<double>(bin.load(std::memory_order_relaxed));
+    }
+    if (total <= 0) {
+      continue;
+    }
+    double running = 0;
+    region.Cdf.front() = 0;
+    for (std::size_t bin = 0; bin < Bins; ++bin) {
+      running += static_cast<double>(region.Learned[bin].load(std::memory_order_relaxed));
+      region.Cdf[bin + 1] = static_cast<float>(running / total);
+    }
+    region.Cdf.back() = 1;
+    region.Trained = true;
+    ++Trained;
+  }
+}
+
+void PathGuide::Clear()
+{
+  for (auto& key : Keys) {
+    key.store(EmptyKey, std::memory_order_relaxed);
+  }
+  for (auto& region : Regions) {
+    for (auto& bin : region.Learned) {
+      bin.store(0, std::memory_order_relaxed);
+    }
+    region.Records.store(0, std::memory_order_relaxed);
+    region.Trained = false;
+  }
+  Claimed = 0;
+  Trained = 0;
+}
+
+void GuidedPath::Finish(const Colour& radiance) const noexcept
+{
+  for (std::size_t index = 0; index < Count; ++index) {
+    const auto& vertex = Vertices[index];
+    // What the bounce sent back towards the camera, undoing the throughput that carried it there.
+    // That is already divided by the bounce's density, and includes the BSDF and cosine, so
+    // regions learn to sample their product with the incident light
+    const auto gathered = radiance - vertex.Radiance;
+    auto reflected = [](double light, double throughput) { return throughput > 0 ? light / throughput : 0.0; };
+    vertex.Region->Record(vertex.Direction, Luminance({reflected(gathered.x, vertex.Throughput.x), reflected(gathered.y, vertex.Throughput.y), reflected(gathered.z, vertex.Throughput.z)}));
+  }
+}
@@ -0,0 +1,371 @@
+#include "quality.hpp"
+#include "async_render.hpp"
+#include "image.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+BenchmarkCase SphereField()
+{
+  auto camera = RandomSphereCamera();
+  camera.Dimensions = {.Width = 320, .Height = 180};
+  return {.Name = "sphere-field", .Scene = RandomSphereScene(0), .Camera = camera};
+}
+
+BenchmarkCase GlassHeavy()
+{
+  SceneDescription scene;
+  const auto ground = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.5, 0.5, 0.5)});
+  const auto glass = scene.AddMaterial({.Type = MaterialType::Dielectric, .Parameter = 1.5});
+  const auto bubble = scene.AddMaterial({.Type = MaterialType::Dielectric, .Parameter = 1.0 / 1.5});
+  scene.Planes.push_back({.Point = Point3(0, 0, 0), .Normal = Vec3(0, 1, 0), .Material = ground});
+
+  // A grid of glass balls, every third one hollow, with small coloured ones between them to refract
+  for (int i = -2; i <= 2; ++i) {
+    for (int j = -2; j <= 2; ++j) {
+      const Point3 center(i, 0.4, j);
+      scene.Spheres.push_back({.Center = center, .Radius = 0.4, .Material = glass});
+      if ((i + j) % 3 == 0) {
+        scene.Spheres.push_back({.Center = center, .Radius = 0.34, .Material = bubble});
+      }
+      const auto colour = Colour(0.2 + (0.15 * (i + 2)), 0.3, 0.2 + (0.15 * (j + 2)));
+      const auto diffuse = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = colour});
+      scene.Spheres.push_back({.Center = Point3(i + 0.5, 0.12, j + 0.5), .Radius = 0.12, .Material = diffuse});
+    }
+  }
+
+  return {
+      .Name = "glass-heavy",
+      .Scene = scene,
+      .Camera = {
+          .Dimensions = {.Width = 240, .Height = 160},
+          .MaxDepth = 30,
+          .FieldOfView = 35,
+          .LookFrom = Point3(0, 3, 6),
+          .LookAt = Point3(0, 0.3, 0),
+          .FocusDistance = 6.7,
+      },
+  };
+}
+
+BenchmarkCase SmallLight()
+{
+  SceneDescription scene;
+  scene.SkyBackground = false;
+  const auto ground = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.6, 0.6, 0.6)});
+  const auto red = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.7, 0.2, 0.2)});
+  const auto white = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.8, 0.8, 0.8)});
+  const auto green = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.2, 0.7, 0.2)});
+  const auto light = scene.AddMaterial({.Type = MaterialType::DiffuseLight, .Albedo = Colour(300, 280, 260)});
+  scene.Planes.push_back({.Point = Point3(0, 0, 0), .Normal = Vec3(0, 1, 0), .Material = ground});
+  scene.Spheres.push_back({.Center = Point3(-2.2, 1, 0), .Radius = 1, .Material = red});
+  scene.Spheres.push_back({.Center = Point3(0, 1, 0), .Radius = 1, .Material = white});
+  scene.Spheres.push_back({.Center = Point3(2.2, 1, 0), .Radius = 1, .Material = green});
+  // Above the top of the frame, so only its light is seen
+  scene.Spheres.push_back({.Center = Point3(0, 4.5, 0), .Radius = 0.15, .Material = light});
+
+  return {
+      .Name = "small-light",
+      .Scene = scene,
+      .Camera = {
+          .Dimensions = {.Width = 240, .Height = 160},
+          .MaxDepth = 10,
+          .FieldOfView = 40,
+          .LookFrom = Point3(0, 2, 8),
+          .LookAt = Point3(0, 1, 0),
+          .FocusDistance = 8,
+      },
+  };
+}
+
+BenchmarkCase WindowRoom()
+{
+  SceneDescription scene;
+  scene.SkyBackground = false;
+  const auto grey = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.7, 0.7, 0.7)});
+  const auto light = scene.AddMaterial({.Type = MaterialType::DiffuseLight, .Albedo = Colour(20, 20, 20)});
+  scene.Quads.push_back({.Corner = Point3(-2, 0, -2), .Opposite = Point3(2, 0, 2), .Material = grey});  // Floor
+  scene.Quads.push_back({.Corner = Point3(-2, 3, -2), .Opposite = Point3(2, 3, 2), .Material = grey});  // Ceiling
+  scene.Quads.push_back({.Corner = Point3(-2, 0, -2), .Opposite = Point3(-2, 3, 2), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(-2, 0, -2), .Opposite = Point3(2, 3, -2), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(-2, 0, 2), .Opposite = Point3(2, 3, 2), .Material = grey});
+  // The wall at x = 2, around a window 0.6 wide and high
+  scene.Quads.push_back({.Corner = Point3(2, 0, -2), .Opposite = Point3(2, 1.2, 2), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(2, 1.8, -2), .Opposite = Point3(2, 3, 2), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(2, 1.2, -2), .Opposite = Point3(2, 1.8, -0.3), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(2, 1.2, 0.3), .Opposite = Point3(2, 1.8, 2), .Material = grey});
+  // Outside, a panel faces away from the window onto a wall (quads face +x), so light reaches the
+  // room only off that wall: light sampling can't find it, and diffuse bounces only by chance
+  scene.Quads.push_back({.Corner = Point3(4, 0.5, -1), .Opposite = Point3(4, 2.5, 1), .Material = light});
+  scene.Quads.push_back({.Corner = Point3(6, -2, -4), .Opposite = Point3(6, 5, 4), .Material = grey});
+
+  return {
+      .Name = "window-room",
+      .Scene = scene,
+      .Camera = {
+          .Dimensions = {.Width = 160, .Height = 120},
+          .MaxDepth = 6,
+          .FieldOfView = 80,
+          .LookFrom = Point3(1.5, 1.5, 1.5),
+          .LookAt = Point3(-2, 1, -1),
+      },
+  };
+}
+
+BenchmarkCase DiffuseRoom()
+{
+  SceneDescription scene;
+  scene.SkyBackground = false;
+  const auto grey = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.7, 0.7, 0.7)});
+  const auto red = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.7, 0.15, 0.1)});
+  const auto green = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.15, 0.6, 0.15)});
+  const auto light = scene.AddMaterial({.Type = MaterialType::DiffuseLight, .Albedo = Colour(15, 15, 15)});
+  scene.Quads.push_back({.Corner = Point3(-2, 0, -2), .Opposite = Point3(2, 0, 2), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(-2, 4, -2), .Opposite = Point3(2, 4, 2), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(-2, 0, -2), .Opposite = Point3(2, 4, -2), .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(-2, 0, -2), .Opposite = Point3(-2, 4, 2), .Material = red});
+  scene.Quads.push_back({.Corner = Point3(2, 0, -2), .Opposite = Point3(2, 4, 2), .Material = green});
+  scene.Spheres.push_back({.Center = Point3(-0.7, 0.8, -0.5), .Radius = 0.8, .Material = grey});
+  scene.Quads.push_back({.Corner = Point3(0.3, 0, 0.2), .Opposite = Point3(1.3, 1.6, 0.2), .Material = grey});
+  // A small sphere under the ceiling: most of what the camera sees is lit partly indirectly
+  scene.Spheres.push_back({.Center = Point3(0, 3.4, 0), .Radius = 0.3, .Material = light});
+
+  return {
+      .Name = "diffuse-room",
+      .Scene = scene,
+      .Camera = {
+          .Dimensions = {.Width = 160, .Height = 120},
+          .MaxDepth = 6,
+          .FieldOfView = 60,
+          .LookFrom = Point3(0, 2, 6),
+          .LookAt = Point3(0, 1.8, 0),
+      },
+  };
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+
+bool SameSize(const FloatImage& image, const FloatImage& reference)
+{
+  return image.Width == reference.Width && image.Height == reference.Height && !image.Pixels.empty();
+}
+
+// Sets up a tracer for `bench` at `samples_per_pixel`, on a world it shares with nobody else
+std::optional<PreparedScene> SetUp(RayTracer& raytracer, const BenchmarkCase& bench, int samples_per_pixel, const TracerSetup& setup)
+{
+  auto camera = bench.Camera;
+  camera.SamplesPerPixel = samples_per_pixel;
+  camera.Apply(raytracer);
+  auto prepared = bench.Scene.Prepare();
+  if (prepared) {
+    prepared->AttachTo(raytracer);
+    if (setup) {
+      setup(raytracer);
+    }
+  }
+  return prepared;
+}
+
+template <typename Pixels>
+FloatImage ToImage(const Dimension2d& dimensions, const Pixels& pixels, double scale)
+{
+  FloatImage image(dimensions.Width, dimensions.Height);
+  for (int y = 0; y < image.Height; ++y) {
+    for (int x = 0; x < image.Width; ++x) {
+      image.Set(x, y, pixels[(static_cast<std::size_t>(y) * static_cast<std::size_t>(image.Width)) + static_cast<std::size_t>(x)] * scale);
+    }
+  }
+  return image;
+}
+
+// An error metric as JSON, which has no infinities: one that couldn't be measured (images of
+// different sizes) is written as null
+struct JsonMetric {
+  double Value;
+};
+
+std::ostream& operator<<(std::ostream& out, JsonMetric metric)
+{
+  if (!std::isfinite(metric.Value)) {
+    return out << "null";
+  }
+  return out << metric.Value;
+}
+}
+
+BenchmarkCase softrays::MakeBenchmarkCase(BenchmarkScene scene)
+{
+  switch (scene) {
+  case BenchmarkScene::SphereField:
+    return SphereField();
+  case BenchmarkScene::GlassHeavy:
+    return GlassHeavy();
+  case BenchmarkScene::SmallLight:
+    return SmallLight();
+  case BenchmarkScene::WindowRoom:
+    return WindowRoom();
+  case BenchmarkScene::DiffuseRoom:
+    return DiffuseRoom();
+  }
+  return SphereField();
+}
+
+std::optional<BenchmarkScene> softrays::FindBenchmarkScene(const std::string& name)
+{
+  for (const auto scene : AllBenchmarkScenes) {
+    if (MakeBenchmarkCase(scene).Name == name) {
+      return scene;
+    }
+  }
+  return std::nullopt;
+}
+
+double softrays::RootMeanSquaredError(const FloatImage& image, const FloatImage& reference)
+{
+  if (!SameSize(image, reference)) {
+    return Infinity;
+  }
+  double sum = 0;
+  for (std::size_t i = 0; i < image.Pixels.size(); ++i) {
+    const auto difference = static_cast<double>(image.Pixels[i]) - static_cast<double>(reference.Pixels[i]);
+    sum += difference * difference;
+  }
+  return std::sqrt(sum / static_cast<double>(image.Pixels.size()));
+}
+
+double softrays::RelativeMeanSquaredError(const FloatImage& image, const FloatImage& reference, double epsilon)
+{
+  if (!SameSize(image, reference)) {
+    return Infinity;
+  }
+  double sum = 0;
+  for (std::size_t i = 0; i < image.Pixels.size(); ++i) {
+    const auto expected = static_cast<double>(reference.Pixels[i]);
+    const auto difference = static_cast<double>(image.Pixels[i]) - expected;
+    sum += (difference * difference) / ((expected * expected) + epsilon);
+  }
+  return sum / static_cast<double>(image.Pixels.size());
+}
+
+double softrays::MeanLuminance(const FloatImage& image)
+{
+  double sum = 0;
+  for (int y = 0; y < image.Height; ++y) {
+    for (int x = 0; x < image.Width; ++x) {
+      sum += Luminance(image.At(x, y));
+    }
+  }
+  return image.Pixels.empty() ? 0.0 : sum / (static_cast<double>(image.Width) * image.Height);
+}
+
+std::optional<FloatImage> softrays::RenderReference(const BenchmarkCase& bench, int samples_per_pixel, const TracerSetup& setup)
+{
+  RayTracer raytracer;
+  if (!SetUp(raytracer, bench, samples_per_pixel, setup)) {
+    return std::nullopt;
+  }
+  AsyncRenderer renderer;
+  renderer.Start(raytracer);
+  renderer.Wait();
+  return ToImage(bench.Camera.Dimensions, raytracer.GetPixelData(), 1.0);
+}
+
+std::optional<FloatImage> softrays::LoadOrRenderReference(const BenchmarkCase& bench, const std::string& path, int samples_per_pixel)
+{
+  if (auto stored = LoadPFM(path); stored && stored->Width == bench.Camera.Dimensions.Width && stored->Height == bench.Camera.Dimensions.Height) {
+    return stored;
+  }
+  auto reference = RenderReference(bench, samples_per_pixel);
+  if (!reference) {
+    return std::nullopt;
+  }
+  const auto parent = std::filesystem::path(path).parent_path();
+  if (std::error_code error; !parent.empty()) {
+    std::filesystem::create_directories(parent, error);
+  }
+  if (!SavePFM(path, *reference)) {
+    return std::nullopt;
+  }
+  return reference;
+}
+
+std::optional<QualityCurve> softrays::MeasureQuality(const BenchmarkCase& bench, const FloatImage& reference, std::span<const double> budgets, int samples_per_pass, const TracerSetup& setup)
+{
+  RayTracer raytracer;
+  if (!SetUp(raytracer, bench, samples_per_pass, setup)) {
+    return std::nullopt;
+  }
+
+  QualityCurve curve{.Scene = bench.Name, .Points = {}};
+  std::vector<Colour> sum(raytracer.GetPixelData().size());
+  double traced = 0;
+  int passes = 0;
+  std::size_t next_budget = 0;
+  while (next_budget < budgets.size()) {
+    const auto start = std::chrono::steady_clock::now();
+    raytracer.Render();
+    traced += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ++passes;
+
+    const auto& pixels = raytracer.GetPixelData();
+    for (std::size_t i = 0; i < sum.size(); ++i) {
+      sum[i] += pixels[i];
+    }
+    if (traced < budgets[next_budget]) {
+      continue;
+    }
+
+    // Scoring is left out of the time, so slow metrics don't penalise the renderer
+    const auto image = ToImage(bench.Camera.Dimensions, sum, 1.0 / passes);
+    const QualityPoint point{
+        .Seconds = traced,
+        .SamplesPerPixel = passes * samples_per_pass,
+        .Rmse = RootMeanSquaredError(image, reference),
+        .RelMse = RelativeMeanSquaredError(image, reference),
+    };
+    for (; next_budget < budgets.size() && traced >= budgets[next_budget]; ++next_budget) {
+      curve.Points.push_back(point);
+    }
+  }
+  return curve;
+}
+
+void softrays::WriteQualityCsv(std::ostream& out, std::span<const QualityCurve> curves)
+{
+  out << "scene,seconds,spp,rmse,relmse\n";
+  for (const auto& curve : curves) {
+    for (const auto& point : curve.Points) {
+      out << curve.Scene << ',' << point.Seconds << ',' << point.SamplesPerPixel << ',' << point.Rmse << ',' << point.RelMse << '\n';
+    }
+  }
+}
+
+void softrays::WriteQualityJson(std::ostream& out, std::span<const QualityCurve> curves)
+{
+  out << "[\n";
+  for (std::size_t c = 0; c < curves.size(); ++c) {
+    out << R"(  {"scene": ")" << curves[c].Scene << R"(", "points": [)";
+    for (std::size_t p = 0; p < curves[c].Points.size(); ++p) {
+      const auto& point = curves[c].Points[p];
+      out << (p == 0 ? "\n" : ",\n") << R"(    {"seconds": )" << point.Seconds << R"(, "spp": )" << point.SamplesPerPixel
+          << R"(, "rmse": )" << JsonMetric{point.Rmse} << R"(, "relmse": )" << JsonMetric{point.RelMse} << '}';
+    }
+    out << "\n  ]}" << (c + 1 < curves.size() ? ",\n" : "\n");
+  }
+  out << "]\n";
+}
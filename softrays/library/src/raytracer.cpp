@@ -1,12 +1,59 @@
 #include "raytracer.hpp"
+#include "framebuffer.hpp"
+#include "irradiance_cache.hpp"
 #include "material.hpp"  //NOLINT(unused-includes) for implementation of MaterialBase
 #include "math.hpp"
+#include "path_guide.hpp"
+#include "trace.hpp"
 #include "utility.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 using namespace softrays;
 
+namespace {
+// A diffuse bounce spreads the ray cone over the hemisphere, so textures seen after one are
+// filtered down to their coarsest levels
+constexpr auto DiffuseSpread = 1.0;
+
+// Least radius of irradiance cache records, in widths of the ray cone at the hit: one pixel for
+// camera rays
+constexpr auto RecordPixels = 1.0;
+
+template <typename Pixel>
+void ConvertToRGBA(const std::vector<Pixel>& pixels, int width, const TileRect& tile, std::vector<std::uint8_t>& rgba)
+{
+  static constexpr Interval intensity(0.000, 0.999);
+  static constexpr int byteMax{256};
+  for (int y = tile.FromY; y < tile.ToY; ++y) {
+    for (int x = tile.FromX; x < tile.ToX; ++x) {
+      const auto pixel_start = static_cast<std::size_t>(y * width) + static_cast<std::size_t>(x);
+      const auto rl_pixel_start = static_cast<std::size_t>((y * width) + x) * 4UL;
+      const auto colour = PixelCodec<Pixel>::Decode(pixels[pixel_start]);
+
+      // NOTE: are we supposed to do gamma-correction here? (it does look more like the book with it)
+      const auto r = LinearToGamma(colour.x);
+      const auto g = LinearToGamma(colour.y);
+      const auto b = LinearToGamma(colour.z);
+
+      rgba[rl_pixel_start] = static_cast<std::uint8_t>(intensity.Clamp(r) * byteMax);
+      rgba[rl_pixel_start + 1] = static_cast<std::uint8_t>(intensity.Clamp(g) * byteMax);
+      rgba[rl_pixel_start + 2] = static_cast<std::uint8_t>(intensity.Clamp(b) * byteMax);
+      rgba[rl_pixel_start + 3] = byteMax - 1;
+    }
+  }
+}
+}
+
 Point3 RayTracer::DefocusDiskSample() const noexcept
 {
   // Returns a random point in the camera defocus disk.
@@ -14,7 +61,8 @@ Point3 RayTracer::DefocusDiskSample() const noexcept
   return CameraPosition + (DefocusDisk_u * rand.x) + (DefocusDisk_v * rand.y);
 }
 
-Ray RayTracer::GetRayForPixel(int x, int y, const Vec3& pixel00_loc, const Vec3& pixel_delta_u, const Vec3& pixel_delta_v) const
+template <bool Defocus>
+Ray RayTracer::JitteredRay(int x, int y, const Vec3& pixel00_loc, const Vec3& pixel_delta_u, const Vec3& pixel_delta_v) const
 {
   // Construct a camera ray originating from the defocus disk and directed at a randomly
   // point around the pixel location x, y.
@@ -24,10 +72,20 @@ Ray RayTracer::GetRayForPixel(int x, int y, const Vec3& pixel00_loc, const Vec3&
       + (pixel_delta_u * (x + offset.x))
       + (pixel_delta_v * (y + offset.y));
 
-  const auto ray_origin = (DefocusAngle <= 0) ? CameraPosition : DefocusDiskSample();
+  Point3 ray_origin;
+  if constexpr (Defocus) {
+    ray_origin = DefocusDiskSample();
+  } else {
+    ray_origin = CameraPosition;
+  }
   const auto ray_direction = pixel_sample - ray_origin;
 
-  return Ray{.Origin = ray_origin, .Direction = ray_direction};
+  return Ray{.Origin = ray_origin, .Direction = ray_direction, .Cone = {.Width = 0, .Spread = PixelSpread}};
+}
+
+Ray RayTracer::GetRayForPixel(int x, int y, const Vec3& pixel00_loc, const Vec3& pixel_delta_u, const Vec3& pixel_delta_v) const
+{
+  return (DefocusAngle <= 0) ? JitteredRay<false>(x, y, pixel00_loc, pixel_delta_u, pixel_delta_v) : JitteredRay<true>(x, y, pixel00_loc, pixel_delta_u, pixel_delta_v);
 }
 
 void RayTracer::SetupCamera()
@@ -45,9 +103,53 @@ void RayTracer::Render()
   Render(0, 0, ViewportDimensions.Width, ViewportDimensions.Height);
 }
 
-void RayTracer::Render(int fromX, int fromY, int toX, int toY)
+void RayTracer::UpdateLights()
+{
+  if (SharedWorld) {
+    return;
+  }
+  Lights.Clear();
+  for (const auto& object : World.GetObjects()) {
+    if (object->IsEmissive()) {
+      Lights.Add(std::shared_ptr<Hittable>(object));
+    }
+  }
+}
+
+void RayTracer::ShareWorld(std::shared_ptr<const Hittable> world, std::shared_ptr<const HittableList> lights)
+{
+  SharedWorld = std::move(world);
+  SharedLights = SharedWorld ? std::move(lights) : nullptr;
+}
+
+const Hittable& RayTracer::ActiveWorld() const noexcept
+{
+  return SharedWorld ? *SharedWorld : World;
+}
+
+const HittableList& RayTracer::ActiveLights() const noexcept
+{
+  if (SharedWorld) {
+    static const HittableList no_lights;
+    return SharedLights ? *SharedLights : no_lights;
+  }
+  return Lights;
+}
+
+void RayTracer::BeginFrame()
 {
+  SOFTRAYS_TRACE_SCOPE("BeginFrame");
+  if (TemporalReuse) {
+    RollHistory();
+  } else {
+    CollectingHistory = false;
+    HasHistory = false;
+  }
   SetupCamera();
+  UpdateLights();
+  if (Guide) {
+    Guide->Refresh();
+  }
 
   const auto theta = DegreesToRadians(FieldOfView);
   const auto hyp = std::tan(theta / 2);
@@ -60,12 +162,13 @@ void RayTracer::Render(int fromX, int fromY, int toX, int toY)
   const Vec3 viewport_v = (-Camera_v) * viewport_height;  // Vector down viewport vertical edge
 
   // Calculate the horizontal and vertical delta vectors from pixel to pixel.
-  const auto pixel_delta_u = viewport_u / ViewportDimensions.Width;
-  const auto pixel_delta_v = viewport_v / ViewportDimensions.Height;
+  PixelDelta_u = viewport_u / ViewportDimensions.Width;
+  PixelDelta_v = viewport_v / ViewportDimensions.Height;
+  PixelSpread = PixelDelta_u.Length() / FocusDistance;
 
   // Calculate the location of the upper left pixel.
   const auto viewport_upper_left = CameraPosition - (Camera_w * FocusDistance) - (viewport_u / 2) - (viewport_v / 2);
-  const auto pixel00_loc = viewport_upper_left + ((pixel_delta_u + pixel_delta_v) * 0.5);
+  Pixel00Location = viewport_upper_left + ((PixelDelta_u + PixelDelta_v) * 0.5);
 
   // Calculate the camera defocus disk basis vectors.
   const auto defocus_radius = FocusDistance * std::tan(DegreesToRadians(DefocusAngle / 2));
@@ -73,46 +176,470 @@ void RayTracer::Render(int fromX, int fromY, int toX, int toY)
   DefocusDisk_u = Camera_u * defocus_radius;
   DefocusDisk_v = Camera_v * defocus_radius;
 
-  for (int y = fromY; y < toY; ++y) {
-    for (int x = fromX; x < toX; ++x) {
-      Colour pixel_colour{};
-      if (SamplesPerPixel > 1) {
-        for (int sample = 0; sample < SamplesPerPixel; ++sample) {
-          const auto ray = GetRayForPixel(x, y, pixel00_loc, pixel_delta_u, pixel_delta_v);
-          pixel_colour += RayColour(ray, MaxDepth, World);
+  SelectKernels();
+}
+
+void RayTracer::SelectKernels()
+{
+  // A single sample is one pinhole ray through the pixel centre, so only sampled pixels defocus
+  if (SamplesPerPixel <= 1) {
+    SelectKernels<false, false>();
+  } else if (DefocusAngle <= 0) {
+    SelectKernels<true, false>();
+  } else {
+    SelectKernels<true, true>();
+  }
+}
+
+template <bool MultiSample, bool Defocus>
+void RayTracer::SelectKernels()
+{
+  FrameTileKernel = CollectingHistory ? &RayTracer::TileKernel<MultiSample, Defocus, true> : &RayTracer::TileKernel<MultiSample, Defocus, false>;
+  FrameSpanKernel = &RayTracer::SpanKernel<MultiSample, Defocus>;
+}
+
+void RayTracer::Render(int fromX, int fromY, int toX, int toY)
+{
+  BeginFrame();
+  RenderTile({.FromX = fromX, .FromY = fromY, .ToX = toX, .ToY = toY});
+}
+
+template <bool MultiSample, bool Defocus>
+Colour RayTracer::TracePixel(int x, int y, const Hittable& world) const
+{
+  if constexpr (MultiSample) {
+    Colour pixel_colour{};
+    for (int sample = 0; sample < SamplesPerPixel; ++sample) {
+      const auto ray = JitteredRay<Defocus>(x, y, Pixel00Location, PixelDelta_u, PixelDelta_v);
+      pixel_colour += RayColour(ray, MaxDepth, world);
+    }
+    return pixel_colour * PixelSamplesScale;
+  } else {
+    const auto pixel_center = Pixel00Location + (PixelDelta_u * x) + (PixelDelta_v * y);
+    const auto ray_direction = pixel_center - CameraPosition;
+    const Ray ray{.Origin = CameraPosition, .Direction = ray_direction, .Cone = {.Width = 0, .Spread = PixelSpread}};
+    return RayColour(ray, MaxDepth, world) * PixelSamplesScale;
+  }
+}
+
+void RayTracer::RenderTile(const TileRect& tile)
+{
+  SOFTRAYS_TRACE_SCOPE("RenderTile", tile);
+  (this->*FrameTileKernel)(tile);
+}
+
+template <bool MultiSample, bool Defocus, bool History>
+void RayTracer::TileKernel(const TileRect& tile)
+{
+  PixelData.Visit([this, &tile](auto& pixels) { RenderTileInto<MultiSample, Defocus, History>(tile, pixels); });
+}
+
+template <bool MultiSample, bool Defocus, bool History, typename Pixel>
+void RayTracer::RenderTileInto(const TileRect& tile, std::vector<Pixel>& pixels)
+{
+  const auto& world = ActiveWorld();
+  for (int y = tile.FromY; y < tile.ToY; ++y) {
+    for (int x = tile.FromX; x < tile.ToX; ++x) {
+      const auto pixel_start = static_cast<std::size_t>(y * ViewportDimensions.Width) + static_cast<std::size_t>(x);
+      auto colour = TracePixel<MultiSample, Defocus>(x, y, world);
+      if constexpr (History) {
+        colour = AccumulateHistory(x, y, pixel_start, colour);
+      }
+      pixels[pixel_start] = PixelCodec<Pixel>::Encode(colour);
+    }
+  }
+}
+
+void RayTracer::RenderPreviewTile(const TileRect& tile, int step, bool refine)
+{
+  SOFTRAYS_TRACE_SCOPE("RenderPreviewTile", tile);
+  step = std::max(step, 1);
+  const auto& world = ActiveWorld();
+  const auto width = static_cast<std::size_t>(ViewportDimensions.Width);
+  PixelData.Visit([&](auto& pixels) {
+    using Pixel = typename std::remove_reference_t<decltype(pixels)>::value_type;
+    // Blocks are aligned to the frame, not the tile, so every pass agrees on where they are
+    for (int y = tile.FromY - (tile.FromY % step); y < tile.ToY; y += step) {
+      for (int x = tile.FromX - (tile.FromX % step); x < tile.ToX; x += step) {
+        if (refine && x % (2 * step) == 0 && y % (2 * step) == 0) {
+          continue;
+        }
+        const auto encoded = PixelCodec<Pixel>::Encode(PreviewColour(x, y, world));
+        for (int block_y = std::max(y, tile.FromY); block_y < std::min(y + step, tile.ToY); ++block_y) {
+          for (int block_x = std::max(x, tile.FromX); block_x < std::min(x + step, tile.ToX); ++block_x) {
+            const auto pixel = (static_cast<std::size_t>(block_y) * width) + static_cast<std::size_t>(block_x);
+            pixels[pixel] = encoded;
+            if (CollectingHistory) {
+              SampleCounts[pixel] = 0;
+            }
+          }
         }
-      } else {
-        const auto pixel_center = pixel00_loc + (pixel_delta_u * x) + (pixel_delta_v * y);
-        const auto ray_direction = pixel_center - CameraPosition;
-        const Ray ray(CameraPosition, ray_direction);
-        pixel_colour = RayColour(ray, MaxDepth, World);
       }
+    }
+  });
+}
+
+void RayTracer::CopyTile(const RayTracer& other, const TileRect& tile)
+{
+  const auto width = static_cast<std::ptrdiff_t>(ViewportDimensions.Width);
+  auto copy_rows = [&tile, width](const auto& from, auto& to) {
+    for (int y = tile.FromY; y < tile.ToY; ++y) {
+      const auto start = (y * width) + tile.FromX;
+      std::copy_n(from.begin() + start, tile.ToX - tile.FromX, to.begin() + start);
+    }
+  };
+  other.PixelData.Visit([&](const auto& from) {
+    PixelData.Visit([&](auto& to) {
+      if constexpr (std::is_same_v<std::remove_cvref_t<decltype(from)>, std::remove_cvref_t<decltype(to)>>) {
+        copy_rows(from, to);
+      }
+    });
+  });
+  if (CollectingHistory) {
+    copy_rows(other.Surfaces, Surfaces);
+    copy_rows(other.SampleCounts, SampleCounts);
+  }
+}
 
-      const auto pixel_start = static_cast<std::size_t>(y * ViewportDimensions.Width) + static_cast<std::size_t>(x);
-      PixelData[pixel_start] = pixel_colour * PixelSamplesScale;
+Colour RayTracer::PreviewColour(int x, int y, const Hittable& world) const
+{
+  constexpr auto minDist = 0.001;
+  const Ray ray{.Origin = CameraPosition, .Direction = Pixel00Location + (PixelDelta_u * x) + (PixelDelta_v * y) - CameraPosition};
+  HitData hit;
+  if (!world.Hit(ray, {.Min = minDist, .Max = Infinity}, hit)) {
+    return Background(ray);
+  }
+  // The normal faces the ray, so a headlight lights everything in view
+  const auto n_dot_l = -hit.Normal.Dot(ray.Direction.UnitVector());
+  return hit.Material->Emitted(ray, hit) + (hit.Material->PreviewAlbedo() * n_dot_l);
+}
+
+void RayTracer::RenderTile(const TileRect& tile, std::span<Colour> pixels) const
+{
+  SOFTRAYS_TRACE_SCOPE("RenderTile", tile);
+  (this->*FrameSpanKernel)(tile, pixels);
+}
+
+template <bool MultiSample, bool Defocus>
+void RayTracer::SpanKernel(const TileRect& tile, std::span<Colour> pixels) const
+{
+  const auto& world = ActiveWorld();
+  auto pixel = pixels.begin();
+  for (int y = tile.FromY; y < tile.ToY; ++y) {
+    for (int x = tile.FromX; x < tile.ToX; ++x) {
+      *pixel++ = TracePixel<MultiSample, Defocus>(x, y, world);
     }
   }
 }
 
-// TODO: we have a maxDepth, so we could remove this recursion in favour of a static array and loop
-Colour RayTracer::RayColour(const Ray& ray, int depth, const Hittable& world) const
+// Keeps the frame just rendered, and the camera it was seen from, as the history of the next one.
+// Pixels a cancelled frame never reached still hold older surfaces; those fail the surface test
+void RayTracer::RollHistory()
 {
-  // If we've exceeded the ray bounce limit, no more light is gathered.
-  if (depth <= 0) {
-    return Colour{0, 0, 0};
+  HasHistory = CollectingHistory;
+  if (HasHistory) {
+    HistoryColour = PixelData;
+    HistorySurfaces = Surfaces;
+    HistorySampleCounts = SampleCounts;
+    HistoryCamera = {
+        .Position = CameraPosition,
+        .Forward = -Camera_w,
+        .Pixel00Location = Pixel00Location,
+        .PixelDelta_u = PixelDelta_u,
+        .PixelDelta_v = PixelDelta_v,
+    };
+  }
+  Surfaces.resize(PixelData.size());
+  SampleCounts.resize(PixelData.size());
+  CollectingHistory = true;
+}
+
+Colour RayTracer::AccumulateHistory(int x, int y, std::size_t pixel, const Colour& colour)
+{
+  const auto surface = TraceSurface(x, y);
+  Surfaces[pixel] = surface;
+  SampleCounts[pixel] = SamplesPerPixel;
+  if (!HasHistory) {
+    return colour;
   }
 
+  const auto history = ReprojectHistory(surface);
+  if (!history) {
+    return colour;
+  }
+  const auto reused = std::min(history->Samples, static_cast<double>(MaxHistorySamples));
+  const auto total = reused + SamplesPerPixel;
+  SampleCounts[pixel] = total;
+  return ((history->Value * reused) + (colour * SamplesPerPixel)) / total;
+}
+
+RayTracer::PixelSurface RayTracer::TraceSurface(int x, int y) const
+{
+  constexpr auto minDist = 0.001;
+  const auto direction = Pixel00Location + (PixelDelta_u * x) + (PixelDelta_v * y) - CameraPosition;
   HitData hit;
+  if (ActiveWorld().Hit({.Origin = CameraPosition, .Direction = direction}, {.Min = minDist, .Max = Infinity}, hit)) {
+    return {.Position = hit.Location, .Normal = hit.Normal, .Hit = true};
+  }
+  return {.Position = direction.UnitVector(), .Normal = {}, .Hit = false};
+}
+
+// Projects `surface` into the previous frame and bilinearly filters the history pixels around it,
+// skipping those that saw a different surface (a disocclusion) or lie off screen. Partial coverage
+// lowers the sample count the result is trusted with.
+std::optional<RayTracer::HistorySample> RayTracer::ReprojectHistory(const PixelSurface& surface) const
+{
+  constexpr auto positionTolerance = 0.02;  // Relative to the distance from the camera
+  constexpr auto normalTolerance = 0.9;  // Cosine between the two normals
+  constexpr auto directionTolerance = 0.9999;  // Cosine between two escaped rays
+  constexpr auto minCoverage = 1e-3;
+
+  const auto& camera = HistoryCamera;
+  // Escaped rays are points at infinity, seen in the same direction from anywhere
+  const auto offset = surface.Hit ? surface.Position - camera.Position : surface.Position;
+  const auto depth = offset.Dot(camera.Forward);
+  if (depth <= 0) {
+    return std::nullopt;
+  }
+  const auto on_plane = camera.Position + (offset * ((camera.Pixel00Location - camera.Position).Dot(camera.Forward) / depth));
+  const auto relative = on_plane - camera.Pixel00Location;
+  const auto fx = relative.Dot(camera.PixelDelta_u) / camera.PixelDelta_u.LengthSquared();
+  const auto fy = relative.Dot(camera.PixelDelta_v) / camera.PixelDelta_v.LengthSquared();
+  const auto x0 = std::floor(fx);
+  const auto y0 = std::floor(fy);
+  const auto tx = fx - x0;
+  const auto ty = fy - y0;
+
+  const auto distance = (surface.Position - CameraPosition).Length();
+  auto same_surface = [&](const PixelSurface& other) {
+    if (other.Hit != surface.Hit) {
+      return false;
+    }
+    if (!surface.Hit) {
+      return other.Position.Dot(surface.Position) >= directionTolerance;
+    }
+    return (other.Position - surface.Position).Length() <= positionTolerance * distance && other.Normal.Dot(surface.Normal) >= normalTolerance;
+  };
+
+  Colour colour{};
+  double samples = 0;
+  double coverage = 0;
+  for (int dy = 0; dy < 2; ++dy) {
+    for (int dx = 0; dx < 2; ++dx) {
+      const auto hx = x0 + dx;
+      const auto hy = y0 + dy;
+      if (hx < 0 || hy < 0 || hx >= ViewportDimensions.Width || hy >= ViewportDimensions.Height) {
+        continue;
+      }
+      const auto index = (static_cast<std::size_t>(hy) * static_cast<std::size_t>(ViewportDimensions.Width)) + static_cast<std::size_t>(hx);
+      if (HistorySampleCounts[index] <= 0 || !same_surface(HistorySurfaces[index])) {
+        continue;
+      }
+      const auto weight = (dx == 0 ? 1 - tx : tx) * (dy == 0 ? 1 - ty : ty);
+      colour += HistoryColour[index] * weight;
+      samples += HistorySampleCounts[index] * weight;
+      coverage += weight;
+    }
+  }
+  if (coverage < minCoverage) {
+    return std::nullopt;
+  }
+  return HistorySample{.Value = colour / coverage, .Samples = samples};
+}
+
+Colour RayTracer::RayColour(const Ray& ray, int depth, const Hittable& world, double ray_pdf, double* distance) const
+{
   constexpr auto minDist = 0.001;
-  if (world.Hit(ray, {.Min = minDist, .Max = Infinity}, hit)) {
+  const auto& lights = ActiveLights();
+  const bool sample_lights = SampleLights && (!lights.Empty() || Environment);
+  auto* const guide = Guide.get();
+  GuidedPath path;
+  // Camera paths only; the paths gathering a record trace on as usual
+  const bool use_cache = Irradiance && ray_pdf <= 0;
+
+  Colour radiance{0, 0, 0};
+  Colour throughput{1, 1, 1};
+  Ray current = ray;
+  // Density the previous bounce sampled `current` with, 0 for camera rays and specular bounces
+  double scatter_pdf = ray_pdf;
+
+  for (int bounce = 0; bounce < depth; ++bounce) {
+    HitData hit;
+    const bool found = world.Hit(current, {.Min = minDist, .Max = Infinity}, hit);
+    if (distance != nullptr && bounce == 0) {
+      *distance = found ? hit.Time * current.Direction.Length() : Infinity;
+    }
+    if (!found) {
+      // Only an environment map takes part in light sampling, the plain backgrounds don't
+      const auto weight = (sample_lights && Environment && scatter_pdf > 0)
+          ? PowerHeuristic(scatter_pdf, LightPdf(current.Origin, current.Direction))
+          : 1.0;
+      radiance += throughput * Background(current) * weight;
+      break;
+    }
+
+    if (hit.Material->IsEmissive()) {
+      // Lights found by BSDF sampling are weighted against the chance light sampling found them too
+      const auto weight = (sample_lights && scatter_pdf > 0)
+          ? PowerHeuristic(scatter_pdf, LightPdf(current.Origin, current.Direction))
+          : 1.0;
+      radiance += throughput * hit.Material->Emitted(current, hit) * weight;
+    }
+
     Ray scattered{};
     Colour attenuation{};
-    if (hit.Material->Scatter(ray, hit, attenuation, scattered)) {
-      return RayColour(scattered, depth - 1, World) * attenuation;
+    if (!hit.Material->Scatter(current, hit, attenuation, scattered)) {
+      break;
+    }
+
+    scatter_pdf = hit.Material->ScatterPdf(current, hit, scattered.Direction);
+    if (use_cache && scatter_pdf > 0) {
+      const auto min_radius = current.Cone.WidthAt(hit.Time * current.Direction.Length()) * RecordPixels;
+      if (min_radius < Irradiance->GetMaxSpacing()) {
+        // Direct light as ever, then the cache's indirect light in place of the rest of the path
+        if (bounce + 1 < depth) {
+          if (sample_lights) {
+            radiance += throughput * SampleDirectLight(current, hit, world, nullptr);
+          }
+          radiance += throughput * hit.Material->Evaluate(current, hit, hit.Normal) * CachedIrradiance(hit, min_radius, depth - bounce - 1, world);
+        }
+        break;
+      }
+    }
+    // Only bounces with a density can be guided; the others are all but deterministic anyway
+    auto* const region = (guide != nullptr && scatter_pdf > 0) ? guide->Locate(hit.Location, hit.Normal) : nullptr;
+    const auto* const sampled_region = (region != nullptr && region->IsTrained()) ? region : nullptr;
+    // Light reached through a shadow ray belongs to the next bounce, so stop when there isn't one
+    if (sample_lights && scatter_pdf > 0 && bounce + 1 < depth) {
+      radiance += throughput * SampleDirectLight(current, hit, world, sampled_region);
+    }
+
+    if (sampled_region != nullptr) {
+      // One sample from the mixture of guide and BSDF, weighted by the mixture's density
+      if (RandomDouble() < guide->Fraction) {
+        scattered.Direction = sampled_region->RandomDirection();
+      }
+      scatter_pdf = BounceDensity(current, hit, scattered.Direction, sampled_region);
+      attenuation = scatter_pdf > 0 ? hit.Material->Evaluate(current, hit, scattered.Direction) / scatter_pdf : Colour{};
+      if (attenuation.NearZero()) {
+        break;
+      }
     }
+
+    if (region != nullptr) {
+      path.Add(region, scattered.Direction, throughput, radiance);
+    }
+    throughput = throughput * attenuation;
+    // The cone carries on from its width at the hit
+    scattered.Cone = {
+        .Width = current.Cone.WidthAt(hit.Time * current.Direction.Length()),
+        .Spread = current.Cone.Spread + (scatter_pdf > 0 ? DiffuseSpread : 0.0),
+    };
+    current = scattered;
+  }
+  if (guide != nullptr) {
+    path.Finish(radiance);
+  }
+  return radiance;
+}
+
+Colour RayTracer::CachedIrradiance(const HitData& hit, double min_radius, int depth, const Hittable& world) const
+{
+  if (const auto cached = Irradiance->Lookup(hit.Location, hit.Normal)) {
+    return *cached;
+  }
+  // Each of the record's rays is a path of its own, lights it finds weighted as a bounce's would be
+  const auto record = Irradiance->Gather(hit.Location, hit.Normal, [&](const Ray& ray, double pdf, double& distance) {
+    const Ray bounce{.Origin = ray.Origin, .Direction = ray.Direction, .Cone = {.Width = 0, .Spread = DiffuseSpread}};
+    return RayColour(bounce, depth, world, pdf, &distance);
+  }, min_radius);
+  // A full cache still shades this point, it just can't share the record
+  Irradiance->Insert(record);
+  return record.Irradiance;
+}
+
+double RayTracer::EnvironmentSelectProbability() const noexcept
+{
+  if (!Environment) {
+    return 0.0;
+  }
+  constexpr auto shared = 0.5;
+  return ActiveLights().Empty() ? 1.0 : shared;
+}
+
+Vec3 RayTracer::SampleLightDirection(const Point3& origin) const
+{
+  if (RandomDouble() < EnvironmentSelectProbability()) {
+    return Environment->RandomDirection();
+  }
+  return ActiveLights().RandomDirection(origin);
+}
+
+double RayTracer::LightPdf(const Point3& origin, const Vec3& direction) const
+{
+  const auto env_probability = EnvironmentSelectProbability();
+  double pdf = 0.0;
+  if (env_probability > 0) {
+    pdf += env_probability * Environment->Pdf(direction);
+  }
+  if (env_probability < 1) {
+    pdf += (1 - env_probability) * ActiveLights().PdfValue(origin, direction);
+  }
+  return pdf;
+}
+
+double RayTracer::BounceDensity(const Ray& ray, const HitData& hit, const Vec3& direction, const PathGuide::Region* region) const
+{
+  const auto bsdf_pdf = hit.Material->ScatterPdf(ray, hit, direction);
+  if (region == nullptr) {
+    return bsdf_pdf;
+  }
+  return (Guide->Fraction * region->Pdf(direction)) + ((1 - Guide->Fraction) * bsdf_pdf);
+}
+
+Colour RayTracer::SampleDirectLight(const Ray& ray, const HitData& hit, const Hittable& world, const PathGuide::Region* region) const
+{
+  constexpr auto minDist = 0.001;
+  const Ray shadow_ray{.Origin = hit.Location, .Direction = SampleLightDirection(hit.Location)};
+  const auto light_pdf = LightPdf(shadow_ray.Origin, shadow_ray.Direction);
+  if (light_pdf <= 0) {
+    return {0, 0, 0};
+  }
+
+  const auto bsdf = hit.Material->Evaluate(ray, hit, shadow_ray.Direction);
+  if (bsdf.NearZero()) {
     return {0, 0, 0};
   }
 
+  // Whatever the shadow ray sees is the light sample: an emitter, the environment, or an occluder
+  Colour incoming{0, 0, 0};
+  HitData light_hit;
+  if (world.Hit(shadow_ray, {.Min = minDist, .Max = Infinity}, light_hit)) {
+    if (!light_hit.Material->IsEmissive()) {
+      return {0, 0, 0};
+    }
+    incoming = light_hit.Material->Emitted(shadow_ray, light_hit);
+  } else if (Environment) {
+    incoming = Environment->Lookup(shadow_ray.Direction);
+  } else {
+    return {0, 0, 0};
+  }
+
+  // Weighted against the way the bounce would have found the light, guided or not
+  const auto bsdf_pdf = BounceDensity(ray, hit, shadow_ray.Direction, region);
+  const auto weight = PowerHeuristic(light_pdf, bsdf_pdf);
+  return bsdf * incoming * (weight / light_pdf);
+}
+
+Colour RayTracer::Background(const Ray& ray) const
+{
+  if (Environment) {
+    return Environment->Lookup(ray.Direction);
+  }
+  if (!SkyBackground) {
+    return BackgroundColour;
+  }
+
   Vec3 unit_direction = ray.Direction.UnitVector();
   // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
   auto a = 0.5 * (unit_direction.y + 1.0);
@@ -120,38 +647,37 @@ Colour RayTracer::RayColour(const Ray& ray, int depth, const Hittable& world) co
   return (Colour{1.0, 1.0, 1.0} * (1.0 - a)) + (Colour{0.5, 0.7, 1.0} * a);
 }
 
-void RayTracer::ResizeViewport(const Dimension2d& dim)
+void RayTracer::ResizeViewport(const Dimension2d& dim, bool framebuffer)
 {
   ViewportDimensions = dim;
-  PixelData.clear();
-  PixelData.resize(static_cast<std::size_t>(ViewportDimensions.Width) * static_cast<std::size_t>(ViewportDimensions.Height), {0.0, 0.0, 0.0});
+  CollectingHistory = false;
+  HasHistory = false;
+  const auto pixels = framebuffer ? static_cast<std::size_t>(ViewportDimensions.Width) * static_cast<std::size_t>(ViewportDimensions.Height) : 0;
+  PixelData.Resize(pixels);
   rlPixels.clear();
-  rlPixels.resize(static_cast<std::size_t>(ViewportDimensions.Width) * static_cast<std::size_t>(ViewportDimensions.Height) * 4UL, 0);
+  rlPixels.resize(pixels * 4UL, 0);
+  if (!framebuffer) {
+    PixelData.ShrinkToFit();
+    rlPixels.shrink_to_fit();
+  }
 }
 
-const std::vector<std::uint8_t>& RayTracer::GetRGBAData()
+void RayTracer::SetPixelFormat(PixelFormat format)
 {
-  static constexpr Interval intensity(0.000, 0.999);
-  static constexpr int byteMax{256};
-  for (int y = 0; y < ViewportDimensions.Height; ++y) {
-    for (int x = 0; x < ViewportDimensions.Width; ++x) {
-      const auto pixel_start = static_cast<std::size_t>(y * ViewportDimensions.Width) + static_cast<std::size_t>(x);
-      const auto rl_pixel_start = static_cast<std::size_t>((y * ViewportDimensions.Width) + x) * 4UL;
-
-      // NOTE: are we supposed to do gamma-correction here? (it does look more like the book with it)
-      // const auto r = (pixels[pixel_start].x);
-      // const auto g = (pixels[pixel_start].y);
-      // const auto b = (pixels[pixel_start].z);
+  CollectingHistory = false;
+  HasHistory = false;
+  PixelData.SetFormat(format);
+  HistoryColour = Framebuffer(format);
+}
 
-      const auto r = LinearToGamma(PixelData[pixel_start].x);
-      const auto g = LinearToGamma(PixelData[pixel_start].y);
-      const auto b = LinearToGamma(PixelData[pixel_start].z);
+const std::vector<std::uint8_t>& RayTracer::GetRGBAData()
+{
+  return GetRGBAData({.FromX = 0, .FromY = 0, .ToX = ViewportDimensions.Width, .ToY = ViewportDimensions.Height});
+}
 
-      rlPixels[rl_pixel_start] = static_cast<std::uint8_t>(intensity.Clamp(r) * byteMax);
-      rlPixels[rl_pixel_start + 1] = static_cast<std::uint8_t>(intensity.Clamp(g) * byteMax);
-      rlPixels[rl_pixel_start + 2] = static_cast<std::uint8_t>(intensity.Clamp(b) * byteMax);
-      rlPixels[rl_pixel_start + 3] = byteMax - 1;
-    }
-  }
+const std::vector<std::uint8_t>& RayTracer::GetRGBAData(const TileRect& tile)
+{
+  SOFTRAYS_TRACE_SCOPE("GetRGBAData", tile);
+  PixelData.Visit([this, &tile](const auto& pixels) { ConvertToRGBA(pixels, ViewportDimensions.Width, tile, rlPixels); });
   return rlPixels;
 }
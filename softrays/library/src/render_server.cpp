@@ -0,0 +1,255 @@
+#include "render_server.hpp"
+#include "image.hpp"
+#include "net.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "serialize.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr auto PollInterval = std::chrono::milliseconds(50);
+constexpr std::size_t ReplyFieldBytes = 64;  // A reply's fields besides its image, and then some
+
+using Clock = std::chrono::steady_clock;
+
+std::uint32_t ToWire(ServerMessage type) noexcept
+{
+  return static_cast<std::uint32_t>(type);
+}
+
+double SecondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+}
+
+void RenderJob::Serialize(ByteWriter& writer) const
+{
+  writer.Write<std::int32_t>(Priority);
+  Scene.Serialize(writer);
+  Camera.Serialize(writer);
+  writer.WriteString(Output);
+}
+
+std::optional<RenderJob> RenderJob::Deserialize(ByteReader& reader)
+{
+  const auto priority = reader.Read<std::int32_t>();
+  auto scene = SceneDescription::Deserialize(reader);
+  const auto camera = CameraSettings::Deserialize(reader);
+  auto output = reader.ReadString();
+  if (!reader.Ok() || !scene || !camera) {
+    return std::nullopt;
+  }
+  return RenderJob{.Priority = priority, .Scene = std::move(*scene), .Camera = *camera, .Output = std::move(output)};
+}
+
+void RenderReply::Serialize(ByteWriter& writer) const
+{
+  writer.Write(Ok);
+  writer.Write(CacheHit);
+  writer.Write(SetupSeconds);
+  writer.Write(TraceSeconds);
+  writer.Write<std::int32_t>(Image.Width);
+  writer.Write<std::int32_t>(Image.Height);
+  writer.WriteSpan(std::span<const float>(Image.Pixels));
+}
+
+std::optional<RenderReply> RenderReply::Deserialize(ByteReader& reader)
+{
+  RenderReply reply;
+  reply.Ok = reader.ReadBool();
+  reply.CacheHit = reader.ReadBool();
+  reply.SetupSeconds = reader.Read<double>();
+  reply.TraceSeconds = reader.Read<double>();
+  reply.Image.Width = reader.Read<std::int32_t>();
+  reply.Image.Height = reader.Read<std::int32_t>();
+  reply.Image.Pixels = reader.ReadVector<float>();
+  const auto expected = static_cast<std::size_t>(std::max(reply.Image.Width, 0)) * static_cast<std::size_t>(std::max(reply.Image.Height, 0)) * 3;
+  if (!reader.Ok() || reply.Image.Pixels.size() != expected) {
+    return std::nullopt;
+  }
+  return reply;
+}
+
+// One job in flight: its tracer is set up once, then its tiles are traced concurrently
+struct RenderServer::ActiveJob {
+  RenderJob Request;
+  std::shared_ptr<Client> Requester;
+  std::shared_ptr<const PreparedScene> Scene;
+  RayTracer Raytracer;
+  std::vector<TileRect> Tiles;
+  std::atomic<std::size_t> TilesLeft;
+  Clock::time_point TraceStart;
+  RenderReply Reply;
+};
+
+RenderServer::RenderServer(RenderServerOptions options)
+    : Options(options), Cache(options.CacheCapacity), Pool(options.Threads)
+{
+}
+
+bool RenderServer::Listen(const std::string& endpoint)
+{
+  Listener = ListenOn(endpoint);
+  return Listener.Valid();
+}
+
+void RenderServer::Serve()
+{
+  if (!Listener.Valid()) {
+    return;
+  }
+
+  while (!Stopping) {
+    std::vector<int> handles{Listener.Get()};
+    for (const auto& client : Clients) {
+      handles.push_back(client->Connection.Get());
+    }
+
+    for (const auto index : WaitReadable(handles, PollInterval)) {
+      if (index == 0) {
+        AcceptClient();
+      } else {
+        HandleMessage(Clients[index - 1]);
+      }
+    }
+    // Jobs still running for a client that left keep their own reference, and their reply is dropped
+    std::erase_if(Clients, [](const auto& client) { return client->Dead; });
+  }
+}
+
+void RenderServer::AcceptClient()
+{
+  auto client = std::make_shared<Client>();
+  client->Connection = Accept(Listener);
+  if (!client->Connection.Valid()) {
+    return;
+  }
+  constexpr auto stalled_message = std::chrono::seconds(10);
+  client->Connection.SetReceiveTimeout(stalled_message);
+  Clients.push_back(std::move(client));
+}
+
+void RenderServer::HandleMessage(const std::shared_ptr<Client>& client)
+{
+  const auto message = client->Connection.Receive();
+  if (!message) {
+    client->Dead = true;
+    return;
+  }
+
+  ByteReader reader(message->Payload);
+  auto request = RenderJob::Deserialize(reader);
+  if (message->Type != ToWire(ServerMessage::Job) || !request) {
+    SendReply(*client, {});
+    return;
+  }
+  // An image too big for one message could never be sent back
+  const auto& dimensions = request->Camera.Dimensions;
+  const auto image_bytes = static_cast<std::size_t>(dimensions.Width) * static_cast<std::size_t>(dimensions.Height) * 3 * sizeof(float);
+  if (request->Output.empty() && image_bytes > MaxMessageBytes - ReplyFieldBytes) {
+    SendReply(*client, {});
+    return;
+  }
+
+  auto job = std::make_shared<ActiveJob>();
+  job->Request = std::move(*request);
+  job->Requester = client;
+  const auto priority = job->Request.Priority;
+  Pool.Submit([this, job] { StartJob(job); }, priority);
+}
+
+void RenderServer::StartJob(const std::shared_ptr<ActiveJob>& job)
+{
+  const auto setup_start = Clock::now();
+  const auto cached = Cache.Acquire(job->Request.Scene);
+  job->Scene = cached.Scene;
+  job->Reply.CacheHit = cached.Hit;
+  const auto& camera = job->Request.Camera;
+  if (!job->Scene || camera.Dimensions.Width <= 0 || camera.Dimensions.Height <= 0) {
+    job->Reply.SetupSeconds = SecondsSince(setup_start);
+    SendReply(*job->Requester, job->Reply);
+    return;
+  }
+
+  camera.Apply(job->Raytracer);
+  job->Scene->AttachTo(job->Raytracer);
+  job->Raytracer.BeginFrame();
+  job->Tiles = SplitIntoTiles(camera.Dimensions, Options.TileSize);
+  job->TilesLeft = job->Tiles.size();
+  job->Reply.SetupSeconds = SecondsSince(setup_start);
+
+  job->TraceStart = Clock::now();
+  for (std::size_t i = 0; i < job->Tiles.size(); ++i) {
+    Pool.Submit(
+        [this, job, i] {
+          job->Raytracer.RenderTile(job->Tiles[i]);
+          if (--job->TilesLeft == 0) {
+            FinishJob(job);
+          }
+        },
+        job->Request.Priority);
+  }
+}
+
+void RenderServer::FinishJob(const std::shared_ptr<ActiveJob>& job)
+{
+  job->Reply.TraceSeconds = SecondsSince(job->TraceStart);
+
+  const auto& dimensions = job->Request.Camera.Dimensions;
+  FloatImage image(dimensions.Width, dimensions.Height);
+  const auto& pixels = job->Raytracer.GetPixelData();
+  for (int y = 0; y < image.Height; ++y) {
+    for (int x = 0; x < image.Width; ++x) {
+      image.Set(x, y, pixels[(static_cast<std::size_t>(y) * static_cast<std::size_t>(image.Width)) + static_cast<std::size_t>(x)]);
+    }
+  }
+
+  if (job->Request.Output.empty()) {
+    job->Reply.Image = std::move(image);
+    job->Reply.Ok = true;
+  } else {
+    job->Reply.Ok = SaveImage(job->Request.Output, image);
+  }
+  SendReply(*job->Requester, job->Reply);
+}
+
+void RenderServer::SendReply(Client& client, const RenderReply& reply)
+{
+  ByteWriter writer;
+  reply.Serialize(writer);
+  const std::scoped_lock lock(client.SendMutex);
+  [[maybe_unused]] const auto sent = client.Connection.Send(ToWire(ServerMessage::Reply), writer.Data());
+}
+
+std::optional<RenderReply> softrays::SubmitRenderJob(const std::string& endpoint, const RenderJob& job, std::chrono::milliseconds connect_timeout)
+{
+  const auto connection = ConnectTo(endpoint, connect_timeout);
+  ByteWriter writer;
+  job.Serialize(writer);
+  if (!connection.Send(ToWire(ServerMessage::Job), writer.Data())) {
+    return std::nullopt;
+  }
+
+  const auto message = connection.Receive();
+  if (!message || message->Type != ToWire(ServerMessage::Reply)) {
+    return std::nullopt;
+  }
+  ByteReader reader(message->Payload);
+  return RenderReply::Deserialize(reader);
+}
@@ -0,0 +1,156 @@
+#include "sampling.hpp"
+#include "math.hpp"
+#include "random.hpp"
+
+#include <cstddef>
+#include <numbers>
+#include <span>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+using namespace softrays;
+
+namespace {
+#if defined(__SSE2__) || defined(_M_X64)
+struct SinCos2 {
+  __m128d Sin;
+  __m128d Cos;
+};
+
+__m128d Select(__m128d mask, __m128d if_set, __m128d if_clear) noexcept
+{
+  return _mm_or_pd(_mm_and_pd(mask, if_set), _mm_andnot_pd(mask, if_clear));
+}
+
+// Lanes whose 32-bit quadrant in `quadrants` has any of `bits` set, as a double-wide mask
+__m128d QuadrantMask(__m128i quadrants, int bits) noexcept
+{
+  return _mm_cmpneq_pd(_mm_cvtepi32_pd(_mm_and_si128(quadrants, _mm_set1_epi32(bits))), _mm_setzero_pd());
+}
+
+// SinCosTurns on two lanes, step for step
+SinCos2 SinCosTurnsSimd(__m128d turns) noexcept
+{
+  constexpr auto roundingOffset = 2.5;
+  const auto quarters = _mm_mul_pd(turns, _mm_set1_pd(4));
+  const auto quadrant = _mm_sub_epi32(_mm_cvttpd_epi32(_mm_add_pd(quarters, _mm_set1_pd(roundingOffset))), _mm_set1_epi32(2));
+  const auto x = _mm_mul_pd(_mm_sub_pd(quarters, _mm_cvtepi32_pd(quadrant)), _mm_set1_pd(std::numbers::pi / 2));
+  const auto x2 = _mm_mul_pd(x, x);
+  auto sin = _mm_set1_pd(SinTerms.back());
+  for (auto term = SinTerms.size() - 1; term-- > 0;) {
+    sin = _mm_add_pd(_mm_mul_pd(sin, x2), _mm_set1_pd(SinTerms[term]));
+  }
+  sin = _mm_mul_pd(sin, x);
+  auto cos = _mm_set1_pd(CosTerms.back());
+  for (auto term = CosTerms.size() - 1; term-- > 0;) {
+    cos = _mm_add_pd(_mm_mul_pd(cos, x2), _mm_set1_pd(CosTerms[term]));
+  }
+  const auto swap = QuadrantMask(quadrant, 1);
+  const auto sign_bit = _mm_set1_pd(-0.0);
+  const auto sin_sign = _mm_and_pd(QuadrantMask(quadrant, 2), sign_bit);
+  const auto cos_sign = _mm_and_pd(QuadrantMask(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), 2), sign_bit);
+  return {.Sin = _mm_xor_pd(Select(swap, cos, sin), sin_sign), .Cos = _mm_xor_pd(Select(swap, sin, cos), cos_sign)};
+}
+#endif
+
+// Two uniform numbers per sample, drawn in the order the scalar samplers draw them
+void DrawPairs(std::size_t count, std::vector<double>& u, std::vector<double>& v)
+{
+  u.resize(count);
+  v.resize(count);
+  auto& generator = RandomGenerator();
+  auto& distribution = RandomDistribution();
+  for (std::size_t index = 0; index < count; ++index) {
+    u[index] = distribution(generator);
+    v[index] = distribution(generator);
+  }
+}
+}
+
+void SampleBatch::Resize(std::size_t count)
+{
+  X.resize(count);
+  Y.resize(count);
+  Z.resize(count);
+}
+
+void softrays::RandomDoubles(std::span<double> values)
+{
+  auto& generator = RandomGenerator();
+  auto& distribution = RandomDistribution();
+  for (auto& value : values) {
+    value = distribution(generator);
+  }
+}
+
+void softrays::MapToUnitSphere(std::span<const double> u, std::span<const double> v, SampleBatch& samples)
+{
+  samples.Resize(u.size());
+  std::size_t index = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+  const auto one = _mm_set1_pd(1);
+  for (; index + 2 <= u.size(); index += 2) {
+    const auto z = _mm_sub_pd(one, _mm_mul_pd(_mm_set1_pd(2), _mm_loadu_pd(&u[index])));
+    const auto radius = _mm_sqrt_pd(_mm_max_pd(_mm_setzero_pd(), _mm_sub_pd(one, _mm_mul_pd(z, z))));
+    const auto [sin, cos] = SinCosTurnsSimd(_mm_loadu_pd(&v[index]));
+    _mm_storeu_pd(&samples.X[index], _mm_mul_pd(radius, cos));
+    _mm_storeu_pd(&samples.Y[index], _mm_mul_pd(radius, sin));
+    _mm_storeu_pd(&samples.Z[index], z);
+  }
+#endif
+  for (; index < u.size(); ++index) {
+    const auto sample = Vec3::OnUnitSphere(u[index], v[index]);
+    samples.X[index] = sample.x;
+    samples.Y[index] = sample.y;
+    samples.Z[index] = sample.z;
+  }
+}
+
+void softrays::MapToUnitDisk(std::span<const double> u, std::span<const double> v, SampleBatch& samples)
+{
+  samples.Resize(u.size());
+  std::size_t index = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+  const auto one = _mm_set1_pd(1);
+  const auto two = _mm_set1_pd(2);
+  const auto sign_bit = _mm_set1_pd(-0.0);
+  const auto eighth = _mm_set1_pd(0.125);  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  for (; index + 2 <= u.size(); index += 2) {
+    const auto a = _mm_sub_pd(_mm_mul_pd(two, _mm_loadu_pd(&u[index])), one);
+    const auto b = _mm_sub_pd(_mm_mul_pd(two, _mm_loadu_pd(&v[index])), one);
+    const auto horizontal = _mm_cmpgt_pd(_mm_andnot_pd(sign_bit, a), _mm_andnot_pd(sign_bit, b));
+    const auto radius = Select(horizontal, a, b);
+    const auto divisor = Select(_mm_cmpgt_pd(_mm_andnot_pd(sign_bit, radius), _mm_setzero_pd()), radius, one);
+    const auto turns = Select(horizontal, _mm_mul_pd(eighth, _mm_div_pd(b, divisor)), _mm_sub_pd(_mm_mul_pd(two, eighth), _mm_mul_pd(eighth, _mm_div_pd(a, divisor))));
+    const auto [sin, cos] = SinCosTurnsSimd(turns);
+    _mm_storeu_pd(&samples.X[index], _mm_mul_pd(radius, cos));
+    _mm_storeu_pd(&samples.Y[index], _mm_mul_pd(radius, sin));
+    _mm_storeu_pd(&samples.Z[index], _mm_setzero_pd());
+  }
+#endif
+  for (; index < u.size(); ++index) {
+    const auto sample = Vec3::InUnitDisk(u[index], v[index]);
+    samples.X[index] = sample.x;
+    samples.Y[index] = sample.y;
+    samples.Z[index] = sample.z;
+  }
+}
+
+void softrays::SampleUnitSphere(std::size_t count, SampleBatch& samples)
+{
+  thread_local std::vector<double> u;
+  thread_local std::vector<double> v;
+  DrawPairs(count, u, v);
+  MapToUnitSphere(u, v, samples);
+}
+
+void softrays::SampleUnitDisk(std::size_t count, SampleBatch& samples)
+{
+  thread_local std::vector<double> u;
+  thread_local std::vector<double> v;
+  DrawPairs(count, u, v);
+  MapToUnitDisk(u, v, samples);
+}
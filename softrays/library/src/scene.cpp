@@ -0,0 +1,407 @@
+#include "scene.hpp"
+#include "arena.hpp"
+#include "environment.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "serialize.hpp"
+#include "shapes.hpp"
+#include "texture.hpp"
+#include "trace.hpp"
+#include "wide_bvh.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr std::uint32_t SceneFormatVersion = 3;
+
+void WriteVec3(ByteWriter& writer, const Vec3& vec)
+{
+  writer.Write(vec.x);
+  writer.Write(vec.y);
+  writer.Write(vec.z);
+}
+
+Vec3 ReadVec3(ByteReader& reader)
+{
+  const auto x = reader.Read<double>();
+  const auto y = reader.Read<double>();
+  const auto z = reader.Read<double>();
+  return {.x = x, .y = y, .z = z};
+}
+
+// Allocates like SceneArena, but on the heap
+struct HeapFactory {
+  template <typename T, typename... Args>
+  [[nodiscard]] std::shared_ptr<T> Make(Args&&... args) const
+  {
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+};
+
+template <typename Factory>
+std::shared_ptr<MaterialBase> BuildMaterial(const MaterialDescription& material, Factory& factory)
+{
+  std::shared_ptr<const TiledTexture> texture;
+  if (!material.TexturePath.empty() && (material.Type == MaterialType::Lambertian || material.Type == MaterialType::Metal)) {
+    texture = TiledTexture::OpenImage(material.TexturePath);
+    if (!texture) {
+      return nullptr;
+    }
+  }
+
+  switch (material.Type) {
+  case MaterialType::Lambertian:
+    return factory.template Make<Lambertian>(material.Albedo, std::move(texture));
+  case MaterialType::Metal:
+    return factory.template Make<Metal>(material.Albedo, material.Parameter, std::move(texture));
+  case MaterialType::Dielectric:
+    return factory.template Make<Dielectric>(material.Parameter);
+  case MaterialType::DiffuseLight:
+    return factory.template Make<DiffuseLight>(material.Albedo);
+  }
+  return nullptr;
+}
+
+// The scene's objects, or nothing if one refers to a material that doesn't exist or can't be built
+template <typename Factory>
+std::optional<std::vector<std::shared_ptr<Hittable>>> BuildObjects(const SceneDescription& scene, Factory& factory)
+{
+  const auto material_count = scene.Materials.size();
+  const auto missing = [material_count](const auto& object) { return object.Material >= material_count; };
+  if (std::ranges::any_of(scene.Spheres, missing) || std::ranges::any_of(scene.Planes, missing) || std::ranges::any_of(scene.Quads, missing)) {
+    return std::nullopt;
+  }
+
+  std::vector<std::shared_ptr<MaterialBase>> materials;
+  materials.reserve(scene.Materials.size());
+  for (const auto& material : scene.Materials) {
+    materials.push_back(BuildMaterial(material, factory));
+    if (!materials.back()) {
+      return std::nullopt;
+    }
+  }
+
+  std::vector<std::shared_ptr<Hittable>> objects;
+  objects.reserve(scene.Spheres.size() + scene.Planes.size() + scene.Quads.size());
+  for (const auto& sphere : scene.Spheres) {
+    auto material = materials[sphere.Material];
+    objects.push_back(factory.template Make<Sphere>(sphere.Center, sphere.Radius, std::move(material)));
+  }
+  for (const auto& plane : scene.Planes) {
+    auto material = materials[plane.Material];
+    objects.push_back(factory.template Make<Plane>(plane.Point, plane.Normal, std::move(material), plane.TextureSize));
+  }
+  for (const auto& quad : scene.Quads) {
+    auto material = materials[quad.Material];
+    objects.push_back(factory.template Make<Quad>(quad.Corner, quad.Opposite, std::move(material)));
+  }
+  return objects;
+}
+
+template <typename Factory>
+bool PopulateWith(const SceneDescription& scene, RayTracer& raytracer, Factory& factory)
+{
+  auto objects = BuildObjects(scene, factory);
+  std::optional<EnvironmentMap> environment;
+  if (!scene.EnvironmentPath.empty()) {
+    environment = EnvironmentMap::Load(scene.EnvironmentPath, scene.EnvironmentIntensity);
+  }
+  if (!objects || (!scene.EnvironmentPath.empty() && !environment)) {
+    return false;
+  }
+
+  auto& world = raytracer.GetWorld();
+  world.Reserve(world.Size() + objects->size());
+  for (auto& object : *objects) {
+    world.Add(std::move(object));
+  }
+  raytracer.SkyBackground = scene.SkyBackground;
+  raytracer.BackgroundColour = scene.BackgroundColour;
+  raytracer.Environment.reset();
+  if (environment) {
+    raytracer.Environment = std::make_shared<const EnvironmentMap>(std::move(*environment));
+  }
+  return true;
+}
+}
+
+std::shared_ptr<MaterialBase> MaterialDescription::Build() const
+{
+  HeapFactory factory;
+  return BuildMaterial(*this, factory);
+}
+
+std::shared_ptr<MaterialBase> MaterialDescription::Build(SceneArena& arena) const
+{
+  return BuildMaterial(*this, arena);
+}
+
+// Fields are written one by one (rather than as raw structs) so padding never reaches the hash
+void SceneDescription::Serialize(ByteWriter& writer) const
+{
+  writer.Write(SceneFormatVersion);
+  writer.Write<std::uint64_t>(Materials.size());
+  for (const auto& material : Materials) {
+    writer.Write(material.Type);
+    WriteVec3(writer, material.Albedo);
+    writer.Write(material.Parameter);
+    writer.WriteString(material.TexturePath);
+  }
+  writer.Write<std::uint64_t>(Spheres.size());
+  for (const auto& sphere : Spheres) {
+    WriteVec3(writer, sphere.Center);
+    writer.Write(sphere.Radius);
+    writer.Write(sphere.Material);
+  }
+  writer.Write<std::uint64_t>(Planes.size());
+  for (const auto& plane : Planes) {
+    WriteVec3(writer, plane.Point);
+    WriteVec3(writer, plane.Normal);
+    writer.Write(plane.Material);
+    writer.Write(plane.TextureSize);
+  }
+  writer.Write<std::uint64_t>(Quads.size());
+  for (const auto& quad : Quads) {
+    WriteVec3(writer, quad.Corner);
+    WriteVec3(writer, quad.Opposite);
+    writer.Write(quad.Material);
+  }
+  writer.Write(SkyBackground);
+  WriteVec3(writer, BackgroundColour);
+  writer.WriteString(EnvironmentPath);
+  writer.Write(EnvironmentIntensity);
+}
+
+std::optional<SceneDescription> SceneDescription::Deserialize(ByteReader& reader)
+{
+  if (reader.Read<std::uint32_t>() != SceneFormatVersion) {
+    return std::nullopt;
+  }
+
+  SceneDescription scene;
+  const auto material_count = reader.Read<std::uint64_t>();
+  for (std::uint64_t i = 0; i < material_count && reader.Ok(); ++i) {
+    MaterialDescription material;
+    material.Type = reader.ReadEnum(MaterialType::DiffuseLight);
+    material.Albedo = ReadVec3(reader);
+    material.Parameter = reader.Read<double>();
+    material.TexturePath = reader.ReadString();
+    scene.Materials.push_back(std::move(material));
+  }
+  const auto sphere_count = reader.Read<std::uint64_t>();
+  for (std::uint64_t i = 0; i < sphere_count && reader.Ok(); ++i) {
+    SphereDescription sphere;
+    sphere.Center = ReadVec3(reader);
+    sphere.Radius = reader.Read<double>();
+    sphere.Material = reader.Read<std::uint32_t>();
+    scene.Spheres.push_back(sphere);
+  }
+  const auto plane_count = reader.Read<std::uint64_t>();
+  for (std::uint64_t i = 0; i < plane_count && reader.Ok(); ++i) {
+    PlaneDescription plane;
+    plane.Point = ReadVec3(reader);
+    plane.Normal = ReadVec3(reader);
+    plane.Material = reader.Read<std::uint32_t>();
+    plane.TextureSize = reader.Read<double>();
+    scene.Planes.push_back(plane);
+  }
+  const auto quad_count = reader.Read<std::uint64_t>();
+  for (std::uint64_t i = 0; i < quad_count && reader.Ok(); ++i) {
+    QuadDescription quad;
+    quad.Corner = ReadVec3(reader);
+    quad.Opposite = ReadVec3(reader);
+    quad.Material = reader.Read<std::uint32_t>();
+    scene.Quads.push_back(quad);
+  }
+  scene.SkyBackground = reader.ReadBool();
+  scene.BackgroundColour = ReadVec3(reader);
+  scene.EnvironmentPath = reader.ReadString();
+  scene.EnvironmentIntensity = reader.Read<double>();
+
+  if (!reader.Ok()) {
+    return std::nullopt;
+  }
+  return scene;
+}
+
+std::uint64_t SceneDescription::Hash() const
+{
+  ByteWriter writer;
+  Serialize(writer);
+  return HashBytes(writer.Data());
+}
+
+bool SceneDescription::Populate(RayTracer& raytracer) const
+{
+  HeapFactory factory;
+  return PopulateWith(*this, raytracer, factory);
+}
+
+bool SceneDescription::Populate(RayTracer& raytracer, SceneArena& arena) const
+{
+  return PopulateWith(*this, raytracer, arena);
+}
+
+std::optional<PreparedScene> SceneDescription::Prepare() const
+{
+  SOFTRAYS_TRACE_SCOPE("PrepareScene");
+  HeapFactory factory;
+  const auto objects = BuildObjects(*this, factory);
+  if (!objects) {
+    return std::nullopt;
+  }
+
+  auto prepared = PrepareBackground();
+  if (!prepared) {
+    return std::nullopt;
+  }
+
+  auto lights = std::make_shared<HittableList>();
+  for (const auto& object : *objects) {
+    if (object->IsEmissive()) {
+      lights->Add(std::shared_ptr<Hittable>(object));
+    }
+  }
+  prepared->World = std::make_shared<const WideBvh>(*objects);
+  prepared->Lights = std::move(lights);
+  return prepared;
+}
+
+std::optional<PreparedScene> SceneDescription::PrepareBackground() const
+{
+  PreparedScene prepared{
+      .World = nullptr,
+      .Lights = nullptr,
+      .Environment = nullptr,
+      .SkyBackground = SkyBackground,
+      .BackgroundColour = BackgroundColour,
+  };
+  if (!EnvironmentPath.empty()) {
+    auto environment = EnvironmentMap::Load(EnvironmentPath, EnvironmentIntensity);
+    if (!environment) {
+      return std::nullopt;
+    }
+    prepared.Environment = std::make_shared<const EnvironmentMap>(std::move(*environment));
+  }
+  return prepared;
+}
+
+void PreparedScene::AttachTo(RayTracer& raytracer) const
+{
+  raytracer.ShareWorld(World, Lights);
+  raytracer.SkyBackground = SkyBackground;
+  raytracer.BackgroundColour = BackgroundColour;
+  raytracer.Environment = Environment;
+}
+
+void CameraSettings::Serialize(ByteWriter& writer) const
+{
+  writer.Write(Dimensions.Width);
+  writer.Write(Dimensions.Height);
+  writer.Write(SamplesPerPixel);
+  writer.Write(MaxDepth);
+  writer.Write(FieldOfView);
+  WriteVec3(writer, LookFrom);
+  WriteVec3(writer, LookAt);
+  WriteVec3(writer, CameraUp);
+  writer.Write(DefocusAngle);
+  writer.Write(FocusDistance);
+}
+
+std::optional<CameraSettings> CameraSettings::Deserialize(ByteReader& reader)
+{
+  CameraSettings camera;
+  camera.Dimensions.Width = reader.Read<int>();
+  camera.Dimensions.Height = reader.Read<int>();
+  camera.SamplesPerPixel = reader.Read<int>();
+  camera.MaxDepth = reader.Read<int>();
+  camera.FieldOfView = reader.Read<double>();
+  camera.LookFrom = ReadVec3(reader);
+  camera.LookAt = ReadVec3(reader);
+  camera.CameraUp = ReadVec3(reader);
+  camera.DefocusAngle = reader.Read<double>();
+  camera.FocusDistance = reader.Read<double>();
+  if (!reader.Ok() || camera.Dimensions.Width <= 0 || camera.Dimensions.Height <= 0 || camera.SamplesPerPixel <= 0) {
+    return std::nullopt;
+  }
+  return camera;
+}
+
+void CameraSettings::Apply(RayTracer& raytracer, bool framebuffer) const
+{
+  raytracer.ResizeViewport(Dimensions, framebuffer);
+  raytracer.SetSamplesPerPixel(SamplesPerPixel);
+  raytracer.MaxDepth = MaxDepth;
+  raytracer.FieldOfView = FieldOfView;
+  raytracer.LookFrom = LookFrom;
+  raytracer.LookAt = LookAt;
+  raytracer.CameraUp = CameraUp;
+  raytracer.DefocusAngle = DefocusAngle;
+  raytracer.FocusDistance = FocusDistance;
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+SceneDescription softrays::RandomSphereScene(std::uint32_t seed)
+{
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  auto random = [&](double min = 0.0, double max = 1.0) { return min + ((max - min) * distribution(generator)); };
+  auto random_colour = [&](double min = 0.0, double max = 1.0) { return Colour(random(min, max), random(min, max), random(min, max)); };
+
+  SceneDescription scene;
+  const auto ground = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.5, 0.5, 0.5)});
+  // The book's ground is a sphere of radius 1000 at (0, -1000, 0), within 0.1 of flat where the spheres sit
+  scene.Planes.push_back({.Point = Point3(0, 0, 0), .Normal = Vec3(0, 1, 0), .Material = ground});
+
+  // Small spheres share one glass material, but every diffuse and metal one gets its own colour
+  const auto glass = scene.AddMaterial({.Type = MaterialType::Dielectric, .Parameter = 1.5});
+  for (int a = -11; a < 11; a++) {
+    for (int b = -11; b < 11; b++) {
+      const auto choose_mat = random();
+      const Point3 center(a + (0.9 * random()), 0.2, b + (0.9 * random()));
+      if ((center - Point3(4, 0.2, 0)).Length() <= 0.9) {
+        continue;
+      }
+      std::uint32_t material = glass;
+      if (choose_mat < 0.8) {
+        material = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = random_colour() * random_colour()});
+      } else if (choose_mat < 0.95) {
+        const auto albedo = random_colour(0.5, 1);
+        material = scene.AddMaterial({.Type = MaterialType::Metal, .Albedo = albedo, .Parameter = random(0, 0.5)});
+      }
+      scene.Spheres.push_back({.Center = center, .Radius = 0.2, .Material = material});
+    }
+  }
+
+  scene.Spheres.push_back({.Center = Point3(0, 1, 0), .Radius = 1.0, .Material = glass});
+  const auto brown = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = Colour(0.4, 0.2, 0.1)});
+  scene.Spheres.push_back({.Center = Point3(-4, 1, 0), .Radius = 1.0, .Material = brown});
+  const auto mirror = scene.AddMaterial({.Type = MaterialType::Metal, .Albedo = Colour(0.7, 0.6, 0.5), .Parameter = 0.0});
+  scene.Spheres.push_back({.Center = Point3(4, 1, 0), .Radius = 1.0, .Material = mirror});
+  return scene;
+}
+
+CameraSettings softrays::RandomSphereCamera()
+{
+  return {
+      .Dimensions = {.Width = 1200, .Height = 675},
+      .SamplesPerPixel = 50,
+      .MaxDepth = 20,
+      .FieldOfView = 20,
+      .LookFrom = Point3(13, 2, 3),
+      .LookAt = Point3(0, 0, 0),
+      .CameraUp = Vec3(0, 1, 0),
+      .DefocusAngle = 0.6,
+      .FocusDistance = 10.0,
+  };
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,93 @@
+#include "scene_cache.hpp"
+#include "scene.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+using namespace softrays;
+
+SceneCache::SceneCache(std::size_t capacity) : Capacity(std::max<std::size_t>(capacity, 1))
+{
+}
+
+SceneCache::Result SceneCache::Acquire(const SceneDescription& scene)
+{
+  const auto hash = scene.Hash();
+  std::promise<std::shared_ptr<const PreparedScene>> promise;
+  Future cached;
+  {
+    const std::scoped_lock lock(Mutex);
+    if (const auto found = Index.find(hash); found != Index.end()) {
+      Entries.splice(Entries.begin(), Entries, found->second);
+      ++HitCount;
+      cached = found->second->Scene;
+    } else {
+      ++MissCount;
+      Entries.push_front({.Hash = hash, .Scene = promise.get_future().share()});
+      Index[hash] = Entries.begin();
+    }
+  }
+  if (cached.valid()) {
+    // Waits, outside the lock, if another thread is still building it
+    return {.Scene = cached.get(), .Hit = true};
+  }
+
+  // Built outside the lock, so other scenes can be looked up meanwhile
+  std::shared_ptr<const PreparedScene> prepared;
+  try {
+    if (auto built = scene.Prepare()) {
+      prepared = std::make_shared<const PreparedScene>(std::move(*built));
+    }
+  } catch (...) {
+    // Threads waiting for the scene get the exception too, rather than waiting forever
+    promise.set_exception(std::current_exception());
+    const std::scoped_lock lock(Mutex);
+    Forget(hash);
+    throw;
+  }
+  promise.set_value(prepared);
+
+  const std::scoped_lock lock(Mutex);
+  if (!prepared) {
+    // Don't keep the failure around; the next request retries
+    Forget(hash);
+  }
+  // Only a scene that built makes room for itself
+  while (Entries.size() > Capacity) {
+    Index.erase(Entries.back().Hash);
+    Entries.pop_back();
+  }
+  return {.Scene = std::move(prepared), .Hit = false};
+}
+
+void SceneCache::Forget(std::uint64_t hash)
+{
+  if (const auto found = Index.find(hash); found != Index.end()) {
+    Entries.erase(found->second);
+    Index.erase(found);
+  }
+}
+
+std::size_t SceneCache::Size() const
+{
+  const std::scoped_lock lock(Mutex);
+  return Entries.size();
+}
+
+std::size_t SceneCache::Hits() const
+{
+  const std::scoped_lock lock(Mutex);
+  return HitCount;
+}
+
+std::size_t SceneCache::Misses() const
+{
+  const std::scoped_lock lock(Mutex);
+  return MissCount;
+}
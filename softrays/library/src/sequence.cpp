@@ -0,0 +1,185 @@
+#include "sequence.hpp"
+#include "image.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+FloatImage CopyFrame(const RayTracer& raytracer)
+{
+  const auto& dimensions = raytracer.GetViewport();
+  FloatImage image(dimensions.Width, dimensions.Height);
+  const auto& pixels = raytracer.GetPixelData();
+  for (int y = 0; y < image.Height; ++y) {
+    for (int x = 0; x < image.Width; ++x) {
+      image.Set(x, y, pixels[(static_cast<std::size_t>(y) * static_cast<std::size_t>(image.Width)) + static_cast<std::size_t>(x)]);
+    }
+  }
+  return image;
+}
+}
+
+bool softrays::RenderSequence(int frame_count, const FrameUpdate& update, const FrameWriter& write, const SequenceOptions& options)
+{
+  auto run_update = [&update](int frame) {
+    SOFTRAYS_TRACE_SCOPE("UpdateFrame");
+    return update(frame);
+  };
+
+  ThreadPool pool(options.Threads);
+  RayTracer raytracer;
+  std::future<std::optional<SequenceFrame>> next;
+  std::future<bool> writing;  // The previous frame
+  if (frame_count > 0) {
+    next = std::async(std::launch::async, run_update, 0);
+  }
+
+  bool ok = true;
+  for (int frame = 0; frame < frame_count; ++frame) {
+    const auto current = next.get();
+    if (!current) {
+      ok = false;
+      break;
+    }
+    if (frame + 1 < frame_count) {
+      next = std::async(std::launch::async, run_update, frame + 1);
+    }
+
+    current->Camera.Apply(raytracer);
+    current->Scene.AttachTo(raytracer);
+    raytracer.BeginFrame();
+    for (const auto& tile : SplitIntoTiles(current->Camera.Dimensions, std::max(options.TileSize, 1))) {
+      pool.Submit([&raytracer, tile] { raytracer.RenderTile(tile); });
+    }
+    pool.WaitIdle();
+    auto image = CopyFrame(raytracer);
+
+    if (writing.valid() && !writing.get()) {
+      ok = false;
+      break;
+    }
+    writing = std::async(std::launch::async, [&write, frame, image = std::move(image)] {
+      SOFTRAYS_TRACE_SCOPE("WriteFrame");
+      return write(frame, image);
+    });
+  }
+
+  if (writing.valid()) {
+    ok = writing.get() && ok;
+  }
+  // An update still running after a failure is waited for by next's destructor
+  return ok;
+}
+
+CameraSettings softrays::InterpolateCamera(std::span<const CameraKeyframe> keyframes, int frame)
+{
+  const auto upper = std::ranges::upper_bound(keyframes, frame, {}, &CameraKeyframe::Frame);
+  if (upper == keyframes.begin()) {
+    return keyframes.front().Camera;
+  }
+  if (upper == keyframes.end()) {
+    return keyframes.back().Camera;
+  }
+  const auto& from = std::prev(upper)->Camera;
+  const auto& to = upper->Camera;
+  const auto t = static_cast<double>(frame - std::prev(upper)->Frame) / static_cast<double>(upper->Frame - std::prev(upper)->Frame);
+  auto lerp = [t](const auto& a, const auto& b) { return a + ((b - a) * t); };
+
+  auto camera = from;
+  camera.LookFrom = lerp(from.LookFrom, to.LookFrom);
+  camera.LookAt = lerp(from.LookAt, to.LookAt);
+  camera.CameraUp = lerp(from.CameraUp, to.CameraUp);
+  camera.FieldOfView = lerp(from.FieldOfView, to.FieldOfView);
+  camera.DefocusAngle = lerp(from.DefocusAngle, to.DefocusAngle);
+  camera.FocusDistance = lerp(from.FocusDistance, to.FocusDistance);
+  return camera;
+}
+
+std::optional<std::vector<CameraKeyframe>> softrays::ReadCameraKeyframes(std::istream& input, const CameraSettings& base)
+{
+  std::vector<CameraKeyframe> keyframes;
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream fields(line);
+    fields >> std::ws;
+    if (fields.eof() || fields.peek() == '#') {
+      continue;
+    }
+
+    CameraKeyframe keyframe{.Frame = 0, .Camera = base};
+    auto& camera = keyframe.Camera;
+    fields >> keyframe.Frame >> camera.LookFrom.x >> camera.LookFrom.y >> camera.LookFrom.z >> camera.LookAt.x >> camera.LookAt.y >> camera.LookAt.z;
+    if (!fields) {
+      return std::nullopt;
+    }
+    double field_of_view = 0;
+    if (fields >> field_of_view) {
+      camera.FieldOfView = field_of_view;
+    } else if (!fields.eof()) {
+      return std::nullopt;
+    }
+    // Anything after the field of view is an error too
+    fields.clear();
+    if (std::string extra; fields >> extra) {
+      return std::nullopt;
+    }
+    keyframes.push_back(keyframe);
+  }
+  if (keyframes.empty()) {
+    return std::nullopt;
+  }
+  std::ranges::stable_sort(keyframes, {}, &CameraKeyframe::Frame);
+  return keyframes;
+}
+
+FrameUpdate softrays::KeyframedCamera(PreparedScene scene, std::vector<CameraKeyframe> keyframes)
+{
+  return [scene = std::move(scene), keyframes = std::move(keyframes)](int frame) -> std::optional<SequenceFrame> {
+    if (keyframes.empty()) {
+      return std::nullopt;
+    }
+    return SequenceFrame{.Scene = scene, .Camera = InterpolateCamera(keyframes, frame)};
+  };
+}
+
+FrameWriter softrays::WriteNumberedFrames(std::string pattern)
+{
+  return [pattern = std::move(pattern)](int frame, const FloatImage& image) { return SaveImage(FramePath(pattern, frame), image); };
+}
+
+std::string softrays::FramePath(std::string_view pattern, int frame)
+{
+  std::ostringstream path;
+  const auto last = pattern.find_last_of('#');
+  if (last == std::string_view::npos) {
+    const auto dot = pattern.find_last_of('.');
+    const auto slash = pattern.find_last_of("/\\");
+    const auto split = (dot != std::string_view::npos && (slash == std::string_view::npos || dot > slash)) ? dot : pattern.size();
+    path << pattern.substr(0, split) << '_' << frame << pattern.substr(split);
+    return path.str();
+  }
+  const auto first = pattern.find_last_not_of('#', last);
+  const auto start = first == std::string_view::npos ? 0 : first + 1;
+  path << pattern.substr(0, start) << std::setw(static_cast<int>(last + 1 - start)) << std::setfill('0') << frame << pattern.substr(last + 1);
+  return path.str();
+}
@@ -0,0 +1,143 @@
+#include "stream_render.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+// The file layout: a text header followed by fixed-size pixels, so every tile row has a known offset
+struct StreamFormat {
+  std::string Header;
+  std::size_t BytesPerPixel{};
+  bool Float{};
+  // PFM stores rows bottom-to-top
+  bool BottomUp{};
+};
+
+StreamFormat FormatFor(const std::string& path, const Dimension2d& dim)
+{
+  std::ostringstream header;
+  if (path.ends_with(".pfm")) {
+    const auto scale = (std::endian::native == std::endian::little) ? "-1.0" : "1.0";
+    header << "PF\n"
+           << dim.Width << ' ' << dim.Height << '\n'
+           << scale << '\n';
+    return {.Header = header.str(), .BytesPerPixel = 3 * sizeof(float), .Float = true, .BottomUp = true};
+  }
+  header << "P6\n"
+         << dim.Width << ' ' << dim.Height << "\n255\n";
+  return {.Header = header.str(), .BytesPerPixel = 3, .Float = false, .BottomUp = false};
+}
+
+// Converts a traced tile to the file's pixel encoding, row-major at the tile's width
+void EncodeTile(const StreamFormat& format, const std::vector<Colour>& pixels, std::size_t count, std::vector<char>& bytes)
+{
+  static constexpr Interval intensity(0.000, 0.999);
+  static constexpr int byteMax{256};
+  auto* out = bytes.data();
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto& pixel = pixels[i];
+    if (format.Float) {
+      const std::array<float, 3> rgb{static_cast<float>(pixel.x), static_cast<float>(pixel.y), static_cast<float>(pixel.z)};
+      std::memcpy(out, rgb.data(), sizeof(rgb));
+      out += sizeof(rgb);
+    } else {
+      for (const auto channel : {pixel.x, pixel.y, pixel.z}) {
+        *out++ = static_cast<char>(static_cast<std::uint8_t>(intensity.Clamp(LinearToGamma(channel)) * byteMax));
+      }
+    }
+  }
+}
+}
+
+bool softrays::RenderToFile(RayTracer& raytracer, const std::string& path, const StreamRenderOptions& options)
+{
+  raytracer.BeginFrame();
+  const auto dim = raytracer.GetViewport();
+  const auto format = FormatFor(path, dim);
+  const auto width = static_cast<std::size_t>(dim.Width);
+  const auto file_size = format.Header.size() + (width * static_cast<std::size_t>(dim.Height) * format.BytesPerPixel);
+
+  {
+    std::ofstream header(path, std::ios::binary | std::ios::trunc);
+    header << format.Header;
+    if (!header) {
+      return false;
+    }
+  }
+  // Sizing the file up front lets tiles land in any order
+  std::error_code error;
+  std::filesystem::resize_file(path, file_size, error);
+  if (error) {
+    return false;
+  }
+  std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+  if (!file) {
+    return false;
+  }
+
+  const auto tile_size = std::max(options.TileSize, 1);
+  const auto tiles_x = static_cast<std::size_t>((dim.Width + tile_size - 1) / tile_size);
+  const auto tiles_y = static_cast<std::size_t>((dim.Height + tile_size - 1) / tile_size);
+  const auto tile_count = tiles_x * tiles_y;
+  const auto threads = static_cast<std::size_t>(options.Threads != 0 ? options.Threads : std::max(std::thread::hardware_concurrency(), 1U));
+
+  std::atomic<std::size_t> next_tile{0};
+  std::atomic<bool> failed{false};
+  std::mutex file_mutex;
+  auto worker = [&] {
+    const auto tile_pixels = static_cast<std::size_t>(tile_size) * static_cast<std::size_t>(tile_size);
+    std::vector<Colour> pixels(tile_pixels);
+    std::vector<char> bytes(tile_pixels * format.BytesPerPixel);
+    for (auto index = next_tile++; index < tile_count && !failed; index = next_tile++) {
+      const auto from_x = static_cast<int>(index % tiles_x) * tile_size;
+      const auto from_y = static_cast<int>(index / tiles_x) * tile_size;
+      const TileRect tile{.FromX = from_x, .FromY = from_y, .ToX = std::min(from_x + tile_size, dim.Width), .ToY = std::min(from_y + tile_size, dim.Height)};
+      raytracer.RenderTile(tile, std::span(pixels.data(), tile.PixelCount()));
+      EncodeTile(format, pixels, tile.PixelCount(), bytes);
+
+      const auto row_bytes = static_cast<std::size_t>(tile.Width()) * format.BytesPerPixel;
+      SOFTRAYS_TRACE_SCOPE("WriteTile", tile);
+      const std::scoped_lock lock(file_mutex);
+      for (int y = tile.FromY; y < tile.ToY; ++y) {
+        const auto file_row = static_cast<std::size_t>(format.BottomUp ? dim.Height - 1 - y : y);
+        const auto offset = format.Header.size() + (((file_row * width) + static_cast<std::size_t>(tile.FromX)) * format.BytesPerPixel);
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(&bytes[static_cast<std::size_t>(y - tile.FromY) * row_bytes], static_cast<std::streamsize>(row_bytes));
+      }
+      if (!file) {
+        failed = true;
+      }
+    }
+  };
+
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t i = 1; i < threads; ++i) {
+      workers.emplace_back(worker);
+    }
+    worker();
+  }
+  file.flush();
+  return !failed && static_cast<bool>(file);
+}
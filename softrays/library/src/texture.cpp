@@ -0,0 +1,436 @@
+#include "texture.hpp"
+#include "image.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "serialize.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+constexpr std::uint32_t TextureMagic = 0x58545253;  // "SRTX"
+constexpr std::uint32_t TextureFormatVersion = 1;
+constexpr std::size_t DefaultCacheBytes = std::size_t{256} << 20U;
+constexpr std::size_t HeaderBytes = (6 * sizeof(std::uint32_t)) + sizeof(std::uint64_t);
+
+struct LevelSize {
+  int Width;
+  int Height;
+};
+
+// Each level halves the last, rounding up, down to 1x1
+std::vector<LevelSize> MipSizes(int width, int height)
+{
+  std::vector<LevelSize> sizes{{.Width = width, .Height = height}};
+  while (sizes.back().Width > 1 || sizes.back().Height > 1) {
+    const auto& last = sizes.back();
+    sizes.push_back({.Width = std::max(1, (last.Width + 1) / 2), .Height = std::max(1, (last.Height + 1) / 2)});
+  }
+  return sizes;
+}
+
+int TilesAcross(int size, int tile_size)
+{
+  return (size + tile_size - 1) / tile_size;
+}
+
+// Box-filters each 2x2 block of `image` into one texel; odd edges average what there is
+FloatImage Downsample(const FloatImage& image, const LevelSize& size)
+{
+  FloatImage level(size.Width, size.Height);
+  for (int y = 0; y < size.Height; ++y) {
+    for (int x = 0; x < size.Width; ++x) {
+      Colour sum;
+      int count = 0;
+      for (int sy = 2 * y; sy < std::min(2 * y + 2, image.Height); ++sy) {
+        for (int sx = 2 * x; sx < std::min(2 * x + 2, image.Width); ++sx) {
+          sum += image.At(sx, sy);
+          ++count;
+        }
+      }
+      level.Set(x, y, sum / count);
+    }
+  }
+  return level;
+}
+
+int Wrap(int value, int size) noexcept
+{
+  const auto wrapped = value % size;
+  return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+std::size_t TileFloats(int width, int height) noexcept
+{
+  return static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 3;
+}
+}
+
+TextureCache::TextureCache(std::size_t capacity_bytes, std::size_t shards)
+    : Shards(std::max<std::size_t>(shards, 1)), ShardCapacity(capacity_bytes / Shards.size())
+{
+}
+
+const std::shared_ptr<TextureCache>& TextureCache::Default()
+{
+  static const auto cache = std::make_shared<TextureCache>(DefaultCacheBytes);
+  return cache;
+}
+
+std::shared_ptr<const TextureTile> TextureCache::Find(std::uint64_t key, const TileLoader& load)
+{
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  auto& shard = Shards[((key * 0x9e3779b97f4a7c15ULL) >> 32U) % Shards.size()];
+  {
+    const std::scoped_lock lock(shard.Mutex);
+    if (const auto found = shard.Index.find(key); found != shard.Index.end()) {
+      shard.Recent.splice(shard.Recent.begin(), shard.Recent, found->second);
+      ++Hits;
+      return found->second->Tile;
+    }
+  }
+
+  // Read without the lock, so other lookups in the shard go on meanwhile; two threads missing the
+  // same tile both read it and the first to finish is kept
+  ++Misses;
+  auto tile = load();
+  if (!tile) {
+    return nullptr;
+  }
+  const std::scoped_lock lock(shard.Mutex);
+  if (const auto found = shard.Index.find(key); found != shard.Index.end()) {
+    return found->second->Tile;
+  }
+  const auto bytes = tile->Bytes();
+  const auto capacity = ShardCapacity.load();
+  if (bytes > capacity) {
+    return tile;  // Used once and dropped
+  }
+  // Room is made first, so the shard never holds more than its share
+  EvictDownTo(shard, capacity - bytes);
+  shard.Recent.push_front({.Key = key, .Tile = tile});
+  shard.Index.emplace(key, shard.Recent.begin());
+  shard.Bytes += bytes;
+  const auto resident = ResidentBytes += bytes;
+  auto peak = PeakBytes.load();
+  while (resident > peak && !PeakBytes.compare_exchange_weak(peak, resident)) {
+  }
+  return tile;
+}
+
+void TextureCache::EvictDownTo(Shard& shard, std::size_t capacity)
+{
+  while (shard.Bytes > capacity && !shard.Recent.empty()) {
+    const auto& oldest = shard.Recent.back();
+    const auto bytes = oldest.Tile->Bytes();
+    shard.Index.erase(oldest.Key);
+    shard.Recent.pop_back();
+    shard.Bytes -= bytes;
+    ResidentBytes -= bytes;
+    ++Evictions;
+  }
+}
+
+void TextureCache::SetCapacity(std::size_t capacity_bytes)
+{
+  ShardCapacity = capacity_bytes / Shards.size();
+  for (auto& shard : Shards) {
+    const std::scoped_lock lock(shard.Mutex);
+    EvictDownTo(shard, ShardCapacity);
+  }
+}
+
+TextureCacheStats TextureCache::Stats() const
+{
+  return {
+      .Hits = Hits,
+      .Misses = Misses,
+      .Evictions = Evictions,
+      .ResidentBytes = ResidentBytes,
+      .PeakBytes = PeakBytes,
+      .CapacityBytes = ShardCapacity * Shards.size(),
+  };
+}
+
+void TextureCache::ResetStats() noexcept
+{
+  Hits = 0;
+  Misses = 0;
+  Evictions = 0;
+  PeakBytes = ResidentBytes.load();
+}
+
+bool softrays::WriteTiledTexture(const std::string& path, const FloatImage& image, int tile_size)
+{
+  SOFTRAYS_TRACE_SCOPE("WriteTiledTexture");
+  if (image.Width <= 0 || image.Height <= 0 || tile_size <= 0) {
+    return false;
+  }
+  const auto sizes = MipSizes(image.Width, image.Height);
+  std::vector<FloatImage> levels{image};
+  for (std::size_t level = 1; level < sizes.size(); ++level) {
+    levels.push_back(Downsample(levels.back(), sizes[level]));
+  }
+
+  // Tiles are laid out level by level, each level row by row
+  std::vector<std::uint64_t> offsets;
+  std::uint64_t tile_bytes = 0;
+  for (const auto& size : sizes) {
+    for (int tile_y = 0; tile_y < TilesAcross(size.Height, tile_size); ++tile_y) {
+      for (int tile_x = 0; tile_x < TilesAcross(size.Width, tile_size); ++tile_x) {
+        offsets.push_back(tile_bytes);
+        const auto width = std::min(tile_size, size.Width - (tile_x * tile_size)) + 1;
+        const auto height = std::min(tile_size, size.Height - (tile_y * tile_size)) + 1;
+        tile_bytes += TileFloats(width, height) * sizeof(float);
+      }
+    }
+  }
+  const auto data_start = HeaderBytes + (offsets.size() * sizeof(std::uint64_t));
+  for (auto& offset : offsets) {
+    offset += data_start;
+  }
+
+  ByteWriter header;
+  header.Reserve(data_start);
+  header.Write(TextureMagic);
+  header.Write(TextureFormatVersion);
+  header.Write(image.Width);
+  header.Write(image.Height);
+  header.Write(tile_size);
+  header.Write(static_cast<std::uint32_t>(sizes.size()));
+  header.WriteSpan(std::span<const std::uint64_t>(offsets));
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file.write(reinterpret_cast<const char*>(header.Data().data()), static_cast<std::streamsize>(header.Data().size()));
+  std::vector<float> texels;
+  for (const auto& level : levels) {
+    for (int tile_y = 0; tile_y < TilesAcross(level.Height, tile_size); ++tile_y) {
+      for (int tile_x = 0; tile_x < TilesAcross(level.Width, tile_size); ++tile_x) {
+        const auto from_x = tile_x * tile_size;
+        const auto from_y = tile_y * tile_size;
+        const auto to_x = std::min(from_x + tile_size, level.Width);
+        const auto to_y = std::min(from_y + tile_size, level.Height);
+        texels.clear();
+        // One texel past the far edges, wrapping around the image like lookups do
+        for (int y = from_y; y <= to_y; ++y) {
+          for (int x = from_x; x <= to_x; ++x) {
+            const auto index = level.Index(Wrap(x, level.Width), Wrap(y, level.Height));
+            texels.insert(texels.end(), &level.Pixels[index], &level.Pixels[index] + 3);
+          }
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        file.write(reinterpret_cast<const char*>(texels.data()), static_cast<std::streamsize>(texels.size() * sizeof(float)));
+      }
+    }
+  }
+  return static_cast<bool>(file.flush());
+}
+
+std::shared_ptr<TiledTexture> TiledTexture::Open(const std::string& path, std::shared_ptr<TextureCache> cache)
+{
+  std::error_code error;
+  const auto file_size = std::filesystem::file_size(path, error);
+  std::ifstream file(path, std::ios::binary);
+  std::vector<std::byte> header_bytes(HeaderBytes);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (error || !cache || !file.read(reinterpret_cast<char*>(header_bytes.data()), static_cast<std::streamsize>(header_bytes.size()))) {
+    return nullptr;
+  }
+  ByteReader header(header_bytes);
+  const auto magic = header.Read<std::uint32_t>();
+  const auto version = header.Read<std::uint32_t>();
+  const auto width = header.Read<int>();
+  const auto height = header.Read<int>();
+  const auto tile_size = header.Read<int>();
+  const auto level_count = header.Read<std::uint32_t>();
+  const auto tile_count = header.Read<std::uint64_t>();
+  if (magic != TextureMagic || version != TextureFormatVersion || width <= 0 || height <= 0 || tile_size <= 0) {
+    return nullptr;
+  }
+
+  std::shared_ptr<TiledTexture> texture(new TiledTexture());
+  texture->TileSize = tile_size;
+  std::size_t tiles = 0;
+  for (const auto& size : MipSizes(width, height)) {
+    const auto tiles_x = TilesAcross(size.Width, tile_size);
+    const auto tiles_y = TilesAcross(size.Height, tile_size);
+    texture->Levels.push_back({.Width = size.Width, .Height = size.Height, .TilesX = tiles_x, .TilesY = tiles_y, .FirstTile = tiles});
+    tiles += static_cast<std::size_t>(tiles_x) * static_cast<std::size_t>(tiles_y);
+  }
+  if (level_count != texture->Levels.size() || tile_count != tiles) {
+    return nullptr;
+  }
+  texture->Offsets.resize(tiles);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (!file.read(reinterpret_cast<char*>(texture->Offsets.data()), static_cast<std::streamsize>(tiles * sizeof(std::uint64_t)))) {
+    return nullptr;
+  }
+  // Every tile must lie inside the file, or a lookup would read past its end
+  for (std::size_t level = 0; level < texture->Levels.size(); ++level) {
+    const auto& info = texture->Levels[level];
+    for (int tile_y = 0; tile_y < info.TilesY; ++tile_y) {
+      for (int tile_x = 0; tile_x < info.TilesX; ++tile_x) {
+        const auto [tile_width, tile_height] = texture->TileExtent(level, tile_x, tile_y);
+        const auto offset = texture->Offsets[texture->TileIndex(level, tile_x, tile_y)];
+        if (offset > file_size || TileFloats(tile_width, tile_height) * sizeof(float) > file_size - offset) {
+          return nullptr;
+        }
+      }
+    }
+  }
+
+  texture->File = std::move(file);
+  texture->Cache = std::move(cache);
+  texture->Id = texture->Cache->NewTextureId();
+  const auto coarsest = texture->LoadTile(texture->Levels.size() - 1, 0, 0);
+  if (!coarsest) {
+    return nullptr;
+  }
+  texture->Mean = {.x = coarsest->Texels[0], .y = coarsest->Texels[1], .z = coarsest->Texels[2]};
+  return texture;
+}
+
+std::shared_ptr<TiledTexture> TiledTexture::OpenImage(const std::string& path, std::shared_ptr<TextureCache> cache)
+{
+  if (!path.ends_with(".pfm")) {
+    return Open(path, std::move(cache));
+  }
+  const auto tiled_path = path + ".tiles";
+  if (!std::filesystem::exists(tiled_path)) {
+    const auto image = LoadPFM(path);
+    if (!image || !WriteTiledTexture(tiled_path, *image)) {
+      return nullptr;
+    }
+  }
+  return Open(tiled_path, std::move(cache));
+}
+
+TiledTexture::TileSize2d TiledTexture::TileExtent(std::size_t level, int tile_x, int tile_y) const noexcept
+{
+  const auto& info = Levels[level];
+  return {.Width = std::min(TileSize, info.Width - (tile_x * TileSize)) + 1, .Height = std::min(TileSize, info.Height - (tile_y * TileSize)) + 1};
+}
+
+std::size_t TiledTexture::TileIndex(std::size_t level, int tile_x, int tile_y) const noexcept
+{
+  const auto& info = Levels[level];
+  return info.FirstTile + (static_cast<std::size_t>(tile_y) * static_cast<std::size_t>(info.TilesX)) + static_cast<std::size_t>(tile_x);
+}
+
+std::shared_ptr<const TextureTile> TiledTexture::LoadTile(std::size_t level, int tile_x, int tile_y) const
+{
+  SOFTRAYS_TRACE_SCOPE("LoadTextureTile");
+  const auto [width, height] = TileExtent(level, tile_x, tile_y);
+  auto tile = std::make_shared<TextureTile>();
+  tile->Width = width;
+  tile->Height = height;
+  tile->Texels.resize(TileFloats(width, height));
+  const std::scoped_lock lock(FileMutex);
+  File.clear();
+  File.seekg(static_cast<std::streamoff>(Offsets[TileIndex(level, tile_x, tile_y)]));
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (!File.read(reinterpret_cast<char*>(tile->Texels.data()), static_cast<std::streamsize>(tile->Bytes()))) {
+    return nullptr;
+  }
+  return tile;
+}
+
+std::shared_ptr<const TextureTile> TiledTexture::FindTile(std::size_t level, int x, int y) const
+{
+  const auto tile_x = x / TileSize;
+  const auto tile_y = y / TileSize;
+  const auto key = (std::uint64_t{Id} << 32U) | TileIndex(level, tile_x, tile_y);
+  return Cache->Find(key, [this, level, tile_x, tile_y] { return LoadTile(level, tile_x, tile_y); });
+}
+
+Colour TiledTexture::Texel(int level, int x, int y) const
+{
+  const auto index = static_cast<std::size_t>(std::clamp(level, 0, LevelCount() - 1));
+  const auto& info = Levels[index];
+  x = Wrap(x, info.Width);
+  y = Wrap(y, info.Height);
+  const auto tile = FindTile(index, x, y);
+  if (!tile) {
+    return Mean;
+  }
+  const auto texel = TileFloats(tile->Width, y % TileSize) + (static_cast<std::size_t>(x % TileSize) * 3);
+  return {.x = tile->Texels[texel], .y = tile->Texels[texel + 1], .z = tile->Texels[texel + 2]};
+}
+
+Colour TiledTexture::Bilinear(std::size_t level, double u, double v) const
+{
+  const auto& info = Levels[level];
+  // Texel centres sit at half-integer positions
+  const auto x = ((u - std::floor(u)) * info.Width) - 0.5;
+  const auto y = ((1 - (v - std::floor(v))) * info.Height) - 0.5;
+  const auto x0 = std::floor(x);
+  const auto y0 = std::floor(y);
+  const auto fx = x - x0;
+  const auto fy = y - y0;
+  const auto texel_x = Wrap(static_cast<int>(x0), info.Width);
+  const auto texel_y = Wrap(static_cast<int>(y0), info.Height);
+  const auto tile = FindTile(level, texel_x, texel_y);
+  if (!tile) {
+    return Mean;
+  }
+
+  // The tile's extra row and column hold the neighbours across its far edges
+  const auto row = static_cast<std::size_t>(tile->Width) * 3;
+  const auto texel = (static_cast<std::size_t>(texel_y % TileSize) * row) + (static_cast<std::size_t>(texel_x % TileSize) * 3);
+  auto at = [&tile](std::size_t index) {
+    return Colour{.x = tile->Texels[index], .y = tile->Texels[index + 1], .z = tile->Texels[index + 2]};
+  };
+  const auto top = (at(texel) * (1 - fx)) + (at(texel + 3) * fx);
+  const auto bottom = (at(texel + row) * (1 - fx)) + (at(texel + row + 3) * fx);
+  return (top * (1 - fy)) + (bottom * fy);
+}
+
+Colour TiledTexture::Sample(double u, double v, double footprint) const
+{
+  if (!std::isfinite(u) || !std::isfinite(v)) {
+    return Mean;
+  }
+  // The level whose texel is as wide as the footprint; NaN and non-positive footprints take the finest
+  const auto lod = std::log2(footprint * std::max(GetWidth(), GetHeight()));
+  const auto level = lod > 0 ? std::min(lod, static_cast<double>(LevelCount() - 1)) : 0.0;
+  const auto finer = static_cast<std::size_t>(level);
+  const auto blend = level - static_cast<double>(finer);
+  const auto colour = Bilinear(finer, u, v);
+  if (blend <= 0 || finer + 1 >= Levels.size()) {
+    return colour;
+  }
+  return (colour * (1 - blend)) + (Bilinear(finer + 1, u, v) * blend);
+}
+
+Colour softrays::SampleTexture(const TiledTexture& texture, const Ray& ray, const HitData& hit)
+{
+  if (hit.TextureScale <= 0) {
+    return texture.Average();
+  }
+  constexpr auto minCosine = 0.05;
+  const auto length = ray.Direction.Length();
+  const auto cosine = std::fabs(ray.Direction.Dot(hit.Normal)) / length;
+  const auto width = ray.Cone.WidthAt(hit.Time * length) / std::fmax(cosine, minCosine);
+  return texture.Sample(hit.U, hit.V, width / hit.TextureScale);
+}
+
+Colour softrays::TextureAverage(const TiledTexture& texture)
+{
+  return texture.Average();
+}
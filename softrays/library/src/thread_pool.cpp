@@ -0,0 +1,72 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+using namespace softrays;
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  Threads.reserve(threads);
+  for (unsigned i = 0; i < threads; ++i) {
+    Threads.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    const std::scoped_lock lock(Mutex);
+    Stopping = true;
+  }
+  WorkAvailable.notify_all();
+  for (auto& thread : Threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task, int priority)
+{
+  {
+    const std::scoped_lock lock(Mutex);
+    Tasks.push({.Priority = priority, .Sequence = NextSequence++, .Work = std::move(task)});
+  }
+  WorkAvailable.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+  std::unique_lock lock(Mutex);
+  Idle.wait(lock, [this] { return Tasks.empty() && Running == 0; });
+}
+
+void ThreadPool::WorkerLoop()
+{
+  std::unique_lock lock(Mutex);
+  while (true) {
+    WorkAvailable.wait(lock, [this] { return Stopping || !Tasks.empty(); });
+    if (Stopping) {
+      return;
+    }
+
+    // top() is const, but the task is popped straight away, so moving out of it is safe
+    auto work = std::move(const_cast<Task&>(Tasks.top()).Work);  // NOLINT(cppcoreguidelines-pro-type-const-cast)
+    Tasks.pop();
+    ++Running;
+    lock.unlock();
+
+    work();
+
+    lock.lock();
+    --Running;
+    if (Tasks.empty() && Running == 0) {
+      Idle.notify_all();
+    }
+  }
+}
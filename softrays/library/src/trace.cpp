@@ -0,0 +1,208 @@
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace softrays;
+
+namespace {
+// Per thread; once full, a thread's oldest events are overwritten
+constexpr std::size_t EventCapacity = 16384;
+
+struct TraceEvent {
+  const char* Name{};
+  std::int64_t Begin{};
+  std::int64_t End{};
+  TileRect Tile{};
+  bool HasTile{};
+};
+
+// One thread's ring of events. Only the owning thread writes to it, publishing each event through
+// Written, so recording takes no locks; readers see every event before the count they load
+struct ThreadBuffer {
+  std::uint32_t ThreadId{};
+  std::atomic<bool> InUse{true};
+  // The trace the events belong to; a buffer left over from an earlier one is emptied on first use
+  std::atomic<std::uint64_t> Session{0};
+  std::atomic<std::uint64_t> Written{0};
+  std::vector<TraceEvent> Events = std::vector<TraceEvent>(EventCapacity);
+};
+
+// Every buffer ever handed out. They outlive their threads, and are reused by later ones, so the
+// events of a finished thread can still be written out
+struct Registry {
+  std::mutex Mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> Buffers;
+};
+
+Registry& GetRegistry()
+{
+  static Registry registry;
+  return registry;
+}
+
+std::atomic<bool> Enabled{false};
+std::atomic<std::uint64_t> CurrentSession{0};
+std::atomic<std::int64_t> SessionStart{0};
+
+std::int64_t Now() noexcept
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Hands the thread's buffer back for reuse when the thread exits
+struct BufferLease {
+  ThreadBuffer* Buffer{};
+
+  BufferLease() = default;
+  BufferLease(const BufferLease&) = delete;
+  BufferLease& operator=(const BufferLease&) = delete;
+  BufferLease(BufferLease&&) = delete;
+  BufferLease& operator=(BufferLease&&) = delete;
+  ~BufferLease()
+  {
+    if (Buffer != nullptr) {
+      Buffer->InUse.store(false, std::memory_order_release);
+    }
+  }
+};
+
+ThreadBuffer& ThisThreadBuffer()
+{
+  thread_local BufferLease lease;
+  if (lease.Buffer == nullptr) {
+    auto& registry = GetRegistry();
+    const std::scoped_lock lock(registry.Mutex);
+    for (const auto& buffer : registry.Buffers) {
+      bool in_use = false;
+      if (buffer->InUse.compare_exchange_strong(in_use, true, std::memory_order_acquire)) {
+        lease.Buffer = buffer.get();
+        break;
+      }
+    }
+    if (lease.Buffer == nullptr) {
+      auto& buffer = registry.Buffers.emplace_back(std::make_unique<ThreadBuffer>());
+      buffer->ThreadId = static_cast<std::uint32_t>(registry.Buffers.size());
+      lease.Buffer = buffer.get();
+    }
+  }
+  return *lease.Buffer;
+}
+
+void Record(const TraceEvent& event)
+{
+  auto& buffer = ThisThreadBuffer();
+  const auto session = CurrentSession.load(std::memory_order_acquire);
+  if (buffer.Session.load(std::memory_order_relaxed) != session) {
+    buffer.Written.store(0, std::memory_order_relaxed);
+    buffer.Session.store(session, std::memory_order_release);
+  }
+  const auto written = buffer.Written.load(std::memory_order_relaxed);
+  buffer.Events[written % EventCapacity] = event;
+  buffer.Written.store(written + 1, std::memory_order_release);
+}
+
+void WriteEscaped(std::ostream& out, const char* text)
+{
+  for (; *text != '\0'; ++text) {
+    if (*text == '"' || *text == '\\') {
+      out << '\\';
+    }
+    out << *text;
+  }
+}
+}
+
+void softrays::StartTracing()
+{
+  Enabled.store(false, std::memory_order_relaxed);
+  SessionStart.store(Now(), std::memory_order_relaxed);
+  CurrentSession.fetch_add(1, std::memory_order_acq_rel);
+  Enabled.store(true, std::memory_order_release);
+}
+
+void softrays::StopTracing()
+{
+  Enabled.store(false, std::memory_order_release);
+}
+
+bool softrays::TracingEnabled() noexcept
+{
+  return Enabled.load(std::memory_order_relaxed);
+}
+
+std::string softrays::ChromeTraceJson()
+{
+  constexpr double nanosecondsPerMicrosecond = 1000.0;
+  const auto session = CurrentSession.load(std::memory_order_acquire);
+  const auto start = SessionStart.load(std::memory_order_relaxed);
+
+  std::ostringstream json;
+  json << std::fixed << std::setprecision(3);
+  json << R"({"displayTimeUnit":"ms","traceEvents":[)";
+  bool first = true;
+  auto& registry = GetRegistry();
+  const std::scoped_lock lock(registry.Mutex);
+  for (const auto& buffer : registry.Buffers) {
+    if (buffer->Session.load(std::memory_order_acquire) != session) {
+      continue;
+    }
+    const auto written = buffer->Written.load(std::memory_order_acquire);
+    const auto from = written > EventCapacity ? written - EventCapacity : 0;
+    for (auto i = from; i < written; ++i) {
+      const auto& event = buffer->Events[i % EventCapacity];
+      json << (first ? "" : ",") << R"({"name":")";
+      WriteEscaped(json, event.Name);
+      json << R"(","ph":"X","pid":1,"tid":)" << buffer->ThreadId
+           << R"(,"ts":)" << static_cast<double>(event.Begin - start) / nanosecondsPerMicrosecond
+           << R"(,"dur":)" << static_cast<double>(event.End - event.Begin) / nanosecondsPerMicrosecond;
+      if (event.HasTile) {
+        json << R"(,"args":{"x":)" << event.Tile.FromX << R"(,"y":)" << event.Tile.FromY
+             << R"(,"width":)" << event.Tile.Width() << R"(,"height":)" << event.Tile.Height() << '}';
+      }
+      json << '}';
+      first = false;
+    }
+  }
+  json << "]}\n";
+  return json.str();
+}
+
+bool softrays::WriteChromeTrace(const std::string& path)
+{
+  std::ofstream file(path);
+  file << ChromeTraceJson();
+  return static_cast<bool>(file);
+}
+
+TraceScope::TraceScope(const char* name) noexcept : Name(name)
+{
+  if (Enabled.load(std::memory_order_relaxed)) {
+    Begin = Now();
+  }
+}
+
+TraceScope::TraceScope(const char* name, const TileRect& tile) noexcept : TraceScope(name)
+{
+  Tile = tile;
+  HasTile = true;
+}
+
+TraceScope::~TraceScope()
+{
+  // Events still open when the trace stopped or restarted are dropped
+  if (Begin < 0 || !Enabled.load(std::memory_order_relaxed) || Begin < SessionStart.load(std::memory_order_relaxed)) {
+    return;
+  }
+  Record({.Name = Name, .Begin = Begin, .End = Now(), .Tile = Tile, .HasTile = HasTile});
+}
@@ -0,0 +1,246 @@
+#include "wide_bvh.hpp"
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "math.hpp"
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+using namespace softrays;
+
+namespace {
+constexpr auto Width = WideBvhNode::Width;
+
+// Entry distance into each child the ray hits inside `ray_time`; returns a bit per child hit
+unsigned IntersectChildren(const WideBvhNode& node, const Point3& origin, const Vec3& inverse_direction, const Interval& ray_time, std::array<double, Width>& entry) noexcept
+{
+  unsigned mask = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+  const auto origin_x = _mm_set1_pd(origin.x);
+  const auto origin_y = _mm_set1_pd(origin.y);
+  const auto origin_z = _mm_set1_pd(origin.z);
+  const auto inverse_x = _mm_set1_pd(inverse_direction.x);
+  const auto inverse_y = _mm_set1_pd(inverse_direction.y);
+  const auto inverse_z = _mm_set1_pd(inverse_direction.z);
+  for (std::size_t lane = 0; lane < Width; lane += 2) {
+    auto t_min = _mm_set1_pd(ray_time.Min);
+    auto t_max = _mm_set1_pd(ray_time.Max);
+    auto slab = [&](const double* min, const double* max, __m128d slab_origin, __m128d inverse) {
+      const auto t0 = _mm_mul_pd(_mm_sub_pd(_mm_load_pd(min), slab_origin), inverse);
+      const auto t1 = _mm_mul_pd(_mm_sub_pd(_mm_load_pd(max), slab_origin), inverse);
+      // With a NaN operand (a ray in the plane of the slab) min/max return their second operand,
+      // which leaves the interval alone
+      t_min = _mm_max_pd(_mm_min_pd(t0, t1), t_min);
+      t_max = _mm_min_pd(_mm_max_pd(t0, t1), t_max);
+    };
+    slab(&node.MinX[lane], &node.MaxX[lane], origin_x, inverse_x);
+    slab(&node.MinY[lane], &node.MaxY[lane], origin_y, inverse_y);
+    slab(&node.MinZ[lane], &node.MaxZ[lane], origin_z, inverse_z);
+    _mm_storeu_pd(&entry[lane], t_min);
+    mask |= static_cast<unsigned>(_mm_movemask_pd(_mm_cmple_pd(t_min, t_max))) << lane;
+  }
+#else
+  for (std::size_t lane = 0; lane < Width; ++lane) {
+    const auto box = Aabb{
+        .X = {.Min = node.MinX[lane], .Max = node.MaxX[lane]},
+        .Y = {.Min = node.MinY[lane], .Max = node.MaxY[lane]},
+        .Z = {.Min = node.MinZ[lane], .Max = node.MaxZ[lane]},
+    };
+    auto box_time = ray_time;
+    if (box.Hit(origin, inverse_direction, box_time)) {
+      entry[lane] = box_time.Min;
+      mask |= 1U << lane;
+    }
+  }
+#endif
+  return mask & ((1U << node.ChildCount) - 1);
+}
+}
+
+WideBvh::WideBvh(const std::vector<std::shared_ptr<Hittable>>& objects)
+{
+  SOFTRAYS_TRACE_SCOPE("BuildWideBvh");
+  auto partition = PartitionByBounds(objects);
+  Unbounded = std::move(partition.Unbounded);
+  const auto layout = BuildBvh(partition.Bounds);
+  Objects.reserve(partition.Bounded.size());
+  for (const auto index : layout.Order) {
+    Objects.push_back(partition.Bounded[index]);
+  }
+  if (!Unbounded.empty()) {
+    RootBounds = Hittable::BoundingBox();
+  }
+  if (layout.Nodes.empty()) {
+    return;
+  }
+
+  if (Unbounded.empty()) {
+    RootBounds = layout.Nodes.front().Bounds;
+  }
+  Collapse(layout, 0);
+}
+
+// Emits a wide node for binary node `node` by pulling up grandchildren, biggest box first, until
+// it has Width children or only leaves are left
+std::uint32_t WideBvh::Collapse(const BvhLayout& layout, std::uint32_t node)
+{
+  std::vector<std::uint32_t> children;
+  if (layout.Nodes[node].IsLeaf()) {
+    children.push_back(node);
+  } else {
+    children = {node + 1, layout.Nodes[node].Offset};
+  }
+  while (children.size() < Width) {
+    auto biggest = children.end();
+    for (auto child = children.begin(); child != children.end(); ++child) {
+      if (!layout.Nodes[*child].IsLeaf()
+          && (biggest == children.end() || layout.Nodes[*child].Bounds.SurfaceArea() > layout.Nodes[*biggest].Bounds.SurfaceArea())) {
+        biggest = child;
+      }
+    }
+    if (biggest == children.end()) {
+      break;
+    }
+    const auto expanded = *biggest;
+    *biggest = expanded + 1;
+    children.insert(biggest + 1, layout.Nodes[expanded].Offset);
+  }
+
+  const auto index = static_cast<std::uint32_t>(Nodes.size());
+  Nodes.emplace_back();
+  Nodes[index].ChildCount = static_cast<std::uint8_t>(children.size());
+  for (std::size_t lane = 0; lane < children.size(); ++lane) {
+    const auto& child = layout.Nodes[children[lane]];
+    Nodes[index].MinX[lane] = child.Bounds.X.Min;
+    Nodes[index].MinY[lane] = child.Bounds.Y.Min;
+    Nodes[index].MinZ[lane] = child.Bounds.Z.Min;
+    Nodes[index].MaxX[lane] = child.Bounds.X.Max;
+    Nodes[index].MaxY[lane] = child.Bounds.Y.Max;
+    Nodes[index].MaxZ[lane] = child.Bounds.Z.Max;
+    if (child.IsLeaf()) {
+      Nodes[index].Child[lane] = child.Offset;
+      Nodes[index].Count[lane] = child.Count;
+    } else {
+      const auto collapsed = Collapse(layout, children[lane]);
+      Nodes[index].Child[lane] = collapsed;
+    }
+  }
+  return index;
+}
+
+bool WideBvh::Hit(const Ray& ray, Interval ray_time, HitData& hit) const
+{
+  const auto hit_unbounded = HitClosest(Unbounded, ray, ray_time, hit);
+  if (Nodes.empty()) {
+    return hit_unbounded;
+  }
+
+  const auto inverse_direction = Aabb::InverseDirection(ray.Direction);
+
+  struct Entry {
+    double Distance;  // Where the ray enters the box, to skip it once something nearer was hit
+    std::uint32_t Child;
+    std::uint16_t Count;
+  };
+  // Each level pushes at most Width - 1 entries beyond the one it pops
+  constexpr std::size_t stack_size = 256;
+  std::array<Entry, stack_size> stack{};
+  std::size_t top = 0;
+  stack[top++] = {.Distance = ray_time.Min, .Child = 0, .Count = 0};
+
+  HitData temp_hit{};
+  bool hit_anything = hit_unbounded;
+  while (top > 0) {
+    const auto entry = stack[--top];
+    if (entry.Distance > ray_time.Max) {
+      continue;
+    }
+
+    if (entry.Count > 0) {
+      for (auto object = entry.Child; object < entry.Child + entry.Count; ++object) {
+        if (Objects[object]->Hit(ray, ray_time, temp_hit)) {
+          ray_time.Max = temp_hit.Time;
+          hit_anything = true;
+          hit = temp_hit;
+        }
+      }
+      continue;
+    }
+
+    const auto& node = Nodes[entry.Child];
+    std::array<double, Width> distance{};
+    auto mask = IntersectChildren(node, ray.Origin, inverse_direction, ray_time, distance);
+
+    // Sort the hit children far to near, so the nearest ends up on top of the stack
+    std::array<std::size_t, Width> order{};
+    std::size_t hits = 0;
+    for (std::size_t lane = 0; lane < Width; ++lane, mask >>= 1U) {
+      if ((mask & 1U) != 0) {
+        auto position = hits++;
+        for (; position > 0 && distance[order[position - 1]] < distance[lane]; --position) {
+          order[position] = order[position - 1];
+        }
+        order[position] = lane;
+      }
+    }
+    for (std::size_t i = 0; i < hits; ++i) {
+      const auto lane = order[i];
+      stack[top++] = {.Distance = distance[lane], .Child = node.Child[lane], .Count = node.Count[lane]};
+    }
+  }
+  return hit_anything;
+}
+
+bool WideBvh::Occluded(const Ray& ray, Interval ray_time) const
+{
+  if (AnyOccludes(Unbounded, ray, ray_time)) {
+    return true;
+  }
+  if (Nodes.empty()) {
+    return false;
+  }
+
+  const auto inverse_direction = Aabb::InverseDirection(ray.Direction);
+
+  // Any hit will do, so children are visited in slot order, without the entry distances
+  struct Entry {
+    std::uint32_t Child;
+    std::uint16_t Count;
+  };
+  constexpr std::size_t stack_size = 256;
+  std::array<Entry, stack_size> stack{};
+  std::size_t top = 0;
+  stack[top++] = {.Child = 0, .Count = 0};
+
+  while (top > 0) {
+    const auto entry = stack[--top];
+    if (entry.Count > 0) {
+      for (auto object = entry.Child; object < entry.Child + entry.Count; ++object) {
+        if (Objects[object]->Occluded(ray, ray_time)) {
+          return true;
+        }
+      }
+      continue;
+    }
+
+    const auto& node = Nodes[entry.Child];
+    std::array<double, Width> distance{};
+    auto mask = IntersectChildren(node, ray.Origin, inverse_direction, ray_time, distance);
+    for (std::size_t lane = 0; lane < Width; ++lane, mask >>= 1U) {
+      if ((mask & 1U) != 0) {
+        stack[top++] = {.Child = node.Child[lane], .Count = node.Count[lane]};
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,116 @@
+#include "arena.hpp"
+#include "material.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "shapes.hpp"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+using softrays::Colour;
+using softrays::Lambertian;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::SceneArena;
+using softrays::Sphere;
+
+namespace {
+struct Counted {
+  int* Destroyed;
+  explicit Counted(int* destroyed) : Destroyed(destroyed) { }
+  Counted(const Counted&) = delete;
+  Counted(Counted&&) = delete;
+  Counted& operator=(const Counted&) = delete;
+  Counted& operator=(Counted&&) = delete;
+  ~Counted() { ++*Destroyed; }
+};
+
+struct alignas(64) Aligned {
+  std::byte Data{};
+};
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("SceneArena hands out contiguous, non-owning objects")
+{
+  SceneArena arena;
+  const auto material = arena.Make<Lambertian>(Colour(0.5, 0.5, 0.5));
+  const auto first = arena.Make<Sphere>(Point3(0, 0, 0), 1, material);
+  const auto second = arena.Make<Sphere>(Point3(0, 0, 1), 1, material);
+
+  // No control block, so nothing is reference counted
+  REQUIRE(first.use_count() == 0);
+  REQUIRE(first->GetMaterial().get() == material.get());
+  REQUIRE(arena.Owns(first.get()));
+  REQUIRE(arena.Owns(material.get()));
+  REQUIRE_FALSE(arena.Owns(&arena));
+
+  const auto* first_bytes = reinterpret_cast<const std::byte*>(first.get());  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+  const auto* second_bytes = reinterpret_cast<const std::byte*>(second.get());  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+  REQUIRE(static_cast<std::size_t>(second_bytes - first_bytes) < sizeof(Sphere) + alignof(Sphere));
+
+  const auto aligned = arena.Make<Aligned>();
+  REQUIRE(reinterpret_cast<std::uintptr_t>(aligned.get()) % 64 == 0);  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+
+TEST_CASE("SceneArena Reset destroys everything and reuses its memory")
+{
+  SceneArena arena(256);
+  int destroyed = 0;
+  for (int i = 0; i < 100; ++i) {
+    [[maybe_unused]] const auto counted = arena.Make<Counted>(&destroyed);
+  }
+  REQUIRE(destroyed == 0);
+  REQUIRE(arena.BlockCount() > 1);
+
+  arena.Reset();
+  REQUIRE(destroyed == 100);
+  REQUIRE(arena.BlockCount() == 1);
+  REQUIRE(arena.BytesUsed() == 0);
+
+  // The kept block is the biggest, so a second, smaller scene fits in it
+  for (int i = 0; i < 10; ++i) {
+    [[maybe_unused]] const auto counted = arena.Make<Counted>(&destroyed);
+  }
+  REQUIRE(arena.BlockCount() == 1);
+}
+
+TEST_CASE("Scenes populate into an arena")
+{
+  SceneArena arena;
+  RayTracer raytracer;
+  raytracer.ResizeViewport({.Width = 8, .Height = 8});
+  raytracer.SetSamplesPerPixel(1);
+  raytracer.MaxDepth = 3;
+  const auto scene = softrays::RandomSphereScene();
+  REQUIRE(scene.Populate(raytracer, arena));
+  REQUIRE(raytracer.GetWorld().Size() == scene.Spheres.size() + scene.Planes.size());
+  REQUIRE(arena.Owns(raytracer.GetWorld().GetObjects().front().get()));
+  raytracer.Render();
+
+  raytracer.GetWorld().Clear();
+  arena.Reset();
+  REQUIRE(arena.BytesUsed() == 0);
+}
+TEST_CASE("Scene construction and teardown on the heap against an arena", "[.][benchmark]")
+{
+  const auto scene = softrays::RandomSphereScene();
+  BENCHMARK("make_shared")
+  {
+    RayTracer raytracer;
+    return scene.Populate(raytracer);
+  };
+  SceneArena arena;
+  BENCHMARK("SceneArena")
+  {
+    RayTracer raytracer;
+    const auto populated = scene.Populate(raytracer, arena);
+    raytracer.GetWorld().Clear();
+    arena.Reset();
+    return populated;
+  };
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,266 @@
+#include "async_render.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "shapes.hpp"
+#include "utility.hpp"
+
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using softrays::AsyncRenderer;
+using softrays::Colour;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::TileRect;
+
+namespace {
+void SetupScene(RayTracer& raytracer, int size, int samples)
+{
+  raytracer.ResizeViewport({.Width = size, .Height = size});
+  raytracer.SetSamplesPerPixel(samples);
+  raytracer.MaxDepth = 8;
+  raytracer.LookFrom = Point3(0, 0, 3);
+  raytracer.LookAt = Point3(0, 0, 0);
+  raytracer.GetWorld().Add(std::make_shared<softrays::Sphere>(Point3(0, 0, 0), 1.0, std::make_shared<softrays::Lambertian>(Colour(0.5, 0.5, 0.5))));
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("AsyncRenderer delivers every tile of the frame once")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, 40, 2);
+
+  AsyncRenderer renderer(4);
+  std::atomic<int> callbacks{0};
+  renderer.Start(raytracer, 16, [&callbacks](const TileRect&) { ++callbacks; });
+
+  std::vector<int> covered(40 * 40, 0);
+  std::size_t tiles = 0;
+  while (tiles < 9) {
+    for (const auto& tile : renderer.TakeCompletedTiles()) {
+      ++tiles;
+      for (int y = tile.FromY; y < tile.ToY; ++y) {
+        for (int x = tile.FromX; x < tile.ToX; ++x) {
+          ++covered[static_cast<std::size_t>((y * 40) + x)];
+        }
+      }
+    }
+    std::this_thread::yield();
+  }
+  renderer.Wait();
+  REQUIRE(renderer.Done());
+  REQUIRE(callbacks == 9);
+  REQUIRE(renderer.TakeCompletedTiles().empty());
+  for (const auto count : covered) {
+    REQUIRE(count == 1);
+  }
+  // The sphere fills the middle of the frame
+  REQUIRE(raytracer.GetPixelData()[(20 * 40) + 20].x > 0.0);
+}
+
+TEST_CASE("AsyncRenderer queues tiles centre first")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, 40, 2);
+
+  // One thread finishes tiles in the order they were queued
+  AsyncRenderer renderer(1);
+  renderer.Start(raytracer, 16);
+  renderer.Wait();
+  const auto tiles = renderer.TakeCompletedTiles();
+  REQUIRE(tiles.size() == 9);
+  REQUIRE(tiles.front().FromX == 16);
+  REQUIRE(tiles.front().FromY == 16);
+}
+
+TEST_CASE("AsyncRenderer cancels a job within a tile's latency")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, 256, 64);
+
+  AsyncRenderer renderer(2);
+  renderer.Start(raytracer, 16);
+  const auto generation = renderer.Generation();
+  while (renderer.TakeCompletedTiles().empty()) {
+    std::this_thread::yield();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  renderer.Cancel();
+  const auto cancel_time = std::chrono::steady_clock::now() - start;
+  REQUIRE(renderer.Done());
+  REQUIRE(renderer.TakeCompletedTiles().empty());
+  // Nowhere near the whole 256-tile frame's worth of tracing
+  REQUIRE(cancel_time < std::chrono::seconds(5));
+
+  // The raytracer can be changed and the next job started straight away
+  raytracer.ResizeViewport({.Width = 32, .Height = 32});
+  raytracer.SetSamplesPerPixel(1);
+  renderer.Start(raytracer, 16);
+  REQUIRE(renderer.Generation() > generation);
+  renderer.Wait();
+  REQUIRE(renderer.TakeCompletedTiles().size() == 4);
+}
+
+TEST_CASE("AsyncRenderer cancels without waiting for the tiles being traced")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, 64, 128);
+
+  // One tile, which takes the worker a while
+  AsyncRenderer renderer(1);
+  renderer.Start(raytracer, 64);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  const auto start = std::chrono::steady_clock::now();
+  renderer.Cancel();
+  const auto cancel_time = std::chrono::steady_clock::now() - start;
+  // The tile traces the job's copy of the camera, so this one may move straight away
+  raytracer.LookFrom = Point3(0, 0, 5);
+  renderer.CancelAndWait();
+  const auto tile_time = std::chrono::steady_clock::now() - start;
+  REQUIRE(cancel_time * 10 < tile_time);
+
+  // The cancelled tile never reached the frame
+  const auto& pixels = raytracer.GetPixelData();
+  for (std::size_t pixel = 0; pixel < pixels.size(); ++pixel) {
+    REQUIRE(pixels[pixel].x == 0.0);
+  }
+}
+
+TEST_CASE("AsyncRenderer frames build on each other's history")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, 32, 2);
+  raytracer.TemporalReuse = true;
+
+  // What each job's copy of the raytracer traced is copied back, with the surfaces and sample
+  // counts the next frame reuses
+  AsyncRenderer renderer(2);
+  for (int frame = 0; frame < 3; ++frame) {
+    renderer.Start(raytracer, 16);
+    renderer.Wait();
+  }
+  REQUIRE(raytracer.GetSampleCounts()[(16 * 32) + 16] == 6.0);
+}
+
+TEST_CASE("Starting a new job replaces the one in flight")
+{
+  RayTracer first;
+  SetupScene(first, 128, 32);
+  RayTracer second;
+  SetupScene(second, 32, 1);
+
+  AsyncRenderer renderer(2);
+  renderer.Start(first, 16);
+  renderer.Start(second, 16);
+  renderer.Wait();
+  // Only the second job's tiles are reported
+  const auto tiles = renderer.TakeCompletedTiles();
+  REQUIRE(tiles.size() == 4);
+  for (const auto& tile : tiles) {
+    REQUIRE(tile.ToX <= 32);
+    REQUIRE(tile.ToY <= 32);
+  }
+}
+
+TEST_CASE("Preview passes refine the frame coarse to fine")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, 64, 1);
+  raytracer.BeginFrame();
+  const auto& pixels = raytracer.GetPixelData();
+  auto at = [&pixels](int x, int y) { return pixels[static_cast<std::size_t>((y * 64) + x)]; };
+  auto same = [](const Colour& a, const Colour& b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+
+  // One first-hit sample per 16x16 block, headlit: the sphere's centre faces the camera
+  raytracer.RenderPreviewTile({.FromX = 0, .FromY = 0, .ToX = 64, .ToY = 64}, 16, false);
+  REQUIRE(at(32, 32).x > 0.45);
+  REQUIRE(at(32, 32).x < 0.51);
+  for (int y = 0; y < 64; ++y) {
+    for (int x = 0; x < 64; ++x) {
+      REQUIRE(same(at(x, y), at(x - (x % 16), y - (y % 16))));
+    }
+  }
+
+  // A refining pass keeps the samples the coarse one took, and fills its blocks on tile edges that aren't aligned to them
+  const auto kept = at(32, 32);
+  raytracer.RenderPreviewTile({.FromX = 0, .FromY = 0, .ToX = 64, .ToY = 64}, 8, true);
+  raytracer.RenderPreviewTile({.FromX = 4, .FromY = 4, .ToX = 60, .ToY = 60}, 4, true);
+  REQUIRE(same(at(32, 32), kept));
+  REQUIRE(same(at(5, 5), at(4, 4)));
+  REQUIRE(same(at(59, 59), at(56, 56)));
+}
+
+TEST_CASE("AsyncRenderer previews the whole frame first and finishes on the same image")
+{
+  // Only the emitted light reaches the camera, so the final frame doesn't depend on random numbers
+  auto emissive_scene = [](RayTracer& raytracer) {
+    raytracer.ResizeViewport({.Width = 64, .Height = 64});
+    raytracer.SetSamplesPerPixel(1);
+    raytracer.MaxDepth = 1;
+    raytracer.SkyBackground = false;
+    raytracer.LookFrom = Point3(0, 0, 3);
+    raytracer.LookAt = Point3(0, 0, 0);
+    raytracer.GetWorld().Add(std::make_shared<softrays::Sphere>(Point3(0, 0, 0), 1.0, std::make_shared<softrays::DiffuseLight>(Colour(2, 2, 2))));
+  };
+  RayTracer reference;
+  emissive_scene(reference);
+  RayTracer previewed;
+  emissive_scene(previewed);
+
+  AsyncRenderer renderer(1);
+  renderer.Start(reference, 16);
+  renderer.Wait();
+  REQUIRE(renderer.TakeCompletedTiles().size() == 16);
+
+  // With one worker the tiles' preview passes all finish before the first full render
+  constexpr auto previewTiles = 16 * AsyncRenderer::PreviewSteps.size();
+  std::size_t callbacks = 0;
+  double coarse_corner = 0;
+  renderer.StartWithPreview(previewed, 16, [&](const TileRect&) {
+    if (++callbacks == 16) {
+      // After the first pass over every tile, the light's 16x16 block reaches past its edge
+      coarse_corner = previewed.GetPixelData()[(47 * 64) + 47].x;
+    }
+  });
+  renderer.Wait();
+  REQUIRE(coarse_corner > 1.0);
+  REQUIRE(callbacks == previewTiles + 16);
+  REQUIRE(renderer.TakeCompletedTiles().size() == previewTiles + 16);
+  for (std::size_t pixel = 0; pixel < 64 * 64; ++pixel) {
+    const auto expected = reference.GetPixelData()[pixel];
+    const auto actual = previewed.GetPixelData()[pixel];
+    REQUIRE(actual.x == expected.x);
+    REQUIRE(actual.y == expected.y);
+    REQUIRE(actual.z == expected.z);
+  }
+}
+
+TEST_CASE("AsyncRenderer hands over finished tiles as RGBA")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, 48, 2);
+
+  AsyncRenderer renderer(4);
+  renderer.StartWithPreview(raytracer, 16);
+  std::vector<std::uint8_t> rgba;
+  std::size_t tiles = 0;
+  while (!renderer.Done()) {
+    tiles += renderer.TakeCompletedTiles(rgba).size();
+    std::this_thread::yield();
+  }
+  tiles += renderer.TakeCompletedTiles(rgba).size();
+  REQUIRE(tiles == 9 * (AsyncRenderer::PreviewSteps.size() + 1));
+  // Each tile's last delivery was its full render, so the copies add up to the finished frame
+  REQUIRE(rgba == raytracer.GetRGBAData());
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
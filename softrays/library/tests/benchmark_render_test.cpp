@@ -35,4 +35,48 @@ TEST_CASE("softrays Benchmarking")
     return raytracer.GetPixelData();
   };
 }
+
+// One benchmark per render kernel instantiation, see RayTracer::SelectKernels
+TEST_CASE("softrays Render kernel Benchmarking")
+{
+  RayTracer raytracer;
+  raytracer.ResizeViewport({.Width = 64, .Height = 64});
+  raytracer.MaxDepth = 5;
+  raytracer.LookFrom = Point3(13, 2, 3);
+  raytracer.LookAt = Point3(0, 0, 0);
+  raytracer.FocusDistance = 10.0;
+  auto& world = raytracer.GetWorld();
+  world.Add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(Colour{0.5, 0.5, 0.5})));
+  world.Add(make_shared<Sphere>(Point3(0, 1, 0), 1.0, std::make_shared<Dielectric>(1.5)));
+  world.Add(make_shared<Sphere>(Point3(4, 1, 0), 1.0, std::make_shared<Metal>(Colour{0.7, 0.6, 0.5}, 0.0)));
+
+  raytracer.SetSamplesPerPixel(1);
+  BENCHMARK("Single sample")
+  {
+    raytracer.Render();
+    return raytracer.GetPixelData()[0];
+  };
+
+  raytracer.SetSamplesPerPixel(4);
+  BENCHMARK("Multi-sample")
+  {
+    raytracer.Render();
+    return raytracer.GetPixelData()[0];
+  };
+
+  raytracer.DefocusAngle = 0.6;
+  BENCHMARK("Multi-sample with defocus")
+  {
+    raytracer.Render();
+    return raytracer.GetPixelData()[0];
+  };
+
+  raytracer.DefocusAngle = 0;
+  raytracer.TemporalReuse = true;
+  BENCHMARK("Multi-sample with temporal history")
+  {
+    raytracer.Render();
+    return raytracer.GetPixelData()[0];
+  };
+}
 // NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
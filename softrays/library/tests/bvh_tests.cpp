@@ -0,0 +1,207 @@
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "scene.hpp"
+#include "shapes.hpp"
+#include "utility.hpp"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using softrays::Aabb;
+using softrays::Bvh;
+using softrays::HitData;
+using softrays::HittableList;
+using softrays::Interval;
+using softrays::Point3;
+using softrays::Ray;
+using softrays::Vec3;
+
+namespace {
+HittableList RandomSpheres(std::uint32_t seed)
+{
+  HittableList list;
+  const auto scene = softrays::RandomSphereScene(seed);
+  for (const auto& sphere : scene.Spheres) {
+    list.Add(std::make_shared<softrays::Sphere>(sphere.Center, sphere.Radius, scene.Materials[sphere.Material].Build()));
+  }
+  return list;
+}
+
+Ray RandomRay()
+{
+  const Point3 origin{.x = RandomDouble(-12, 12), .y = RandomDouble(0.1, 4), .z = RandomDouble(-12, 12)};
+  return {.Origin = origin, .Direction = Vec3::RandomUnitVector()};
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Aabb slab test")
+{
+  const auto box = Aabb::FromPoints(Point3(1, 1, 1), Point3(-1, -1, -1));
+  REQUIRE(box.Hit({.Origin = Point3(0, 0, -5), .Direction = Vec3(0, 0, 1)}, {.Min = 0, .Max = 100}));
+  REQUIRE_FALSE(box.Hit({.Origin = Point3(0, 0, -5), .Direction = Vec3(0, 0, -1)}, {.Min = 0, .Max = 100}));
+  REQUIRE_FALSE(box.Hit({.Origin = Point3(0, 0, -5), .Direction = Vec3(0, 0, 1)}, {.Min = 0, .Max = 3}));
+  // Parallel to a slab, inside and outside it
+  REQUIRE(box.Hit({.Origin = Point3(0.5, 0, -5), .Direction = Vec3(0, 0, 1)}, {.Min = 0, .Max = 100}));
+  REQUIRE_FALSE(box.Hit({.Origin = Point3(2, 0, -5), .Direction = Vec3(0, 0, 1)}, {.Min = 0, .Max = 100}));
+
+  auto ray_time = Interval{.Min = 0, .Max = 100};
+  REQUIRE(box.Hit(Point3(0, 0, -5), Aabb::InverseDirection(Vec3(0, 0, 1)), ray_time));
+  REQUIRE_THAT(ray_time.Min, WithinAbs(4.0, 1e-12));
+  REQUIRE_THAT(ray_time.Max, WithinAbs(6.0, 1e-12));
+
+  REQUIRE_THAT(box.SurfaceArea(), WithinAbs(24.0, 1e-12));
+  REQUIRE(Aabb{}.IsEmpty());
+}
+
+TEST_CASE("Bvh finds the same closest hits as a linear list")
+{
+  const auto list = RandomSpheres(3);
+  const Bvh bvh(list.GetObjects());
+  REQUIRE(bvh.Size() == list.Size());
+
+  // Children lie inside their parent
+  const auto nodes = bvh.GetNodes();
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    if (!nodes[i].IsLeaf()) {
+      for (const auto child : {i + 1, static_cast<std::size_t>(nodes[i].Offset)}) {
+        REQUIRE(Aabb::Merge(nodes[i].Bounds, nodes[child].Bounds).SurfaceArea() == nodes[i].Bounds.SurfaceArea());
+      }
+    }
+  }
+
+  int hits = 0;
+  for (int i = 0; i < 2000; ++i) {
+    const auto ray = RandomRay();
+    HitData expected;
+    HitData actual;
+    const auto list_hit = list.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, expected);
+    const auto bvh_hit = bvh.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, actual);
+    REQUIRE(list_hit == bvh_hit);
+    if (list_hit) {
+      ++hits;
+      REQUIRE(actual.Time == expected.Time);
+      REQUIRE(actual.Material == expected.Material);
+    }
+  }
+  REQUIRE(hits > 100);
+}
+
+TEST_CASE("Occlusion queries agree with closest hits")
+{
+  const auto list = RandomSpheres(4);
+  const Bvh bvh(list.GetObjects());
+
+  int occluded = 0;
+  for (int i = 0; i < 2000; ++i) {
+    const auto ray = RandomRay();
+    // Short segments too, like shadow rays to a light, so the interval's end matters
+    for (const auto max : {softrays::Infinity, RandomDouble(0.1, 4)}) {
+      const Interval ray_time{.Min = 0.001, .Max = max};
+      HitData hit;
+      const auto expected = list.Hit(ray, ray_time, hit);
+      REQUIRE(list.Occluded(ray, ray_time) == expected);
+      REQUIRE(bvh.Occluded(ray, ray_time) == expected);
+      occluded += expected ? 1 : 0;
+    }
+  }
+  REQUIRE(occluded > 100);
+  REQUIRE(occluded < 3900);
+}
+
+TEST_CASE("Bvh handles degenerate inputs")
+{
+  HittableList same_place;
+  for (int i = 0; i < 100; ++i) {
+    same_place.Add(std::make_shared<softrays::Sphere>(Point3(0, 0, -3), 1.0, std::make_shared<softrays::Lambertian>(softrays::Colour(0.5, 0.5, 0.5))));
+  }
+  const Bvh bvh(same_place.GetObjects());
+  HitData hit;
+  REQUIRE(bvh.Hit({.Origin = Point3(0, 0, 0), .Direction = Vec3(0, 0, -1)}, {.Min = 0.001, .Max = softrays::Infinity}, hit));
+  REQUIRE_THAT(hit.Time, WithinAbs(2.0, 1e-12));
+
+  const Bvh empty({});
+  REQUIRE_FALSE(empty.Hit({.Origin = Point3(0, 0, 0), .Direction = Vec3(0, 0, -1)}, {.Min = 0.001, .Max = softrays::Infinity}, hit));
+}
+
+TEST_CASE("Bvh against HittableList on the final scene", "[.][benchmark]")
+{
+  const auto list = RandomSpheres(0);
+  const Bvh bvh(list.GetObjects());
+  std::vector<Ray> rays;
+  for (int i = 0; i < 10000; ++i) {
+    rays.push_back(RandomRay());
+  }
+
+  BENCHMARK("HittableList")
+  {
+    int hits = 0;
+    HitData hit;
+    for (const auto& ray : rays) {
+      hits += list.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, hit) ? 1 : 0;
+    }
+    return hits;
+  };
+  BENCHMARK("Bvh")
+  {
+    int hits = 0;
+    HitData hit;
+    for (const auto& ray : rays) {
+      hits += bvh.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, hit) ? 1 : 0;
+    }
+    return hits;
+  };
+}
+
+TEST_CASE("Occluded against Hit on the final scene", "[.][benchmark]")
+{
+  const auto list = RandomSpheres(0);
+  const Bvh bvh(list.GetObjects());
+  std::vector<Ray> rays;
+  for (int i = 0; i < 10000; ++i) {
+    rays.push_back(RandomRay());
+  }
+
+  BENCHMARK("HittableList Hit")
+  {
+    int hits = 0;
+    HitData hit;
+    for (const auto& ray : rays) {
+      hits += list.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, hit) ? 1 : 0;
+    }
+    return hits;
+  };
+  BENCHMARK("HittableList Occluded")
+  {
+    int hits = 0;
+    for (const auto& ray : rays) {
+      hits += list.Occluded(ray, {.Min = 0.001, .Max = softrays::Infinity}) ? 1 : 0;
+    }
+    return hits;
+  };
+  BENCHMARK("Bvh Hit")
+  {
+    int hits = 0;
+    HitData hit;
+    for (const auto& ray : rays) {
+      hits += bvh.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, hit) ? 1 : 0;
+    }
+    return hits;
+  };
+  BENCHMARK("Bvh Occluded")
+  {
+    int hits = 0;
+    for (const auto& ray : rays) {
+      hits += bvh.Occluded(ray, {.Min = 0.001, .Max = softrays::Infinity}) ? 1 : 0;
+    }
+    return hits;
+  };
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,68 @@
+#include "camera_rig.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+using Catch::Matchers::WithinAbs;
+using softrays::CameraRig;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::Vec3;
+
+namespace {
+void RequireNear(const Vec3& actual, const Vec3& expected)
+{
+  REQUIRE_THAT(actual.x, WithinAbs(expected.x, 1e-9));
+  REQUIRE_THAT(actual.y, WithinAbs(expected.y, 1e-9));
+  REQUIRE_THAT(actual.z, WithinAbs(expected.z, 1e-9));
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("CameraRig reproduces the camera it was made from")
+{
+  const auto rig = CameraRig::FromLookAt(Point3(13, 2, 3), Point3(0, 0, 0));
+  RequireNear(rig.Eye(), Point3(13, 2, 3));
+  RequireNear(rig.Forward(), (Point3(0, 0, 0) - Point3(13, 2, 3)).UnitVector());
+  REQUIRE_THAT(rig.Right().Dot(rig.Forward()), WithinAbs(0.0, 1e-12));
+  REQUIRE_THAT(rig.Right().y, WithinAbs(0.0, 1e-12));
+
+  RayTracer raytracer;
+  rig.ApplyTo(raytracer);
+  RequireNear(raytracer.LookFrom, Point3(13, 2, 3));
+  RequireNear(raytracer.LookAt, Point3(0, 0, 0));
+  REQUIRE_THAT(raytracer.FocusDistance, WithinAbs(Vec3(13, 2, 3).Length(), 1e-9));
+}
+
+TEST_CASE("CameraRig orbits, zooms and flies")
+{
+  auto rig = CameraRig::FromLookAt(Point3(0, 0, 5), Point3(0, 0, 0));
+
+  SECTION("Orbiting keeps the distance and stops short of the poles")
+  {
+    rig.Orbit(softrays::Pi / 2, 0);
+    RequireNear(rig.Eye(), Point3(-5, 0, 0));
+    rig.Orbit(0, 10);
+    REQUIRE(rig.Eye().y < 5);
+    REQUIRE(rig.Eye().y > 4.99);
+    REQUIRE_THAT((rig.Eye() - rig.Target).Length(), WithinAbs(5.0, 1e-9));
+  }
+
+  SECTION("Zooming scales the distance but never reaches the target")
+  {
+    rig.Zoom(0.5);
+    RequireNear(rig.Eye(), Point3(0, 0, 2.5));
+    rig.Zoom(0);
+    REQUIRE(rig.Distance >= CameraRig::MinDistance);
+  }
+
+  SECTION("Flying moves the eye and the target together")
+  {
+    rig.Fly(1, 2, 3);
+    RequireNear(rig.Target, Point3(2, 3, -1));
+    RequireNear(rig.Eye(), Point3(2, 3, 4));
+  }
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,124 @@
+#include "checkpoint.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "utility.hpp"
+
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+using softrays::CheckpointOptions;
+using softrays::RayTracer;
+
+namespace {
+std::string CheckpointPath(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / ("softrays_" + name + ".checkpoint")).string();
+}
+
+void SetupTracer(RayTracer& raytracer, const softrays::PreparedScene& scene)
+{
+  auto camera = softrays::RandomSphereCamera();
+  camera.Dimensions = {.Width = 32, .Height = 24};  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  camera.SamplesPerPixel = 8;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  camera.MaxDepth = 4;  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+  camera.Apply(raytracer, false);
+  scene.AttachTo(raytracer);
+}
+
+// Misses everything, counting the rays that tried
+class RayCounter : public softrays::Hittable {
+  public:
+  mutable std::atomic<int> Rays{0};
+
+  [[nodiscard]] bool Hit([[maybe_unused]] const softrays::Ray& ray, [[maybe_unused]] softrays::Interval ray_time, [[maybe_unused]] softrays::HitData& hit) const override
+  {
+    ++Rays;
+    return false;
+  }
+};
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("A render stopped and resumed from its checkpoint matches an uninterrupted one")
+{
+  const auto prepared = softrays::RandomSphereScene(1).Prepare();
+  REQUIRE(prepared.has_value());
+  const auto path = CheckpointPath("resume");
+  std::filesystem::remove(path);
+
+  RayTracer raytracer;
+  SetupTracer(raytracer, *prepared);
+  const CheckpointOptions base{.TileSize = 8, .SamplesPerPass = 2, .Threads = 3, .Seed = 7, .SceneKey = 11};
+  const auto uninterrupted = softrays::RenderWithCheckpoints(raytracer, base);
+  REQUIRE(uninterrupted.has_value());
+
+  // 12 tiles of 4 passes each: stop part way through
+  auto options = base;
+  options.Path = path;
+  options.IntervalSeconds = 3600;
+  std::atomic<int> passes{0};
+  options.ShouldStop = [&passes] { return ++passes > 20; };
+  REQUIRE_FALSE(softrays::RenderWithCheckpoints(raytracer, options).has_value());
+  REQUIRE(std::filesystem::exists(path));
+
+  options.ShouldStop = {};
+  const auto resumed = softrays::RenderWithCheckpoints(raytracer, options);
+  REQUIRE(resumed.has_value());
+  REQUIRE(resumed->Pixels == uninterrupted->Pixels);
+
+  // Finished: a rerun only reads the checkpoint back
+  options.ShouldStop = [] { return true; };
+  const auto reread = softrays::RenderWithCheckpoints(raytracer, options);
+  REQUIRE(reread.has_value());
+  REQUIRE(reread->Pixels == uninterrupted->Pixels);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Checkpoints of another render are ignored")
+{
+  const auto prepared = softrays::RandomSphereScene(1).Prepare();
+  REQUIRE(prepared.has_value());
+  const auto path = CheckpointPath("mismatch");
+  std::filesystem::remove(path);
+
+  RayTracer raytracer;
+  SetupTracer(raytracer, *prepared);
+  CheckpointOptions options{.Path = path, .TileSize = 8, .SamplesPerPass = 2, .Threads = 2, .Seed = 7, .SceneKey = 11};
+  REQUIRE(softrays::RenderWithCheckpoints(raytracer, options).has_value());
+
+  // A stopped render that can't use the finished checkpoint has nothing to return
+  options.ShouldStop = [] { return true; };
+  options.SceneKey = 12;
+  REQUIRE_FALSE(softrays::RenderWithCheckpoints(raytracer, options).has_value());
+  options.SceneKey = 11;
+  options.Seed = 8;
+  REQUIRE_FALSE(softrays::RenderWithCheckpoints(raytracer, options).has_value());
+  options.Seed = 7;
+  raytracer.LookFrom = raytracer.LookFrom + softrays::Vec3(0, 1, 0);
+  REQUIRE_FALSE(softrays::RenderWithCheckpoints(raytracer, options).has_value());
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("A checkpointed render traces as many samples as an uninterrupted one")
+{
+  RayTracer raytracer;
+  auto counter = std::make_shared<RayCounter>();
+  raytracer.GetWorld().Add(std::shared_ptr<softrays::Hittable>(counter));
+  raytracer.ResizeViewport({.Width = 16, .Height = 8});
+  raytracer.SetSamplesPerPixel(8);
+
+  // Every camera ray misses, so each is one sample
+  raytracer.Render();
+  REQUIRE(counter->Rays == 16 * 8 * 8);
+
+  counter->Rays = 0;
+  const CheckpointOptions options{.TileSize = 8, .SamplesPerPass = 2, .Threads = 2, .Seed = 7, .SceneKey = 11};
+  REQUIRE(softrays::RenderWithCheckpoints(raytracer, options).has_value());
+  REQUIRE(counter->Rays == 16 * 8 * 8);
+  REQUIRE(raytracer.GetSamplesPerPixel() == 8);
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,152 @@
+#include "arena.hpp"
+#include "bvh.hpp"
+#include "compact_bvh.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "scene.hpp"
+#include "shapes.hpp"
+#include "utility.hpp"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+using softrays::Aabb;
+using softrays::Bvh;
+using softrays::CompactBvh;
+using softrays::CompactBvhNode;
+using softrays::HitData;
+using softrays::Hittable;
+using softrays::Point3;
+using softrays::Ray;
+using softrays::Vec3;
+
+namespace {
+// Small spheres scattered through a cube, `count` of them
+std::vector<std::shared_ptr<Hittable>> SphereCloud(softrays::SceneArena& arena, std::size_t count, double size)
+{
+  std::mt19937 generator(11);
+  std::uniform_real_distribution<double> position(-size, size);
+  const auto material = arena.Make<softrays::Lambertian>(softrays::Colour(0.5, 0.5, 0.5));
+  std::vector<std::shared_ptr<Hittable>> objects;
+  objects.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    objects.push_back(arena.Make<softrays::Sphere>(Point3(position(generator), position(generator), position(generator)), 0.05, material));
+  }
+  return objects;
+}
+
+std::vector<Ray> RaysThrough(double size, int count)
+{
+  std::vector<Ray> rays;
+  for (int i = 0; i < count; ++i) {
+    const Point3 origin{.x = RandomDouble(-size, size), .y = RandomDouble(-size, size), .z = RandomDouble(-size, size)};
+    rays.push_back({.Origin = origin, .Direction = Vec3::RandomUnitVector()});
+  }
+  return rays;
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("CompactBvh nodes are small and aligned")
+{
+  STATIC_REQUIRE(sizeof(CompactBvhNode) <= 32);
+  STATIC_REQUIRE(64 % alignof(CompactBvhNode) == 0);
+
+  softrays::SceneArena arena;
+  const CompactBvh bvh(SphereCloud(arena, 1000, 5));
+  for (const auto& node : bvh.GetNodes()) {
+    REQUIRE(reinterpret_cast<std::uintptr_t>(&node) % 32 == 0);  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+  }
+}
+
+TEST_CASE("CompactBvh decoding is conservative")
+{
+  softrays::SceneArena arena;
+  const auto objects = SphereCloud(arena, 5000, 100);
+  const CompactBvh bvh(objects);
+
+  // Walk the tree, checking every decoded leaf box holds its primitives
+  struct Entry {
+    std::uint32_t Node;
+    Aabb Frame;
+  };
+  std::vector<Entry> stack{{.Node = 0, .Frame = bvh.BoundingBox()}};
+  std::size_t primitives = 0;
+  while (!stack.empty()) {
+    const auto entry = stack.back();
+    stack.pop_back();
+    const auto& node = bvh.GetNodes()[entry.Node];
+    for (std::size_t i = 0; i < 2; ++i) {
+      if (node.Child[i] == CompactBvhNode::NoChild) {
+        continue;
+      }
+      const auto box = node.Decode(i, entry.Frame);
+      if (node.Count[i] == 0) {
+        stack.push_back({.Node = node.Child[i], .Frame = box});
+        continue;
+      }
+      primitives += node.Count[i];
+      for (const auto& object : bvh.GetObjects().subspan(node.Child[i], node.Count[i])) {
+        const auto object_box = object->BoundingBox();
+        REQUIRE(Aabb::Merge(box, object_box).SurfaceArea() == box.SurfaceArea());
+      }
+    }
+  }
+  REQUIRE(primitives == objects.size());
+}
+
+TEST_CASE("CompactBvh finds the same closest hits as Bvh")
+{
+  softrays::SceneArena arena;
+  const auto objects = SphereCloud(arena, 20000, 10);
+  const Bvh bvh(objects);
+  const CompactBvh compact(objects);
+  REQUIRE(compact.NodeBytes() * 3 < bvh.GetNodes().size_bytes());
+
+  int hits = 0;
+  for (const auto& ray : RaysThrough(10, 5000)) {
+    HitData expected;
+    HitData actual;
+    const auto bvh_hit = bvh.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, expected);
+    REQUIRE(compact.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, actual) == bvh_hit);
+    REQUIRE(compact.Occluded(ray, {.Min = 0.001, .Max = softrays::Infinity}) == bvh_hit);
+    if (bvh_hit) {
+      ++hits;
+      REQUIRE(actual.Time == expected.Time);
+    }
+  }
+  REQUIRE(hits > 500);
+}
+
+TEST_CASE("CompactBvh against Bvh on a million spheres", "[.][benchmark]")
+{
+  softrays::SceneArena arena;
+  const auto objects = SphereCloud(arena, 1'000'000, 50);
+  const Bvh bvh(objects);
+  const CompactBvh compact(objects);
+  WARN("Bvh nodes " << bvh.GetNodes().size_bytes() / (1024 * 1024) << " MiB, CompactBvh nodes " << compact.NodeBytes() / (1024 * 1024) << " MiB");
+
+  const auto rays = RaysThrough(50, 20000);
+  auto trace = [&](const Hittable& world) {
+    int hits = 0;
+    HitData hit;
+    for (const auto& ray : rays) {
+      hits += world.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, hit) ? 1 : 0;
+    }
+    return hits;
+  };
+  BENCHMARK("Bvh")
+  {
+    return trace(bvh);
+  };
+  BENCHMARK("CompactBvh")
+  {
+    return trace(compact);
+  };
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,135 @@
+#include "distributed.hpp"
+#include "net.hpp"
+#include "scene.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using softrays::CameraSettings;
+using softrays::Coordinator;
+using softrays::DistributedMessage;
+using softrays::FloatImage;
+
+namespace {
+std::string TestEndpoint(const std::string& name)
+{
+  return "unix:" + (std::filesystem::temp_directory_path() / ("softrays_" + name + ".sock")).string();
+}
+
+CameraSettings SmallCamera()
+{
+  auto camera = softrays::RandomSphereCamera();
+  camera.Dimensions = {.Width = 48, .Height = 32};
+  camera.SamplesPerPixel = 2;
+  camera.MaxDepth = 4;
+  return camera;
+}
+
+// Some paths legitimately end up black, but never a whole tile's worth
+bool FullyRendered(const FloatImage& image, int tile_size)
+{
+  for (const auto& tile : softrays::SplitIntoTiles({.Width = image.Width, .Height = image.Height}, tile_size)) {
+    double sum = 0.0;
+    for (int y = tile.FromY; y < tile.ToY; ++y) {
+      for (int x = tile.FromX; x < tile.ToX; ++x) {
+        const auto colour = image.At(x, y);
+        sum += colour.x + colour.y + colour.z;
+      }
+    }
+    if (sum <= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Connects like a worker, takes one tile and then misbehaves
+void RogueWorker(const std::string& endpoint, std::promise<void>& has_tile, bool hang)
+{
+  const auto connection = softrays::ConnectTo(endpoint);
+  [[maybe_unused]] const auto scene = connection.Receive();
+  [[maybe_unused]] const auto tile = connection.Receive();
+  has_tile.set_value();
+  if (hang) {
+    // Hold on to the tile until the coordinator says it's finished without us
+    [[maybe_unused]] const auto done = connection.Receive();
+  }
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Coordinator assembles a frame from several local workers")
+{
+  const auto endpoint = TestEndpoint("workers");
+  Coordinator coordinator(softrays::RandomSphereScene(), SmallCamera(), {.TileSize = 8});
+  REQUIRE(coordinator.Listen(endpoint));
+
+  std::vector<std::future<bool>> workers;
+  for (int i = 0; i < 3; ++i) {
+    workers.push_back(std::async(std::launch::async, [&] { return softrays::RunWorker(endpoint); }));
+  }
+
+  const auto image = coordinator.Run();
+  for (auto& worker : workers) {
+    worker.wait();
+  }
+  REQUIRE(image.has_value());
+  REQUIRE(image->Width == 48);
+  REQUIRE(FullyRendered(*image, 8));
+  REQUIRE(coordinator.GetStats().WorkersSeen == 3);
+}
+
+TEST_CASE("Tiles from a worker that dies are reassigned")
+{
+  const auto endpoint = TestEndpoint("dead_worker");
+  Coordinator coordinator(softrays::RandomSphereScene(), SmallCamera(), {.TileSize = 16});
+  REQUIRE(coordinator.Listen(endpoint));
+  auto result = std::async(std::launch::async, [&] { return coordinator.Run(); });
+
+  std::promise<void> has_tile;
+  std::thread rogue(RogueWorker, endpoint, std::ref(has_tile), false);
+  has_tile.get_future().wait();
+  rogue.join();
+
+  auto worker = std::async(std::launch::async, [&] { return softrays::RunWorker(endpoint); });
+  const auto image = result.get();
+  worker.wait();
+  REQUIRE(image.has_value());
+  REQUIRE(FullyRendered(*image, 16));
+  REQUIRE(coordinator.GetStats().TilesReassigned >= 1);
+}
+
+TEST_CASE("Straggling tiles are duplicated onto idle workers")
+{
+  const auto endpoint = TestEndpoint("slow_worker");
+  Coordinator coordinator(softrays::RandomSphereScene(), SmallCamera(), {.TileSize = 16, .StragglerFactor = 1.0});
+  REQUIRE(coordinator.Listen(endpoint));
+  auto result = std::async(std::launch::async, [&] { return coordinator.Run(); });
+
+  std::promise<void> has_tile;
+  std::thread rogue(RogueWorker, endpoint, std::ref(has_tile), true);
+  has_tile.get_future().wait();
+
+  auto worker = std::async(std::launch::async, [&] { return softrays::RunWorker(endpoint); });
+  const auto image = result.get();
+  rogue.join();
+  worker.wait();
+  REQUIRE(image.has_value());
+  REQUIRE(FullyRendered(*image, 16));
+  REQUIRE(coordinator.GetStats().TilesDuplicated >= 1);
+  REQUIRE(coordinator.GetStats().TilesReassigned == 0);
+}
+
+TEST_CASE("Coordinator gives up without workers")
+{
+  Coordinator coordinator(softrays::RandomSphereScene(), SmallCamera(), {.IdleTimeout = std::chrono::milliseconds(100)});
+  REQUIRE(coordinator.Listen(TestEndpoint("no_workers")));
+  REQUIRE_FALSE(coordinator.Run().has_value());
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,165 @@
+#include "environment.hpp"
+#include "image.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "shapes.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using Catch::Matchers::WithinRel;
+using softrays::Colour;
+using softrays::EnvironmentMap;
+using softrays::FloatImage;
+using softrays::Lambertian;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::Sphere;
+using softrays::Vec3;
+
+namespace {
+// A dim sky with a tiny, very bright sun straight overhead-ish
+FloatImage SunnySky()
+{
+  FloatImage image(64, 32);
+  for (int y = 0; y < image.Height; ++y) {
+    for (int x = 0; x < image.Width; ++x) {
+      image.Set(x, y, Colour(0.2, 0.25, 0.3));
+    }
+  }
+  image.Set(20, 6, Colour(5000, 4500, 4000));
+  image.Set(21, 6, Colour(5000, 4500, 4000));
+  return image;
+}
+
+double MeanPixelVariance(RayTracer& raytracer, int renders)
+{
+  const auto& pixels = raytracer.GetPixelData();
+  std::vector<double> sum(pixels.size(), 0.0);
+  std::vector<double> sum_sq(pixels.size(), 0.0);
+  for (int i = 0; i < renders; ++i) {
+    raytracer.Render();
+    for (std::size_t p = 0; p < pixels.size(); ++p) {
+      const auto value = pixels[p].x + pixels[p].y + pixels[p].z;
+      sum[p] += value;
+      sum_sq[p] += value * value;
+    }
+  }
+  double variance = 0.0;
+  for (std::size_t p = 0; p < pixels.size(); ++p) {
+    const auto mean = sum[p] / renders;
+    variance += (sum_sq[p] / renders) - (mean * mean);
+  }
+  return variance / static_cast<double>(pixels.size());
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("PFM images round-trip through disk")
+{
+  const auto path = std::filesystem::temp_directory_path() / "softrays_environment_test.pfm";
+  const auto image = SunnySky();
+  REQUIRE(softrays::SavePFM(path.string(), image));
+
+  const auto loaded = softrays::LoadPFM(path.string());
+  REQUIRE(loaded.has_value());
+  REQUIRE(loaded->Width == image.Width);
+  REQUIRE(loaded->Height == image.Height);
+  REQUIRE(loaded->Pixels == image.Pixels);
+
+  std::filesystem::remove(path);
+  REQUIRE_FALSE(softrays::LoadPFM(path.string()).has_value());
+}
+
+TEST_CASE("EnvironmentMap lookup follows the lat-long layout")
+{
+  FloatImage image(4, 2);
+  image.Set(0, 0, Colour(1, 0, 0));  // upper hemisphere
+  image.Set(0, 1, Colour(0, 1, 0));  // lower hemisphere
+  const EnvironmentMap environment(image, 2.0);
+
+  // phi = atan2(z, x) = -pi lands in column 0
+  REQUIRE_THAT(environment.Lookup(Vec3(-1, 0.5, -1e-6)).x, WithinRel(2.0));
+  REQUIRE_THAT(environment.Lookup(Vec3(-1, -0.5, -1e-6)).y, WithinRel(2.0));
+}
+
+TEST_CASE("EnvironmentMap importance sampling")
+{
+  const EnvironmentMap environment(SunnySky());
+
+  SECTION("Sample and Pdf agree, and the sun is sampled most of the time")
+  {
+    int sun_samples = 0;
+    constexpr int samples = 2000;
+    for (int i = 0; i < samples; ++i) {
+      const auto direction = environment.RandomDirection();
+      REQUIRE_THAT(direction.Length(), WithinRel(1.0, 1e-9));
+      REQUIRE(environment.Pdf(direction) > 0);
+      if (environment.Lookup(direction).x > 1000) {
+        ++sun_samples;
+      }
+    }
+    // The two sun pixels hold the vast majority of the map's power
+    REQUIRE(sun_samples > samples * 9 / 10);
+  }
+
+  SECTION("The pdf integrates to one over the sphere")
+  {
+    // Midpoint rule in lat-long space, on a grid aligned with the map's pixels
+    constexpr int columns = 64 * 4;
+    constexpr int rows = 32 * 4;
+    const auto du = 1.0 / columns;
+    const auto dv = 1.0 / rows;
+    double integral = 0.0;
+    for (int j = 0; j < rows; ++j) {
+      const auto theta = softrays::Pi * (j + 0.5) * dv;
+      for (int i = 0; i < columns; ++i) {
+        const auto phi = (2 * softrays::Pi * (i + 0.5) * du) - softrays::Pi;
+        const Vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        // Solid angle of the grid cell
+        integral += environment.Pdf(direction) * 2 * softrays::Pi * softrays::Pi * std::sin(theta) * du * dv;
+      }
+    }
+    REQUIRE_THAT(integral, WithinRel(1.0, 1e-3));
+  }
+
+  SECTION("A black map falls back to sampling the sphere")
+  {
+    const EnvironmentMap black(FloatImage(8, 4));
+    const auto direction = black.RandomDirection();
+    REQUIRE(black.Pdf(direction) > 0);
+    REQUIRE_THAT(black.Lookup(direction).Length(), WithinAbs(0.0, 1e-12));
+  }
+}
+
+TEST_CASE("Environment light sampling removes sun fireflies")
+{
+  const auto environment = std::make_shared<EnvironmentMap>(SunnySky());
+  auto setup = [&](RayTracer& raytracer) {
+    raytracer.ResizeViewport({.Width = 12, .Height = 12});
+    raytracer.SetSamplesPerPixel(4);
+    raytracer.MaxDepth = 3;
+    raytracer.FieldOfView = 40;
+    raytracer.LookFrom = Point3(0, 4, 0.01);
+    raytracer.LookAt = Point3(0, 0, 0);
+    raytracer.Environment = environment;
+    raytracer.GetWorld().Add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5))));
+  };
+
+  RayTracer sampled;
+  setup(sampled);
+  RayTracer unsampled;
+  setup(unsampled);
+  unsampled.SampleLights = false;
+
+  constexpr int renders = 16;
+  REQUIRE(MeanPixelVariance(sampled, renders) * 10 < MeanPixelVariance(unsampled, renders));
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,116 @@
+#include "framebuffer.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "shapes.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+using Catch::Matchers::WithinAbs;
+using Catch::Matchers::WithinRel;
+using softrays::Colour;
+using softrays::Framebuffer;
+using softrays::Lambertian;
+using softrays::PixelFormat;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::Sphere;
+
+namespace {
+void SetupScene(RayTracer& raytracer, PixelFormat format)
+{
+  raytracer.SetPixelFormat(format);
+  raytracer.ResizeViewport({.Width = 24, .Height = 16});
+  raytracer.SetSamplesPerPixel(1);
+  raytracer.MaxDepth = 1;
+  raytracer.LookFrom = Point3(0, 1, 4);
+  raytracer.LookAt = Point3(0, 0, 0);
+  raytracer.GetWorld().Add(std::make_shared<Sphere>(Point3(0, 0.5, 0), 0.5, std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5))));
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Compact pixel formats are smaller")
+{
+  REQUIRE(Framebuffer(PixelFormat::RGB64).BytesPerPixel() == 24);
+  REQUIRE(Framebuffer(PixelFormat::RGBA32).BytesPerPixel() == 16);
+  REQUIRE(Framebuffer(PixelFormat::RGBA16).BytesPerPixel() == 8);
+  REQUIRE(Framebuffer(PixelFormat::RGB9E5).BytesPerPixel() == 4);
+  REQUIRE(alignof(softrays::PixelRGBA32) == 16);
+}
+
+TEST_CASE("Half floats round trip within their precision")
+{
+  REQUIRE(softrays::HalfToFloat(softrays::FloatToHalf(1.0F)) == 1.0F);
+  REQUIRE(softrays::HalfToFloat(softrays::FloatToHalf(0.0F)) == 0.0F);
+  REQUIRE(softrays::HalfToFloat(softrays::FloatToHalf(-2.5F)) == -2.5F);
+  // Ties round to even: 1 + 2^-11 is halfway between 1 and the next half, 1 + 2^-10
+  REQUIRE(softrays::HalfToFloat(softrays::FloatToHalf(1.0F + 0x1p-11F)) == 1.0F);
+  REQUIRE(softrays::HalfToFloat(softrays::FloatToHalf(0x1p-24F)) == 0x1p-24F);
+  REQUIRE(softrays::FloatToHalf(1e6F) == 0x7C00);
+
+  for (const auto value : {0.001F, 0.18F, 0.5F, 0.73F, 3.14159F, 1000.0F}) {
+    REQUIRE_THAT(softrays::HalfToFloat(softrays::FloatToHalf(value)), WithinRel(value, 1.0F / 1024));
+  }
+}
+
+TEST_CASE("Shared-exponent colours round trip within their precision")
+{
+  const Colour colour{0.8, 0.2, 0.05};
+  const auto decoded = softrays::DecodeRGB9E5(softrays::EncodeRGB9E5(colour));
+  // Every channel is quantised to the brightest one's step, 2^-9 of its power of two
+  REQUIRE_THAT(decoded.x, WithinAbs(colour.x, 1.0 / 512));
+  REQUIRE_THAT(decoded.y, WithinAbs(colour.y, 1.0 / 512));
+  REQUIRE_THAT(decoded.z, WithinAbs(colour.z, 1.0 / 512));
+
+  const auto black = softrays::DecodeRGB9E5(softrays::EncodeRGB9E5({0, 0, 0}));
+  REQUIRE(black.NearZero());
+  const auto negative = softrays::DecodeRGB9E5(softrays::EncodeRGB9E5({-1, 2, 0}));
+  REQUIRE_THAT(negative.x, WithinAbs(0, 0));
+  REQUIRE_THAT(negative.y, WithinAbs(2, 0));
+  // Rounding the largest mantissa up bumps the exponent instead of overflowing
+  const auto almost_two = softrays::DecodeRGB9E5(softrays::EncodeRGB9E5({1.9999, 0, 0}));
+  REQUIRE_THAT(almost_two.x, WithinAbs(2, 0));
+}
+
+TEST_CASE("Framebuffers switch formats and keep their size")
+{
+  Framebuffer pixels(PixelFormat::RGBA32, 10);
+  pixels.Set(3, {0.25, 0.5, 0.75});
+  REQUIRE(pixels[3].x == 0.25);
+  REQUIRE(pixels[3].z == 0.75);
+
+  pixels.SetFormat(PixelFormat::RGBA16);
+  REQUIRE(pixels.Format() == PixelFormat::RGBA16);
+  REQUIRE(pixels.size() == 10);
+  REQUIRE(pixels[3].NearZero());
+}
+
+TEST_CASE("Every pixel format renders the same preview")
+{
+  RayTracer reference;
+  SetupScene(reference, PixelFormat::RGB64);
+  reference.Render();
+  const auto expected = reference.GetRGBAData();
+
+  for (const auto format : {PixelFormat::RGBA32, PixelFormat::RGBA16, PixelFormat::RGB9E5}) {
+    RayTracer raytracer;
+    SetupScene(raytracer, format);
+    REQUIRE(raytracer.GetPixelFormat() == format);
+    raytracer.Render();
+    REQUIRE_THAT(raytracer.GetPixelData()[200].y, WithinAbs(reference.GetPixelData()[200].y, 0.01));
+
+    // Quantisation may move a channel by one 8-bit step at most
+    const auto& rgba = raytracer.GetRGBAData();
+    REQUIRE(rgba.size() == expected.size());
+    for (std::size_t i = 0; i < rgba.size(); ++i) {
+      REQUIRE(std::abs(static_cast<int>(rgba[i]) - static_cast<int>(expected[i])) <= 1);
+    }
+  }
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
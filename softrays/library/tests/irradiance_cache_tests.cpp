@@ -0,0 +1,201 @@
+#include "irradiance_cache.hpp"
+#include "math.hpp"
+#include "quality.hpp"
+#include "random.hpp"
+#include "raytracer.hpp"
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using Catch::Matchers::WithinRel;
+using softrays::BenchmarkScene;
+using softrays::Colour;
+using softrays::IrradianceCache;
+using softrays::Point3;
+using softrays::Ray;
+using softrays::RayTracer;
+using softrays::Vec3;
+
+namespace {
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+// A white wall at x = 1, a unit high, seen from the floor; nothing else gives light
+Colour Wall(const Ray& ray, [[maybe_unused]] double pdf, double& distance)
+{
+  if (ray.Direction.x <= 0) {
+    return {0, 0, 0};
+  }
+  const auto time = (1 - ray.Origin.x) / ray.Direction.x;
+  if (ray.Origin.y + (time * ray.Direction.y) > 1) {
+    return {0, 0, 0};
+  }
+  distance = time * ray.Direction.Length();
+  return {1, 1, 1};
+}
+
+double GatheredIrradiance(const IrradianceCache& cache, const Point3& position, const Vec3& normal)
+{
+  double sum = 0;
+  constexpr int gathers = 8;
+  for (int i = 0; i < gathers; ++i) {
+    sum += cache.Gather(position, normal, Wall).Irradiance.x / gathers;
+  }
+  return sum;
+}
+}
+
+TEST_CASE("Irradiance records serve points within their radius and facing")
+{
+  IrradianceCache cache(1.0);
+  REQUIRE_FALSE(cache.Lookup(Point3(0, 0, 0), Vec3(0, 1, 0)).has_value());
+
+  IrradianceCache::Record record{.Position = Point3(0, 0, 0), .Normal = Vec3(0, 1, 0), .Irradiance = Colour(1, 2, 3), .Radius = 0.5};
+  record.TranslationGradient = {Vec3(1, 0, 0), Vec3(0, 0, 0), Vec3(0, 0, 0)};
+  REQUIRE(cache.Insert(record));
+  REQUIRE(cache.Size() == 1);
+
+  const auto at_record = cache.Lookup(Point3(0, 0, 0), Vec3(0, 1, 0));
+  REQUIRE(at_record.has_value());
+  REQUIRE((*at_record - Colour(1, 2, 3)).NearZero());
+  // Extrapolated along its gradient, here red growing towards +x
+  const auto along = cache.Lookup(Point3(0.2, 0, 0), Vec3(0, 1, 0));
+  REQUIRE(along.has_value());
+  REQUIRE_THAT(along->x, WithinAbs(1.2, 1e-9));
+  REQUIRE_THAT(along->y, WithinAbs(2, 1e-9));
+
+  REQUIRE_FALSE(cache.Lookup(Point3(0.6, 0, 0), Vec3(0, 1, 0)).has_value());  // Beyond the radius
+  REQUIRE_FALSE(cache.Lookup(Point3(0, 0, 0), Vec3(0, -1, 0)).has_value());  // The other side
+  REQUIRE_FALSE(cache.Lookup(Point3(0, -0.2, 0), Vec3(0, 1, 0)).has_value());  // The record is in front
+  REQUIRE(cache.Lookup(Point3(0, 0, 0), Vec3(0.2, 1, 0).UnitVector()).has_value());  // Slightly turned
+
+  // Two records blend, nearer counting more
+  record = {.Position = Point3(0.4, 0, 0), .Normal = Vec3(0, 1, 0), .Irradiance = Colour(3, 3, 3), .Radius = 0.5};
+  REQUIRE(cache.Insert(record));
+  const auto between = cache.Lookup(Point3(0.3, 0, 0), Vec3(0, 1, 0));
+  REQUIRE(between.has_value());
+  REQUIRE(between->y > 2.5);
+  REQUIRE(between->y < 3);
+
+  cache.Clear();
+  REQUIRE(cache.Size() == 0);
+  REQUIRE_FALSE(cache.Lookup(Point3(0, 0, 0), Vec3(0, 1, 0)).has_value());
+}
+
+TEST_CASE("Gathered gradients match how irradiance changes")
+{
+  IrradianceCache cache(1.0);
+  const Point3 position(0, 0, 0.3);
+  const Vec3 up(0, 1, 0);
+  SeedRandom(3);
+
+  // Averaged over many gathers, which are noisy on their own
+  Vec3 translation{0, 0, 0};
+  Vec3 rotation{0, 0, 0};
+  double radius = 0;
+  constexpr int gathers = 100;
+  for (int i = 0; i < gathers; ++i) {
+    const auto record = cache.Gather(position, up, Wall);
+    REQUIRE((record.Normal - up).NearZero());
+    translation += record.TranslationGradient[0] / gathers;
+    rotation += record.RotationGradient[0] / gathers;
+    radius += record.Radius / gathers;
+  }
+  REQUIRE(radius < 1.0);  // Nearer the wall than the maximum spacing allows
+
+  // Against central differences of finely gathered irradiance
+  cache.ThetaStrata = 40;
+  constexpr double step = 0.05;
+  const auto towards_wall = (GatheredIrradiance(cache, position + Vec3(step, 0, 0), up) - GatheredIrradiance(cache, position - Vec3(step, 0, 0), up)) / (2 * step);
+  REQUIRE(towards_wall > 0);
+  REQUIRE_THAT(translation.x, WithinRel(towards_wall, 0.2));
+  REQUIRE_THAT(translation.z, WithinAbs(0, 0.05));
+  // Tilting the normal towards the wall turns it about -z
+  const auto tilt = (GatheredIrradiance(cache, position, Vec3(std::sin(step), std::cos(step), 0)) - GatheredIrradiance(cache, position, Vec3(-std::sin(step), std::cos(step), 0))) / (2 * step);
+  REQUIRE_THAT(-rotation.z, WithinRel(tilt, 0.2));
+}
+
+TEST_CASE("Irradiance records are inserted and found from many threads at once")
+{
+  IrradianceCache cache(0.5, 8192);
+  constexpr int perThread = 1000;
+  {
+    std::vector<std::jthread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+      threads.emplace_back([&cache, thread] {
+        for (int i = 0; i < perThread; ++i) {
+          const Point3 position((i % 40) * 0.25, thread, (i / 40) * 0.25);
+          REQUIRE(cache.Insert({.Position = position, .Normal = Vec3(0, 1, 0), .Irradiance = Colour(1, 1, 1), .Radius = 0.3}));
+          (void)cache.Lookup(position + Vec3(0.1, 0, 0), Vec3(0, 1, 0));
+        }
+      });
+    }
+  }
+  REQUIRE(cache.Size() == 4 * perThread);
+  for (int thread = 0; thread < 4; ++thread) {
+    for (int i = 0; i < perThread; ++i) {
+      const auto found = cache.Lookup(Point3((i % 40) * 0.25, thread, (i / 40) * 0.25), Vec3(0, 1, 0));
+      REQUIRE(found.has_value());
+      REQUIRE((*found - Colour(1, 1, 1)).NearZero());
+    }
+  }
+
+  // A full pool turns records away, and what it holds keeps working
+  IrradianceCache small(1.0, 2);
+  REQUIRE(small.Insert({.Position = Point3(0, 0, 0), .Normal = Vec3(0, 1, 0), .Irradiance = Colour(1, 1, 1), .Radius = 0.5}));
+  REQUIRE(small.Insert({.Position = Point3(5, 0, 0), .Normal = Vec3(0, 1, 0), .Irradiance = Colour(1, 1, 1), .Radius = 0.5}));
+  REQUIRE_FALSE(small.Insert({.Position = Point3(9, 0, 0), .Normal = Vec3(0, 1, 0), .Irradiance = Colour(1, 1, 1), .Radius = 0.5}));
+  REQUIRE(small.Size() == 2);
+  REQUIRE(small.Lookup(Point3(5, 0, 0), Vec3(0, 1, 0)).has_value());
+}
+
+TEST_CASE("Cached rendering stays close to path tracing")
+{
+  auto bench = softrays::MakeBenchmarkCase(BenchmarkScene::DiffuseRoom);
+  bench.Camera.Dimensions = {.Width = 24, .Height = 18};
+  const auto traced = softrays::RenderReference(bench, 200);
+  REQUIRE(traced.has_value());
+
+  // The cache outlives each render's tracer, so later renders reuse its records
+  const auto cache = std::make_shared<IrradianceCache>(0.5);
+  const softrays::TracerSetup with_cache = [&cache](RayTracer& raytracer) { raytracer.Irradiance = cache; };
+  const auto cached = softrays::RenderReference(bench, 50, with_cache);
+  REQUIRE(cached.has_value());
+  REQUIRE(cache->Size() > 0);
+  const auto records = cache->Size();
+  // Each record's noise is shared by every pixel it serves, so a frame is a few percent off
+  // however many samples it takes; averaged over many caches they agree
+  REQUIRE_THAT(softrays::MeanLuminance(*cached), WithinRel(softrays::MeanLuminance(*traced), 0.1));
+
+  // Filled lazily: the next frame mostly reuses what the first gathered
+  REQUIRE(softrays::RenderReference(bench, 50, with_cache).has_value());
+  REQUIRE(cache->Size() < records * 2);
+}
+
+TEST_CASE("Cached against path traced error in equal time", "[.][benchmark]")
+{
+  auto bench = softrays::MakeBenchmarkCase(BenchmarkScene::DiffuseRoom);
+  bench.Camera.Dimensions = {.Width = 96, .Height = 72};
+  const auto reference = softrays::RenderReference(bench, 4096);
+  REQUIRE(reference.has_value());
+
+  constexpr std::array budgets{0.5, 2.0, 8.0};
+  const auto traced = softrays::MeasureQuality(bench, *reference, budgets);
+  std::shared_ptr<IrradianceCache> cache;
+  const auto cached = softrays::MeasureQuality(bench, *reference, budgets, 1, [&cache](RayTracer& raytracer) {
+    cache = std::make_shared<IrradianceCache>(0.5);
+    raytracer.Irradiance = cache;
+  });
+  REQUIRE(traced.has_value());
+  REQUIRE(cached.has_value());
+  for (std::size_t point = 0; point < budgets.size(); ++point) {
+    WARN(budgets[point] << " s: relmse " << traced->Points[point].RelMse << " path traced, " << cached->Points[point].RelMse << " cached");
+  }
+  WARN(cache->Size() << " records after " << budgets.back() << " s");
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,165 @@
+#include "material.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "shapes.hpp"
+#include "utility.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using Catch::Matchers::WithinRel;
+using softrays::Colour;
+using softrays::DiffuseLight;
+using softrays::HitData;
+using softrays::Lambertian;
+using softrays::Point3;
+using softrays::Ray;
+using softrays::RayTracer;
+using softrays::Sphere;
+using softrays::Vec3;
+
+namespace {
+// Mean per-pixel variance (of the luminance-ish channel sum) and overall mean across repeated renders
+struct NoiseStats {
+  double Mean{};
+  double Variance{};
+};
+
+NoiseStats MeasureNoise(RayTracer& raytracer, int renders)
+{
+  const auto& pixels = raytracer.GetPixelData();
+  std::vector<double> sum(pixels.size(), 0.0);
+  std::vector<double> sum_sq(pixels.size(), 0.0);
+  for (int i = 0; i < renders; ++i) {
+    raytracer.Render();
+    for (std::size_t p = 0; p < pixels.size(); ++p) {
+      const auto value = pixels[p].x + pixels[p].y + pixels[p].z;
+      sum[p] += value;
+      sum_sq[p] += value * value;
+    }
+  }
+
+  NoiseStats stats;
+  for (std::size_t p = 0; p < pixels.size(); ++p) {
+    const auto mean = sum[p] / renders;
+    stats.Mean += mean;
+    stats.Variance += (sum_sq[p] / renders) - (mean * mean);
+  }
+  stats.Mean /= static_cast<double>(pixels.size());
+  stats.Variance /= static_cast<double>(pixels.size());
+  return stats;
+}
+
+void SetupSmallLightScene(RayTracer& raytracer)
+{
+  raytracer.ResizeViewport({.Width = 16, .Height = 16});
+  raytracer.SetSamplesPerPixel(4);
+  raytracer.MaxDepth = 4;
+  raytracer.FieldOfView = 60;
+  // Looking straight down at the floor, with the light just outside the frustum
+  raytracer.LookFrom = Point3(0, 3, 0);
+  raytracer.LookAt = Point3(0, 0, 0);
+  raytracer.CameraUp = Vec3(0, 0, -1);
+  raytracer.SkyBackground = false;
+
+  auto& world = raytracer.GetWorld();
+  world.Add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5))));
+  world.Add(std::make_shared<Sphere>(Point3(2.5, 1, 0), 0.2, std::make_shared<DiffuseLight>(Colour(20, 20, 20))));
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("DiffuseLight only emits from its front face")
+{
+  const DiffuseLight light(Colour(4, 2, 1));
+  const Ray ray(Point3(0, 0, 0), Vec3(0, 0, 1));
+  HitData hit_data;
+
+  hit_data.FrontFace = true;
+  REQUIRE_THAT(light.Emitted(ray, hit_data).x, WithinRel(4.0));
+  REQUIRE(light.IsEmissive());
+
+  hit_data.FrontFace = false;
+  REQUIRE(light.Emitted(ray, hit_data).NearZero());
+
+  Colour attenuation;
+  Ray scattered;
+  REQUIRE_FALSE(light.Scatter(ray, hit_data, attenuation, scattered));
+}
+
+TEST_CASE("Lambertian Evaluate and ScatterPdf agree with Scatter's attenuation")
+{
+  const Lambertian lambertian(Colour(0.8, 0.4, 0.2));
+  const Ray ray(Point3(0, 0, 1), Vec3(0, 0, -1));
+  HitData hit_data;
+  hit_data.Normal = Vec3(0, 0, 1);
+
+  const Vec3 direction(0, 0.6, 0.8);
+  const auto pdf = lambertian.ScatterPdf(ray, hit_data, direction);
+  REQUIRE_THAT(pdf, WithinRel(0.8 / softrays::Pi));
+  const auto bsdf_cos = lambertian.Evaluate(ray, hit_data, direction);
+  REQUIRE_THAT(bsdf_cos.x / pdf, WithinRel(0.8));
+
+  // Below the surface, nothing is scattered
+  REQUIRE_THAT(lambertian.ScatterPdf(ray, hit_data, Vec3(0, 0, -1)), WithinAbs(0.0, 1e-12));
+}
+
+TEST_CASE("Sphere light sampling")
+{
+  const Sphere light(Point3(0, 0, -4), 1.0, std::make_shared<DiffuseLight>(Colour(1, 1, 1)));
+  const Point3 origin(0, 0, 0);
+  REQUIRE(light.IsEmissive());
+
+  SECTION("Sampled directions hit the sphere with a constant density")
+  {
+    const auto expected_pdf = 1.0 / (2 * softrays::Pi * (1 - std::sqrt(1 - (1.0 / 16.0))));
+    for (int i = 0; i < 100; ++i) {
+      const auto direction = light.RandomDirection(origin);
+      REQUIRE_THAT(direction.Length(), WithinRel(1.0, 1e-9));
+      REQUIRE_THAT(light.PdfValue(origin, direction), WithinRel(expected_pdf, 1e-9));
+    }
+  }
+
+  SECTION("Directions missing the sphere have zero density")
+  {
+    REQUIRE_THAT(light.PdfValue(origin, Vec3(0, 0, 1)), WithinAbs(0.0, 1e-12));
+  }
+
+  SECTION("Non-emissive spheres are not lights")
+  {
+    const Sphere plain(Point3(0, 0, -4), 1.0, std::make_shared<Lambertian>(Colour(1, 1, 1)));
+    REQUIRE_FALSE(plain.IsEmissive());
+  }
+}
+
+TEST_CASE("RayTracer collects emissive objects into its light list")
+{
+  RayTracer raytracer;
+  SetupSmallLightScene(raytracer);
+  raytracer.UpdateLights();
+  REQUIRE(raytracer.GetLights().Size() == 1);
+}
+
+TEST_CASE("Light sampling reduces noise without changing the mean")
+{
+  constexpr int renders = 32;
+
+  RayTracer with_nee;
+  SetupSmallLightScene(with_nee);
+  const auto nee_stats = MeasureNoise(with_nee, renders);
+
+  RayTracer without_nee;
+  SetupSmallLightScene(without_nee);
+  without_nee.SampleLights = false;
+  const auto bsdf_stats = MeasureNoise(without_nee, renders);
+
+  REQUIRE(nee_stats.Mean > 0);
+  REQUIRE_THAT(nee_stats.Mean, WithinRel(bsdf_stats.Mean, 0.3));
+  REQUIRE(nee_stats.Variance * 10 < bsdf_stats.Variance);
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
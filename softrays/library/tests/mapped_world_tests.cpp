@@ -0,0 +1,236 @@
+#include "bvh.hpp"
+#include "mapped_world.hpp"
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "utility.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+
+using softrays::HitData;
+using softrays::MappedWorld;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::SceneDescription;
+using softrays::Vec3;
+
+namespace {
+std::string TestPath(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / ("softrays_" + name + ".world")).string();
+}
+
+// A flat field of small spheres, `side` x `side`, far bigger than any one view of it
+SceneDescription SphereField(int side)
+{
+  SceneDescription scene;
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<double> jitter(-0.2, 0.2);
+  const auto diffuse = scene.AddMaterial({.Type = softrays::MaterialType::Lambertian, .Albedo = {0.6, 0.5, 0.4}, .Parameter = 0});
+  const auto metal = scene.AddMaterial({.Type = softrays::MaterialType::Metal, .Albedo = {0.8, 0.8, 0.8}, .Parameter = 0.1});
+  scene.Spheres.reserve(static_cast<std::size_t>(side) * static_cast<std::size_t>(side));
+  for (int z = 0; z < side; ++z) {
+    for (int x = 0; x < side; ++x) {
+      scene.Spheres.push_back({
+          .Center = {x + jitter(generator), 0.4, z + jitter(generator)},
+          .Radius = 0.4,
+          .Material = (x + z) % 5 == 0 ? metal : diffuse,
+      });
+    }
+  }
+  return scene;
+}
+
+#if defined(__linux__)
+// A "VmRSS:" style field of /proc/self/status, in KiB
+std::size_t StatusKib(std::string_view field)
+{
+  std::ifstream status("/proc/self/status");
+  std::string name;
+  std::size_t value = 0;
+  while (status >> name) {
+    if (name == field) {
+      status >> value;
+      return value;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return 0;
+}
+
+// How far `prepare` takes resident memory above where it started, in bytes; the most there is if
+// it fails
+template <typename Prepare>
+std::size_t PeakGrowth(Prepare prepare)
+{
+  std::ofstream("/proc/self/clear_refs") << "5";  // Resets the peak to the current size
+  const auto start = StatusKib("VmRSS:");
+  const bool prepared = prepare().has_value();
+  return prepared ? (StatusKib("VmHWM:") - start) * 1024 : std::numeric_limits<std::size_t>::max();
+}
+#endif
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("MappedWorld traces the same scene as the in-memory hierarchy")
+{
+  const auto path = TestPath("mapped");
+  auto scene = softrays::RandomSphereScene(5);
+  const auto light = scene.AddMaterial({.Type = softrays::MaterialType::DiffuseLight, .Albedo = {4, 4, 4}, .Parameter = 0});
+  scene.Spheres.push_back({.Center = {0, 6, 0}, .Radius = 1, .Material = light});
+  REQUIRE(softrays::WriteMappedScene(path, scene));
+
+  const auto world = MappedWorld::Open(path);
+  REQUIRE(world != nullptr);
+  REQUIRE(world->SphereCount() == scene.Spheres.size());
+  REQUIRE(world->GetLights()->Size() == 1);
+
+  const auto prepared = scene.Prepare();
+  REQUIRE(prepared.has_value());
+  for (int i = 0; i < 2000; ++i) {
+    const softrays::Ray ray{
+        .Origin = {RandomDouble(-12, 12), RandomDouble(0.1, 4), RandomDouble(-12, 12)},
+        .Direction = Vec3::RandomUnitVector(),
+    };
+    HitData expected;
+    HitData actual;
+    const auto in_memory = prepared->World->Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, expected);
+    REQUIRE(world->Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, actual) == in_memory);
+    REQUIRE(world->Occluded(ray, {.Min = 0.001, .Max = softrays::Infinity}) == in_memory);
+    if (in_memory) {
+      REQUIRE(actual.Time == expected.Time);
+      REQUIRE(actual.Material->IsEmissive() == expected.Material->IsEmissive());
+    }
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("MappedWorld rejects files that aren't mapped scenes")
+{
+  const auto path = TestPath("not_mapped");
+  REQUIRE(MappedWorld::Open(path) == nullptr);
+  {
+    std::ofstream file(path);
+    file << "definitely not a scene, but long enough to hold a header if it were one";
+  }
+  REQUIRE(MappedWorld::Open(path) == nullptr);
+  std::filesystem::remove(path);
+
+  auto broken = softrays::RandomSphereScene();
+  broken.Spheres[0].Material = 1000;
+  REQUIRE_FALSE(softrays::WriteMappedScene(path, broken));
+  // Nor can the file hold quads
+  auto with_quad = softrays::RandomSphereScene();
+  with_quad.Quads.push_back({.Corner = {0, 0, 0}, .Opposite = {1, 1, 0}, .Material = 0});
+  REQUIRE_FALSE(softrays::WriteMappedScene(path, with_quad));
+
+  // A material of no known type, as a corrupt file would have
+  auto unknown = softrays::RandomSphereScene();
+  unknown.Materials[0].Type = static_cast<softrays::MaterialType>(200);
+  REQUIRE(softrays::WriteMappedScene(path, unknown));
+  REQUIRE(MappedWorld::Open(path) == nullptr);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("A mapped scene is prepared without building it in memory")
+{
+  const auto path = TestPath("prepare");
+  std::filesystem::remove(path);
+  auto scene = SphereField(300);
+  scene.SkyBackground = false;
+  // Written on first use, then only opened
+  auto prepared = softrays::PrepareMapped(path, scene);
+  REQUIRE(prepared.has_value());
+  const auto* world = dynamic_cast<const MappedWorld*>(prepared->World.get());
+  REQUIRE(world != nullptr);
+  REQUIRE(world->SphereCount() == scene.Spheres.size());
+  REQUIRE(prepared->Lights != nullptr);
+  REQUIRE_FALSE(prepared->SkyBackground);
+  const auto file_size = world->FileSize();
+  prepared.reset();
+
+#if defined(__linux__)
+  const auto mapped = PeakGrowth([&] { return softrays::PrepareMapped(path, scene); });
+  const auto in_memory = PeakGrowth([&] { return scene.Prepare(); });
+  WARN("peak growth " << mapped / 1024 << " KiB mapped, " << in_memory / 1024 << " KiB in memory, file " << file_size / 1024 << " KiB");
+  REQUIRE(mapped < file_size / 8);
+  REQUIRE(mapped * 8 < in_memory);
+#endif
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("MappedWorld only pages in what rays reach")
+{
+  const auto path = TestPath("paging");
+  REQUIRE(softrays::WriteMappedScene(path, SphereField(200)));
+  const auto world = MappedWorld::Open(path);
+  REQUIRE(world != nullptr);
+  world->ReleaseResident();
+
+  // A close-up of one corner of the field
+  RayTracer raytracer;
+  raytracer.ResizeViewport({.Width = 32, .Height = 24});
+  raytracer.SetSamplesPerPixel(2);
+  raytracer.MaxDepth = 3;
+  raytracer.FieldOfView = 30;
+  raytracer.LookFrom = Point3(-3, 3, -3);
+  raytracer.LookAt = Point3(2, 0, 2);
+  raytracer.ShareWorld(std::shared_ptr<const MappedWorld>(world.get(), [](const MappedWorld*) { }), world->GetLights());
+  raytracer.Render();
+
+#if __has_include(<sys/mman.h>)
+  REQUIRE(world->ResidentBytes() < world->FileSize() / 2);
+#endif
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("MappedWorld rendering with capped resident memory", "[.][benchmark]")
+{
+  // About 2.2M spheres, 170 MB on disk
+  const auto path = TestPath("benchmark");
+  REQUIRE(softrays::WriteMappedScene(path, SphereField(1500)));
+  const auto world = MappedWorld::Open(path);
+  REQUIRE(world != nullptr);
+  world->ReleaseResident();
+
+  RayTracer raytracer;
+  raytracer.ResizeViewport({.Width = 320, .Height = 180});
+  raytracer.SetSamplesPerPixel(4);
+  raytracer.MaxDepth = 4;
+  raytracer.FieldOfView = 60;
+  raytracer.LookFrom = Point3(-20, 30, -20);
+  raytracer.LookAt = Point3(750, 0, 750);
+  raytracer.ShareWorld(std::shared_ptr<const MappedWorld>(world.get(), [](const MappedWorld*) { }), world->GetLights());
+
+  // Pages go back to the OS whenever a tile takes the mapping past the budget
+  const auto budget = world->FileSize() / 16;
+  std::size_t peak = 0;
+  std::size_t releases = 0;
+  const auto start = std::chrono::steady_clock::now();
+  raytracer.BeginFrame();
+  for (const auto& tile : softrays::SplitIntoTiles({.Width = 320, .Height = 180}, 16)) {
+    raytracer.RenderTile(tile);
+    const auto resident = world->ResidentBytes();
+    peak = std::max(peak, resident);
+    if (resident > budget) {
+      world->ReleaseResident();
+      ++releases;
+    }
+  }
+  const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  WARN("file " << world->FileSize() / (1024 * 1024) << " MiB, budget " << budget / (1024 * 1024) << " MiB, peak resident "
+               << peak / (1024 * 1024) << " MiB after a tile, " << releases << " releases, " << seconds << " s");
+  std::filesystem::remove(path);
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,131 @@
+#include "math.hpp"
+#include "path_guide.hpp"
+#include "quality.hpp"
+#include "random.hpp"
+#include "raytracer.hpp"
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using softrays::BenchmarkScene;
+using softrays::PathGuide;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::Vec3;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Guide regions learn where radiance comes from")
+{
+  PathGuide guide(0.5);
+  auto* region = guide.Locate(Point3(0.1, 0.2, 0.3), Vec3(0, 1, 0));
+  REQUIRE(region != nullptr);
+  REQUIRE(guide.Locate(Point3(0.4, 0.4, 0.4), Vec3(0.1, 1, 0)) == region);
+  REQUIRE(guide.Locate(Point3(0.4, 0.4, 0.4), Vec3(0, -1, 0)) != region);  // The other side
+  REQUIRE(guide.Locate(Point3(0.6, 0.4, 0.4), Vec3(0, 1, 0)) != region);
+  REQUIRE(guide.RegionCount() == 3);
+
+  // Uniformly sampled directions, with light arriving only from around +x
+  const Vec3 bright = Vec3(1, 0.2, 0.1).UnitVector();
+  SeedRandom(5);
+  for (int i = 0; i < 20000; ++i) {
+    const auto direction = Vec3::RandomUnitVector();
+    region->Record(direction, direction.Dot(bright) > 0.9 ? 4 * softrays::Pi : 0.0);
+  }
+  REQUIRE_FALSE(region->IsTrained());
+  guide.Refresh();
+  REQUIRE(region->IsTrained());
+  REQUIRE(guide.TrainedCount() == 1);
+
+  REQUIRE(region->Pdf(bright) > 10 / (4 * softrays::Pi));
+  REQUIRE_THAT(region->Pdf(-bright), WithinAbs(0, 1e-12));
+  // The density integrates to one over the sphere, and samples land where it is
+  double integral = 0;
+  int near_bright = 0;
+  constexpr int count = 20000;
+  for (int i = 0; i < count; ++i) {
+    integral += region->Pdf(Vec3::RandomUnitVector()) * 4 * softrays::Pi / count;
+    const auto sample = region->RandomDirection();
+    REQUIRE_THAT(sample.Length(), WithinAbs(1, 1e-9));
+    REQUIRE(region->Pdf(sample) > 0);
+    near_bright += sample.Dot(bright) > 0.7 ? 1 : 0;
+  }
+  REQUIRE_THAT(integral, WithinAbs(1, 0.05));
+  REQUIRE(near_bright > count * 9 / 10);
+
+  guide.Clear();
+  REQUIRE(guide.RegionCount() == 0);
+  REQUIRE(guide.Locate(Point3(0.1, 0.2, 0.3), Vec3(0, 1, 0))->RecordCount() == 0);
+}
+
+TEST_CASE("Guides are claimed and filled from many threads at once")
+{
+  PathGuide guide(1.0, 256);
+  {
+    std::vector<std::jthread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+      threads.emplace_back([&guide] {
+        for (int i = 0; i < 10000; ++i) {
+          auto* region = guide.Locate(Point3(i % 10, 0.5, 0.5), Vec3(0, 1, 0));
+          region->Record(Vec3(1, 0, 0), 1.0);
+        }
+      });
+    }
+  }
+  REQUIRE(guide.RegionCount() == 10);
+  for (int cell = 0; cell < 10; ++cell) {
+    REQUIRE(guide.Locate(Point3(cell, 0.5, 0.5), Vec3(0, 1, 0))->RecordCount() == 4000);
+  }
+
+  // A full table leaves new cells unguided rather than evicting
+  PathGuide small(1.0, 16);
+  int located = 0;
+  for (int cell = 0; cell < 40; ++cell) {
+    located += small.Locate(Point3(cell, 0, 0), Vec3(0, 1, 0)) != nullptr ? 1 : 0;
+  }
+  REQUIRE(located == 16);
+}
+
+TEST_CASE("Guided rendering converges to the same image")
+{
+  auto bench = softrays::MakeBenchmarkCase(BenchmarkScene::WindowRoom);
+  bench.Camera.Dimensions = {.Width = 16, .Height = 12};
+  const auto unguided = softrays::RenderReference(bench, 2000);
+  REQUIRE(unguided.has_value());
+
+  // The guide outlives each render's tracer, so it keeps what earlier ones taught it
+  const auto guide = std::make_shared<PathGuide>(1.0);
+  const softrays::TracerSetup with_guide = [&guide](RayTracer& raytracer) { raytracer.Guide = guide; };
+  for (int pass = 0; pass < 3; ++pass) {
+    REQUIRE(softrays::RenderReference(bench, 40, with_guide).has_value());
+  }
+  REQUIRE(guide->TrainedCount() > 0);
+  const auto guided = softrays::RenderReference(bench, 2000, with_guide);
+  REQUIRE(guided.has_value());
+  // Unguided, this little light is still noisy: a few percent apart is expected
+  const auto expected = softrays::MeanLuminance(*unguided);
+  REQUIRE_THAT(softrays::MeanLuminance(*guided), WithinAbs(expected, expected * 0.08));
+}
+
+TEST_CASE("Guided against unguided error in equal time", "[.][benchmark]")
+{
+  auto bench = softrays::MakeBenchmarkCase(BenchmarkScene::WindowRoom);
+  bench.Camera.Dimensions = {.Width = 64, .Height = 48};
+  const auto reference = softrays::RenderReference(bench, 4096);
+  REQUIRE(reference.has_value());
+
+  constexpr std::array budgets{1.0, 4.0, 16.0};
+  const auto unguided = softrays::MeasureQuality(bench, *reference, budgets);
+  const auto guided = softrays::MeasureQuality(bench, *reference, budgets, 1, [](RayTracer& raytracer) { raytracer.Guide = std::make_shared<PathGuide>(1.0); });
+  REQUIRE(unguided.has_value());
+  REQUIRE(guided.has_value());
+  for (std::size_t point = 0; point < budgets.size(); ++point) {
+    WARN(budgets[point] << " s: relmse " << unguided->Points[point].RelMse << " unguided, " << guided->Points[point].RelMse << " guided");
+  }
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,140 @@
+#include "bvh.hpp"
+#include "compact_bvh.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "random.hpp"
+#include "shapes.hpp"
+#include "utility.hpp"
+#include "wide_bvh.hpp"
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <memory>
+
+using Catch::Matchers::WithinAbs;
+using softrays::Colour;
+using softrays::HitData;
+using softrays::HittableList;
+using softrays::Interval;
+using softrays::Lambertian;
+using softrays::Plane;
+using softrays::Point3;
+using softrays::Quad;
+using softrays::Ray;
+using softrays::Vec3;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Planes are hit from either side and never along them")
+{
+  const Plane plane(Point3(0, -1, 0), Vec3(0, 2, 0), std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5)));
+  const Interval ray_time{.Min = 0.001, .Max = softrays::Infinity};
+
+  HitData hit;
+  const Ray down{.Origin = {3, 1, -2}, .Direction = {0, -1, 0}};
+  REQUIRE(plane.Hit(down, ray_time, hit));
+  REQUIRE_THAT(hit.Time, WithinAbs(2.0, 1e-12));
+  REQUIRE((hit.Location - Point3(3, -1, -2)).NearZero());
+  REQUIRE((hit.Normal - Vec3(0, 1, 0)).NearZero());
+  REQUIRE(hit.FrontFace);
+  REQUIRE(plane.Occluded(down, ray_time));
+  REQUIRE_FALSE(plane.Occluded(down, {.Min = 0.001, .Max = 1.5}));
+
+  // From below the normal faces the ray
+  const Ray up{.Origin = {0, -4, 0}, .Direction = Vec3(1, 1, 0).UnitVector()};
+  REQUIRE(plane.Hit(up, ray_time, hit));
+  REQUIRE_THAT(hit.Location.y, WithinAbs(-1.0, 1e-12));
+  REQUIRE((hit.Normal - Vec3(0, -1, 0)).NearZero());
+  REQUIRE_FALSE(hit.FrontFace);
+
+  REQUIRE_FALSE(plane.Hit({.Origin = {0, 1, 0}, .Direction = {0, 1, 0}}, ray_time, hit));
+  REQUIRE_FALSE(plane.Hit({.Origin = {0, 1, 0}, .Direction = {1, 0, 0}}, ray_time, hit));
+  REQUIRE_FALSE(plane.Occluded({.Origin = {0, -1, 0}, .Direction = {0, 0, 1}}, ray_time));
+}
+
+TEST_CASE("Quads are hit inside their corners only")
+{
+  // Flat in z, whichever order the corners come in
+  const Quad quad(Point3(1, 2, -3), Point3(-1, 0, -3), std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5)));
+  const Interval ray_time{.Min = 0.001, .Max = softrays::Infinity};
+
+  HitData hit;
+  REQUIRE(quad.Hit({.Origin = {0.5, 1.5, 0}, .Direction = {0, 0, -1}}, ray_time, hit));
+  REQUIRE_THAT(hit.Time, WithinAbs(3.0, 1e-12));
+  REQUIRE((hit.Normal - Vec3(0, 0, 1)).NearZero());
+  REQUIRE_FALSE(quad.Hit({.Origin = {1.5, 1.5, 0}, .Direction = {0, 0, -1}}, ray_time, hit));
+  REQUIRE_FALSE(quad.Hit({.Origin = {0, 1, -3}, .Direction = {1, 0, 0}}, ray_time, hit));
+  REQUIRE(quad.Occluded({.Origin = {0, 1, -6}, .Direction = {0, 0, 1}}, ray_time));
+  REQUIRE_FALSE(quad.Occluded({.Origin = {0, 1, -6}, .Direction = {0, 0, 1}}, {.Min = 0.001, .Max = 2}));
+
+  // Boxes are finite and enclose the quad, so hierarchies can hold it
+  const auto box = quad.BoundingBox();
+  REQUIRE(box.X.Min == -1);
+  REQUIRE(box.Y.Max == 2);
+  REQUIRE(box.Z.Contains(-3));
+  REQUIRE(box.Z.Size() > 0);
+}
+
+TEST_CASE("Quad lights sample their area with a matching pdf")
+{
+  const Quad light(Point3(-1, 4, -1), Point3(1, 4, 1), std::make_shared<softrays::DiffuseLight>(Colour(4, 4, 4)));
+  REQUIRE(light.IsEmissive());
+  const Point3 origin(0.3, 0, 0.2);
+
+  // Averaging 1/pdf over sampled directions estimates the solid angle the quad covers
+  SeedRandom(9);
+  double solid_angle = 0;
+  constexpr int count = 20000;
+  for (int i = 0; i < count; ++i) {
+    const auto direction = light.RandomDirection(origin);
+    const auto pdf = light.PdfValue(origin, direction);
+    REQUIRE(pdf > 0);
+    solid_angle += 1 / pdf / count;
+  }
+  // Directly above, at height 4, a 2 x 2 square covers about area / distance squared
+  REQUIRE_THAT(solid_angle, WithinAbs(4.0 / 16.0, 0.02));
+  REQUIRE(light.PdfValue(origin, Vec3(0, -1, 0)) == 0);
+}
+
+TEST_CASE("Hierarchies test planes apart from the tree")
+{
+  HittableList list;
+  auto grey = std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5));
+  for (int i = 0; i < 50; ++i) {
+    list.Add(std::make_shared<softrays::Sphere>(Point3(RandomDouble(-10, 10), RandomDouble(0, 3), RandomDouble(-10, 10)), 0.6, std::shared_ptr(grey)));
+  }
+  list.Add(std::make_shared<Quad>(Point3(-2, 0, 5), Point3(2, 3, 5), std::shared_ptr(grey)));
+  list.Add(std::make_shared<Plane>(Point3(0, 0, 0), Vec3(0, 1, 0), std::shared_ptr(grey)));
+  list.Add(std::make_shared<Plane>(Point3(0, 0, -12), Vec3(0, 0, 1), std::shared_ptr(grey)));
+
+  const softrays::Bvh bvh(list.GetObjects());
+  const softrays::WideBvh wide(list.GetObjects());
+  const softrays::CompactBvh compact(list.GetObjects());
+  REQUIRE(bvh.Size() == list.Size());
+  REQUIRE(bvh.BoundingBox().X.Min == -softrays::Infinity);
+
+  for (int i = 0; i < 2000; ++i) {
+    const Ray ray{.Origin = {RandomDouble(-12, 12), RandomDouble(0.1, 4), RandomDouble(-11, 12)}, .Direction = Vec3::RandomUnitVector()};
+    const Interval ray_time{.Min = 0.001, .Max = softrays::Infinity};
+    HitData expected;
+    const auto in_list = list.Hit(ray, ray_time, expected);
+    for (const auto* hierarchy : std::array<const softrays::Hittable*, 3>{&bvh, &wide, &compact}) {
+      HitData actual;
+      REQUIRE(hierarchy->Hit(ray, ray_time, actual) == in_list);
+      REQUIRE(hierarchy->Occluded(ray, ray_time) == in_list);
+      if (in_list) {
+        REQUIRE_THAT(actual.Time, WithinAbs(expected.Time, 1e-9));
+      }
+    }
+  }
+
+  // Nothing but planes leaves an empty tree
+  HittableList floor_only;
+  floor_only.Add(std::make_shared<Plane>(Point3(0, 0, 0), Vec3(0, 1, 0), std::shared_ptr(grey)));
+  const softrays::Bvh planes(floor_only.GetObjects());
+  HitData hit;
+  REQUIRE(planes.Hit({.Origin = {0, 1, 0}, .Direction = {0, -1, 0}}, {.Min = 0.001, .Max = softrays::Infinity}, hit));
+  REQUIRE_FALSE(planes.Hit({.Origin = {0, 1, 0}, .Direction = {0, 1, 0}}, {.Min = 0.001, .Max = softrays::Infinity}, hit));
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,102 @@
+#include "image.hpp"
+#include "quality.hpp"
+
+#include <array>
+#include <cmath>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Catch::Matchers::WithinRel;
+using softrays::BenchmarkScene;
+using softrays::Colour;
+using softrays::FloatImage;
+using softrays::QualityCurve;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Image error metrics")
+{
+  FloatImage reference(2, 1);
+  reference.Set(0, 0, Colour(1, 1, 1));
+  reference.Set(1, 0, Colour(0, 0, 0));
+  FloatImage image = reference;
+  REQUIRE(softrays::RootMeanSquaredError(image, reference) == 0.0);
+  REQUIRE(softrays::RelativeMeanSquaredError(image, reference) == 0.0);
+
+  // Off by 0.5 in every channel of the bright pixel only
+  image.Set(0, 0, Colour(1.5, 1.5, 1.5));
+  REQUIRE_THAT(softrays::RootMeanSquaredError(image, reference), WithinRel(std::sqrt(0.25 / 2)));
+  REQUIRE_THAT(softrays::RelativeMeanSquaredError(image, reference), WithinRel(0.25 / 1.01 / 2));
+
+  // The same absolute error costs far more on a dark pixel
+  image = reference;
+  image.Set(1, 0, Colour(0.5, 0.5, 0.5));
+  REQUIRE(softrays::RelativeMeanSquaredError(image, reference) > 10 * softrays::RootMeanSquaredError(image, reference));
+
+  REQUIRE(std::isinf(softrays::RootMeanSquaredError(FloatImage(3, 1), reference)));
+
+  // White and black pixels average to half of white's luminance
+  REQUIRE_THAT(softrays::MeanLuminance(reference), WithinRel(0.5));
+}
+
+TEST_CASE("Canonical benchmark scenes build and are found by name")
+{
+  std::vector<std::string> names;
+  for (const auto scene : softrays::AllBenchmarkScenes) {
+    const auto bench = softrays::MakeBenchmarkCase(scene);
+    REQUIRE(bench.Scene.Prepare().has_value());
+    REQUIRE(softrays::FindBenchmarkScene(bench.Name) == scene);
+    names.push_back(bench.Name);
+  }
+  REQUIRE(names == std::vector<std::string>{"sphere-field", "glass-heavy", "small-light", "window-room", "diffuse-room"});
+  REQUIRE_FALSE(softrays::FindBenchmarkScene("cornell-box").has_value());
+}
+
+TEST_CASE("Quality improves with the time budget")
+{
+  auto bench = softrays::MakeBenchmarkCase(BenchmarkScene::SmallLight);
+  bench.Camera.Dimensions = {.Width = 24, .Height = 16};
+  const auto reference = softrays::RenderReference(bench, 512);
+  REQUIRE(reference.has_value());
+
+  constexpr std::array budgets{0.002, 0.05};
+  const auto curve = softrays::MeasureQuality(bench, *reference, budgets);
+  REQUIRE(curve.has_value());
+  REQUIRE(curve->Scene == "small-light");
+  REQUIRE(curve->Points.size() == 2);
+  REQUIRE(curve->Points[0].Seconds >= 0.002);
+  REQUIRE(curve->Points[1].Seconds >= 0.05);
+  REQUIRE(curve->Points[1].SamplesPerPixel > curve->Points[0].SamplesPerPixel);
+  REQUIRE(curve->Points[1].Rmse < curve->Points[0].Rmse);
+  REQUIRE(curve->Points[1].RelMse < curve->Points[0].RelMse);
+}
+
+TEST_CASE("Quality curves are written as CSV and JSON")
+{
+  const std::vector<QualityCurve> curves{
+      {.Scene = "a", .Points = {{.Seconds = 1, .SamplesPerPixel = 4, .Rmse = 0.5, .RelMse = 0.25}}},
+      {.Scene = "b", .Points = {{.Seconds = 2, .SamplesPerPixel = 8, .Rmse = 0.125, .RelMse = 0.0625}, {.Seconds = 4, .SamplesPerPixel = 16, .Rmse = 0.1, .RelMse = 0.05}}},
+  };
+
+  std::ostringstream csv;
+  softrays::WriteQualityCsv(csv, curves);
+  REQUIRE(csv.str() == "scene,seconds,spp,rmse,relmse\na,1,4,0.5,0.25\nb,2,8,0.125,0.0625\nb,4,16,0.1,0.05\n");
+
+  std::ostringstream json;
+  softrays::WriteQualityJson(json, curves);
+  REQUIRE(json.str().contains(R"({"scene": "b", "points": [)"));
+  REQUIRE(json.str().contains(R"({"seconds": 4, "spp": 16, "rmse": 0.1, "relmse": 0.05})"));
+  REQUIRE(json.str().starts_with("[\n"));
+  REQUIRE(json.str().ends_with("]\n"));
+
+  // Errors against a reference of another size are infinite, which JSON can't hold
+  const std::vector<QualityCurve> unmeasured{
+      {.Scene = "c", .Points = {{.Seconds = 1, .SamplesPerPixel = 4, .Rmse = softrays::Infinity, .RelMse = softrays::Infinity}}},
+  };
+  std::ostringstream null_json;
+  softrays::WriteQualityJson(null_json, unmeasured);
+  REQUIRE(null_json.str().contains(R"({"seconds": 1, "spp": 4, "rmse": null, "relmse": null})"));
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,140 @@
+#include "render_server.hpp"
+#include "scene.hpp"
+#include "scene_cache.hpp"
+#include "thread_pool.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using softrays::RenderJob;
+using softrays::RenderServer;
+using softrays::SceneCache;
+using softrays::SceneDescription;
+using softrays::ThreadPool;
+
+namespace {
+SceneDescription SmallScene(double radius)
+{
+  SceneDescription scene;
+  const auto material = scene.AddMaterial({.Type = softrays::MaterialType::Lambertian, .Albedo = {0.5, 0.5, 0.5}, .Parameter = 0});
+  scene.Spheres.push_back({.Center = {0, 0, -1}, .Radius = radius, .Material = material});
+  return scene;
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("ThreadPool runs higher priorities first, in order within a priority")
+{
+  ThreadPool pool(1);
+  std::promise<void> release;
+  pool.Submit([gate = release.get_future().share()] { gate.wait(); });
+
+  std::mutex mutex;
+  std::vector<int> order;
+  for (const auto id : {0, 50, 10, 51}) {
+    pool.Submit(
+        [&, id] {
+          const std::scoped_lock lock(mutex);
+          order.push_back(id);
+        },
+        id / 10);
+  }
+  release.set_value();
+  pool.WaitIdle();
+
+  REQUIRE(order == std::vector<int>{50, 51, 10, 0});
+}
+
+TEST_CASE("SceneCache keeps the most recently used scenes")
+{
+  SceneCache cache(2);
+  const auto a = SmallScene(0.5);
+  const auto b = SmallScene(0.6);
+  const auto c = SmallScene(0.7);
+
+  const auto first = cache.Acquire(a);
+  REQUIRE(first.Scene != nullptr);
+  REQUIRE_FALSE(first.Hit);
+
+  const auto again = cache.Acquire(a);
+  REQUIRE(again.Hit);
+  REQUIRE(again.Scene == first.Scene);
+
+  REQUIRE_FALSE(cache.Acquire(b).Hit);
+  REQUIRE(cache.Acquire(a).Hit);  // a is now the most recent, so c evicts b
+  REQUIRE_FALSE(cache.Acquire(c).Hit);
+  REQUIRE(cache.Size() == 2);
+  REQUIRE(cache.Acquire(a).Hit);
+  REQUIRE_FALSE(cache.Acquire(b).Hit);
+  REQUIRE(cache.Hits() == 3);
+  REQUIRE(cache.Misses() == 4);
+
+  SECTION("Scenes that fail to build are not cached")
+  {
+    auto broken = SmallScene(0.5);
+    broken.Spheres[0].Material = 7;
+    REQUIRE(cache.Acquire(broken).Scene == nullptr);
+    REQUIRE(cache.Acquire(broken).Scene == nullptr);
+    REQUIRE(cache.Misses() == 6);
+    REQUIRE(cache.Size() == 2);
+  }
+}
+
+TEST_CASE("SceneCache builds a scene once for concurrent requests")
+{
+  SceneCache cache;
+  const auto scene = softrays::RandomSphereScene();
+  std::vector<std::future<SceneCache::Result>> results;
+  for (int i = 0; i < 4; ++i) {
+    results.push_back(std::async(std::launch::async, [&] { return cache.Acquire(scene); }));
+  }
+  const auto first = results[0].get().Scene;
+  for (std::size_t i = 1; i < results.size(); ++i) {
+    REQUIRE(results[i].get().Scene == first);
+  }
+  REQUIRE(cache.Misses() == 1);
+}
+
+TEST_CASE("RenderServer reuses the scene for repeat jobs")
+{
+  const auto endpoint = "unix:" + (std::filesystem::temp_directory_path() / "softrays_render_server.sock").string();
+  RenderServer server({.Threads = 2, .CacheCapacity = 4, .TileSize = 8});
+  REQUIRE(server.Listen(endpoint));
+  std::thread serving([&] { server.Serve(); });
+
+  RenderJob job;
+  job.Scene = softrays::RandomSphereScene();
+  job.Camera = softrays::RandomSphereCamera();
+  job.Camera.Dimensions = {.Width = 24, .Height = 16};
+  job.Camera.SamplesPerPixel = 2;
+  job.Camera.MaxDepth = 4;
+
+  const auto first = softrays::SubmitRenderJob(endpoint, job);
+  job.Camera.LookFrom = {10, 3, 2};  // Same scene, another camera
+  const auto second = softrays::SubmitRenderJob(endpoint, job);
+  job.Scene.Spheres[0].Material = 100000;
+  const auto broken = softrays::SubmitRenderJob(endpoint, job);
+
+  server.Stop();
+  serving.join();
+
+  REQUIRE(first.has_value());
+  REQUIRE(first->Ok);
+  REQUIRE_FALSE(first->CacheHit);
+  REQUIRE(first->Image.Width == 24);
+  REQUIRE(first->Image.Height == 16);
+
+  REQUIRE(second.has_value());
+  REQUIRE(second->Ok);
+  REQUIRE(second->CacheHit);
+  REQUIRE(server.GetCache().Hits() == 1);
+
+  REQUIRE(broken.has_value());
+  REQUIRE_FALSE(broken->Ok);
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,209 @@
+#include "math.hpp"
+#include "random.hpp"
+#include "sampling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using softrays::SampleBatch;
+using softrays::Vec3;
+
+namespace {
+// The book's samplers, kept to compare against
+Vec3 RejectionUnitVector()
+{
+  while (true) {
+    const auto rand = Vec3::Random(-1.0, 1.0);
+    const auto lensq = rand.LengthSquared();
+    if (1e-160 < lensq && lensq <= 1) {  // NOLINT(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+      return rand / std::sqrt(lensq);
+    }
+  }
+}
+
+Vec3 RejectionInUnitDisk()
+{
+  while (true) {
+    const auto rand = Vec3{.x = RandomDouble(-1, 1), .y = RandomDouble(-1, 1), .z = 0};
+    if (rand.LengthSquared() < 1) {
+      return rand;
+    }
+  }
+}
+
+// Pearson's chi-squared statistic of `counts` against equally likely bins
+template <std::size_t Bins>
+double ChiSquared(const std::array<int, Bins>& counts, int total)
+{
+  const auto expected = static_cast<double>(total) / Bins;
+  double chi_squared = 0;
+  for (const auto count : counts) {
+    chi_squared += (count - expected) * (count - expected) / expected;
+  }
+  return chi_squared;
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("SinCosTurns matches the standard library")
+{
+  for (int step = -4999; step <= 20000; ++step) {
+    const auto turns = step / 10000.0;
+    const auto [sin, cos] = softrays::SinCosTurns(turns);
+    REQUIRE_THAT(sin, WithinAbs(std::sin(2 * softrays::Pi * turns), 2e-15));
+    REQUIRE_THAT(cos, WithinAbs(std::cos(2 * softrays::Pi * turns), 2e-15));
+  }
+}
+
+TEST_CASE("Analytic sphere samples are uniform")
+{
+  SeedRandom(1);
+  constexpr int count = 200000;
+  std::array<int, 8> octants{};
+  std::array<int, 10> heights{};
+  Vec3 mean;
+  for (int i = 0; i < count; ++i) {
+    const auto sample = Vec3::RandomUnitVector();
+    REQUIRE_THAT(sample.Length(), WithinAbs(1, 1e-12));
+    mean += sample / count;
+    ++octants[(sample.x > 0 ? 1U : 0U) | (sample.y > 0 ? 2U : 0U) | (sample.z > 0 ? 4U : 0U)];
+    ++heights[std::min(static_cast<std::size_t>((sample.z + 1) * 5), heights.size() - 1)];
+  }
+  // Each component has variance 1/3, so the means sit well inside 5 standard errors of 0
+  const auto standard_error = std::sqrt(1.0 / 3 / count);
+  REQUIRE(std::fabs(mean.x) < 5 * standard_error);
+  REQUIRE(std::fabs(mean.y) < 5 * standard_error);
+  REQUIRE(std::fabs(mean.z) < 5 * standard_error);
+  // Chi-squared critical values at p = 0.001 for 7 and 9 degrees of freedom
+  REQUIRE(ChiSquared(octants, count) < 24.3);
+  REQUIRE(ChiSquared(heights, count) < 27.9);
+}
+
+TEST_CASE("Analytic disk samples are uniform")
+{
+  SeedRandom(2);
+  constexpr int count = 200000;
+  std::array<int, 8> sectors{};
+  std::array<int, 10> areas{};
+  for (int i = 0; i < count; ++i) {
+    const auto sample = Vec3::RandomInUnitDisk();
+    REQUIRE(sample.LengthSquared() <= 1);
+    REQUIRE_THAT(sample.z, WithinAbs(0, 0));
+    const auto angle = std::atan2(sample.y, sample.x) + softrays::Pi;
+    ++sectors[std::min(static_cast<std::size_t>(angle / (2 * softrays::Pi) * 8), sectors.size() - 1)];
+    // Equal-area rings: the squared radius is uniform
+    ++areas[std::min(static_cast<std::size_t>(sample.LengthSquared() * 10), areas.size() - 1)];
+  }
+  REQUIRE(ChiSquared(sectors, count) < 24.3);
+  REQUIRE(ChiSquared(areas, count) < 27.9);
+
+  REQUIRE_THAT(Vec3::InUnitDisk(0.5, 0.5).LengthSquared(), WithinAbs(0, 0));
+}
+
+TEST_CASE("Batches match the scalar samplers")
+{
+  // Odd, so the lanes left over after the SIMD pairs are covered too
+  constexpr std::size_t count = 1001;
+  for (const auto disk : {false, true}) {
+    SeedRandom(3);
+    SampleBatch batch;
+    if (disk) {
+      softrays::SampleUnitDisk(count, batch);
+    } else {
+      softrays::SampleUnitSphere(count, batch);
+    }
+    REQUIRE(batch.Size() == count);
+
+    SeedRandom(3);
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto expected = disk ? Vec3::RandomInUnitDisk() : Vec3::RandomUnitVector();
+      REQUIRE_THAT(batch[i].x, WithinAbs(expected.x, 1e-15));
+      REQUIRE_THAT(batch[i].y, WithinAbs(expected.y, 1e-15));
+      REQUIRE_THAT(batch[i].z, WithinAbs(expected.z, 1e-15));
+    }
+  }
+
+  std::vector<double> values(5);
+  SeedRandom(4);
+  softrays::RandomDoubles(values);
+  SeedRandom(4);
+  for (const auto value : values) {
+    REQUIRE_THAT(value, WithinAbs(RandomDouble(), 0));
+  }
+}
+
+TEST_CASE("Rejection against analytic and batched sampling", "[.][benchmark]")
+{
+  constexpr std::size_t count = 4096;
+  SampleBatch batch;
+
+  BENCHMARK("Sphere by rejection")
+  {
+    Vec3 sum;
+    for (std::size_t i = 0; i < count; ++i) {
+      sum += RejectionUnitVector();
+    }
+    return sum.x;
+  };
+  BENCHMARK("Sphere analytic")
+  {
+    Vec3 sum;
+    for (std::size_t i = 0; i < count; ++i) {
+      sum += Vec3::RandomUnitVector();
+    }
+    return sum.x;
+  };
+  BENCHMARK("Sphere batched")
+  {
+    softrays::SampleUnitSphere(count, batch);
+    return batch.X.back();
+  };
+  BENCHMARK("Disk by rejection")
+  {
+    Vec3 sum;
+    for (std::size_t i = 0; i < count; ++i) {
+      sum += RejectionInUnitDisk();
+    }
+    return sum.x;
+  };
+  BENCHMARK("Disk analytic")
+  {
+    Vec3 sum;
+    for (std::size_t i = 0; i < count; ++i) {
+      sum += Vec3::RandomInUnitDisk();
+    }
+    return sum.x;
+  };
+  BENCHMARK("Disk batched")
+  {
+    softrays::SampleUnitDisk(count, batch);
+    return batch.X.back();
+  };
+
+  // The mappings alone, without the generator that dominates the above
+  std::vector<double> u(count);
+  std::vector<double> v(count);
+  softrays::RandomDoubles(u);
+  softrays::RandomDoubles(v);
+  BENCHMARK("Disk mapping, one at a time")
+  {
+    Vec3 sum;
+    for (std::size_t i = 0; i < count; ++i) {
+      sum += Vec3::InUnitDisk(u[i], v[i]);
+    }
+    return sum.x;
+  };
+  BENCHMARK("Disk mapping, batched")
+  {
+    softrays::MapToUnitDisk(u, v, batch);
+    return batch.X.back();
+  };
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
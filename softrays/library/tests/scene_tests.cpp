@@ -0,0 +1,110 @@
+#include "raytracer.hpp"
+#include "scene.hpp"
+#include "serialize.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cstddef>
+#include <span>
+
+using Catch::Matchers::WithinRel;
+using softrays::ByteReader;
+using softrays::ByteWriter;
+using softrays::CameraSettings;
+using softrays::MaterialType;
+using softrays::RayTracer;
+using softrays::SceneDescription;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Random sphere scenes are reproducible from their seed")
+{
+  const auto scene = softrays::RandomSphereScene(7);
+  REQUIRE(scene.Spheres.size() > 400);
+  REQUIRE(scene.Hash() == softrays::RandomSphereScene(7).Hash());
+  REQUIRE(scene.Hash() != softrays::RandomSphereScene(8).Hash());
+}
+
+TEST_CASE("Scene and camera descriptions round-trip through bytes")
+{
+  auto scene = softrays::RandomSphereScene(1);
+  scene.SkyBackground = false;
+  scene.EnvironmentPath = "sky.pfm";
+  scene.Quads.push_back({.Corner = {-1, 0, -2}, .Opposite = {1, 2, -2}, .Material = 0});
+  auto camera = softrays::RandomSphereCamera();
+  camera.Dimensions = {.Width = 33, .Height = 17};
+
+  ByteWriter writer;
+  scene.Serialize(writer);
+  camera.Serialize(writer);
+
+  ByteReader reader(writer.Data());
+  const auto scene_copy = SceneDescription::Deserialize(reader);
+  const auto camera_copy = CameraSettings::Deserialize(reader);
+  REQUIRE(scene_copy.has_value());
+  REQUIRE(camera_copy.has_value());
+  REQUIRE(reader.AtEnd());
+
+  REQUIRE(scene_copy->Hash() == scene.Hash());
+  REQUIRE(scene_copy->Spheres.size() == scene.Spheres.size());
+  REQUIRE(scene_copy->Planes.size() == 1);
+  REQUIRE(scene_copy->Quads.size() == 1);
+  REQUIRE(scene_copy->Quads.front().Opposite.y == 2);
+  REQUIRE(scene_copy->EnvironmentPath == "sky.pfm");
+  REQUIRE_FALSE(scene_copy->SkyBackground);
+  REQUIRE(camera_copy->Dimensions.Width == 33);
+  REQUIRE_THAT(camera_copy->FieldOfView, WithinRel(camera.FieldOfView));
+}
+
+TEST_CASE("Truncated scene bytes are rejected")
+{
+  ByteWriter writer;
+  softrays::RandomSphereScene(1).Serialize(writer);
+  const auto& bytes = writer.Data();
+  const auto truncated = std::span<const std::byte>(bytes).first(bytes.size() / 2);
+  ByteReader reader(truncated);
+  REQUIRE_FALSE(SceneDescription::Deserialize(reader).has_value());
+}
+
+TEST_CASE("Scene bytes with an unknown material type are rejected")
+{
+  auto scene = softrays::RandomSphereScene(1);
+  scene.Materials[0].Type = static_cast<MaterialType>(200);
+  ByteWriter writer;
+  scene.Serialize(writer);
+  ByteReader reader(writer.Data());
+  REQUIRE_FALSE(SceneDescription::Deserialize(reader).has_value());
+}
+
+TEST_CASE("Scene bytes with a flag that is neither true nor false are rejected")
+{
+  ByteWriter writer;
+  softrays::RandomSphereScene(1).Serialize(writer);
+  auto bytes = writer.Take();
+  // SkyBackground, followed by the background colour, an empty environment path and its intensity
+  auto& sky = bytes[bytes.size() - 41];
+  REQUIRE(sky == std::byte{1});
+  sky = std::byte{2};
+  ByteReader reader(bytes);
+  REQUIRE_FALSE(SceneDescription::Deserialize(reader).has_value());
+}
+
+TEST_CASE("Populating a tracer builds the described world")
+{
+  SceneDescription scene;
+  const auto light = scene.AddMaterial({.Type = MaterialType::DiffuseLight, .Albedo = {4, 4, 4}});
+  const auto ground = scene.AddMaterial({.Type = MaterialType::Lambertian, .Albedo = {0.5, 0.5, 0.5}});
+  scene.Spheres.push_back({.Center = {0, 2, 0}, .Radius = 0.5, .Material = light});
+  scene.Planes.push_back({.Point = {0, 0, 0}, .Normal = {0, 1, 0}, .Material = ground});
+  scene.Quads.push_back({.Corner = {-1, 3, -1}, .Opposite = {1, 3, 1}, .Material = light});
+
+  RayTracer raytracer;
+  REQUIRE(scene.Populate(raytracer));
+  REQUIRE(raytracer.GetWorld().Size() == 3);
+  raytracer.UpdateLights();
+  REQUIRE(raytracer.GetLights().Size() == 2);
+
+  scene.Spheres.push_back({.Center = {0, 0, 0}, .Radius = 1, .Material = 99});
+  RayTracer broken;
+  REQUIRE_FALSE(scene.Populate(broken));
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,106 @@
+#include "image.hpp"
+#include "math.hpp"
+#include "scene.hpp"
+#include "sequence.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using softrays::CameraKeyframe;
+using softrays::CameraSettings;
+using softrays::FloatImage;
+using softrays::Point3;
+using softrays::SequenceFrame;
+
+namespace {
+CameraSettings SmallCamera()
+{
+  auto camera = softrays::RandomSphereCamera();
+  camera.Dimensions = {.Width = 16, .Height = 8};
+  camera.SamplesPerPixel = 1;
+  camera.MaxDepth = 2;
+  return camera;
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Keyframed cameras interpolate between keyframes")
+{
+  auto camera = SmallCamera();
+  std::vector<CameraKeyframe> keyframes{{.Frame = 0, .Camera = camera}, {.Frame = 10, .Camera = camera}};
+  keyframes[0].Camera.LookFrom = Point3(0, 0, 0);
+  keyframes[1].Camera.LookFrom = Point3(10, 0, 0);
+  keyframes[1].Camera.FieldOfView = camera.FieldOfView + 10;
+
+  REQUIRE_THAT(softrays::InterpolateCamera(keyframes, 3).LookFrom.x, WithinAbs(3, 1e-12));
+  REQUIRE_THAT(softrays::InterpolateCamera(keyframes, 5).FieldOfView, WithinAbs(camera.FieldOfView + 5, 1e-12));
+  REQUIRE_THAT(softrays::InterpolateCamera(keyframes, -4).LookFrom.x, WithinAbs(0, 1e-12));
+  REQUIRE_THAT(softrays::InterpolateCamera(keyframes, 25).LookFrom.x, WithinAbs(10, 1e-12));
+}
+
+TEST_CASE("Camera keyframes are read from text")
+{
+  std::istringstream text("# frame from at [fov]\n\n8 1 2 3 0 0 0 45\n0 13 2 3 0 0 0\n");
+  const auto keyframes = softrays::ReadCameraKeyframes(text, SmallCamera());
+  REQUIRE(keyframes.has_value());
+  REQUIRE(keyframes->size() == 2);
+  REQUIRE(keyframes->front().Frame == 0);
+  REQUIRE_THAT(keyframes->front().Camera.LookFrom.x, WithinAbs(13, 0));
+  REQUIRE_THAT(keyframes->front().Camera.FieldOfView, WithinAbs(SmallCamera().FieldOfView, 0));
+  REQUIRE_THAT(keyframes->back().Camera.FieldOfView, WithinAbs(45, 0));
+
+  std::istringstream malformed("0 1 2 3 0 0\n");
+  REQUIRE_FALSE(softrays::ReadCameraKeyframes(malformed, SmallCamera()).has_value());
+  std::istringstream trailing("0 1 2 3 0 0 0 45 extra\n");
+  REQUIRE_FALSE(softrays::ReadCameraKeyframes(trailing, SmallCamera()).has_value());
+  std::istringstream empty("# nothing\n");
+  REQUIRE_FALSE(softrays::ReadCameraKeyframes(empty, SmallCamera()).has_value());
+}
+
+TEST_CASE("Frame paths number each frame")
+{
+  REQUIRE(softrays::FramePath("frame_###.ppm", 7) == "frame_007.ppm");
+  REQUIRE(softrays::FramePath("out/##/f.pfm", 3) == "out/03/f.pfm");
+  REQUIRE(softrays::FramePath("render.ppm", 12) == "render_12.ppm");
+  REQUIRE(softrays::FramePath("dir.v2/render", 1) == "dir.v2/render_1");
+}
+
+TEST_CASE("Sequences render and write every frame in order")
+{
+  const auto prepared = softrays::RandomSphereScene(1).Prepare();
+  REQUIRE(prepared.has_value());
+  const auto camera = SmallCamera();
+
+  std::mutex mutex;
+  std::vector<int> updated;
+  std::vector<int> written;
+  auto update = [&](int frame) -> std::optional<SequenceFrame> {
+    const std::scoped_lock lock(mutex);
+    updated.push_back(frame);
+    return SequenceFrame{.Scene = *prepared, .Camera = camera};
+  };
+  auto write = [&](int frame, const FloatImage& image) {
+    const std::scoped_lock lock(mutex);
+    written.push_back(frame);
+    return image.Width == 16 && image.Height == 8;
+  };
+  REQUIRE(softrays::RenderSequence(5, update, write, {.TileSize = 4, .Threads = 2}));
+  REQUIRE(updated == std::vector<int>{0, 1, 2, 3, 4});
+  REQUIRE(written == std::vector<int>{0, 1, 2, 3, 4});
+
+  // A failed write stops the sequence
+  written.clear();
+  auto failing_write = [&](int frame, const FloatImage&) {
+    const std::scoped_lock lock(mutex);
+    written.push_back(frame);
+    return frame < 1;
+  };
+  REQUIRE_FALSE(softrays::RenderSequence(5, update, failing_write, {.TileSize = 4, .Threads = 2}));
+  REQUIRE(written.size() < 5);
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
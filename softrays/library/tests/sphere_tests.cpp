@@ -37,6 +37,9 @@ TEST_CASE("Sphere ray intersection tests")
     REQUIRE_THAT(hit_data.Time, WithinRel(2.0));  // Expect hit time to be 2
     REQUIRE((hit_data.Location - Point3(0.0, 0.0, -1.0)).NearZero());  // Expect hit location on the sphere surface
     REQUIRE((hit_data.Normal - Point3(0.0, 0.0, -1.0)).NearZero());  // Expect outward normal at the hit point
+
+    REQUIRE(sphere.Occluded(ray, interval));
+    REQUIRE_FALSE(sphere.Occluded(ray, {.Min = 0.001, .Max = 1.5}));  // Ends before reaching the sphere
   }
 
   // Test ray that misses the sphere
@@ -47,6 +50,7 @@ TEST_CASE("Sphere ray intersection tests")
     HitData hit_data;
 
     REQUIRE_FALSE(sphere.Hit(ray, interval, hit_data));  // Should miss the sphere
+    REQUIRE_FALSE(sphere.Occluded(ray, interval));
   }
 
   // Test ray that starts inside the sphere
@@ -0,0 +1,115 @@
+#include "image.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "shapes.hpp"
+#include "stream_render.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using softrays::Colour;
+using softrays::FloatImage;
+using softrays::Lambertian;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::Sphere;
+using softrays::StreamRenderOptions;
+
+namespace {
+// One sample through each pixel centre and no bounces: only the sky and the spheres' silhouettes,
+// so every render of the frame is identical
+void SetupDeterministicScene(RayTracer& raytracer, int width, int height, bool framebuffer = true)
+{
+  raytracer.ResizeViewport({.Width = width, .Height = height}, framebuffer);
+  raytracer.SetSamplesPerPixel(1);
+  raytracer.MaxDepth = 1;
+  raytracer.LookFrom = Point3(0, 1, 4);
+  raytracer.LookAt = Point3(0, 0, 0);
+  auto& world = raytracer.GetWorld();
+  world.Add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5))));
+  world.Add(std::make_shared<Sphere>(Point3(0, 0.5, 0), 0.5, std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5))));
+}
+
+FloatImage RenderInMemory(int width, int height)
+{
+  RayTracer raytracer;
+  SetupDeterministicScene(raytracer, width, height);
+  raytracer.Render();
+  FloatImage image(width, height);
+  const auto& pixels = raytracer.GetPixelData();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      image.Set(x, y, pixels[(static_cast<std::size_t>(y) * static_cast<std::size_t>(width)) + static_cast<std::size_t>(x)]);
+    }
+  }
+  return image;
+}
+
+std::vector<std::uint8_t> ReadBytes(const std::filesystem::path& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Streamed PFM renders match in-memory renders")
+{
+  // Sizes that are not multiples of the tile size leave partial tiles on the right and bottom edges
+  constexpr int width = 37;
+  constexpr int height = 23;
+  const auto path = std::filesystem::temp_directory_path() / "softrays_stream_test.pfm";
+
+  RayTracer raytracer;
+  SetupDeterministicScene(raytracer, width, height, false);
+  REQUIRE(raytracer.GetPixelData().empty());
+  REQUIRE(softrays::RenderToFile(raytracer, path.string(), {.TileSize = 8, .Threads = 3}));
+
+  const auto streamed = softrays::LoadPFM(path.string());
+  REQUIRE(streamed.has_value());
+  REQUIRE(streamed->Width == width);
+  REQUIRE(streamed->Height == height);
+  REQUIRE(streamed->Pixels == RenderInMemory(width, height).Pixels);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Streamed PPM renders are binary 8-bit images")
+{
+  constexpr int width = 20;
+  constexpr int height = 12;
+  const auto path = std::filesystem::temp_directory_path() / "softrays_stream_test.ppm";
+
+  RayTracer raytracer;
+  SetupDeterministicScene(raytracer, width, height, false);
+  REQUIRE(softrays::RenderToFile(raytracer, path.string(), {.TileSize = 16, .Threads = 2}));
+
+  const std::string header = "P6\n20 12\n255\n";
+  const auto bytes = ReadBytes(path);
+  REQUIRE(bytes.size() == header.size() + (width * height * 3));
+  REQUIRE(std::string(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(header.size())) == header);
+
+  const auto expected = softrays::ToRGBA8(RenderInMemory(width, height));
+  for (std::size_t pixel = 0; pixel < static_cast<std::size_t>(width * height); ++pixel) {
+    for (std::size_t channel = 0; channel < 3; ++channel) {
+      REQUIRE(bytes[header.size() + (pixel * 3) + channel] == expected[(pixel * 4) + channel]);
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Streaming to an unwritable path fails cleanly")
+{
+  RayTracer raytracer;
+  SetupDeterministicScene(raytracer, 8, 8, false);
+  const auto path = std::filesystem::temp_directory_path() / "softrays_no_such_directory" / "out.pfm";
+  REQUIRE_FALSE(softrays::RenderToFile(raytracer, path.string(), StreamRenderOptions{}));
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
@@ -0,0 +1,139 @@
+#include "material.hpp"
+#include "math.hpp"
+#include "raytracer.hpp"
+#include "shapes.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cstddef>
+#include <memory>
+
+using Catch::Matchers::WithinAbs;
+using softrays::Colour;
+using softrays::Lambertian;
+using softrays::Point3;
+using softrays::RayTracer;
+using softrays::Sphere;
+using softrays::Vec3;
+
+namespace {
+constexpr int size = 32;
+constexpr int samples = 2;
+
+// Looking straight down at the ground, optionally with a ball floating between it and the camera
+void SetupScene(RayTracer& raytracer, bool with_ball)
+{
+  raytracer.ResizeViewport({.Width = size, .Height = size});
+  raytracer.SetSamplesPerPixel(samples);
+  raytracer.MaxDepth = 4;
+  raytracer.FieldOfView = 60;
+  raytracer.LookFrom = Point3(0, 5, 0);
+  raytracer.LookAt = Point3(0, 0, 0);
+  raytracer.CameraUp = Vec3(0, 0, -1);
+  raytracer.TemporalReuse = true;
+  const auto grey = std::make_shared<Lambertian>(Colour(0.5, 0.5, 0.5));
+  raytracer.GetWorld().Add(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, grey));
+  if (with_ball) {
+    raytracer.GetWorld().Add(std::make_shared<Sphere>(Point3(0, 2, 0), 0.8, grey));
+  }
+}
+
+void Pan(RayTracer& raytracer, double dx)
+{
+  raytracer.LookFrom += Vec3(dx, 0, 0);
+  raytracer.LookAt += Vec3(dx, 0, 0);
+}
+
+// Mean squared difference between two independent renders, i.e. twice their noise variance
+double NoiseBetween(const RayTracer& a, const RayTracer& b)
+{
+  double sum = 0;
+  for (std::size_t i = 0; i < a.GetPixelData().size(); ++i) {
+    sum += (a.GetPixelData()[i] - b.GetPixelData()[i]).LengthSquared();
+  }
+  return sum / static_cast<double>(a.GetPixelData().size());
+}
+
+// Pixels away from the border that had to start over
+int FreshInteriorPixels(const RayTracer& raytracer)
+{
+  int fresh = 0;
+  for (int y = 4; y < size - 4; ++y) {
+    for (int x = 4; x < size - 4; ++x) {
+      if (raytracer.GetSampleCounts()[static_cast<std::size_t>((y * size) + x)] <= samples) {
+        ++fresh;
+      }
+    }
+  }
+  return fresh;
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Temporal reuse accumulates a still camera's frames")
+{
+  RayTracer first;
+  SetupScene(first, false);
+  RayTracer second;
+  SetupScene(second, false);
+  constexpr int frames = 8;
+  for (int i = 0; i < frames; ++i) {
+    first.Render();
+    second.Render();
+  }
+  for (const auto count : first.GetSampleCounts()) {
+    REQUIRE_THAT(count, WithinAbs(samples * frames, 1e-6));
+  }
+  const auto accumulated = NoiseBetween(first, second);
+
+  first.TemporalReuse = false;
+  second.TemporalReuse = false;
+  first.Render();
+  second.Render();
+  REQUIRE(accumulated * 4 < NoiseBetween(first, second));
+}
+
+TEST_CASE("Temporal reuse survives a camera pan")
+{
+  RayTracer first;
+  SetupScene(first, false);
+  RayTracer second;
+  SetupScene(second, false);
+  for (int i = 0; i < 8; ++i) {
+    first.Render();
+    second.Render();
+  }
+  Pan(first, 0.2);
+  Pan(second, 0.2);
+  first.Render();
+  second.Render();
+  REQUIRE(FreshInteriorPixels(first) == 0);
+  const auto panned = NoiseBetween(first, second);
+
+  first.TemporalReuse = false;
+  second.TemporalReuse = false;
+  first.Render();
+  second.Render();
+  REQUIRE(panned * 3 < NoiseBetween(first, second));
+}
+
+TEST_CASE("Temporal reuse rejects disoccluded history")
+{
+  RayTracer raytracer;
+  SetupScene(raytracer, true);
+  for (int i = 0; i < 4; ++i) {
+    raytracer.Render();
+  }
+  // The ball is much nearer than the ground, so it slides off the ground it was hiding
+  Pan(raytracer, 0.3);
+  raytracer.Render();
+  REQUIRE(FreshInteriorPixels(raytracer) > 0);
+
+  // Changing the viewport starts over
+  raytracer.ResizeViewport({.Width = size, .Height = size});
+  raytracer.Render();
+  for (const auto count : raytracer.GetSampleCounts()) {
+    REQUIRE(count == samples);
+  }
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
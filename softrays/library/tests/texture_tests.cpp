@@ -0,0 +1,222 @@
+#include "image.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "scene.hpp"
+#include "serialize.hpp"
+#include "shapes.hpp"
+#include "texture.hpp"
+#include "utility.hpp"
+
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using softrays::Colour;
+using softrays::FloatImage;
+using softrays::TextureCache;
+using softrays::TiledTexture;
+
+namespace {
+std::string TexturePath(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / ("softrays_" + name + ".tiles")).string();
+}
+
+// Every texel a different colour, so a texel from the wrong place shows
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+FloatImage Gradient(int width, int height)
+{
+  FloatImage image(width, height);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      image.Set(x, y, Colour(x / 128.0, y / 128.0, ((x * 7) + (y * 3)) % 11 / 10.0));
+    }
+  }
+  return image;
+}
+
+void RequireColour(const Colour& actual, const Colour& expected, double margin = 1e-6)
+{
+  REQUIRE_THAT(actual.x, WithinAbs(expected.x, margin));
+  REQUIRE_THAT(actual.y, WithinAbs(expected.y, margin));
+  REQUIRE_THAT(actual.z, WithinAbs(expected.z, margin));
+}
+}
+
+TEST_CASE("Tiled textures read back their image and its mip levels")
+{
+  // Neither side a multiple of the tile size, so the edge tiles are partial
+  const auto image = Gradient(100, 60);
+  const auto path = TexturePath("levels");
+  REQUIRE(softrays::WriteTiledTexture(path, image, 16));
+  const auto texture = TiledTexture::Open(path, std::make_shared<TextureCache>(1U << 20U));
+  REQUIRE(texture != nullptr);
+  REQUIRE(texture->GetWidth() == 100);
+  REQUIRE(texture->GetHeight() == 60);
+  REQUIRE(texture->LevelCount() == 8);  // 100 halves to 1 in 7 steps
+
+  for (int y = 0; y < image.Height; ++y) {
+    for (int x = 0; x < image.Width; ++x) {
+      RequireColour(texture->Texel(0, x, y), image.At(x, y));
+    }
+  }
+  RequireColour(texture->Texel(0, -1, 60), image.At(99, 0));
+
+  // Bilinear lookups at texel centres are that texel, across tile edges as well
+  RequireColour(texture->Sample((15.5 / 100), 1 - (20.5 / 60), 0), image.At(15, 20));
+  RequireColour(texture->Sample((16.0 / 100), 1 - (20.5 / 60), 0), (image.At(15, 20) + image.At(16, 20)) * 0.5);
+
+  // A power of two box-filters down to its exact mean
+  const auto square = Gradient(64, 64);
+  REQUIRE(softrays::WriteTiledTexture(path, square, 16));
+  const auto pyramid = TiledTexture::Open(path, std::make_shared<TextureCache>(1U << 20U));
+  REQUIRE(pyramid != nullptr);
+  Colour mean;
+  for (int y = 0; y < 64; ++y) {
+    for (int x = 0; x < 64; ++x) {
+      mean += square.At(x, y) / (64.0 * 64.0);
+    }
+  }
+  RequireColour(pyramid->Average(), mean);
+  RequireColour(pyramid->Texel(1, 3, 5), (square.At(6, 10) + square.At(7, 10) + square.At(6, 11) + square.At(7, 11)) * 0.25);
+  // A footprint as wide as the texture filters all of it
+  RequireColour(pyramid->Sample(0.3, 0.8, 1.0), mean);
+  std::filesystem::remove(path);
+
+  REQUIRE(TiledTexture::Open(TexturePath("missing")) == nullptr);
+}
+
+TEST_CASE("The tile cache stays within its capacity")
+{
+  const auto image = Gradient(256, 256);
+  const auto path = TexturePath("bounded");
+  REQUIRE(softrays::WriteTiledTexture(path, image, 16));
+  // Room for about a dozen of the 342 tiles
+  const auto cache = std::make_shared<TextureCache>(48U << 10U, 4);
+  const auto texture = TiledTexture::Open(path, cache);
+  REQUIRE(texture != nullptr);
+
+  std::mt19937 generator(5);
+  std::uniform_int_distribution<int> coordinate(0, 255);
+  for (int lookup = 0; lookup < 5000; ++lookup) {
+    const auto x = coordinate(generator);
+    const auto y = coordinate(generator);
+    RequireColour(texture->Texel(0, x, y), image.At(x, y));
+  }
+  const auto stats = cache->Stats();
+  REQUIRE(stats.Evictions > 0);
+  REQUIRE(stats.PeakBytes <= stats.CapacityBytes);
+  REQUIRE(stats.Hits + stats.Misses == 5000);
+
+  // Neighbouring lookups mostly hit the tile the previous one loaded
+  cache->ResetStats();
+  for (int y = 0; y < 256; ++y) {
+    for (int x = 0; x < 256; ++x) {
+      static_cast<void>(texture->Texel(0, x, y));
+    }
+  }
+  REQUIRE(cache->Stats().HitRate() > 0.9);
+
+  cache->SetCapacity(0);
+  REQUIRE(cache->Stats().ResidentBytes == 0);
+  RequireColour(texture->Texel(0, 10, 20), image.At(10, 20));
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Textures can be looked up from many threads at once")
+{
+  const auto image = Gradient(192, 128);
+  const auto path = TexturePath("threads");
+  REQUIRE(softrays::WriteTiledTexture(path, image, 16));
+  const auto cache = std::make_shared<TextureCache>(32U << 10U, 4);
+  const auto texture = TiledTexture::Open(path, cache);
+  REQUIRE(texture != nullptr);
+
+  std::atomic<int> wrong{0};
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned seed = 0; seed < 4; ++seed) {
+      threads.emplace_back([&, seed] {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> x_of(0, image.Width - 1);
+        std::uniform_int_distribution<int> y_of(0, image.Height - 1);
+        for (int lookup = 0; lookup < 20000; ++lookup) {
+          const auto x = x_of(generator);
+          const auto y = y_of(generator);
+          if ((texture->Texel(0, x, y) - image.At(x, y)).LengthSquared() > 1e-12) {
+            ++wrong;
+          }
+        }
+      });
+    }
+  }
+  REQUIRE(wrong == 0);
+  REQUIRE(cache->Stats().PeakBytes <= cache->Stats().CapacityBytes);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Textured materials take their albedo from the texture")
+{
+  const auto image = Gradient(32, 32);
+  const auto source = (std::filesystem::temp_directory_path() / "softrays_material_texture.pfm").string();
+  REQUIRE(softrays::SavePFM(source, image));
+  std::filesystem::remove(source + ".tiles");
+  // Converted on first open, then reused
+  const auto texture = TiledTexture::OpenImage(source);
+  REQUIRE(texture != nullptr);
+  REQUIRE(std::filesystem::exists(source + ".tiles"));
+  REQUIRE(TiledTexture::OpenImage(source) != nullptr);
+
+  const softrays::Lambertian material(Colour(0.5, 1, 1), texture);
+  const softrays::Ray ray{.Origin = {0, 0, 1}, .Direction = {0, 0, -1}};
+  softrays::HitData hit;
+  hit.Location = {0, 0, 0};
+  hit.Normal = {0, 0, 1};
+  hit.Time = 1;
+  hit.U = 9.5 / 32;
+  hit.V = 1 - (4.5 / 32);
+  hit.TextureScale = 1;
+  Colour attenuation;
+  softrays::Ray scattered;
+  REQUIRE(material.Scatter(ray, hit, attenuation, scattered));
+  RequireColour(attenuation, image.At(9, 4) * Colour(0.5, 1, 1));
+  RequireColour(material.PreviewAlbedo(), texture->Average() * Colour(0.5, 1, 1));
+
+  // Without texture coordinates the surface gets the texture's mean
+  hit.TextureScale = 0;
+  REQUIRE(material.Scatter(ray, hit, attenuation, scattered));
+  RequireColour(attenuation, texture->Average() * Colour(0.5, 1, 1));
+
+  // Spheres provide coordinates to textured materials
+  const softrays::Sphere sphere({0, 0, -3}, 1, std::make_shared<softrays::Lambertian>(Colour(1, 1, 1), texture));
+  softrays::HitData sphere_hit;
+  REQUIRE(sphere.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, sphere_hit));
+  REQUIRE(sphere_hit.U >= 0);
+  REQUIRE(sphere_hit.U <= 1);
+  REQUIRE_THAT(sphere_hit.V, WithinAbs(0.5, 1e-12));
+  REQUIRE(sphere_hit.TextureScale > 0);
+
+  // A scene's texture paths survive serialization, and one that can't be opened fails the build
+  auto scene = softrays::RandomSphereScene(1);
+  scene.Materials.front().TexturePath = source;
+  softrays::ByteWriter writer;
+  scene.Serialize(writer);
+  softrays::ByteReader reader(writer.Data());
+  const auto copy = softrays::SceneDescription::Deserialize(reader);
+  REQUIRE(copy.has_value());
+  REQUIRE(copy->Materials.front().TexturePath == source);
+  REQUIRE(copy->Prepare().has_value());
+  scene.Materials.front().TexturePath = TexturePath("missing");
+  REQUIRE_FALSE(scene.Prepare().has_value());
+
+  std::filesystem::remove(source);
+  std::filesystem::remove(source + ".tiles");
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
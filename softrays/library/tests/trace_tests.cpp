@@ -0,0 +1,91 @@
+#include "trace.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <latch>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using softrays::TileRect;
+using softrays::TraceScope;
+
+namespace {
+std::size_t Count(std::string_view text, std::string_view pattern)
+{
+  std::size_t count = 0;
+  for (auto at = text.find(pattern); at != std::string_view::npos; at = text.find(pattern, at + 1)) {
+    ++count;
+  }
+  return count;
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("Trace events are only recorded while tracing")
+{
+  softrays::StartTracing();
+  softrays::StopTracing();
+  {
+    const TraceScope ignored("Ignored");
+  }
+  REQUIRE(Count(softrays::ChromeTraceJson(), "\"name\"") == 0);
+
+  softrays::StartTracing();
+  REQUIRE(softrays::TracingEnabled());
+  {
+    const TraceScope frame("Frame");
+    const TraceScope tile("Tile", TileRect{.FromX = 32, .FromY = 64, .ToX = 48, .ToY = 80});
+  }
+  softrays::StopTracing();
+
+  const auto json = softrays::ChromeTraceJson();
+  REQUIRE(json.starts_with(R"({"displayTimeUnit":"ms","traceEvents":[)"));
+  REQUIRE(Count(json, R"("name":"Frame","ph":"X")") == 1);
+  REQUIRE(Count(json, R"("args":{"x":32,"y":64,"width":16,"height":16})") == 1);
+
+  // A new trace starts empty
+  softrays::StartTracing();
+  softrays::StopTracing();
+  REQUIRE(Count(softrays::ChromeTraceJson(), "\"name\"") == 0);
+}
+
+TEST_CASE("Each thread records onto its own track")
+{
+  constexpr int threadCount = 4;
+  constexpr int eventsPerThread = 100;
+  softrays::StartTracing();
+  {
+    // Threads that exit hand their buffer on, so keep them all alive until each has recorded
+    std::latch recorded(threadCount);
+    std::vector<std::jthread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+      threads.emplace_back([&recorded] {
+        for (int i = 0; i < eventsPerThread; ++i) {
+          const TraceScope event("Work");
+        }
+        recorded.arrive_and_wait();
+      });
+    }
+  }
+  softrays::StopTracing();
+
+  const auto json = softrays::ChromeTraceJson();
+  REQUIRE(Count(json, R"("name":"Work")") == threadCount * eventsPerThread);
+  // Each tid appears on exactly the events of one thread
+  std::vector<std::string> tids;
+  for (auto at = json.find("\"tid\":"); at != std::string::npos; at = json.find("\"tid\":", at + 1)) {
+    const auto tid = json.substr(at, json.find(',', at) - at);
+    if (std::find(tids.begin(), tids.end(), tid) == tids.end()) {
+      tids.push_back(tid);
+    }
+  }
+  REQUIRE(tids.size() == threadCount);
+  for (const auto& tid : tids) {
+    REQUIRE(Count(json, tid + ",") == eventsPerThread);
+  }
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
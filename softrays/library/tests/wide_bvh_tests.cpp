@@ -0,0 +1,160 @@
+#include "bvh.hpp"
+#include "material.hpp"
+#include "math.hpp"
+#include "scene.hpp"
+#include "shapes.hpp"
+#include "utility.hpp"
+#include "wide_bvh.hpp"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+using softrays::Bvh;
+using softrays::HitData;
+using softrays::HittableList;
+using softrays::Point3;
+using softrays::Ray;
+using softrays::Vec3;
+using softrays::WideBvh;
+using softrays::WideBvhNode;
+
+namespace {
+HittableList RandomSpheres(std::uint32_t seed)
+{
+  HittableList list;
+  const auto scene = softrays::RandomSphereScene(seed);
+  for (const auto& sphere : scene.Spheres) {
+    list.Add(std::make_shared<softrays::Sphere>(sphere.Center, sphere.Radius, scene.Materials[sphere.Material].Build()));
+  }
+  return list;
+}
+
+Ray RandomRay()
+{
+  const Point3 origin{.x = RandomDouble(-12, 12), .y = RandomDouble(0.1, 4), .z = RandomDouble(-12, 12)};
+  return {.Origin = origin, .Direction = Vec3::RandomUnitVector()};
+}
+}
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
+TEST_CASE("WideBvh nodes are cache-line aligned and mostly full")
+{
+  REQUIRE(alignof(WideBvhNode) == 64);
+
+  const auto list = RandomSpheres(5);
+  const WideBvh bvh(list.GetObjects());
+  const auto nodes = bvh.GetNodes();
+  REQUIRE_FALSE(nodes.empty());
+
+  std::size_t children = 0;
+  std::size_t primitives = 0;
+  for (const auto& node : nodes) {
+    REQUIRE(node.ChildCount >= 1);
+    REQUIRE(node.ChildCount <= WideBvhNode::Width);
+    children += node.ChildCount;
+    for (std::size_t lane = 0; lane < node.ChildCount; ++lane) {
+      primitives += node.Count[lane];
+      if (node.Count[lane] == 0) {
+        REQUIRE(node.Child[lane] < nodes.size());
+      }
+    }
+  }
+  REQUIRE(primitives == list.Size());
+  // Every node but the root is some node's child; the rest of the slots hold leaves
+  REQUIRE(children > 3 * nodes.size());
+}
+
+TEST_CASE("WideBvh finds the same closest hits as a linear list")
+{
+  const auto list = RandomSpheres(3);
+  const WideBvh bvh(list.GetObjects());
+
+  int hits = 0;
+  for (int i = 0; i < 2000; ++i) {
+    const auto ray = RandomRay();
+    HitData expected;
+    HitData actual;
+    const auto list_hit = list.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, expected);
+    const auto bvh_hit = bvh.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, actual);
+    REQUIRE(list_hit == bvh_hit);
+    REQUIRE(bvh.Occluded(ray, {.Min = 0.001, .Max = softrays::Infinity}) == list_hit);
+    if (list_hit) {
+      ++hits;
+      REQUIRE(actual.Time == expected.Time);
+      REQUIRE(actual.Material == expected.Material);
+    }
+  }
+  REQUIRE(hits > 100);
+
+  // Axis-aligned rays put the origin in the plane of some slabs
+  for (const auto& direction : {Vec3(1, 0, 0), Vec3(0, -1, 0), Vec3(0, 0, 1)}) {
+    const Ray ray{.Origin = Point3(0, 1, 0), .Direction = direction};
+    HitData expected;
+    HitData actual;
+    REQUIRE(list.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, expected) == bvh.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, actual));
+    REQUIRE(actual.Time == expected.Time);
+  }
+}
+
+TEST_CASE("WideBvh handles small and degenerate inputs")
+{
+  const auto material = std::make_shared<softrays::Lambertian>(softrays::Colour(0.5, 0.5, 0.5));
+  HitData hit;
+
+  HittableList one;
+  one.Add(std::make_shared<softrays::Sphere>(Point3(0, 0, -3), 1.0, material));
+  const WideBvh single(one.GetObjects());
+  REQUIRE(single.Hit({.Origin = Point3(0, 0, 0), .Direction = Vec3(0, 0, -1)}, {.Min = 0.001, .Max = softrays::Infinity}, hit));
+  REQUIRE_THAT(hit.Time, WithinAbs(2.0, 1e-12));
+  REQUIRE_FALSE(single.Hit({.Origin = Point3(0, 0, 0), .Direction = Vec3(0, 0, -1)}, {.Min = 0.001, .Max = 1.5}, hit));
+
+  HittableList same_place;
+  for (int i = 0; i < 100; ++i) {
+    same_place.Add(std::make_shared<softrays::Sphere>(Point3(0, 0, -3), 1.0, material));
+  }
+  const WideBvh stacked(same_place.GetObjects());
+  REQUIRE(stacked.Hit({.Origin = Point3(0, 0, 0), .Direction = Vec3(0, 0, -1)}, {.Min = 0.001, .Max = softrays::Infinity}, hit));
+  REQUIRE_THAT(hit.Time, WithinAbs(2.0, 1e-12));
+
+  const WideBvh empty({});
+  REQUIRE_FALSE(empty.Hit({.Origin = Point3(0, 0, 0), .Direction = Vec3(0, 0, -1)}, {.Min = 0.001, .Max = softrays::Infinity}, hit));
+}
+
+TEST_CASE("WideBvh against Bvh and HittableList on the final scene", "[.][benchmark]")
+{
+  const auto list = RandomSpheres(0);
+  const Bvh bvh(list.GetObjects());
+  const WideBvh wide(list.GetObjects());
+  std::vector<Ray> rays;
+  for (int i = 0; i < 10000; ++i) {
+    rays.push_back(RandomRay());
+  }
+
+  auto trace = [&rays](const softrays::Hittable& world) {
+    int hits = 0;
+    HitData hit;
+    for (const auto& ray : rays) {
+      hits += world.Hit(ray, {.Min = 0.001, .Max = softrays::Infinity}, hit) ? 1 : 0;
+    }
+    return hits;
+  };
+  BENCHMARK("HittableList")
+  {
+    return trace(list);
+  };
+  BENCHMARK("Bvh")
+  {
+    return trace(bvh);
+  };
+  BENCHMARK("WideBvh")
+  {
+    return trace(wide);
+  };
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)